@@ -0,0 +1,15 @@
+#include <stdio.h>
+
+void runJsonBenchmarks();
+void runValidatorBenchmarks();
+void runSqlBenchmarks();
+
+int main() {
+    printf("=== Lavandula Benchmarks ===\n\n");
+
+    runJsonBenchmarks();
+    runValidatorBenchmarks();
+    runSqlBenchmarks();
+
+    return 0;
+}
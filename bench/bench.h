@@ -0,0 +1,21 @@
+#ifndef bench_h
+#define bench_h
+
+#include <stdio.h>
+#include <time.h>
+
+static inline double benchNow() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// runs body `iterations` times and prints the mean time per iteration
+#define benchmark(name, iterations, body) do { \
+    double start = benchNow(); \
+    for (int _i = 0; _i < (iterations); _i++) { body; } \
+    double elapsed = benchNow() - start; \
+    printf("  %-40s %10.3f us/op\n", name, elapsed * 1e6 / (iterations)); \
+} while(0)
+
+#endif
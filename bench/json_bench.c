@@ -0,0 +1,340 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench.h"
+#include "../src/include/json.h"
+#include "../src/include/json_number.h"
+#include "../src/include/json_struct.h"
+
+#define ARRAY_SIZE 10000
+
+JSON_STRUCT(Todo,
+    FIELD(int, id),
+    FIELD(str, title),
+    FIELD(bool, completed)
+)
+
+static JsonBuilder *integerArrayDocument(JsonArray *array) {
+    *array = jsonArray();
+    for (int i = 0; i < ARRAY_SIZE; i++) {
+        jsonArrayAppend(array, jsonInteger(i * 7919 - 5000000));
+    }
+
+    JsonBuilder *root = jsonBuilder();
+    jsonPutArray(root, "values", array);
+
+    return root;
+}
+
+static JsonBuilder *doubleArrayDocument(JsonArray *array) {
+    *array = jsonArray();
+    for (int i = 0; i < ARRAY_SIZE; i++) {
+        jsonArrayAppend(array, jsonDouble((i * 7919 - 5000000) / 1024.0 + 0.1));
+    }
+
+    JsonBuilder *root = jsonBuilder();
+    jsonPutArray(root, "values", array);
+
+    return root;
+}
+
+static JsonBuilder *objectArrayDocument(JsonArray *array) {
+    *array = jsonArray();
+    for (int i = 0; i < ARRAY_SIZE; i++) {
+        JsonBuilder *todo = jsonBuilder();
+        jsonPutInteger(todo, "id", i);
+        jsonPutString(todo, "title", "Write the \"benchmark\" section");
+        jsonPutBool(todo, "completed", i % 2 == 0);
+
+        jsonArrayAppend(array, jsonObject(todo));
+    }
+
+    JsonBuilder *root = jsonBuilder();
+    jsonPutArray(root, "todos", array);
+
+    return root;
+}
+
+// 1000 paragraphs of about 1 KB, mostly ASCII with some accented text and a few escapes
+static JsonBuilder *textArrayDocument(JsonArray *array) {
+    static const char sentence[] = "The caf\xc3\xa9 on the corner serves \"na\xc3\xafve\" coffee to everyone who asks. ";
+
+    char paragraph[1024];
+    size_t length = 0;
+    while (length + sizeof(sentence) < sizeof(paragraph)) {
+        memcpy(paragraph + length, sentence, sizeof(sentence) - 1);
+        length += sizeof(sentence) - 1;
+    }
+    paragraph[length - 1] = '\n';
+    paragraph[length] = '\0';
+
+    *array = jsonArray();
+    for (int i = 0; i < 1000; i++) {
+        jsonArrayAppend(array, jsonString(paragraph));
+    }
+
+    JsonBuilder *root = jsonBuilder();
+    jsonPutArray(root, "paragraphs", array);
+
+    return root;
+}
+
+void runJsonBenchmarks() {
+    printf("json:\n");
+
+    JsonArray integers;
+    JsonBuilder *integerDocument = integerArrayDocument(&integers);
+
+    size_t length = 0;
+    benchmark("jsonStringify 10k integers", 200, {
+        char *json = jsonStringify(integerDocument);
+        length = strlen(json);
+        free(json);
+    });
+    printf("  %-40s %10zu bytes\n", "", length);
+
+    JsonArray packed = jsonIntegerArray();
+    for (int i = 0; i < ARRAY_SIZE; i++) {
+        jsonArrayAppendInteger64(&packed, i * 7919 - 5000000);
+    }
+
+    JsonBuilder *packedDocument = jsonBuilder();
+    jsonPutArray(packedDocument, "values", &packed);
+
+    benchmark("jsonStringify 10k packed integers", 200, {
+        char *json = jsonStringify(packedDocument);
+        free(json);
+    });
+
+    freeJsonBuilder(packedDocument);
+
+    benchmark("build + free 10k objects", 100, {
+        JsonArray built;
+        freeJsonBuilder(objectArrayDocument(&built));
+    });
+
+    // a typical list response, built and stringified once per request
+    benchmark("response of 100 objects, heap", 5000, {
+        JsonBuilder *root = jsonBuilder();
+        JsonArray todos = jsonArray();
+        jsonPutArray(root, "todos", &todos);
+
+        for (int k = 0; k < 100; k++) {
+            JsonBuilder *todo = jsonBuilder();
+            jsonPutInteger(todo, "id", k);
+            jsonPutString(todo, "title", "Write the section");
+            jsonPutBool(todo, "completed", k % 2 == 0);
+            jsonArrayAppend(&todos, jsonObject(todo));
+        }
+
+        free(jsonStringify(root));
+        freeJsonBuilder(root);
+    });
+
+    Arena requestArena = arena(0);
+    benchmark("response of 100 objects, arena", 5000, {
+        JsonBuilder *root = jsonArenaBuilder(&requestArena);
+        JsonArray todos = jsonArenaArray(&requestArena);
+        jsonPutArray(root, "todos", &todos);
+
+        for (int k = 0; k < 100; k++) {
+            JsonBuilder *todo = jsonArenaBuilder(&requestArena);
+            jsonPutInteger(todo, "id", k);
+            jsonPutString(todo, "title", "Write the section");
+            jsonPutBool(todo, "completed", k % 2 == 0);
+            jsonArrayAppend(&todos, jsonObject(todo));
+        }
+
+        jsonStringifyArena(root, &requestArena);
+        arenaReset(&requestArena);
+    });
+    freeArena(&requestArena);
+
+    JsonArray objects;
+    JsonBuilder *objectDocument = objectArrayDocument(&objects);
+
+    benchmark("jsonStringify 10k objects", 100, {
+        char *json = jsonStringify(objectDocument);
+        length = strlen(json);
+        free(json);
+    });
+    printf("  %-40s %10zu bytes\n", "", length);
+
+    char *integerJson = jsonStringify(integerDocument);
+    char *objectJson = jsonStringify(objectDocument);
+
+    benchmark("jsonParse 10k integers", 200, {
+        freeJsonBuilder(jsonParse(integerJson));
+    });
+
+    // modifying the parsed object copies its members, and the array, out of the document
+    benchmark("jsonParse + modify 10k integers", 200, {
+        JsonBuilder *parsed = jsonParse(integerJson);
+        jsonPutBool(parsed, "seen", true);
+        freeJsonBuilder(parsed);
+    });
+
+    benchmark("jsonParse 10k objects", 100, {
+        freeJsonBuilder(jsonParse(objectJson));
+    });
+
+    benchmark("jsonParse + jsonStringify 10k objects", 100, {
+        JsonBuilder *parsed = jsonParse(objectJson);
+        char *json = jsonStringify(parsed);
+        free(json);
+        freeJsonBuilder(parsed);
+    });
+
+    // the same objects from an array of structs, as a handler would write them
+    Todo *todos = malloc(sizeof(Todo) * ARRAY_SIZE);
+    for (int i = 0; i < ARRAY_SIZE; i++) {
+        todos[i] = (Todo) { .id = i, .title = "Write the \"benchmark\" section", .completed = i % 2 == 0 };
+    }
+
+    benchmark("build + jsonStringify 10k todos", 100, {
+        JsonArray array = jsonArray();
+        for (int k = 0; k < ARRAY_SIZE; k++) {
+            JsonBuilder *todo = jsonBuilder();
+            jsonPutInteger(todo, "id", todos[k].id);
+            jsonPutString(todo, "title", (char *)todos[k].title);
+            jsonPutBool(todo, "completed", todos[k].completed);
+
+            jsonArrayAppend(&array, jsonObject(todo));
+        }
+
+        JsonBuilder *root = jsonBuilder();
+        jsonPutArray(root, "todos", &array);
+
+        free(jsonStringify(root));
+        freeJsonBuilder(root);
+    });
+
+    benchmark("Todo_toJson 10k todos", 100, {
+        JsonWriter writer = jsonWriter();
+        jwObjectStart(&writer);
+        jwKey(&writer, "todos");
+        jwArrayStart(&writer);
+        for (int k = 0; k < ARRAY_SIZE; k++) {
+            Todo_toJson(&writer, &todos[k]);
+        }
+        jwArrayEnd(&writer);
+        jwObjectEnd(&writer);
+
+        free(jwTakeString(&writer));
+    });
+
+    long long completed = 0;
+    benchmark("jsonParse + jsonGet* 10k todos", 100, {
+        JsonBuilder *parsed = jsonParse(objectJson);
+        JsonArray *array = jsonGetArray(parsed, "todos");
+
+        for (int k = 0; k < ARRAY_SIZE; k++) {
+            JsonBuilder *todo = jsonArrayGet(array, k).object;
+            todos[k].id = jsonGetInteger(todo, "id");
+            todos[k].title = jsonGetString(todo, "title");
+            todos[k].completed = jsonGetBool(todo, "completed");
+            completed += todos[k].completed;
+        }
+
+        freeJsonBuilder(parsed);
+    });
+
+    benchmark("jsonParseDocument + Todo_fromJson 10k", 100, {
+        JsonDocument *document = jsonParseDocument(objectJson, strlen(objectJson));
+
+        JsonValue todosValue;
+        jsonValueFind(jsonDocumentRoot(document), "todos", &todosValue);
+
+        int k = 0;
+        for (JsonValue v = jsonValueFirst(todosValue); !jsonValueIsEnd(v); v = jsonValueSkip(v)) {
+            Todo_fromJson(v, &todos[k]);
+            completed += todos[k++].completed;
+        }
+
+        freeJsonDocument(document);
+    });
+    printf("  %-40s %10lld\n", "", completed / 200);
+
+    free(todos);
+    free(integerJson);
+    free(objectJson);
+
+    JsonArray doubles;
+    JsonBuilder *doubleDocument = doubleArrayDocument(&doubles);
+
+    benchmark("jsonStringify 10k doubles", 200, {
+        char *json = jsonStringify(doubleDocument);
+        length = strlen(json);
+        free(json);
+    });
+    printf("  %-40s %10zu bytes\n", "", length);
+
+    char buffer[32];
+    benchmark("snprintf %.17g 10k doubles (baseline)", 200, {
+        for (int k = 0; k < doubles.count; k++) {
+            snprintf(buffer, sizeof(buffer), "%.17g", doubles.items[k].number);
+        }
+    });
+
+    char *doubleJson = jsonStringify(doubleDocument);
+
+    benchmark("jsonParse 10k doubles", 200, {
+        freeJsonBuilder(jsonParse(doubleJson));
+    });
+
+    double total = 0;
+    benchmark("strtod 10k doubles (baseline)", 200, {
+        char *cursor = strchr(doubleJson, '[') + 1;
+        for (int k = 0; k < ARRAY_SIZE; k++) {
+            total += strtod(cursor, &cursor);
+            cursor += 2;
+        }
+    });
+    printf("  %-40s %10.0f\n", "", total / 200);
+
+    free(doubleJson);
+    freeJsonBuilder(doubleDocument);
+
+    JsonArray paragraphs;
+    JsonBuilder *textDocument = textArrayDocument(&paragraphs);
+
+    benchmark("jsonStringify 1 MB of text", 200, {
+        char *json = jsonStringify(textDocument);
+        length = strlen(json);
+        free(json);
+    });
+    printf("  %-40s %10zu bytes\n", "", length);
+
+    char *textJson = jsonStringify(textDocument);
+
+    benchmark("jsonParse 1 MB of text", 200, {
+        freeJsonBuilder(jsonParse(textJson));
+    });
+
+    free(textJson);
+    freeJsonBuilder(textDocument);
+
+    JsonBuilder *wide = jsonBuilder();
+    char keys[200][16];
+
+    for (int i = 0; i < 200; i++) {
+        snprintf(keys[i], sizeof(keys[i]), "setting_%d", i);
+        jsonPutInteger(wide, keys[i], i);
+    }
+
+    long long sum = 0;
+    benchmark("jsonGetInteger x200 on 200 members", 2000, {
+        for (int k = 0; k < 200; k++) {
+            sum += jsonGetInteger(wide, keys[k]);
+        }
+    });
+    printf("  %-40s %10lld\n", "", sum / 2000);
+
+    freeJsonBuilder(wide);
+
+    freeJsonBuilder(integerDocument);
+    freeJsonBuilder(objectDocument);
+
+    printf("\n");
+}
@@ -0,0 +1,340 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <poll.h>
+
+#include "bench.h"
+#include "../src/include/sql.h"
+#include "../src/include/sql_json.h"
+#include "../src/include/sql_writer.h"
+#include "../src/include/sql_cache.h"
+#include "../src/include/sql_async.h"
+#include "../src/include/sql_stats.h"
+#include "../src/include/app.h"
+#include "../src/include/json.h"
+
+static DbContext *todoDatabase(int rows) {
+    DbContext *db = createSqlLite3DbContext(":memory:");
+    dbExec(db, "create table todos (id integer primary key, title text, completed integer);", NULL, 0);
+
+    dbExec(db, "begin;", NULL, 0);
+    for (int i = 0; i < rows; i++) {
+        dbExec(db, "insert into todos (title, completed) values ('Write the benchmark section', ?);", DB_PARAMS(PARAM_BOOL(i % 2)), 1);
+    }
+    dbExec(db, "commit;", NULL, 0);
+
+    return db;
+}
+
+static void countCompleted(int colCount, char **colNames, char **colValues, void *userData) {
+    (void)colCount;
+    (void)colNames;
+    *(long long *)userData += atoll(colValues[2]);
+}
+
+// a client that reads and discards a response as fast as it can
+static void *discard(void *socket) {
+    char buffer[64 * 1024];
+    while (read(*(int *)socket, buffer, sizeof(buffer)) > 0);
+
+    return NULL;
+}
+
+static HttpResponse ignoreRows(RequestContext ctx, DbResult *result) {
+    (void)ctx;
+    (void)result;
+
+    return (HttpResponse) { .status = HTTP_OK };
+}
+
+// what the server loop does between requests until the query comes back
+static void resumeQuery(DbAsyncPool *async) {
+    DbAsyncQuery *query;
+
+    while (!(query = dbAsyncCompleted(async))) {
+        struct pollfd fd = { .fd = dbAsyncFd(async), .events = POLLIN };
+        poll(&fd, 1, 10);
+    }
+
+    freeDbAsyncQuery(query);
+}
+
+#define WRITER_THREADS 8
+#define WRITES_PER_THREAD 500
+
+static void *insertThroughWriter(void *writer) {
+    for (int i = 0; i < WRITES_PER_THREAD; i++) {
+        dbWrite(writer, "insert into todos (title, completed) values (?, 0);", DB_PARAMS(PARAM_TEXT("Write the benchmark section")), 1);
+    }
+
+    return NULL;
+}
+
+void runSqlBenchmarks() {
+    printf("sql:\n");
+
+    DbContext *db = todoDatabase(1000);
+
+    const char *point = "select id, title, completed from todos where id = ?;";
+    const char *update = "update todos set completed = ? where id = ?;";
+
+    dbSetStatementCacheSize(db, 0);
+
+    benchmark("dbQueryRows by id, no cache", 20000, {
+        freeDbResult(dbQueryRows(db, point, DB_PARAMS(PARAM_INT(_i % 1000 + 1)), 1));
+    });
+
+    benchmark("dbExec update by id, no cache", 20000, {
+        dbExec(db, update, DB_PARAMS(PARAM_BOOL(_i % 2), PARAM_INT(_i % 1000 + 1)), 2);
+    });
+
+    dbSetStatementCacheSize(db, DB_STATEMENT_CACHE_SIZE);
+
+    benchmark("dbQueryRows by id, cached", 20000, {
+        freeDbResult(dbQueryRows(db, point, DB_PARAMS(PARAM_INT(_i % 1000 + 1)), 1));
+    });
+
+    benchmark("dbExec update by id, cached", 20000, {
+        dbExec(db, update, DB_PARAMS(PARAM_BOOL(_i % 2), PARAM_INT(_i % 1000 + 1)), 2);
+    });
+    printf("  %-40s %10llu hits %llu misses\n", "", db->statements.hits, db->statements.misses);
+
+    // the same with every statement timed into DbStats
+    DbStats *timings = createDbStats(-1, NULL);
+    dbAttachStats(db, timings);
+
+    benchmark("dbQueryRows by id, timed", 20000, {
+        freeDbResult(dbQueryRows(db, point, DB_PARAMS(PARAM_INT(_i % 1000 + 1)), 1));
+    });
+
+    benchmark("dbExec update by id, timed", 20000, {
+        dbExec(db, update, DB_PARAMS(PARAM_BOOL(_i % 2), PARAM_INT(_i % 1000 + 1)), 2);
+    });
+
+    dbDetachStats(db);
+    freeDbStats(timings);
+
+    // the same reads through the query cache, which only runs SQLite on a miss
+    const char *grouped = "select completed, count(*) from todos group by completed;";
+
+    benchmark("group by over 1k rows, dbQueryRows", 2000, {
+        freeDbResult(dbQueryRows(db, grouped, NULL, 0));
+    });
+
+    DbQueryCache *cache = createDbQueryCache(DB_QUERY_CACHE_BUDGET, DB_QUERY_CACHE_TTL_MS);
+    dbAttachQueryCache(db, cache);
+
+    benchmark("dbQueryCached by id", 20000, {
+        freeDbResult(dbQueryCached(db, point, DB_PARAMS(PARAM_INT(_i % 1000 + 1)), 1));
+    });
+
+    benchmark("group by over 1k rows, dbQueryCached", 2000, {
+        freeDbResult(dbQueryCached(db, grouped, NULL, 0));
+    });
+
+    // 10 hot rows read 100 times for every write to the table, which invalidates all of them
+    benchmark("dbQueryCached by id, 1 write per 100", 20000, {
+        if (_i % 100 == 0) dbExec(db, update, DB_PARAMS(PARAM_BOOL(_i % 2), PARAM_INT(1)), 2);
+        freeDbResult(dbQueryCached(db, point, DB_PARAMS(PARAM_INT(_i % 10 + 1)), 1));
+    });
+
+    DbQueryCacheStats cacheStats = dbQueryCacheStats(cache);
+    printf("  %-40s %10llu hits %llu misses %llu invalidated\n", "", cacheStats.hits, cacheStats.misses, cacheStats.invalidations);
+
+    dbClose(db);
+    freeDbQueryCache(cache);
+
+    // a full scan of 100k rows, materialised, through a callback, and through a cursor
+    db = todoDatabase(100000);
+    const char *scan = "select id, title, completed from todos;";
+
+    long long total = 0;
+    benchmark("scan 100k rows, dbQueryRows", 20, {
+        DbResult *result = dbQueryRows(db, scan, NULL, 0);
+        for (int r = 0; r < result->rowCount; r++) {
+            total += dbGetInt64(result, r, 2);
+        }
+        freeDbResult(result);
+    });
+
+    benchmark("scan 100k rows, dbQueryEach", 20, {
+        dbQueryEach(db, scan, NULL, 0, countCompleted, &total);
+    });
+
+    benchmark("scan 100k rows, dbQueryCursor", 20, {
+        DbCursor cursor = dbQueryCursor(db, scan, NULL, 0);
+        while (dbNext(&cursor)) {
+            total += dbColumnInt64(&cursor, 2);
+        }
+    });
+    printf("  %-40s %10lld\n", "", total / 60);
+
+    dbClose(db);
+
+    // list responses, through a DbResult, a struct and a JsonBuilder, and written directly
+    db = todoDatabase(10000);
+
+    const char *page = "select id, title, completed from todos where id <= ?;";
+    int sizes[] = { 100, 10000 };
+
+    for (int s = 0; s < 2; s++) {
+        char name[64];
+        int iterations = 200000 / sizes[s];
+
+        snprintf(name, sizeof(name), "%d rows, dbQueryRows + JsonBuilder", sizes[s]);
+        benchmark(name, iterations, {
+            DbResult *result = dbQueryRows(db, page, DB_PARAMS(PARAM_INT(sizes[s])), 1);
+
+            JsonBuilder *root = jsonBuilder();
+            JsonArray todos = jsonArray();
+            jsonPutArray(root, "todos", &todos);
+
+            for (int r = 0; r < result->rowCount; r++) {
+                JsonBuilder *todo = jsonBuilder();
+                jsonPutInteger(todo, "id", dbGetInt(result, r, 0));
+                jsonPutString(todo, "title", (char *)dbGetText(result, r, 1, NULL));
+                jsonPutBool(todo, "completed", dbGetBool(result, r, 2));
+                jsonArrayAppend(&todos, jsonObject(todo));
+            }
+
+            free(jsonStringify(root));
+            freeJsonBuilder(root);
+            freeDbResult(result);
+        });
+
+        snprintf(name, sizeof(name), "%d rows, dbQueryJson", sizes[s]);
+        benchmark(name, iterations, {
+            JsonWriter writer = jsonWriter();
+            jwObjectStart(&writer);
+            jwKey(&writer, "todos");
+            dbQueryJson(db, page, DB_PARAMS(PARAM_INT(sizes[s])), 1, &writer);
+            jwObjectEnd(&writer);
+
+            free(jwTakeString(&writer));
+        });
+    }
+
+    dbClose(db);
+
+    // an export of 100k rows, all built in memory first, and streamed to a reading client
+    db = todoDatabase(100000);
+    const char *export = "select id, title, completed from todos;";
+
+    benchmark("export 100k rows, dbQueryJson in memory", 10, {
+        JsonWriter writer = jsonWriter();
+        dbQueryJson(db, export, NULL, 0, &writer);
+        free(jwTakeString(&writer));
+    });
+
+    int sockets[2];
+    socketpair(AF_UNIX, SOCK_STREAM, 0, sockets);
+
+    pthread_t client;
+    pthread_create(&client, NULL, discard, &sockets[1]);
+
+    ResponseStream stream;
+    RequestContext ctx = { .db = db, .stream = &stream };
+
+    benchmark("export 100k rows, dbStreamJson", 10, {
+        stream = responseStream(sockets[0]);
+        dbStreamJson(ctx, export, NULL, 0);
+    });
+
+    close(sockets[0]);
+    pthread_join(client, NULL);
+    close(sockets[1]);
+
+    dbClose(db);
+
+    // single row inserts into a file, each its own transaction
+    char path[] = "/tmp/lavandula_bench_XXXXXX";
+    close(mkstemp(path));
+
+    db = createSqlLite3DbContext(path);
+    dbExec(db, "create table todos (id integer primary key, title text, completed integer);", NULL, 0);
+
+    benchmark("insert, rollback journal, default pragmas", 200, {
+        dbExec(db, "insert into todos (title, completed) values (?, 0);", DB_PARAMS(PARAM_TEXT("Write the benchmark section")), 1);
+    });
+
+    dbClose(db);
+
+    DbPool *pool = createDbPool(path, 2, dbDefaultPragmas());
+    db = dbPoolConnection(pool);
+
+    benchmark("insert, pooled, dbDefaultPragmas", 2000, {
+        dbExec(db, "insert into todos (title, completed) values (?, 0);", DB_PARAMS(PARAM_TEXT("Write the benchmark section")), 1);
+    });
+
+    benchmark("dbQueryRows by id, pooled file", 20000, {
+        freeDbResult(dbQueryRows(db, point, DB_PARAMS(PARAM_INT(_i % 2000 + 1)), 1));
+    });
+
+    // the same query handed to a database thread, until its result is back on this one
+    App app = { .dbPool = pool, .dbAsync = createDbAsyncPool(pool, 1) };
+    ResponseStream asyncStream = responseStream(-1);
+    RequestContext asyncCtx = requestContext(&app, (HttpRequest) { .resource = "/todo" });
+    asyncCtx.stream = &asyncStream;
+
+    benchmark("dbQueryAsync by id, round trip", 20000, {
+        dbQueryAsync(asyncCtx, point, DB_PARAMS(PARAM_INT(_i % 2000 + 1)), 1, ignoreRows);
+        resumeQuery(app.dbAsync);
+    });
+
+    freeDbAsyncPool(app.dbAsync);
+    freeDbPool(pool);
+
+    // the same inserts with every commit synced, one by one, as one dbExecMany, and queued by
+    // several threads to a writer that commits them in batches
+    DbPragmas full = dbDefaultPragmas();
+    full.synchronous = "FULL";
+
+    pool = createDbPool(path, 1, full);
+    db = dbPoolConnection(pool);
+
+    benchmark("insert, autocommit, synchronous=FULL", 500, {
+        dbExec(db, "insert into todos (title, completed) values (?, 0);", DB_PARAMS(PARAM_TEXT("Write the benchmark section")), 1);
+    });
+
+    DbParam *rows = malloc(sizeof(DbParam) * 1000);
+    for (int i = 0; i < 1000; i++) {
+        rows[i] = PARAM_TEXT("Write the benchmark section");
+    }
+
+    benchmark("insert 1000 rows, dbExecMany", 20, {
+        dbExecMany(db, "insert into todos (title, completed) values (?, 0);", rows, 1, 1000);
+    });
+    free(rows);
+
+    freeDbPool(pool);
+
+    DbWriter *writer = createDbWriter(path, full);
+    pthread_t threads[WRITER_THREADS];
+
+    double start = benchNow();
+    for (int i = 0; i < WRITER_THREADS; i++) {
+        pthread_create(&threads[i], NULL, insertThroughWriter, writer);
+    }
+    for (int i = 0; i < WRITER_THREADS; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    double elapsed = benchNow() - start;
+
+    DbWriterStats stats = dbWriterStats(writer);
+    printf("  %-40s %10.3f us/op\n", "insert, dbWrite from 8 threads", elapsed * 1e6 / stats.writes);
+    printf("  %-40s %10.0f writes/s %.1f per batch\n", "", stats.writes / elapsed, (double)stats.writes / stats.batches);
+
+    freeDbWriter(writer);
+
+    char sidecar[64];
+    snprintf(sidecar, sizeof(sidecar), "%s-wal", path);
+    unlink(sidecar);
+    snprintf(sidecar, sizeof(sidecar), "%s-shm", path);
+    unlink(sidecar);
+    unlink(path);
+
+    printf("\n");
+}
@@ -0,0 +1,76 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench.h"
+#include "../src/include/json.h"
+#include "../src/include/validator.h"
+
+static const char *signup =
+    "{\"username\": \"ada_lovelace\", \"email\": \"ada@example.com\", \"password\": \"correct horse battery\","
+    " \"age\": 36, \"role\": \"member\", \"newsletter\": true,"
+    " \"address\": {\"street\": \"12 St James's Square\", \"city\": \"London\", \"zip\": \"SW1Y 4JH\"},"
+    " \"interests\": [\"mathematics\", \"engines\", \"poetry\"]}";
+
+void runValidatorBenchmarks() {
+    printf("validator:\n");
+
+    const char *roles[] = { "admin", "member", "guest" };
+
+    JsonValidator v = createValidator();
+    required(&v, "username");
+    required(&v, "email");
+    required(&v, "password");
+    required(&v, "address.city");
+    isString(&v, "username", 3, 32);
+    isString(&v, "password", 8, 128);
+    isInteger(&v, "age", 13, 150);
+    isOneOf(&v, "role", roles, 3);
+    isBool(&v, "newsletter");
+    isString(&v, "address.city", 1, 64);
+    isArray(&v, "interests", 16);
+    compileValidator(&v);
+
+    size_t length = strlen(signup);
+
+    // what validate() did before: parse the whole body, then look up each required key
+    int valid = 0;
+    benchmark("jsonParse + jsonHasKey x4 signup", 20000, {
+        JsonBuilder *body = jsonParse((char *)signup);
+        JsonBuilder *address = jsonGetJson(body, "address");
+        valid += jsonHasKey(body, "username") && jsonHasKey(body, "email") &&
+                 jsonHasKey(body, "password") && jsonHasKey(address, "city");
+        freeJsonBuilder(body);
+    });
+
+    benchmark("compiled schema, 11 rules, signup", 20000, {
+        valid += validateJson(&v, signup, length);
+    });
+    printf("  %-40s %10d\n", "", valid);
+
+    // a 1 MB body whose first field breaks a rule
+    size_t largeLength = 1024 * 1024;
+    char *large = malloc(largeLength + 1);
+
+    int prefix = snprintf(large, largeLength, "{\"age\": 7, \"interests\": [");
+    size_t p = prefix;
+    while (p + 16 < largeLength) {
+        memcpy(large + p, "\"abcdefghij\", ", 14);
+        p += 14;
+    }
+    memcpy(large + p, "\"x\"]}", 6);
+    largeLength = p + 5;
+
+    benchmark("jsonParse 1 MB invalid body", 50, {
+        freeJsonBuilder(jsonParse(large));
+    });
+
+    benchmark("compiled schema, 1 MB invalid body", 50, {
+        valid += validateJson(&v, large, largeLength);
+    });
+
+    free(large);
+    freeValidator(&v);
+
+    printf("\n");
+}
@@ -33,11 +33,9 @@ HttpResponse getTodos(RequestContext ctx) {
     jsonPutArray(root, "todos", &array);
 
     for (int i = 0; i < result->rowCount; i++) {
-        DbRow *row = &result->rows[i];
-
         Todo todo = {
-            .name = strdup(row->colValues[0]),
-            .id = atoi(row->colValues[1])
+            .name = strdup(dbGetText(result, i, 0, NULL)),
+            .id = dbGetInt(result, i, 1)
         };
         
         jsonArrayAppend(&array, todoToJson(todo));
@@ -1,65 +1,55 @@
 
 #include "../include/lavandula.h"
 
-typedef struct {
-    int id;
-    char title[100];
-    bool completed;
-} Todo;
-
-Todo rowToTodo(DbRow row) {
+// declares the Todo struct along with Todo_toJson and Todo_fromJson
+JSON_STRUCT(Todo,
+    FIELD(int, id),
+    FIELD(str, title),
+    FIELD(bool, completed)
+)
+
+// title points into the result, so the todo is valid for as long as the result is
+Todo rowToTodo(DbResult *result, int row) {
     Todo todo;
 
-    todo.id = atoi(row.colValues[0]);
-    strcpy(todo.title, row.colValues[1]);
-    todo.completed = atoi(row.colValues[2]);
+    todo.id = dbGetInt(result, row, 0);
+    todo.title = dbGetText(result, row, 1, NULL);
+    todo.completed = dbGetBool(result, row, 2);
 
     return todo;
 }
 
-Json todoToJson(Todo todo) {
-    JsonBuilder *builder = jsonBuilder();
-
-    jsonPutInteger(builder, "id", todo.id);
-    jsonPutString(builder, "title", todo.title);
-    jsonPutBool(builder, "completed", todo.completed);
-
-    return jsonObject(builder);
-}
-
+// the rows are written straight into the response, each column as its own JSON type
 appRoute(getTodos, ctx) {
-    DbResult *result = dbQueryRows(ctx.db, "select * from todos;", NULL, 0);
-    if (!result) { 
-        return internalServerError("Database query failed", TEXT_PLAIN); 
-    }
+    JsonWriter writer = jsonWriter();
+    jwObjectStart(&writer);
+    jwKey(&writer, "todos");
 
-    JsonBuilder *root = jsonBuilder();
-    JsonArray array = jsonArray();
-    jsonPutArray(root, "todos", &array);
-    
-    for (int i = 0; i < result->rowCount; i++) {
-        jsonArrayAppend(&array, todoToJson(rowToTodo(result->rows[i])));
+    if (!dbQueryJson(ctx.db, "select id, title, completed from todos;", NULL, 0, &writer)) {
+        freeJsonWriter(&writer);
+        return internalServerError("Database query failed", TEXT_PLAIN);
     }
 
-    char *json = jsonStringify(root);
-    freeJsonBuilder(root);
+    jwObjectEnd(&writer);
 
-    return ok(json, APPLICATION_JSON);
+    return ok(jwTakeString(&writer), APPLICATION_JSON);
 }
 
 appRoute(createTodo, ctx) {
-    JsonBuilder *builder = jsonParse(ctx.request.body);
+    JsonValue body;
+    Todo todo = { 0 };
 
-    if (!jsonHasKey(builder, "title")) { 
-        return internalServerError("Missing 'title' in request body", TEXT_PLAIN); 
+    if (!jsonBuilderValue(ctx.body, &body) || !Todo_fromJson(body, &todo)) {
+        return badRequest("Invalid todo in request body", TEXT_PLAIN);
     }
 
-    char *name = jsonGetString(builder, "title");
-    bool completed = jsonGetBool(builder, "completed");
+    if (!todo.title) { 
+        return internalServerError("Missing 'title' in request body", TEXT_PLAIN); 
+    }
 
     DbParam *params = DB_PARAMS(
-        PARAM_TEXT(name),
-        PARAM_BOOL(completed)
+        PARAM_TEXT((char *)todo.title),
+        PARAM_BOOL(todo.completed)
     );
 
     bool result = dbExec(ctx.db, "insert into todos (title, completed) values (?, ?);", params, 2);
@@ -120,13 +110,11 @@ appRoute(deleteTodo, ctx) {
 }
 
 appRoute(getTodo, ctx) {
-    JsonBuilder *builder = jsonParse(ctx.request.body);
-
-    if (!jsonHasKey(builder, "id")) { 
+    if (!jsonResolve(ctx.body) || !jsonHasKey(ctx.body, "id")) { 
         return internalServerError("Missing 'id' in request body", TEXT_PLAIN); 
     }
 
-    int id = jsonGetInteger(builder, "id");
+    int id = jsonGetInteger(ctx.body, "id");
 
     DbParam *params = DB_PARAMS(
         PARAM_INT(id)
@@ -138,16 +126,22 @@ appRoute(getTodo, ctx) {
     }
 
     if (result->rowCount == 0) {
+        freeDbResult(result);
         return internalServerError("Todo not found", TEXT_PLAIN);
     }
 
-    JsonBuilder *root = jsonBuilder();
+    Todo todo = rowToTodo(result, 0);
+
+    JsonWriter writer = jsonWriter();
+    jwObjectStart(&writer);
+    jwKey(&writer, "todo");
+    Todo_toJson(&writer, &todo);
+    jwObjectEnd(&writer);
 
-    Json todo = todoToJson(rowToTodo(result->rows[0]));
-    jsonPutJson(root, "todo", todo);
+    // the title is written, so the result can go
+    freeDbResult(result);
 
-    char *json = jsonStringify(root);
-    return ok(json, APPLICATION_JSON);
+    return ok(jwTakeString(&writer), APPLICATION_JSON);
 }
 
 int main(int argc, char *argv[]) {
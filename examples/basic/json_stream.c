@@ -0,0 +1,35 @@
+#include "../include/lavandula.h"
+
+// streams a large array to the client in chunks without building a JsonBuilder tree
+appRoute(numbers, ctx) {
+    JsonWriter writer = jsonStreamWriter(ctx, HTTP_OK);
+
+    jwObjectStart(&writer);
+    jwKey(&writer, "numbers");
+    jwArrayStart(&writer);
+
+    for (int i = 0; i < 100000; i++) {
+        jwObjectStart(&writer);
+        jwKey(&writer, "value");
+        jwInt(&writer, i);
+        jwKey(&writer, "even");
+        jwBool(&writer, i % 2 == 0);
+        jwObjectEnd(&writer);
+    }
+
+    jwArrayEnd(&writer);
+    jwObjectEnd(&writer);
+
+    return jwEndStream(&writer);
+}
+
+int main(int argc, char *argv[]) {
+    AppBuilder builder = createBuilder();
+    App app = build(builder);
+
+    get(&app, "/numbers", numbers);
+
+    runApp(&app);
+
+    return 0;
+}
@@ -0,0 +1,139 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../include/arena.h"
+
+#define ARENA_ALIGNMENT 16
+
+struct ArenaBlock {
+    ArenaBlock *next;
+    size_t      used;
+    size_t      capacity;
+    _Alignas(ARENA_ALIGNMENT) char data[];
+};
+
+struct ArenaCleanup {
+    ArenaCleanup *next;
+    void        (*cleanup)(void *data);
+    void         *data;
+};
+
+Arena arena(size_t blockSize) {
+    return (Arena) {
+        .head = NULL,
+        .blockSize = blockSize == 0 ? ARENA_DEFAULT_BLOCK_SIZE : blockSize,
+        .cleanups = NULL,
+    };
+}
+
+// the cleanup records live in the arena, so they run before any block is released
+static void runCleanups(Arena *arena) {
+    ArenaCleanup *cleanup = arena->cleanups;
+    arena->cleanups = NULL;
+
+    while (cleanup) {
+        cleanup->cleanup(cleanup->data);
+        cleanup = cleanup->next;
+    }
+}
+
+void freeArena(Arena *arena) {
+    if (!arena) return;
+
+    runCleanups(arena);
+
+    ArenaBlock *block = arena->head;
+    while (block) {
+        ArenaBlock *next = block->next;
+        free(block);
+        block = next;
+    }
+
+    arena->head = NULL;
+}
+
+void arenaReset(Arena *arena) {
+    if (!arena) return;
+
+    runCleanups(arena);
+
+    // keep one regular sized block around so the next use does not have to malloc
+    ArenaBlock *kept = NULL;
+    ArenaBlock *block = arena->head;
+
+    while (block) {
+        ArenaBlock *next = block->next;
+
+        if (!kept && block->capacity == arena->blockSize) {
+            kept = block;
+            kept->used = 0;
+            kept->next = NULL;
+        } else {
+            free(block);
+        }
+
+        block = next;
+    }
+
+    arena->head = kept;
+}
+
+static ArenaBlock *newBlock(size_t capacity) {
+    ArenaBlock *block = malloc(sizeof(ArenaBlock) + capacity);
+    if (!block) {
+        fprintf(stderr, "Fatal: out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+
+    block->next = NULL;
+    block->used = 0;
+    block->capacity = capacity;
+
+    return block;
+}
+
+void *arenaAlloc(Arena *arena, size_t size) {
+    size = (size + ARENA_ALIGNMENT - 1) & ~(size_t)(ARENA_ALIGNMENT - 1);
+
+    ArenaBlock *block = arena->head;
+
+    if (!block || block->capacity - block->used < size) {
+        // oversized allocations get a block of their own behind the current one
+        if (size > arena->blockSize / 2 && block) {
+            ArenaBlock *large = newBlock(size);
+            large->used = size;
+            large->next = block->next;
+            block->next = large;
+            return large->data;
+        }
+
+        block = newBlock(size > arena->blockSize ? size : arena->blockSize);
+        block->next = arena->head;
+        arena->head = block;
+    }
+
+    void *ptr = block->data + block->used;
+    block->used += size;
+
+    return ptr;
+}
+
+char *arenaStrndup(Arena *arena, const char *str, size_t length) {
+    char *copy = arenaAlloc(arena, length + 1);
+
+    memcpy(copy, str, length);
+    copy[length] = '\0';
+
+    return copy;
+}
+
+void arenaDefer(Arena *arena, void (*cleanup)(void *data), void *data) {
+    ArenaCleanup *record = arenaAlloc(arena, sizeof(ArenaCleanup));
+
+    record->next = arena->cleanups;
+    record->cleanup = cleanup;
+    record->data = data;
+
+    arena->cleanups = record;
+}
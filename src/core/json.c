@@ -3,6 +3,9 @@
 #include <string.h>
 
 #include "../include/json.h"
+#include "../include/json_shape.h"
+#include "../include/json_tape.h"
+#include "../include/json_writer.h"
 
 JsonBuilder *jsonBuilder() {
     JsonBuilder *builder = malloc(sizeof(JsonBuilder));
@@ -16,6 +19,36 @@ JsonBuilder *jsonBuilder() {
     builder->jsonCount = 0;
     builder->jsonCapacity = 0;
 
+    builder->index = NULL;
+    builder->indexCapacity = 0;
+
+    builder->shape = jsonEmptyShape();
+
+    builder->source = NULL;
+    builder->sourceLength = 0;
+    builder->isPending = false;
+    builder->isInvalid = false;
+
+    builder->document = NULL;
+    builder->tapeIndex = 0;
+    builder->isView = false;
+    builder->ownsDocument = false;
+    builder->arenaAllocated = false;
+    builder->arena = NULL;
+    builder->nextMaterialized = NULL;
+
+    return builder;
+}
+
+JsonBuilder *jsonArenaBuilder(Arena *arena) {
+    JsonBuilder *builder = arenaAlloc(arena, sizeof(JsonBuilder));
+
+    *builder = (JsonBuilder) {
+        .shape = jsonEmptyShape(),
+        .arenaAllocated = true,
+        .arena = arena,
+    };
+
     return builder;
 }
 
@@ -23,10 +56,37 @@ JsonArray jsonArray() {
     return (JsonArray) {
         .items = NULL,
         .count = 0,
-        .capacity = 0
+        .capacity = 0,
+        .type = JSON_ARRAY_MIXED,
     };
 }
 
+static JsonArray packedArray(JsonArrayType type) {
+    JsonArray array = jsonArray();
+    array.type = type;
+
+    return array;
+}
+
+JsonArray jsonArenaArray(Arena *arena) {
+    JsonArray array = jsonArray();
+    array.arena = arena;
+
+    return array;
+}
+
+JsonArray jsonIntegerArray() {
+    return packedArray(JSON_ARRAY_INTEGERS);
+}
+
+JsonArray jsonDoubleArray() {
+    return packedArray(JSON_ARRAY_DOUBLES);
+}
+
+JsonArray jsonStringArray() {
+    return packedArray(JSON_ARRAY_STRINGS);
+}
+
 static void freeJson(Json json){
     if (json.type == JSON_STRING && json.value) {
         free(json.value);
@@ -36,25 +96,55 @@ static void freeJson(Json json){
         freeJsonArray(json.array);
     }
 
-    if (json.key != NULL) {
+    if (json.ownsKey) {
         free(json.key);
     }
 }
 
 void freeJsonArray(JsonArray *jsonArray) {
-    for (int i = 0; i < jsonArray->count; i++) {
-        Json json = jsonArray->items[i];
-        freeJson(json);
+    if (jsonArray->arena) return;
+
+    switch (jsonArray->type) {
+        case JSON_ARRAY_INTEGERS:
+            free(jsonArray->integers);
+            break;
+        case JSON_ARRAY_DOUBLES:
+            free(jsonArray->numbers);
+            break;
+        case JSON_ARRAY_STRINGS:
+            if (!jsonArray->borrowsStrings) {
+                for (int i = 0; i < jsonArray->count; i++) {
+                    free(jsonArray->strings[i].value);
+                }
+            }
+            free(jsonArray->strings);
+            break;
+        default:
+            for (int i = 0; i < jsonArray->count; i++) {
+                Json json = jsonArray->items[i];
+                freeJson(json);
+            }
+            free(jsonArray->items);
+            break;
     }
-    free(jsonArray->items);
 }
 
-void freeJsonBuilder(JsonBuilder *builder) {
-    if (!builder) return;
+// the index of an arena view lives in the arena too
+static void releaseIndex(JsonBuilder *builder) {
+    if (!builder->arenaAllocated) free(builder->index);
 
-    for (int i = 0; i < builder->jsonCount; i++) {
-        Json json = builder->json[i];
-        freeJson(json);
+    builder->index = NULL;
+    builder->indexCapacity = 0;
+}
+
+static void freeJsonNodes(JsonBuilder *builder) {
+    releaseIndex(builder);
+
+    if (!builder->isView) {
+        for (int i = 0; i < builder->jsonCount; i++) {
+            Json json = builder->json[i];
+            freeJson(json);
+        }
     }
 
     free(builder->json);
@@ -62,12 +152,52 @@ void freeJsonBuilder(JsonBuilder *builder) {
     builder->json = NULL;
     builder->jsonCount = 0;
     builder->jsonCapacity = 0;
+}
+
+void freeJsonBuilder(JsonBuilder *builder) {
+    if (!builder || builder->arenaAllocated) return;
+
+    freeJsonNodes(builder);
+
+    if (builder->ownsDocument) {
+        for (JsonBuilder *view = builder->document->materialized; view; view = view->nextMaterialized) {
+            freeJsonNodes(view);
+        }
+
+        freeJsonDocument(builder->document);
+    }
 
     free(builder);
 }
 
+static void materialize(JsonBuilder *builder);
+static void adoptJson(Arena *arena, Json *json);
+
+static void indexInsert(JsonIndexSlot *index, unsigned int capacity, unsigned int hash, unsigned int position) {
+    unsigned int mask = capacity - 1;
+    unsigned int slot = hash & mask;
+
+    while (index[slot].position) {
+        slot = (slot + 1) & mask;
+    }
+
+    index[slot].hash = hash;
+    index[slot].position = position + 1;
+}
+
 void addJson(JsonBuilder *builder, Json json) {
-    if (builder->jsonCount >= builder->jsonCapacity) {
+    jsonResolve(builder);
+    materialize(builder);
+
+    if (builder->jsonCount >= builder->jsonCapacity && builder->arena) {
+        int capacity = builder->jsonCapacity == 0 ? JSON_ARENA_INITIAL_CAPACITY : builder->jsonCapacity * 2;
+
+        Json *json = arenaAlloc(builder->arena, sizeof(Json) * capacity);
+        if (builder->jsonCount) memcpy(json, builder->json, sizeof(Json) * builder->jsonCount);
+
+        builder->json = json;
+        builder->jsonCapacity = capacity;
+    } else if (builder->jsonCount >= builder->jsonCapacity) {
         builder->jsonCapacity = builder->jsonCapacity == 0 ? 1 : builder->jsonCapacity * 2;
         builder->json = realloc(builder->json, sizeof(Json) * builder->jsonCapacity);
 
@@ -77,25 +207,50 @@ void addJson(JsonBuilder *builder, Json json) {
         }
     }
     builder->json[builder->jsonCount++] = json;
+
+    // parsed objects and keys that could not be interned leave the builder without a shape
+    if (builder->shape) {
+        builder->shape = json.ownsKey ? NULL : jsonShapeAdd(builder->shape, json.key);
+    }
+
+    if (builder->index) {
+        // rebuilt at twice the size by the next lookup
+        if ((unsigned int)builder->jsonCount * 2 > builder->indexCapacity) {
+            releaseIndex(builder);
+        } else {
+            const char *key = json.key ? json.key : "";
+            indexInsert(builder->index, builder->indexCapacity, jsonHashKey(key, strlen(key)), builder->jsonCount - 1);
+        }
+    }
+}
+
+// shares the interned copy of key, or copies it if the key cannot be interned
+static void setKey(Json *json, const char *key) {
+    json->key = (char *)jsonInternKey(key, strlen(key));
+    json->ownsKey = json->key == NULL;
+
+    if (json->ownsKey) {
+        json->key = strdup(key);
+
+        if (!json->key) {
+            fprintf(stderr, "Fatal: out of memory\n");
+            exit(EXIT_FAILURE);
+        }
+    }
 }
 
 static Json makeJson(char *key, JsonType type) {
     Json json = (Json){
         .type = type,
-        .key = strdup(key),
     };
-
-    if (!json.key) {
-        fprintf(stderr, "Fatal: out of memory\n");
-        exit(EXIT_FAILURE);
-    }
+    setKey(&json, key);
 
     return json;
 }
 
 void jsonPutString(JsonBuilder *builder, char *key, char *value) {
     Json json = makeJson(key, JSON_STRING);
-    json.value = strdup(value);
+    json.value = builder->arena ? arenaStrndup(builder->arena, value, strlen(value)) : strdup(value);
 
     if (!json.value) {
         fprintf(stderr, "Fatal: out of memory\n");
@@ -119,6 +274,20 @@ void jsonPutInteger(JsonBuilder *builder, char *key, int value) {
     addJson(builder, json);
 }
 
+void jsonPutInteger64(JsonBuilder *builder, char *key, long long value) {
+    Json json = makeJson(key, JSON_NUMBER);
+    json.integer = value;
+
+    addJson(builder, json);
+}
+
+void jsonPutDouble(JsonBuilder *builder, char *key, double value) {
+    Json json = makeJson(key, JSON_DOUBLE);
+    json.number = value;
+
+    addJson(builder, json);
+}
+
 void jsonPutNull(JsonBuilder *builder, char *key) {
     Json json = makeJson(key, JSON_NULL);
 
@@ -129,15 +298,15 @@ void jsonPutObject(JsonBuilder *builder, char *key, JsonBuilder *object) {
     Json json = makeJson(key, JSON_OBJECT);
     json.object = object;
 
+    if (builder->arena) adoptJson(builder->arena, &json);
+
     addJson(builder, json);
 }
 
 void jsonPutJson(JsonBuilder *builder, char *key, Json value) {
-    value.key = strdup(key);
-    if (!value.key) {
-        fprintf(stderr, "Fatal: out of memory\n");
-        exit(EXIT_FAILURE);
-    }
+    setKey(&value, key);
+
+    if (builder->arena) adoptJson(builder->arena, &value);
 
     addJson(builder, value);
 }
@@ -146,6 +315,8 @@ void jsonPutArray(JsonBuilder *builder, char *key, JsonArray *array) {
     Json json = makeJson(key, JSON_ARRAY);
     json.array = array;
 
+    if (builder->arena) adoptJson(builder->arena, &json);
+
     addJson(builder, json);
 }
 
@@ -157,6 +328,22 @@ Json jsonInteger(int value) {
     };
 }
 
+Json jsonInteger64(long long value) {
+    return (Json) {
+        .type = JSON_NUMBER,
+        .key = NULL,
+        .integer = value,
+    };
+}
+
+Json jsonDouble(double value) {
+    return (Json) {
+        .type = JSON_DOUBLE,
+        .key = NULL,
+        .number = value,
+    };
+}
+
 Json jsonBool(bool value) {
     return (Json) {
         .type = value ? JSON_TRUE : JSON_FALSE,
@@ -196,411 +383,620 @@ Json jsonArrayJson(JsonArray *array) {
     };
 }
 
-void jsonArrayAppend(JsonArray *array, Json value) {
-    if (array->count >= array->capacity) {
-        array->capacity = array->capacity == 0 ? 1 : array->capacity * 2;
-        array->items = realloc(array->items, sizeof(Json) * array->capacity);
+// arena storage cannot be resized, the count elements in use are copied over instead
+static void *resizeStorage(Arena *arena, void *storage, int count, int capacity, size_t elementSize) {
+    if (arena) {
+        void *resized = arenaAlloc(arena, elementSize * capacity);
+        if (count) memcpy(resized, storage, elementSize * count);
 
-        if (!array->items) {
-            fprintf(stderr, "Fatal: out of memory\n");
-            exit(EXIT_FAILURE);
-        }
+        return resized;
     }
-    array->items[array->count++] = value;
-}
 
-char *jsonStringify(JsonBuilder *builder) {
-    if (!builder) return NULL;
-    
-    int capacity = 16;
-    int length = 0;
-    char *json = malloc(capacity);
+    storage = realloc(storage, elementSize * capacity);
 
-    if (!json) {
+    if (!storage) {
         fprintf(stderr, "Fatal: out of memory\n");
         exit(EXIT_FAILURE);
     }
 
-    json[length++] = '{';
+    return storage;
+}
 
-    for (int i = 0; i < builder->jsonCount; i++) {
-        Json node = builder->json[i];
-        char buffer[256];
-
-        switch (node.type) {
-            case JSON_STRING:
-                snprintf(buffer, sizeof(buffer), "\"%s\": \"%s\"", node.key, node.value);
-                break;
-            case JSON_TRUE:
-                snprintf(buffer, sizeof(buffer), "\"%s\": true", node.key);
-                break;
-            case JSON_FALSE:
-                snprintf(buffer, sizeof(buffer), "\"%s\": false", node.key);
-                break;
-            case JSON_NUMBER:
-                snprintf(buffer, sizeof(buffer), "\"%s\": %d", node.key, node.integer);
-                break;
-            case JSON_NULL:
-                snprintf(buffer, sizeof(buffer), "\"%s\": null", node.key);
-                break;
-            case JSON_ARRAY: {
-                int arrCap = 64;
-                int arrLen = 0;
-                char *arrStr = malloc(arrCap);
-                
-                if (!arrStr) {
-                    fprintf(stderr, "Fatal: out of memory\n");
-                    exit(EXIT_FAILURE);
-                }
+static void reserveElement(JsonArray *array) {
+    if (array->count < array->capacity) return;
 
-                arrStr[arrLen++] = '[';
-
-                for (int j = 0; j < node.array->count; j++) {
-                    Json arrItem = node.array->items[j];
-                    char arrBuf[256];
-                    switch (arrItem.type) {
-                        case JSON_STRING:
-                            snprintf(arrBuf, sizeof(arrBuf), "\"%s\"", arrItem.value);
-                            break;
-                        case JSON_NUMBER:
-                            snprintf(arrBuf, sizeof(arrBuf), "%d", arrItem.integer);
-                            break;
-                        case JSON_TRUE:
-                            snprintf(arrBuf, sizeof(arrBuf), "true");
-                            break;
-                        case JSON_FALSE:
-                            snprintf(arrBuf, sizeof(arrBuf), "false");
-                            break;
-                        case JSON_NULL:
-                            snprintf(arrBuf, sizeof(arrBuf), "null");
-                            break;
-                        case JSON_OBJECT: {
-                            char *nested = jsonStringify(arrItem.object);
-                            snprintf(arrBuf, sizeof(arrBuf), "%s", nested);
-                            free(nested);
-                            break;
-                        }
-                        case JSON_ARRAY: {
-                            // char *nested = jsonStringify(arrItem.array);
-                            // snprintf(arrBuf, sizeof(arrBuf), "%s", nested);
-                            // free(nested);
-                            break;
-                        }
-                        default:
-                            arrBuf[0] = '\0';
-                            break;
-                    }
-                    int arrBufLen = strlen(arrBuf);
-                    if (arrLen + arrBufLen + 3 > arrCap) {
-                        arrCap = (arrLen + arrBufLen + 3) * 2;
-                        arrStr = realloc(arrStr, arrCap);
-
-                        if (!arrStr) {
-                            fprintf(stderr, "Fatal: out of memory\n");
-                            exit(EXIT_FAILURE);
-                        }
-                    }
-                    memcpy(arrStr + arrLen, arrBuf, arrBufLen);
-                    arrLen += arrBufLen;
-                    if (j < node.array->count - 1) {
-                        arrStr[arrLen++] = ',';
-                        arrStr[arrLen++] = ' ';
-                    }
-                }
-                arrStr[arrLen++] = ']';
-                arrStr[arrLen] = '\0';
-                snprintf(buffer, sizeof(buffer), "\"%s\": %s", node.key, arrStr);
-                free(arrStr);
-                break;
-            }
-            case JSON_OBJECT: {
-                char *nestedJson = jsonStringify(node.object);
-                snprintf(buffer, sizeof(buffer), "\"%s\": %s", node.key, nestedJson);
-                free(nestedJson);
-                break;
-            }
-            default:
-                buffer[0] = '\0';
-                break;
+    if (array->capacity == 0) {
+        array->capacity = array->arena ? JSON_ARENA_INITIAL_CAPACITY : 1;
+    } else {
+        array->capacity *= 2;
+    }
+
+    Arena *arena = array->arena;
+    int count = array->count;
+
+    switch (array->type) {
+        case JSON_ARRAY_INTEGERS:
+            array->integers = resizeStorage(arena, array->integers, count, array->capacity, sizeof(long long));
+            break;
+        case JSON_ARRAY_DOUBLES:
+            array->numbers = resizeStorage(arena, array->numbers, count, array->capacity, sizeof(double));
+            break;
+        case JSON_ARRAY_STRINGS:
+            array->strings = resizeStorage(arena, array->strings, count, array->capacity, sizeof(JsonStringView));
+            break;
+        default:
+            array->items = resizeStorage(arena, array->items, count, array->capacity, sizeof(Json));
+            break;
+    }
+}
+
+Json jsonArrayGet(JsonArray *array, int index) {
+    if (index < 0 || index >= array->count) {
+        return (Json) {
+            .type = JSON_NULL,
+            .key = NULL,
+        };
+    }
+
+    switch (array->type) {
+        case JSON_ARRAY_INTEGERS:
+            return jsonInteger64(array->integers[index]);
+        case JSON_ARRAY_DOUBLES:
+            return jsonDouble(array->numbers[index]);
+        case JSON_ARRAY_STRINGS:
+            return (Json) {
+                .type = JSON_STRING,
+                .key = NULL,
+                .value = array->strings[index].value,
+            };
+        default:
+            return array->items[index];
+    }
+}
+
+// turns a packed array back into Json items so it can hold values of any type
+static void unpackArray(JsonArray *array) {
+    if (array->type == JSON_ARRAY_MIXED) return;
+
+    Json *items = array->capacity ? resizeStorage(array->arena, NULL, 0, array->capacity, sizeof(Json)) : NULL;
+
+    for (int i = 0; i < array->count; i++) {
+        items[i] = jsonArrayGet(array, i);
+
+        // owned strings move over to the items, borrowed ones are copied
+        if (array->type == JSON_ARRAY_STRINGS && array->borrowsStrings) {
+            char *value = items[i].value;
+            items[i] = array->arena ? (Json) { .type = JSON_STRING, .value = arenaStrndup(array->arena, value, strlen(value)) } : jsonString(value);
         }
+    }
+
+    // only the storage, the strings now belong to items
+    if (!array->arena) free(array->integers);
+
+    array->type = JSON_ARRAY_MIXED;
+    array->integers = NULL;
+    array->items = items;
+    array->borrowsStrings = false;
+}
+
+static void releaseBuilder(void *builder) {
+    freeJsonBuilder(builder);
+}
+
+// moves a heap array into arena, taking its values along
+static void adoptArray(Arena *arena, JsonArray *array) {
+    if (array->arena) return;
 
-        int bufferLength = strlen(buffer);
-        if (length + bufferLength + 3 > capacity) {
-            capacity = (length + bufferLength + 3) * 2;
-            json = realloc(json, capacity);
+    int count = array->count;
 
-            if (!json) {
-                fprintf(stderr, "Fatal: out of memory\n");
-                exit(EXIT_FAILURE);
+    switch (array->type) {
+        case JSON_ARRAY_INTEGERS: {
+            long long *integers = array->integers;
+            array->integers = resizeStorage(arena, integers, count, count, sizeof(long long));
+            free(integers);
+            break;
+        }
+        case JSON_ARRAY_DOUBLES: {
+            double *numbers = array->numbers;
+            array->numbers = resizeStorage(arena, numbers, count, count, sizeof(double));
+            free(numbers);
+            break;
+        }
+        case JSON_ARRAY_STRINGS: {
+            JsonStringView *strings = array->strings;
+            array->strings = resizeStorage(arena, strings, count, count, sizeof(JsonStringView));
+
+            if (!array->borrowsStrings) {
+                for (int i = 0; i < count; i++) {
+                    array->strings[i].value = arenaStrndup(arena, strings[i].value, strings[i].length);
+                    free(strings[i].value);
+                }
             }
+
+            free(strings);
+            break;
         }
+        default: {
+            Json *items = array->items;
+            array->items = resizeStorage(arena, items, count, count, sizeof(Json));
 
-        memcpy(json + length, buffer, bufferLength);
-        length += bufferLength;
+            for (int i = 0; i < count; i++) {
+                adoptJson(arena, &array->items[i]);
+            }
 
-        if (i < builder->jsonCount - 1) {
-            json[length++] = ',';
-            json[length++] = ' ';
+            free(items);
+            break;
         }
     }
 
-    json[length++] = '}';
-    json[length] = '\0';
-
-    return json;
+    array->capacity = count;
+    array->arena = arena;
 }
 
-static char *skipWhitespace(char *str) {
-    while (*str && (*str == ' ' || *str == '\t' || *str == '\n' || *str == '\r')) {
-        str++;
+// values put into an arena builder or array are released with the arena.
+// strings are copied in, heap objects are freed when the arena is reset
+static void adoptJson(Arena *arena, Json *json) {
+    if (json->type == JSON_STRING && json->value) {
+        char *value = json->value;
+
+        json->value = arenaStrndup(arena, value, strlen(value));
+        free(value);
+    } else if (json->type == JSON_OBJECT && json->object && !json->object->arenaAllocated) {
+        arenaDefer(arena, releaseBuilder, json->object);
+    } else if (json->type == JSON_ARRAY && json->array) {
+        adoptArray(arena, json->array);
     }
-    return str;
 }
 
-static char *parseJsonString(char **str) {
-    char *start = *str;
-    if (*start != '"') return NULL;
-    
-    start++;
-    char *end = start;
-    
-    while (*end && *end != '"') {
-        end++;
-    }
-    
-    if (*end != '"') return NULL;
-    
-    int length = end - start;
-    char *result = malloc(length + 1);
-    
-    if (!result) {
-        fprintf(stderr, "Fatal: out of memory\n");
-        exit(EXIT_FAILURE);
+static void appendValue(JsonArray *array, Json value) {
+    switch (array->type) {
+        case JSON_ARRAY_INTEGERS:
+            if (value.type != JSON_NUMBER) break;
+
+            reserveElement(array);
+            array->integers[array->count++] = value.integer;
+            return;
+        case JSON_ARRAY_DOUBLES:
+            if (value.type != JSON_DOUBLE) break;
+
+            reserveElement(array);
+            array->numbers[array->count++] = value.number;
+            return;
+        case JSON_ARRAY_STRINGS:
+            if (value.type != JSON_STRING || !value.value || array->borrowsStrings) break;
+
+            reserveElement(array);
+            array->strings[array->count++] = (JsonStringView) {
+                .value = value.value,
+                .length = strlen(value.value),
+            };
+            return;
+        default:
+            break;
     }
 
-    strncpy(result, start, length);
-    result[length] = '\0';
-    
-    *str = end + 1;
-    return result;
+    unpackArray(array);
+    reserveElement(array);
+    array->items[array->count++] = value;
 }
 
-static int parseJsonNumber(char **str) {
-    char *start = *str;
-    int result = 0;
-    int negative = 0;
-    
-    if (*start == '-') {
-        negative = 1;
-        start++;
-    }
-    
-    while (*start >= '0' && *start <= '9') {
-        result = result * 10 + (*start - '0');
-        start++;
+void jsonArrayAppend(JsonArray *array, Json value) {
+    if (array->arena) adoptJson(array->arena, &value);
+
+    appendValue(array, value);
+}
+
+void jsonArrayAppendInteger64(JsonArray *array, long long value) {
+    jsonArrayAppend(array, jsonInteger64(value));
+}
+
+void jsonArrayAppendDouble(JsonArray *array, double value) {
+    jsonArrayAppend(array, jsonDouble(value));
+}
+
+void jsonArrayAppendString(JsonArray *array, char *value) {
+    if (!array->arena) {
+        jsonArrayAppend(array, jsonString(value));
+        return;
     }
-    
-    *str = start;
-    return negative ? -result : result;
+
+    // copied straight into the arena rather than through a heap copy
+    appendValue(array, (Json) {
+        .type = JSON_STRING,
+        .value = arenaStrndup(array->arena, value, strlen(value)),
+    });
 }
 
-static Json parseJsonValue(char **str);
+long long jsonArrayGetInteger64(JsonArray *array, int index) {
+    Json json = jsonArrayGet(array, index);
+    return json.type == JSON_NUMBER ? json.integer : 0;
+}
 
-static JsonArray *parseJsonArray(char **str) {
-    *str = skipWhitespace(*str);
-    if (**str != '[') return NULL;
-    
-    (*str)++;
-    JsonArray *array = malloc(sizeof(JsonArray));
-    
-    if (!array) {
-        fprintf(stderr, "Fatal: out of memory\n");
-        exit(EXIT_FAILURE);
+double jsonArrayGetDouble(JsonArray *array, int index) {
+    Json json = jsonArrayGet(array, index);
+
+    if (json.type == JSON_DOUBLE) return json.number;
+    if (json.type == JSON_NUMBER) return (double)json.integer;
+
+    return 0;
+}
+
+char *jsonArrayGetString(JsonArray *array, int index) {
+    Json json = jsonArrayGet(array, index);
+    return json.type == JSON_STRING ? json.value : NULL;
+}
+
+char *jsonStringify(JsonBuilder *builder) {
+    if (!builder) return NULL;
+
+    JsonWriter writer = jsonWriter();
+    writer.spaced = true;
+    jwObject(&writer, builder);
+
+    return jwTakeString(&writer);
+}
+
+char *jsonStringifyArena(JsonBuilder *builder, Arena *arena) {
+    char *json = jsonStringify(builder);
+    if (json) arenaDefer(arena, free, json);
+
+    return json;
+}
+
+static JsonValue viewValue(JsonBuilder *builder) {
+    return (JsonValue) {
+        .document = builder->document,
+        .index = builder->tapeIndex,
+    };
+}
+
+static JsonBuilder *documentView(JsonDocument *document, size_t index) {
+    JsonBuilder *builder = arenaAlloc(&document->arena, sizeof(JsonBuilder));
+
+    *builder = (JsonBuilder) {
+        .document = document,
+        .tapeIndex = index,
+        .isView = true,
+        .arenaAllocated = true,
+    };
+
+    builder->jsonCount = jsonValueCount(viewValue(builder));
+    return builder;
+}
+
+static Json jsonFromValue(JsonValue value);
+
+// arrays holding only integers, only doubles or only strings are packed
+static JsonArrayType packedType(JsonValue array) {
+    JsonValue item = jsonValueFirst(array);
+    if (jsonValueIsEnd(item)) return JSON_ARRAY_MIXED;
+
+    JsonType type = jsonValueType(item);
+    if (type != JSON_NUMBER && type != JSON_DOUBLE && type != JSON_STRING) return JSON_ARRAY_MIXED;
+
+    for (; !jsonValueIsEnd(item); item = jsonValueSkip(item)) {
+        if (jsonValueType(item) != type) return JSON_ARRAY_MIXED;
     }
 
-    *array = jsonArray();
-    
-    *str = skipWhitespace(*str);
-    
-    if (**str == ']') {
-        (*str)++;
+    if (type == JSON_NUMBER) return JSON_ARRAY_INTEGERS;
+    if (type == JSON_DOUBLE) return JSON_ARRAY_DOUBLES;
+
+    return JSON_ARRAY_STRINGS;
+}
+
+static JsonArray *arrayFromValue(JsonValue value) {
+    JsonArray *array = arenaAlloc(&value.document->arena, sizeof(JsonArray));
+    *array = packedArray(packedType(value));
+
+    if (array->type == JSON_ARRAY_MIXED) {
+        for (JsonValue item = jsonValueFirst(value); !jsonValueIsEnd(item); item = jsonValueSkip(item)) {
+            jsonArrayAppend(array, jsonFromValue(item));
+        }
+
         return array;
     }
-    
-    while (1) {
-        *str = skipWhitespace(*str);
-        Json value = parseJsonValue(str);
-        jsonArrayAppend(array, value);
-        
-        *str = skipWhitespace(*str);
-        if (**str == ']') {
-            (*str)++;
+
+    int count = (int)jsonValueCount(value);
+    array->count = count;
+    array->capacity = count;
+
+    int i = 0;
+    JsonValue item = jsonValueFirst(value);
+
+    switch (array->type) {
+        case JSON_ARRAY_INTEGERS:
+            array->integers = resizeStorage(NULL, NULL, 0, count, sizeof(long long));
+            for (; !jsonValueIsEnd(item); item = jsonValueSkip(item)) {
+                array->integers[i++] = jsonValueInteger(item);
+            }
+            break;
+        case JSON_ARRAY_DOUBLES:
+            array->numbers = resizeStorage(NULL, NULL, 0, count, sizeof(double));
+            for (; !jsonValueIsEnd(item); item = jsonValueSkip(item)) {
+                array->numbers[i++] = jsonValueDouble(item);
+            }
+            break;
+        default:
+            // unescaped in place, the strings live as long as the document
+            array->strings = resizeStorage(NULL, NULL, 0, count, sizeof(JsonStringView));
+            array->borrowsStrings = true;
+
+            for (; !jsonValueIsEnd(item); item = jsonValueSkip(item)) {
+                JsonStringView *view = &array->strings[i++];
+                view->value = (char *)jsonValueString(item, &view->length);
+            }
             break;
-        } else if (**str == ',') {
-            (*str)++;
-        } else {
-            freeJsonArray(array);
-            free(array);
-            return NULL;
-        }
     }
-    
+
     return array;
 }
 
-static JsonBuilder *parseJsonObject(char **str) {
-    *str = skipWhitespace(*str);
-    if (**str != '{') return NULL;
-    
-    (*str)++;
-    JsonBuilder *builder = jsonBuilder();
-    
-    *str = skipWhitespace(*str);
-    
-    if (**str == '}') {
-        (*str)++;
-        return builder;
-    }
-    
-    while (1) {
-        *str = skipWhitespace(*str);
-        
-        char *key = parseJsonString(str);
-        if (!key) {
-            freeJsonBuilder(builder);
-            return NULL;
-        }
-        
-        *str = skipWhitespace(*str);
-        if (**str != ':') {
-            free(key);
-            freeJsonBuilder(builder);
-            return NULL;
-        }
-        (*str)++;
-        
-        *str = skipWhitespace(*str);
-        
-        Json value = parseJsonValue(str);
-        value.key = key;
-        addJson(builder, value);
-        
-        *str = skipWhitespace(*str);
-        if (**str == '}') {
-            (*str)++;
-            break;
-        } else if (**str == ',') {
-            (*str)++;
-        } else {
-            freeJsonBuilder(builder);
-            return NULL;
-        }
+// nested objects stay views, they are only copied once they are modified themselves
+static Json jsonFromValue(JsonValue value) {
+    switch (jsonValueType(value)) {
+        case JSON_STRING:
+            return jsonString((char *)jsonValueString(value, NULL));
+        case JSON_NUMBER:
+            return jsonInteger64(jsonValueInteger(value));
+        case JSON_DOUBLE:
+            return jsonDouble(jsonValueDouble(value));
+        case JSON_TRUE:
+        case JSON_FALSE:
+            return jsonBool(jsonValueBool(value));
+        case JSON_OBJECT:
+            return jsonObject(documentView(value.document, value.index));
+        case JSON_ARRAY:
+            return jsonArrayJson(arrayFromValue(value));
+        default:
+            return (Json) {
+                .type = JSON_NULL,
+                .key = NULL,
+            };
     }
-    
+}
+
+// copies a view's members into regular nodes so they can be modified
+static void materialize(JsonBuilder *builder) {
+    if (!builder->isView) return;
+
+    JsonValue object = viewValue(builder);
+
+    // indexed positions point into the tape
+    releaseIndex(builder);
+
+    builder->isView = false;
+    builder->jsonCount = 0;
+
+    JsonValue key = jsonValueFirst(object);
+    while (!jsonValueIsEnd(key)) {
+        JsonValue value = jsonValueSkip(key);
+
+        // keys stay in the document, which lives as long as the builder
+        Json json = jsonFromValue(value);
+        json.key = (char *)jsonValueString(key, NULL);
+
+        addJson(builder, json);
+        key = jsonValueSkip(value);
+    }
+
+    if (builder->arenaAllocated) {
+        builder->nextMaterialized = builder->document->materialized;
+        builder->document->materialized = builder;
+    }
+}
+
+JsonBuilder *jsonParseLazy(const char *json, size_t length) {
+    JsonBuilder *builder = jsonBuilder();
+
+    builder->source = json;
+    builder->sourceLength = length;
+    builder->isPending = true;
+
     return builder;
 }
 
-static Json parseJsonValue(char **str) {
-    Json json = {0};
-    *str = skipWhitespace(*str);
-    
-    if (**str == '"') {
-        char *value = parseJsonString(str);
-        json.type = JSON_STRING;
-        json.value = value;
-    } else if (**str == '{') {
-        JsonBuilder *object = parseJsonObject(str);
-        json.type = JSON_OBJECT;
-        json.object = object;
-    } else if (**str == '[') {
-        JsonArray *array = parseJsonArray(str);
-        json.type = JSON_ARRAY;
-        json.array = array;
-    } else if (strncmp(*str, "true", 4) == 0) {
-        json.type = JSON_TRUE;
-        json.boolean = true;
-        *str += 4;
-    } else if (strncmp(*str, "false", 5) == 0) {
-        json.type = JSON_FALSE;
-        json.boolean = false;
-        *str += 5;
-    } else if (strncmp(*str, "null", 4) == 0) {
-        json.type = JSON_NULL;
-        *str += 4;
-    } else if (**str == '-' || (**str >= '0' && **str <= '9')) {
-        int value = parseJsonNumber(str);
-        json.type = JSON_NUMBER;
-        json.integer = value;
-    }
-    
-    return json;
+bool jsonResolve(JsonBuilder *builder) {
+    if (!builder) return false;
+    if (!builder->isPending) return !builder->isInvalid;
+
+    builder->isPending = false;
+
+    JsonDocument *document = jsonParseDocument(builder->source, builder->sourceLength);
+    builder->source = NULL;
+
+    if (!document || jsonValueType(jsonDocumentRoot(document)) != JSON_OBJECT) {
+        freeJsonDocument(document);
+        builder->isInvalid = true;
+        return false;
+    }
+
+    builder->document = document;
+    builder->tapeIndex = 0;
+    builder->shape = NULL;
+    builder->isView = true;
+    builder->ownsDocument = true;
+    builder->jsonCount = jsonValueCount(jsonDocumentRoot(document));
+
+    return true;
+}
+
+bool jsonBuilderValue(JsonBuilder *builder, JsonValue *value) {
+    if (!jsonResolve(builder) || !builder->isView) return false;
+
+    value->document = builder->document;
+    value->index = builder->tapeIndex;
+
+    return true;
 }
 
 JsonBuilder *jsonParse(char *jsonString) {
     if (!jsonString) return NULL;
-    
-    char *str = jsonString;
-    str = skipWhitespace(str);
-    
-    if (*str != '{') return NULL;
-    
-    JsonBuilder *builder = parseJsonObject(&str);
+
+    JsonBuilder *builder = jsonParseLazy(jsonString, strlen(jsonString));
+
+    if (!jsonResolve(builder)) {
+        freeJsonBuilder(builder);
+        return NULL;
+    }
+
     return builder;
 }
 
-char *jsonGetString(JsonBuilder *jsonBuilder, char *key) {
-    for (int i = 0; i < jsonBuilder->jsonCount; i++) {
-        Json json = jsonBuilder->json[i];
-        
-        if (json.type == JSON_STRING && strcmp(json.key, key) == 0) {
-            return json.value;
-        }
+#define ANY_TYPE -1
+
+// JSON_TRUE stands for either boolean, JSON_DOUBLE for any number
+static bool typeMatches(JsonType type, int want) {
+    if (want == ANY_TYPE) return true;
+    if (want == JSON_TRUE) return type == JSON_TRUE || type == JSON_FALSE;
+    if (want == JSON_DOUBLE) return type == JSON_DOUBLE || type == JSON_NUMBER;
+
+    return (int)type == want;
+}
+
+// positions are indexes into json for regular builders and the key's tape index for views
+static JsonValue memberValue(JsonBuilder *builder, unsigned int position) {
+    return (JsonValue) {
+        .document = builder->document,
+        .index = position + 1,
+    };
+}
+
+static const char *memberKey(JsonBuilder *builder, unsigned int position, size_t *length) {
+    if (builder->isView) {
+        return jsonValueString((JsonValue) { .document = builder->document, .index = position }, length);
     }
 
-    return NULL;
+    const char *key = builder->json[position].key ? builder->json[position].key : "";
+    *length = strlen(key);
+
+    return key;
 }
 
-bool jsonGetBool(JsonBuilder *jsonBuilder, char *key) {
-    for (int i = 0; i < jsonBuilder->jsonCount; i++) {
-        Json json = jsonBuilder->json[i];
+static bool memberMatches(JsonBuilder *builder, unsigned int position, const char *key, size_t keyLength, int want) {
+    if (builder->isView) {
+        size_t length;
+        const char *name = memberKey(builder, position, &length);
 
-        if ((json.type == JSON_TRUE || json.type == JSON_FALSE) && strcmp(json.key, key) == 0) {
-            return json.boolean;
-        }
+        if (length != keyLength || memcmp(name, key, keyLength) != 0) return false;
+
+        return typeMatches(jsonValueType(memberValue(builder, position)), want);
     }
 
-    return false;
+    Json *json = &builder->json[position];
+    return json->key && strcmp(json->key, key) == 0 && typeMatches(json->type, want);
 }
 
-int jsonGetInteger(JsonBuilder *jsonBuilder, char *key) {
-    for (int i = 0; i < jsonBuilder->jsonCount; i++) {
-        Json json = jsonBuilder->json[i];
+static JsonIndexSlot *buildIndex(JsonBuilder *builder, Arena *arena, unsigned int *indexCapacity) {
+    unsigned int capacity = 32;
+    while (capacity < (unsigned int)builder->jsonCount * 2) {
+        capacity *= 2;
+    }
+
+    size_t size = sizeof(JsonIndexSlot) * capacity;
+
+    JsonIndexSlot *index = arena ? arenaAlloc(arena, size) : malloc(size);
+    if (!index) {
+        fprintf(stderr, "Fatal: out of memory\n");
+        exit(EXIT_FAILURE);
+    }
 
-        if (json.type == JSON_NUMBER && strcmp(json.key, key) == 0) {
-            return json.integer;
+    memset(index, 0, size);
+    *indexCapacity = capacity;
+
+    if (builder->isView) {
+        JsonValue name = jsonValueFirst(viewValue(builder));
+
+        while (!jsonValueIsEnd(name)) {
+            size_t length;
+            const char *key = jsonValueString(name, &length);
+
+            indexInsert(index, capacity, jsonHashKey(key, length), name.index);
+            name = jsonValueSkip(jsonValueSkip(name));
         }
+        return index;
     }
 
-    return 0;
+    for (int i = 0; i < builder->jsonCount; i++) {
+        size_t length;
+        const char *key = memberKey(builder, i, &length);
+
+        indexInsert(index, capacity, jsonHashKey(key, length), i);
+    }
+
+    return index;
 }
 
-JsonBuilder *jsonGetJson(JsonBuilder *jsonBuilder, char *key) {
-    for (int i = 0; i < jsonBuilder->jsonCount; i++) {
-        Json json = jsonBuilder->json[i];
+// objects with the same shape have the same key at every position, so they can share one index.
+// a shape only one object has reached is likely still growing, that object indexes itself
+static JsonIndexSlot *memberIndex(JsonBuilder *builder, unsigned int *capacity) {
+    JsonShape *shape = builder->shape;
 
-        if (strcmp(json.key, key) == 0) {
-            return json.object;
-        }
+    // shapes outlive any arena
+    if (shape && !shape->index && shape->uses > 1) {
+        shape->index = buildIndex(builder, NULL, &shape->indexCapacity);
+    }
+
+    if (shape && shape->index) {
+        *capacity = shape->indexCapacity;
+        return shape->index;
     }
 
-    return NULL;
+    if (!builder->index) {
+        // arena views index into the document's arena, arena builders into their own
+        Arena *arena = builder->arena;
+        if (!arena && builder->arenaAllocated) arena = &builder->document->arena;
+
+        builder->index = buildIndex(builder, arena, &builder->indexCapacity);
+    }
+
+    *capacity = builder->indexCapacity;
+    return builder->index;
 }
 
-bool jsonHasKey(JsonBuilder *jsonBuilder, char *key) {
-    for (int i = 0; i < jsonBuilder->jsonCount; i++) {
-        Json json = jsonBuilder->json[i];
+// the first member named key whose type matches, in insertion order
+static bool findMember(JsonBuilder *builder, const char *key, int want, unsigned int *position) {
+    jsonResolve(builder);
+
+    size_t keyLength = strlen(key);
+
+    if (builder->jsonCount >= JSON_INDEX_THRESHOLD) {
+        unsigned int capacity;
+        JsonIndexSlot *index = memberIndex(builder, &capacity);
 
-        if (strcmp(json.key, key) == 0) {
+        unsigned int hash = jsonHashKey(key, keyLength);
+        unsigned int mask = capacity - 1;
+
+        // linear probing keeps members with the same key in insertion order
+        for (unsigned int slot = hash & mask; index[slot].position; slot = (slot + 1) & mask) {
+            JsonIndexSlot *entry = &index[slot];
+
+            if (entry->hash == hash && memberMatches(builder, entry->position - 1, key, keyLength, want)) {
+                *position = entry->position - 1;
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    if (builder->isView) {
+        JsonValue name = jsonValueFirst(viewValue(builder));
+
+        while (!jsonValueIsEnd(name)) {
+            if (memberMatches(builder, name.index, key, keyLength, want)) {
+                *position = name.index;
+                return true;
+            }
+
+            name = jsonValueSkip(jsonValueSkip(name));
+        }
+
+        return false;
+    }
+
+    for (int i = 0; i < builder->jsonCount; i++) {
+        if (memberMatches(builder, i, key, keyLength, want)) {
+            *position = i;
             return true;
         }
     }
@@ -608,44 +1004,95 @@ bool jsonHasKey(JsonBuilder *jsonBuilder, char *key) {
     return false;
 }
 
-void jsonFilePrintNode(FILE *fp, Json json) {
-    switch (json.type) {
-        case JSON_STRING:
-            fprintf(fp, "\"%s\": \"%s\"", json.key, json.value);
-            break;
-        case JSON_TRUE:
-            fprintf(fp, "\"%s\": true", json.key);
-            break;
-        case JSON_FALSE:
-            fprintf(fp, "\"%s\": false", json.key);
-            break;
-        case JSON_NUMBER:
-            fprintf(fp, "\"%s\": %d", json.key, json.integer);
-            break;
-        case JSON_NULL:
-            fprintf(fp, "\"%s\": null", json.key);
-            break;
-        case JSON_ARRAY:
-            break;
-        case JSON_OBJECT:
-            fprintf(fp, "\"%s\": ", json.key);
-            jsonFilePrint(fp, json.object);
-            break;
-        default:
-            break;
+char *jsonGetString(JsonBuilder *jsonBuilder, char *key) {
+    unsigned int position;
+    if (!findMember(jsonBuilder, key, JSON_STRING, &position)) return NULL;
+
+    if (jsonBuilder->isView) {
+        return (char *)jsonValueString(memberValue(jsonBuilder, position), NULL);
     }
+
+    return jsonBuilder->json[position].value;
 }
 
-void jsonFilePrint(FILE *fp, JsonBuilder *builder) {
-    fprintf(fp, "{");
-    for (int i = 0; i < builder->jsonCount; i++) {
-        jsonFilePrintNode(fp, builder->json[i]);
+bool jsonGetBool(JsonBuilder *jsonBuilder, char *key) {
+    unsigned int position;
+    if (!findMember(jsonBuilder, key, JSON_TRUE, &position)) return false;
 
-        if (i < builder->jsonCount - 1) {
-            fprintf(fp, ", ");
-        }
+    if (jsonBuilder->isView) {
+        return jsonValueBool(memberValue(jsonBuilder, position));
+    }
+
+    return jsonBuilder->json[position].boolean;
+}
+
+int jsonGetInteger(JsonBuilder *jsonBuilder, char *key) {
+    unsigned int position;
+    if (!findMember(jsonBuilder, key, JSON_NUMBER, &position)) return 0;
+
+    if (jsonBuilder->isView) {
+        return (int)jsonValueInteger(memberValue(jsonBuilder, position));
     }
-    fprintf(fp, "}\n");
+
+    return jsonBuilder->json[position].integer;
+}
+
+long long jsonGetInteger64(JsonBuilder *jsonBuilder, char *key) {
+    unsigned int position;
+    if (!findMember(jsonBuilder, key, JSON_NUMBER, &position)) return 0;
+
+    if (jsonBuilder->isView) {
+        return jsonValueInteger(memberValue(jsonBuilder, position));
+    }
+
+    return jsonBuilder->json[position].integer;
+}
+
+double jsonGetDouble(JsonBuilder *jsonBuilder, char *key) {
+    unsigned int position;
+    if (!findMember(jsonBuilder, key, JSON_DOUBLE, &position)) return 0;
+
+    if (jsonBuilder->isView) {
+        return jsonValueDouble(memberValue(jsonBuilder, position));
+    }
+
+    Json *json = &jsonBuilder->json[position];
+    return json->type == JSON_DOUBLE ? json->number : (double)json->integer;
+}
+
+JsonBuilder *jsonGetJson(JsonBuilder *jsonBuilder, char *key) {
+    // the returned object may be modified, so the parent has to hold on to it
+    jsonResolve(jsonBuilder);
+    materialize(jsonBuilder);
+
+    unsigned int position;
+    if (!findMember(jsonBuilder, key, JSON_OBJECT, &position)) return NULL;
+
+    return jsonBuilder->json[position].object;
+}
+
+JsonArray *jsonGetArray(JsonBuilder *jsonBuilder, char *key) {
+    // arrays are only built once their parent is copied out of the document
+    jsonResolve(jsonBuilder);
+    materialize(jsonBuilder);
+
+    unsigned int position;
+    if (!findMember(jsonBuilder, key, JSON_ARRAY, &position)) return NULL;
+
+    return jsonBuilder->json[position].array;
+}
+
+bool jsonHasKey(JsonBuilder *jsonBuilder, char *key) {
+    unsigned int position;
+    return findMember(jsonBuilder, key, ANY_TYPE, &position);
+}
+
+void jsonFilePrint(FILE *fp, JsonBuilder *builder) {
+    char *json = jsonStringify(builder);
+    if (!json) return;
+
+    fprintf(fp, "%s\n", json);
+    free(json);
 }
 
 void jsonPrint(JsonBuilder *builder) {
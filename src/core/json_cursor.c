@@ -0,0 +1,317 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "../include/json_cursor.h"
+#include "../include/json_tape.h"
+#include "../include/json_number.h"
+
+static inline size_t skipWhitespace(const char *json, size_t pos, size_t length) {
+    while (pos < length && (json[pos] == ' ' || json[pos] == '\n' || json[pos] == '\r' || json[pos] == '\t')) {
+        pos++;
+    }
+    return pos;
+}
+
+static inline bool isDigit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+JsonCursor jsonCursor(const char *json, size_t length) {
+    JsonCursor cursor = {
+        .json = json,
+        .length = json ? length : 0,
+        .position = 0,
+        .failed = !json,
+    };
+
+    cursor.position = skipWhitespace(cursor.json, 0, cursor.length);
+    if (cursor.position >= cursor.length) cursor.failed = true;
+
+    return cursor;
+}
+
+// pos is on the opening quote, moves past the closing one
+static bool skipString(const JsonCursor *cursor, size_t *pos) {
+    const char *json = cursor->json;
+    size_t open = *pos;
+    size_t p = open + 1;
+
+    while (p < cursor->length) {
+        const char *quote = memchr(json + p, '"', cursor->length - p);
+        if (!quote) return false;
+
+        size_t close = quote - json;
+
+        // a quote behind an odd number of backslashes is part of the string
+        size_t backslashes = 0;
+        while (close - backslashes > open + 1 && json[close - backslashes - 1] == '\\') {
+            backslashes++;
+        }
+
+        p = close + 1;
+
+        if (backslashes % 2 == 0) {
+            *pos = p;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static inline bool isDelimiter(char c) {
+    return c == ',' || c == '}' || c == ']' || c == ' ' || c == '\n' || c == '\r' || c == '\t';
+}
+
+// moves past the value at pos, nested values are skipped by bracket depth without being checked
+static bool skipValue(const JsonCursor *cursor, size_t *pos) {
+    const char *json = cursor->json;
+    size_t length = cursor->length;
+    size_t p = *pos;
+
+    if (p >= length) return false;
+
+    if (json[p] == '"') {
+        return skipString(cursor, pos);
+    }
+
+    if (json[p] == '{' || json[p] == '[') {
+        int depth = 0;
+
+        while (p < length) {
+            char c = json[p];
+
+            if (c == '"') {
+                if (!skipString(cursor, &p)) return false;
+                continue;
+            }
+
+            if (c == '{' || c == '[') {
+                depth++;
+            } else if ((c == '}' || c == ']') && --depth == 0) {
+                *pos = p + 1;
+                return true;
+            }
+
+            p++;
+        }
+
+        return false;
+    }
+
+    while (p < length && !isDelimiter(json[p])) {
+        p++;
+    }
+
+    if (p == *pos) return false;
+
+    *pos = p;
+    return true;
+}
+
+static bool keyEquals(const char *raw, size_t rawLength, const char *key, size_t keyLength) {
+    if (!memchr(raw, '\\', rawLength)) {
+        return rawLength == keyLength && memcmp(raw, key, keyLength) == 0;
+    }
+
+    // unescaping never makes a string longer
+    if (keyLength > rawLength) return false;
+
+    return jsonUnescapedEquals(raw, rawLength, key, keyLength);
+}
+
+// pos is on '{', moves to the value of the member named key
+static bool findKey(const JsonCursor *cursor, const char *key, size_t keyLength, size_t *pos) {
+    const char *json = cursor->json;
+    size_t length = cursor->length;
+    size_t p = skipWhitespace(json, *pos + 1, length);
+
+    while (p < length && json[p] == '"') {
+        size_t keyStart = p + 1;
+        if (!skipString(cursor, &p)) return false;
+
+        bool match = keyEquals(json + keyStart, p - 1 - keyStart, key, keyLength);
+
+        p = skipWhitespace(json, p, length);
+        if (p >= length || json[p] != ':') return false;
+        p = skipWhitespace(json, p + 1, length);
+
+        if (match) {
+            *pos = p;
+            return p < length;
+        }
+
+        if (!skipValue(cursor, &p)) return false;
+
+        p = skipWhitespace(json, p, length);
+        if (p >= length || json[p] != ',') return false;
+        p = skipWhitespace(json, p + 1, length);
+    }
+
+    return false;
+}
+
+// pos is on '[', moves to the element at index
+static bool findIndex(const JsonCursor *cursor, size_t index, size_t *pos) {
+    const char *json = cursor->json;
+    size_t length = cursor->length;
+    size_t p = skipWhitespace(json, *pos + 1, length);
+
+    if (p >= length || json[p] == ']') return false;
+
+    for (size_t i = 0; i < index; i++) {
+        if (!skipValue(cursor, &p)) return false;
+
+        p = skipWhitespace(json, p, length);
+        if (p >= length || json[p] != ',') return false;
+        p = skipWhitespace(json, p + 1, length);
+    }
+
+    *pos = p;
+    return p < length;
+}
+
+static bool failSeek(JsonCursor *cursor) {
+    cursor->failed = true;
+    return false;
+}
+
+bool jsonCursorSeek(JsonCursor *cursor, const char *path) {
+    if (cursor->failed || !path) return failSeek(cursor);
+
+    const char *json = cursor->json;
+    size_t pos = cursor->position;
+
+    const char *p = path;
+    if (*p == '$') p++;
+
+    while (*p) {
+        if (*p == '[') {
+            if (!isDigit(p[1]) || json[pos] != '[') return failSeek(cursor);
+
+            char *end;
+            unsigned long long index = strtoull(p + 1, &end, 10);
+
+            if (*end != ']' || !findIndex(cursor, index, &pos)) return failSeek(cursor);
+
+            p = end + 1;
+            continue;
+        }
+
+        if (*p == '.') p++;
+
+        size_t keyLength = strcspn(p, ".[");
+        if (keyLength == 0 || json[pos] != '{') return failSeek(cursor);
+        if (!findKey(cursor, p, keyLength, &pos)) return failSeek(cursor);
+
+        p += keyLength;
+    }
+
+    cursor->position = pos;
+    return true;
+}
+
+// whether a value may end before pos: at the end of the input, whitespace or a delimiter
+static bool endsValue(const JsonCursor *cursor, size_t pos) {
+    if (pos >= cursor->length) return true;
+
+    char c = cursor->json[pos];
+    return c == ' ' || c == '\n' || c == '\r' || c == '\t' || c == ',' || c == '}' || c == ']';
+}
+
+static bool readNumber(JsonCursor *cursor, JsonNumber *number) {
+    if (cursor->failed) return false;
+
+    size_t length = jsonParseNumber(cursor->json + cursor->position, cursor->length - cursor->position, number);
+    return length > 0 && endsValue(cursor, cursor->position + length);
+}
+
+// whether the value is the whole of literal, e.g. true but not txyz or trueish
+static bool isLiteral(const JsonCursor *cursor, const char *literal) {
+    size_t length = strlen(literal);
+
+    return cursor->length - cursor->position >= length
+        && memcmp(cursor->json + cursor->position, literal, length) == 0
+        && endsValue(cursor, cursor->position + length);
+}
+
+JsonType jsonCursorType(JsonCursor *cursor) {
+    if (cursor->failed) return JSON_NULL;
+
+    char c = cursor->json[cursor->position];
+
+    switch (c) {
+        case '{':
+            return JSON_OBJECT;
+        case '[':
+            return JSON_ARRAY;
+        case '"':
+            return JSON_STRING;
+        case 't':
+            return isLiteral(cursor, "true") ? JSON_TRUE : JSON_NULL;
+        case 'f':
+            return isLiteral(cursor, "false") ? JSON_FALSE : JSON_NULL;
+        default: {
+            JsonNumber number;
+            if (!readNumber(cursor, &number)) return JSON_NULL;
+
+            return number.isInteger ? JSON_NUMBER : JSON_DOUBLE;
+        }
+    }
+}
+
+bool jsonCursorInteger(JsonCursor *cursor, long long *value) {
+    JsonNumber number;
+    if (!readNumber(cursor, &number) || !number.isInteger) return false;
+
+    *value = number.integer;
+    return true;
+}
+
+bool jsonCursorDouble(JsonCursor *cursor, double *value) {
+    JsonNumber number;
+    if (!readNumber(cursor, &number)) return false;
+
+    *value = number.isInteger ? (double)number.integer : number.number;
+    return true;
+}
+
+bool jsonCursorBool(JsonCursor *cursor, bool *value) {
+    if (cursor->failed) return false;
+
+    if (isLiteral(cursor, "true")) {
+        *value = true;
+        return true;
+    }
+
+    if (isLiteral(cursor, "false")) {
+        *value = false;
+        return true;
+    }
+
+    return false;
+}
+
+const char *jsonCursorRawString(JsonCursor *cursor, size_t *length) {
+    if (cursor->failed || cursor->json[cursor->position] != '"') return NULL;
+
+    size_t end = cursor->position;
+    if (!skipString(cursor, &end)) return NULL;
+
+    *length = end - cursor->position - 2;
+    return cursor->json + cursor->position + 1;
+}
+
+bool jsonCursorString(JsonCursor *cursor, char *buffer, size_t size) {
+    size_t rawLength;
+    const char *raw = jsonCursorRawString(cursor, &rawLength);
+
+    if (!raw || rawLength >= size) return false;
+
+    size_t length;
+    if (!jsonUnescape(buffer, raw, rawLength, &length)) return false;
+
+    buffer[length] = '\0';
+    return true;
+}
@@ -0,0 +1,187 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../include/json_shape.h"
+#include "../include/arena.h"
+#include "../include/utils.h"
+
+typedef struct {
+    unsigned int hash;
+    unsigned int length;
+    const char  *key;
+} InternSlot;
+
+// interned keys, shapes and shape indexes live here until freeJsonKeys
+static Arena        keyArena;
+static bool         keyArenaReady = false;
+
+static InternSlot  *internTable = NULL;
+static unsigned int internCapacity = 0;
+static unsigned int internCount = 0;
+static size_t       internBytes = 0;
+
+static JsonShape   *emptyShape = NULL;
+
+// every shape, so their transitions can be freed
+static JsonShape  **shapes = NULL;
+static int          shapeCount = 0;
+static int          shapeCapacity = 0;
+
+unsigned int jsonHashKey(const char *key, size_t length) {
+    return hashBytes(key, length);
+}
+
+static Arena *keys() {
+    if (!keyArenaReady) {
+        keyArena = arena(0);
+        keyArenaReady = true;
+    }
+
+    return &keyArena;
+}
+
+static void internInsert(InternSlot *table, unsigned int capacity, InternSlot entry) {
+    unsigned int mask = capacity - 1;
+    unsigned int slot = entry.hash & mask;
+
+    while (table[slot].key) {
+        slot = (slot + 1) & mask;
+    }
+
+    table[slot] = entry;
+}
+
+static void growInternTable() {
+    unsigned int capacity = internCapacity == 0 ? 256 : internCapacity * 2;
+
+    InternSlot *table = calloc(capacity, sizeof(InternSlot));
+    if (!table) {
+        fprintf(stderr, "Fatal: out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+
+    for (unsigned int i = 0; i < internCapacity; i++) {
+        if (internTable[i].key) internInsert(table, capacity, internTable[i]);
+    }
+
+    free(internTable);
+    internTable = table;
+    internCapacity = capacity;
+}
+
+const char *jsonInternKey(const char *key, size_t length) {
+    if (length > JSON_INTERN_MAX_KEY_LENGTH) return NULL;
+
+    unsigned int hash = jsonHashKey(key, length);
+
+    if (internCapacity) {
+        unsigned int mask = internCapacity - 1;
+
+        for (unsigned int slot = hash & mask; internTable[slot].key; slot = (slot + 1) & mask) {
+            InternSlot *entry = &internTable[slot];
+
+            if (entry->hash == hash && entry->length == length && memcmp(entry->key, key, length) == 0) {
+                return entry->key;
+            }
+        }
+    }
+
+    if (internBytes + length + 1 > JSON_INTERN_MAX_BYTES) return NULL;
+
+    if ((internCount + 1) * 2 > internCapacity) growInternTable();
+
+    InternSlot entry = {
+        .hash = hash,
+        .length = (unsigned int)length,
+        .key = arenaStrndup(keys(), key, length),
+    };
+
+    internInsert(internTable, internCapacity, entry);
+    internCount++;
+    internBytes += length + 1;
+
+    return entry.key;
+}
+
+static JsonShape *newShape(const char *key, int count) {
+    if (shapeCount >= JSON_MAX_SHAPES) return NULL;
+
+    if (shapeCount >= shapeCapacity) {
+        shapeCapacity = shapeCapacity == 0 ? 64 : shapeCapacity * 2;
+        shapes = realloc(shapes, sizeof(JsonShape *) * shapeCapacity);
+
+        if (!shapes) {
+            fprintf(stderr, "Fatal: out of memory\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    JsonShape *shape = arenaAlloc(keys(), sizeof(JsonShape));
+    *shape = (JsonShape) {
+        .key = key,
+        .count = count,
+    };
+
+    shapes[shapeCount++] = shape;
+    return shape;
+}
+
+JsonShape *jsonEmptyShape(void) {
+    if (!emptyShape) emptyShape = newShape(NULL, 0);
+
+    return emptyShape;
+}
+
+JsonShape *jsonShapeAdd(JsonShape *shape, const char *key) {
+    // most shapes only ever grow one way
+    for (int i = 0; i < shape->transitionCount; i++) {
+        JsonShape *next = shape->transitions[i];
+
+        if (next->key == key) {
+            // only ever compared with 1, so it stops at 2 instead of overflowing
+            if (next->uses < 2) next->uses++;
+            return next;
+        }
+    }
+
+    JsonShape *next = newShape(key, shape->count + 1);
+    if (!next) return NULL;
+
+    next->uses = 1;
+
+    if (shape->transitionCount >= shape->transitionCapacity) {
+        shape->transitionCapacity = shape->transitionCapacity == 0 ? 1 : shape->transitionCapacity * 2;
+        shape->transitions = realloc(shape->transitions, sizeof(JsonShape *) * shape->transitionCapacity);
+
+        if (!shape->transitions) {
+            fprintf(stderr, "Fatal: out of memory\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    shape->transitions[shape->transitionCount++] = next;
+    return next;
+}
+
+void freeJsonKeys(void) {
+    for (int i = 0; i < shapeCount; i++) {
+        free(shapes[i]->transitions);
+        free(shapes[i]->index);
+    }
+
+    free(shapes);
+    shapes = NULL;
+    shapeCount = 0;
+    shapeCapacity = 0;
+    emptyShape = NULL;
+
+    free(internTable);
+    internTable = NULL;
+    internCapacity = 0;
+    internCount = 0;
+    internBytes = 0;
+
+    if (keyArenaReady) freeArena(&keyArena);
+    keyArenaReady = false;
+}
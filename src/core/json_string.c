@@ -0,0 +1,307 @@
+#include <stdint.h>
+
+#include "../include/json_string.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+#define HAS_AVX2_PATH 1
+#endif
+
+// 1 for bytes that cannot appear unescaped in a JSON string
+static const uint8_t needsEscape[256] = {
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+    0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0,
+};
+
+static size_t findEscapeScalar(const unsigned char *str, size_t pos, size_t length) {
+    while (pos < length && !needsEscape[str[pos]]) {
+        pos++;
+    }
+
+    return pos;
+}
+
+#if defined(HAS_AVX2_PATH)
+static bool hasAvx2() {
+    static int supported = -1;
+
+    if (supported < 0) {
+        __builtin_cpu_init();
+        supported = __builtin_cpu_supports("avx2") ? 1 : 0;
+    }
+
+    return supported;
+}
+
+__attribute__((target("avx2")))
+static size_t findEscapeAvx2(const unsigned char *str, size_t length) {
+    const __m256i quote = _mm256_set1_epi8('"');
+    const __m256i backslash = _mm256_set1_epi8('\\');
+    const __m256i control = _mm256_set1_epi8(0x1F);
+
+    size_t pos = 0;
+    for (; pos + 32 <= length; pos += 32) {
+        __m256i chunk = _mm256_loadu_si256((const __m256i *)(str + pos));
+
+        // max(c, 0x1F) == 0x1F only for c <= 0x1F
+        __m256i matches = _mm256_or_si256(
+            _mm256_or_si256(_mm256_cmpeq_epi8(chunk, quote), _mm256_cmpeq_epi8(chunk, backslash)),
+            _mm256_cmpeq_epi8(_mm256_max_epu8(chunk, control), control)
+        );
+
+        unsigned mask = _mm256_movemask_epi8(matches);
+        if (mask) return pos + __builtin_ctz(mask);
+    }
+
+    return findEscapeScalar(str, pos, length);
+}
+#endif
+
+size_t jsonFindEscape(const char *str, size_t length) {
+    const unsigned char *bytes = (const unsigned char *)str;
+
+#if defined(HAS_AVX2_PATH)
+    if (length >= 64 && hasAvx2()) return findEscapeAvx2(bytes, length);
+#endif
+
+    size_t pos = 0;
+
+#if defined(__SSE2__)
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    const __m128i control = _mm_set1_epi8(0x1F);
+
+    for (; pos + 16 <= length; pos += 16) {
+        __m128i chunk = _mm_loadu_si128((const __m128i *)(bytes + pos));
+
+        __m128i matches = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(chunk, quote), _mm_cmpeq_epi8(chunk, backslash)),
+            _mm_cmpeq_epi8(_mm_max_epu8(chunk, control), control)
+        );
+
+        unsigned mask = _mm_movemask_epi8(matches);
+        if (mask) return pos + __builtin_ctz(mask);
+    }
+#endif
+
+    return findEscapeScalar(bytes, pos, length);
+}
+
+// length of the well formed sequence at str[0], 0 if it is malformed (Unicode table 3-7)
+static size_t sequenceLength(const unsigned char *str, size_t remaining) {
+    unsigned char lead = str[0];
+
+    if (lead < 0x80) return 1;
+    if (lead < 0xC2) return 0;
+
+    if (lead < 0xE0) {
+        return remaining >= 2 && (str[1] & 0xC0) == 0x80 ? 2 : 0;
+    }
+
+    if (lead < 0xF0) {
+        unsigned char low = lead == 0xE0 ? 0xA0 : 0x80;
+        unsigned char high = lead == 0xED ? 0x9F : 0xBF;
+
+        if (remaining < 3 || str[1] < low || str[1] > high) return 0;
+        return (str[2] & 0xC0) == 0x80 ? 3 : 0;
+    }
+
+    if (lead < 0xF5) {
+        unsigned char low = lead == 0xF0 ? 0x90 : 0x80;
+        unsigned char high = lead == 0xF4 ? 0x8F : 0xBF;
+
+        if (remaining < 4 || str[1] < low || str[1] > high) return 0;
+        return (str[2] & 0xC0) == 0x80 && (str[3] & 0xC0) == 0x80 ? 4 : 0;
+    }
+
+    return 0;
+}
+
+static bool validUtf8Scalar(const unsigned char *str, size_t pos, size_t length) {
+    while (pos < length) {
+        if (str[pos] < 0x80) {
+            pos++;
+            continue;
+        }
+
+        size_t sequence = sequenceLength(str + pos, length - pos);
+        if (!sequence) return false;
+
+        pos += sequence;
+    }
+
+    return true;
+}
+
+#if defined(HAS_AVX2_PATH)
+
+/*
+** Keiser and Lemire, "Validating UTF-8 In Less Than One Instruction Per Byte".
+** Each byte is checked against the one, two and three bytes before it with three
+** 16 entry table lookups, one bit per kind of error.
+*/
+#define TOO_SHORT      (1 << 0)
+#define TOO_LONG       (1 << 1)
+#define OVERLONG_3     (1 << 2)
+#define TOO_LARGE      (1 << 3)
+#define SURROGATE      (1 << 4)
+#define OVERLONG_2     (1 << 5)
+#define TOO_LARGE_1000 (1 << 6)
+#define OVERLONG_4     (1 << 6)
+#define TWO_CONTS      (1 << 7)
+#define CARRY          (TOO_SHORT | TOO_LONG | TWO_CONTS)
+
+#define TABLE16(...) _mm256_setr_epi8(__VA_ARGS__, __VA_ARGS__)
+
+// the 32 bytes ending `count` bytes before the end of input, continuing from previous
+__attribute__((target("avx2")))
+static inline __m256i previousBytes(__m256i input, __m256i previous, int count) {
+    __m256i shifted = _mm256_permute2x128_si256(previous, input, 0x21);
+
+    switch (count) {
+        case 1: return _mm256_alignr_epi8(input, shifted, 15);
+        case 2: return _mm256_alignr_epi8(input, shifted, 14);
+        default: return _mm256_alignr_epi8(input, shifted, 13);
+    }
+}
+
+__attribute__((target("avx2")))
+static inline __m256i utf8Errors(__m256i input, __m256i previous) {
+    const __m256i lowNibble = _mm256_set1_epi8(0x0F);
+
+    const __m256i byte1HighTable = TABLE16(
+        TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG,
+        TWO_CONTS, TWO_CONTS, TWO_CONTS, TWO_CONTS,
+        TOO_SHORT | OVERLONG_2,
+        TOO_SHORT,
+        TOO_SHORT | OVERLONG_3 | SURROGATE,
+        TOO_SHORT | TOO_LARGE | TOO_LARGE_1000 | OVERLONG_4
+    );
+
+    const __m256i byte1LowTable = TABLE16(
+        CARRY | OVERLONG_3 | OVERLONG_2 | OVERLONG_4,
+        CARRY | OVERLONG_2,
+        CARRY,
+        CARRY,
+        CARRY | TOO_LARGE,
+        CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000 | SURROGATE,
+        CARRY | TOO_LARGE | TOO_LARGE_1000,
+        CARRY | TOO_LARGE | TOO_LARGE_1000
+    );
+
+    const __m256i byte2HighTable = TABLE16(
+        TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT,
+        TOO_LONG | OVERLONG_2 | TWO_CONTS | OVERLONG_3 | TOO_LARGE_1000 | OVERLONG_4,
+        TOO_LONG | OVERLONG_2 | TWO_CONTS | OVERLONG_3 | TOO_LARGE,
+        TOO_LONG | OVERLONG_2 | TWO_CONTS | SURROGATE | TOO_LARGE,
+        TOO_LONG | OVERLONG_2 | TWO_CONTS | SURROGATE | TOO_LARGE,
+        TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT
+    );
+
+    __m256i previous1 = previousBytes(input, previous, 1);
+
+    // there is no 8 bit shift, masking off the bits shifted in from the neighbour does the same
+    __m256i byte1High = _mm256_shuffle_epi8(byte1HighTable, _mm256_and_si256(_mm256_srli_epi16(previous1, 4), lowNibble));
+    __m256i byte1Low = _mm256_shuffle_epi8(byte1LowTable, _mm256_and_si256(previous1, lowNibble));
+    __m256i byte2High = _mm256_shuffle_epi8(byte2HighTable, _mm256_and_si256(_mm256_srli_epi16(input, 4), lowNibble));
+
+    __m256i special = _mm256_and_si256(_mm256_and_si256(byte1High, byte1Low), byte2High);
+
+    // bytes two after a 3 or 4 byte lead, or three after a 4 byte lead, must be continuations
+    __m256i thirdByte = _mm256_subs_epu8(previousBytes(input, previous, 2), _mm256_set1_epi8((char)(0xE0 - 0x80)));
+    __m256i fourthByte = _mm256_subs_epu8(previousBytes(input, previous, 3), _mm256_set1_epi8((char)(0xF0 - 0x80)));
+    __m256i mustContinue = _mm256_and_si256(_mm256_or_si256(thirdByte, fourthByte), _mm256_set1_epi8((char)0x80));
+
+    return _mm256_xor_si256(mustContinue, special);
+}
+
+__attribute__((target("avx2")))
+static bool validUtf8Avx2(const unsigned char *str, size_t length) {
+    // a lead byte in the last three positions that still expects continuation bytes
+    const __m256i incompleteLimit = _mm256_setr_epi8(
+        -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+        -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+        (char)(0xF0 - 1), (char)(0xE0 - 1), (char)(0xC0 - 1)
+    );
+
+    __m256i previous = _mm256_setzero_si256();
+    __m256i incomplete = _mm256_setzero_si256();
+    __m256i errors = _mm256_setzero_si256();
+
+    size_t pos = 0;
+    for (; pos + 32 <= length; pos += 32) {
+        __m256i input = _mm256_loadu_si256((const __m256i *)(str + pos));
+
+        if (_mm256_movemask_epi8(input) == 0) {
+            // an ASCII block cannot finish a sequence left open by the previous one
+            errors = _mm256_or_si256(errors, incomplete);
+            incomplete = _mm256_setzero_si256();
+        } else {
+            errors = _mm256_or_si256(errors, utf8Errors(input, previous));
+            incomplete = _mm256_subs_epu8(input, incompleteLimit);
+        }
+
+        previous = input;
+    }
+
+    if (!_mm256_testz_si256(errors, errors)) return false;
+
+    // sequences starting in the last three bytes of the blocks were not checked against what follows
+    size_t tail = pos;
+    for (size_t back = 1; back <= 3 && back <= pos; back++) {
+        if ((str[pos - back] & 0xC0) != 0x80) {
+            tail = pos - back;
+            break;
+        }
+    }
+
+    return validUtf8Scalar(str, tail, length);
+}
+#endif
+
+bool jsonValidUtf8(const char *str, size_t length) {
+    const unsigned char *bytes = (const unsigned char *)str;
+
+#if defined(HAS_AVX2_PATH)
+    if (length >= 64 && hasAvx2()) return validUtf8Avx2(bytes, length);
+#endif
+
+    size_t pos = 0;
+
+#if defined(__SSE2__)
+    // skip ASCII 16 bytes at a time, anything else is checked one sequence at a time
+    while (pos + 16 <= length) {
+        unsigned mask = _mm_movemask_epi8(_mm_loadu_si128((const __m128i *)(bytes + pos)));
+
+        if (!mask) {
+            pos += 16;
+            continue;
+        }
+
+        pos += __builtin_ctz(mask);
+
+        size_t sequence = sequenceLength(bytes + pos, length - pos);
+        if (!sequence) return false;
+
+        pos += sequence;
+    }
+#endif
+
+    return validUtf8Scalar(bytes, pos, length);
+}
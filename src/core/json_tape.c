@@ -0,0 +1,719 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "../include/json_tape.h"
+#include "../include/json_number.h"
+#include "../include/json_string.h"
+
+// set on a closing quote's position when the string contains a backslash
+#define QUOTE_ESCAPED 0x80000000u
+#define POSITION_MASK 0x7FFFFFFFu
+
+typedef struct {
+    uint32_t *positions;
+    size_t    count;
+    size_t    capacity;
+} StructuralIndex;
+
+static void growIndex(StructuralIndex *index) {
+    index->capacity *= 2;
+    index->positions = realloc(index->positions, sizeof(uint32_t) * index->capacity);
+
+    if (!index->positions) {
+        fprintf(stderr, "Fatal: out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+}
+
+static inline void pushStructural(StructuralIndex *index, uint32_t position) {
+    if (index->count >= index->capacity) {
+        growIndex(index);
+    }
+
+    index->positions[index->count++] = position;
+}
+
+typedef struct {
+    bool   inString;
+    bool   escaped;
+
+    // position of the character following a backslash
+    size_t skip;
+} ScanState;
+
+// candidates are quotes, backslashes and structural characters. Inside strings only the
+// closing quote is kept, structural characters are part of the text
+static inline void scanCandidate(const char *src, size_t pos, ScanState *state, StructuralIndex *index) {
+    if (pos == state->skip) return;
+
+    char c = src[pos];
+
+    if (state->inString) {
+        if (c == '\\') {
+            state->skip = pos + 1;
+            state->escaped = true;
+        } else if (c == '"') {
+            state->inString = false;
+            pushStructural(index, pos | (state->escaped ? QUOTE_ESCAPED : 0));
+        }
+        return;
+    }
+
+    if (c == '"') {
+        state->inString = true;
+        state->escaped = false;
+    } else if (c == '\\') {
+        // not structural, stage 2 rejects it when it fails to parse as a value
+        return;
+    }
+
+    pushStructural(index, pos);
+}
+
+static inline bool isCandidate(char c) {
+    return c == '"' || c == '\\' || c == '{' || c == '}' || c == '[' || c == ']' || c == ':' || c == ',';
+}
+
+// stage 1: collect the positions of all structural characters
+static bool indexStructurals(const char *src, size_t length, StructuralIndex *index) {
+    ScanState state = { .inString = false, .escaped = false, .skip = SIZE_MAX };
+    size_t pos = 0;
+
+#if defined(__SSE2__)
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    const __m128i colon = _mm_set1_epi8(':');
+    const __m128i comma = _mm_set1_epi8(',');
+    const __m128i caseBit = _mm_set1_epi8(0x20);
+    const __m128i openBrace = _mm_set1_epi8('{');
+    const __m128i closeBrace = _mm_set1_epi8('}');
+
+    for (; pos + 16 <= length; pos += 16) {
+        __m128i chunk = _mm_loadu_si128((const __m128i *)(src + pos));
+
+        // '[' and ']' only differ from '{' and '}' by 0x20
+        __m128i folded = _mm_or_si128(chunk, caseBit);
+
+        __m128i matches = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(chunk, quote), _mm_cmpeq_epi8(chunk, backslash)),
+            _mm_or_si128(
+                _mm_or_si128(_mm_cmpeq_epi8(chunk, colon), _mm_cmpeq_epi8(chunk, comma)),
+                _mm_or_si128(_mm_cmpeq_epi8(folded, openBrace), _mm_cmpeq_epi8(folded, closeBrace))
+            )
+        );
+
+        unsigned mask = _mm_movemask_epi8(matches);
+        while (mask) {
+            scanCandidate(src, pos + __builtin_ctz(mask), &state, index);
+            mask &= mask - 1;
+        }
+    }
+#endif
+
+    for (; pos < length; pos++) {
+        if (isCandidate(src[pos])) {
+            scanCandidate(src, pos, &state, index);
+        }
+    }
+
+    return !state.inString;
+}
+
+typedef struct {
+    JsonDocument   *document;
+    size_t          tapeCapacity;
+
+    const uint32_t *structurals;
+    size_t          structuralCount;
+    size_t          next;
+} TapeBuilder;
+
+static inline size_t skipWhitespace(const char *src, size_t pos, size_t length) {
+    while (pos < length && (src[pos] == ' ' || src[pos] == '\n' || src[pos] == '\r' || src[pos] == '\t')) {
+        pos++;
+    }
+    return pos;
+}
+
+static inline bool takeStructural(TapeBuilder *builder, size_t pos) {
+    if (builder->next >= builder->structuralCount) return false;
+    if ((builder->structurals[builder->next] & POSITION_MASK) != pos) return false;
+
+    builder->next++;
+    return true;
+}
+
+static inline JsonTapeEntry *emit(TapeBuilder *builder, uint8_t type) {
+    JsonDocument *document = builder->document;
+    if (document->tapeCount >= builder->tapeCapacity) return NULL;
+
+    JsonTapeEntry *entry = &document->tape[document->tapeCount++];
+    entry->type = type;
+    entry->flags = 0;
+    entry->length = 0;
+    entry->offset = 0;
+
+    return entry;
+}
+
+static inline bool isDigit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+static inline int hexValue(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+// checks a raw string body: escapes must be well formed and control characters are not allowed.
+// jumps straight from one quote, backslash or control character to the next
+static bool validString(const char *str, size_t length) {
+    for (size_t i = jsonFindEscape(str, length); i < length; i += 1 + jsonFindEscape(str + i + 1, length - i - 1)) {
+        if (str[i] != '\\') return false;
+        if (++i >= length) return false;
+
+        switch (str[i]) {
+            case '"': case '\\': case '/': case 'b': case 'f': case 'n': case 'r': case 't':
+                break;
+            case 'u':
+                if (i + 4 >= length) return false;
+                for (int h = 1; h <= 4; h++) {
+                    if (hexValue(str[i + h]) < 0) return false;
+                }
+                i += 4;
+                break;
+            default:
+                return false;
+        }
+    }
+
+    return true;
+}
+
+static bool parseString(TapeBuilder *builder, size_t *pos) {
+    size_t open = *pos;
+    if (!takeStructural(builder, open)) return false;
+    if (builder->next >= builder->structuralCount) return false;
+
+    uint32_t close = builder->structurals[builder->next++];
+    bool escaped = close & QUOTE_ESCAPED;
+    close &= POSITION_MASK;
+
+    JsonTapeEntry *entry = emit(builder, JSON_TAPE_STRING);
+    if (!entry) return false;
+
+    entry->offset = open + 1;
+    entry->length = close - open - 1;
+
+    if (!validString(builder->document->source + entry->offset, entry->length)) return false;
+    if (escaped) entry->flags = JSON_TAPE_ESCAPED;
+
+    *pos = close + 1;
+    return true;
+}
+
+static size_t parseNumber(JsonTapeEntry *entry, const char *src, size_t pos, size_t length) {
+    JsonNumber number;
+
+    size_t used = jsonParseNumber(src + pos, length - pos, &number);
+    if (!used) return 0;
+
+    if (number.isInteger) {
+        entry->type = JSON_TAPE_INTEGER;
+        entry->integer = number.integer;
+    } else {
+        entry->type = JSON_TAPE_DOUBLE;
+        entry->number = number.number;
+    }
+
+    return pos + used;
+}
+
+// true, false, null and numbers, returns the position after the value or 0
+static size_t parseAtom(TapeBuilder *builder, size_t pos) {
+    const char *src = builder->document->source;
+    size_t length = builder->document->length;
+
+    JsonTapeEntry *entry = emit(builder, JSON_TAPE_NULL);
+    if (!entry) return 0;
+
+    switch (src[pos]) {
+        case 't':
+            if (length - pos < 4 || memcmp(src + pos, "true", 4) != 0) return 0;
+            entry->type = JSON_TAPE_TRUE;
+            return pos + 4;
+        case 'f':
+            if (length - pos < 5 || memcmp(src + pos, "false", 5) != 0) return 0;
+            entry->type = JSON_TAPE_FALSE;
+            return pos + 5;
+        case 'n':
+            if (length - pos < 4 || memcmp(src + pos, "null", 4) != 0) return 0;
+            return pos + 4;
+        default:
+            if (src[pos] != '-' && !isDigit(src[pos])) return 0;
+            return parseNumber(entry, src, pos, length);
+    }
+}
+
+typedef enum {
+    EXPECT_VALUE,
+    EXPECT_ARRAY_FIRST,
+    EXPECT_OBJECT_FIRST,
+    EXPECT_KEY,
+    EXPECT_AFTER_VALUE,
+} TapeState;
+
+// stage 2: walk the structural positions and write the tape
+static bool buildTape(TapeBuilder *builder) {
+    JsonDocument *document = builder->document;
+    const char *src = document->source;
+    size_t length = document->length;
+
+    uint32_t stack[JSON_MAX_DEPTH];
+    int depth = 0;
+
+    TapeState state = EXPECT_VALUE;
+    size_t pos = 0;
+
+    while (true) {
+        pos = skipWhitespace(src, pos, length);
+
+        switch (state) {
+            case EXPECT_OBJECT_FIRST:
+            case EXPECT_ARRAY_FIRST: {
+                char close = state == EXPECT_OBJECT_FIRST ? '}' : ']';
+
+                if (pos < length && src[pos] == close) {
+                    if (!takeStructural(builder, pos)) return false;
+
+                    uint32_t start = stack[--depth];
+                    if (!emit(builder, close)) return false;
+                    document->tape[start].end = document->tapeCount;
+
+                    pos++;
+                    state = EXPECT_AFTER_VALUE;
+                    break;
+                }
+
+                state = state == EXPECT_OBJECT_FIRST ? EXPECT_KEY : EXPECT_VALUE;
+                break;
+            }
+
+            case EXPECT_KEY:
+                if (pos >= length || src[pos] != '"') return false;
+                if (!parseString(builder, &pos)) return false;
+
+                pos = skipWhitespace(src, pos, length);
+                if (pos >= length || src[pos] != ':' || !takeStructural(builder, pos)) return false;
+
+                pos++;
+                state = EXPECT_VALUE;
+                break;
+
+            case EXPECT_VALUE: {
+                if (pos >= length) return false;
+
+                char c = src[pos];
+
+                if (c == '{' || c == '[') {
+                    if (depth >= JSON_MAX_DEPTH || !takeStructural(builder, pos)) return false;
+
+                    stack[depth++] = document->tapeCount;
+                    if (!emit(builder, c)) return false;
+
+                    pos++;
+                    state = c == '{' ? EXPECT_OBJECT_FIRST : EXPECT_ARRAY_FIRST;
+                    break;
+                }
+
+                if (c == '"') {
+                    if (!parseString(builder, &pos)) return false;
+                } else {
+                    size_t end = parseAtom(builder, pos);
+                    if (!end) return false;
+                    pos = end;
+                }
+
+                state = EXPECT_AFTER_VALUE;
+                break;
+            }
+
+            case EXPECT_AFTER_VALUE: {
+                if (depth == 0) {
+                    return pos == length && builder->next == builder->structuralCount;
+                }
+
+                JsonTapeEntry *container = &document->tape[stack[depth - 1]];
+                container->length++;
+
+                if (pos >= length || !takeStructural(builder, pos)) return false;
+
+                char c = src[pos++];
+                bool inObject = container->type == JSON_TAPE_OBJECT_START;
+
+                if (c == ',') {
+                    state = inObject ? EXPECT_KEY : EXPECT_VALUE;
+                    break;
+                }
+
+                if (c != (inObject ? '}' : ']')) return false;
+
+                uint32_t start = stack[--depth];
+                if (!emit(builder, c)) return false;
+                document->tape[start].end = document->tapeCount;
+
+                state = EXPECT_AFTER_VALUE;
+                break;
+            }
+        }
+    }
+}
+
+void freeJsonDocument(JsonDocument *document) {
+    if (!document) return;
+
+    free(document->source);
+    free(document->tape);
+    freeArena(&document->arena);
+    free(document);
+}
+
+JsonDocument *jsonParseDocument(const char *json, size_t length) {
+    if (!json || length >= POSITION_MASK) return NULL;
+
+    JsonDocument *document = malloc(sizeof(JsonDocument));
+    if (!document) {
+        fprintf(stderr, "Fatal: out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+
+    document->source = malloc(length + 1);
+    document->length = length;
+    document->tape = NULL;
+    document->tapeCount = 0;
+    document->arena = arena(1024);
+    document->materialized = NULL;
+
+    if (!document->source) {
+        fprintf(stderr, "Fatal: out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+
+    memcpy(document->source, json, length);
+    document->source[length] = '\0';
+
+    if (!jsonValidUtf8(document->source, length)) {
+        freeJsonDocument(document);
+        return NULL;
+    }
+
+    StructuralIndex index = {
+        .positions = malloc(sizeof(uint32_t) * (length / 8 + 16)),
+        .count = 0,
+        .capacity = length / 8 + 16,
+    };
+
+    if (!index.positions) {
+        fprintf(stderr, "Fatal: out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+
+    if (!indexStructurals(document->source, length, &index)) {
+        free(index.positions);
+        freeJsonDocument(document);
+        return NULL;
+    }
+
+    // every tape entry consumes at least one structural, except atoms which follow one
+    TapeBuilder builder = {
+        .document = document,
+        .tapeCapacity = index.count + 2,
+        .structurals = index.positions,
+        .structuralCount = index.count,
+        .next = 0,
+    };
+
+    document->tape = malloc(sizeof(JsonTapeEntry) * builder.tapeCapacity);
+    if (!document->tape) {
+        fprintf(stderr, "Fatal: out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+
+    bool valid = buildTape(&builder);
+    free(index.positions);
+
+    if (!valid) {
+        freeJsonDocument(document);
+        return NULL;
+    }
+
+    return document;
+}
+
+JsonValue jsonDocumentRoot(JsonDocument *document) {
+    return (JsonValue) {
+        .document = document,
+        .index = 0,
+    };
+}
+
+static inline JsonTapeEntry *entryOf(JsonValue value) {
+    return &value.document->tape[value.index];
+}
+
+JsonType jsonValueType(JsonValue value) {
+    switch (entryOf(value)->type) {
+        case JSON_TAPE_OBJECT_START:
+            return JSON_OBJECT;
+        case JSON_TAPE_ARRAY_START:
+            return JSON_ARRAY;
+        case JSON_TAPE_STRING:
+            return JSON_STRING;
+        case JSON_TAPE_INTEGER:
+            return JSON_NUMBER;
+        case JSON_TAPE_DOUBLE:
+            return JSON_DOUBLE;
+        case JSON_TAPE_TRUE:
+            return JSON_TRUE;
+        case JSON_TAPE_FALSE:
+            return JSON_FALSE;
+        default:
+            return JSON_NULL;
+    }
+}
+
+bool jsonValueIsInteger(JsonValue value) {
+    return entryOf(value)->type == JSON_TAPE_INTEGER;
+}
+
+size_t jsonValueCount(JsonValue value) {
+    JsonTapeEntry *entry = entryOf(value);
+
+    if (entry->type != JSON_TAPE_OBJECT_START && entry->type != JSON_TAPE_ARRAY_START) return 0;
+    return entry->length;
+}
+
+JsonValue jsonValueSkip(JsonValue value) {
+    JsonTapeEntry *entry = entryOf(value);
+
+    if (entry->type == JSON_TAPE_OBJECT_START || entry->type == JSON_TAPE_ARRAY_START) {
+        value.index = entry->end;
+    } else {
+        value.index++;
+    }
+
+    return value;
+}
+
+JsonValue jsonValueFirst(JsonValue container) {
+    container.index++;
+    return container;
+}
+
+bool jsonValueIsEnd(JsonValue value) {
+    uint8_t type = entryOf(value)->type;
+    return type == JSON_TAPE_OBJECT_END || type == JSON_TAPE_ARRAY_END;
+}
+
+static void appendUtf8(char **out, uint32_t codepoint) {
+    char *p = *out;
+
+    if (codepoint < 0x80) {
+        *p++ = codepoint;
+    } else if (codepoint < 0x800) {
+        *p++ = 0xC0 | (codepoint >> 6);
+        *p++ = 0x80 | (codepoint & 0x3F);
+    } else if (codepoint < 0x10000) {
+        *p++ = 0xE0 | (codepoint >> 12);
+        *p++ = 0x80 | ((codepoint >> 6) & 0x3F);
+        *p++ = 0x80 | (codepoint & 0x3F);
+    } else {
+        *p++ = 0xF0 | (codepoint >> 18);
+        *p++ = 0x80 | ((codepoint >> 12) & 0x3F);
+        *p++ = 0x80 | ((codepoint >> 6) & 0x3F);
+        *p++ = 0x80 | (codepoint & 0x3F);
+    }
+
+    *out = p;
+}
+
+static uint32_t readHex4(const char *p) {
+    return (hexValue(p[0]) << 12) | (hexValue(p[1]) << 8) | (hexValue(p[2]) << 4) | hexValue(p[3]);
+}
+
+// decodes the escape at *read into at most 4 bytes at *write and moves both past it. The escape must already be valid
+static void decodeEscape(const char **read, const char *end, char **write) {
+    const char *p = *read + 2;
+    char escape = p[-1];
+
+    switch (escape) {
+        case 'b': *(*write)++ = '\b'; break;
+        case 'f': *(*write)++ = '\f'; break;
+        case 'n': *(*write)++ = '\n'; break;
+        case 'r': *(*write)++ = '\r'; break;
+        case 't': *(*write)++ = '\t'; break;
+        case 'u': {
+            uint32_t codepoint = readHex4(p);
+            p += 4;
+
+            if (codepoint >= 0xD800 && codepoint <= 0xDBFF) {
+                uint32_t low = end - p >= 6 && p[0] == '\\' && p[1] == 'u' ? readHex4(p + 2) : 0;
+
+                if (low >= 0xDC00 && low <= 0xDFFF) {
+                    codepoint = 0x10000 + ((codepoint - 0xD800) << 10) + (low - 0xDC00);
+                    p += 6;
+                } else {
+                    codepoint = 0xFFFD;
+                }
+            } else if (codepoint >= 0xDC00 && codepoint <= 0xDFFF) {
+                codepoint = 0xFFFD;
+            }
+
+            appendUtf8(write, codepoint);
+            break;
+        }
+        default:
+            *(*write)++ = escape;
+            break;
+    }
+
+    *read = p;
+}
+
+// unescaped text is never longer than its source, so out may be the source itself. Escapes must already be valid
+static size_t unescape(char *out, const char *str, size_t length) {
+    const char *read = str;
+    const char *end = str + length;
+    char *write = out;
+
+    while (read < end) {
+        const char *backslash = memchr(read, '\\', end - read);
+        if (!backslash) backslash = end;
+
+        if (write != read) memmove(write, read, backslash - read);
+        write += backslash - read;
+        read = backslash;
+
+        if (read >= end) break;
+
+        decodeEscape(&read, end, &write);
+    }
+
+    return write - out;
+}
+
+bool jsonUnescape(char *out, const char *str, size_t length, size_t *outLength) {
+    if (!validString(str, length)) return false;
+
+    *outLength = unescape(out, str, length);
+    return true;
+}
+
+bool jsonUnescapedEquals(const char *str, size_t length, const char *text, size_t textLength) {
+    if (!validString(str, length)) return false;
+
+    const char *read = str;
+    const char *end = str + length;
+    const char *expected = text;
+    const char *expectedEnd = text + textLength;
+
+    while (read < end) {
+        const char *backslash = memchr(read, '\\', end - read);
+        if (!backslash) backslash = end;
+
+        size_t plain = backslash - read;
+        if ((size_t)(expectedEnd - expected) < plain || memcmp(read, expected, plain) != 0) return false;
+
+        expected += plain;
+        read = backslash;
+
+        if (read >= end) break;
+
+        char decoded[4];
+        char *write = decoded;
+        decodeEscape(&read, end, &write);
+
+        size_t size = write - decoded;
+        if ((size_t)(expectedEnd - expected) < size || memcmp(decoded, expected, size) != 0) return false;
+
+        expected += size;
+    }
+
+    return expected == expectedEnd;
+}
+
+const char *jsonValueString(JsonValue value, size_t *length) {
+    JsonTapeEntry *entry = entryOf(value);
+    if (entry->type != JSON_TAPE_STRING) return NULL;
+
+    char *str = value.document->source + entry->offset;
+
+    if (!(entry->flags & JSON_TAPE_UNESCAPED)) {
+        if (entry->flags & JSON_TAPE_ESCAPED) {
+            entry->length = unescape(str, str, entry->length);
+        }
+
+        // overwrites the closing quote, which is no longer needed once the tape is built
+        str[entry->length] = '\0';
+        entry->flags |= JSON_TAPE_UNESCAPED;
+    }
+
+    if (length) *length = entry->length;
+    return str;
+}
+
+long long jsonValueInteger(JsonValue value) {
+    JsonTapeEntry *entry = entryOf(value);
+
+    if (entry->type == JSON_TAPE_INTEGER) return entry->integer;
+    if (entry->type == JSON_TAPE_DOUBLE) return (long long)entry->number;
+
+    return 0;
+}
+
+double jsonValueDouble(JsonValue value) {
+    JsonTapeEntry *entry = entryOf(value);
+
+    if (entry->type == JSON_TAPE_DOUBLE) return entry->number;
+    if (entry->type == JSON_TAPE_INTEGER) return (double)entry->integer;
+
+    return 0;
+}
+
+bool jsonValueBool(JsonValue value) {
+    return entryOf(value)->type == JSON_TAPE_TRUE;
+}
+
+bool jsonValueFind(JsonValue object, const char *key, JsonValue *out) {
+    if (entryOf(object)->type != JSON_TAPE_OBJECT_START) return false;
+
+    size_t keyLength = strlen(key);
+    JsonValue member = jsonValueFirst(object);
+
+    while (!jsonValueIsEnd(member)) {
+        JsonTapeEntry *entry = entryOf(member);
+
+        // escaped keys have to be unescaped before their length means anything
+        if ((entry->flags & (JSON_TAPE_ESCAPED | JSON_TAPE_UNESCAPED)) == JSON_TAPE_ESCAPED) {
+            jsonValueString(member, NULL);
+        }
+
+        JsonValue value = { .document = object.document, .index = member.index + 1 };
+
+        if (entry->length == keyLength && memcmp(object.document->source + entry->offset, key, keyLength) == 0) {
+            if (out) *out = value;
+            return true;
+        }
+
+        member = jsonValueSkip(value);
+    }
+
+    return false;
+}
@@ -0,0 +1,626 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../include/json_writer.h"
+#include "../include/json_tape.h"
+#include "../include/json_number.h"
+#include "../include/json_string.h"
+
+JsonWriter jsonWriter() {
+    return (JsonWriter) {
+        .buffer = NULL,
+        .length = 0,
+        .capacity = 0,
+        .stream = NULL,
+        .depth = 0,
+    };
+}
+
+void freeJsonWriter(JsonWriter *writer) {
+    if (!writer) return;
+
+    free(writer->buffer);
+    writer->buffer = NULL;
+    writer->length = 0;
+    writer->capacity = 0;
+}
+
+JsonWriter jsonStreamWriter(RequestContext ctx, HttpStatusCode status) {
+    JsonWriter writer = jsonWriter();
+
+    writer.stream = ctx.stream;
+    writer.capacity = JSON_STREAM_BUFFER_SIZE;
+    writer.buffer = malloc(writer.capacity);
+
+    if (!writer.buffer) {
+        fprintf(stderr, "Fatal: out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+
+    if (!writer.stream || !startChunkedResponse(writer.stream, status, APPLICATION_JSON)) {
+        writer.failed = true;
+    }
+
+    return writer;
+}
+
+static void grow(JsonWriter *writer, size_t extra) {
+    // streamed writers send the full buffer as a chunk instead of growing it
+    if (writer->stream && writer->length > 0) {
+        jwFlush(writer);
+        if (extra <= writer->capacity) return;
+    }
+
+    size_t capacity = writer->capacity == 0 ? 64 : writer->capacity;
+    while (writer->length + extra > capacity) {
+        capacity *= 2;
+    }
+
+    writer->buffer = realloc(writer->buffer, capacity);
+    if (!writer->buffer) {
+        fprintf(stderr, "Fatal: out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+
+    writer->capacity = capacity;
+}
+
+static inline void reserve(JsonWriter *writer, size_t extra) {
+    if (writer->length + extra > writer->capacity) {
+        grow(writer, extra);
+    }
+}
+
+static inline void append(JsonWriter *writer, const char *data, size_t length) {
+    reserve(writer, length);
+    memcpy(writer->buffer + writer->length, data, length);
+    writer->length += length;
+}
+
+static inline void appendChar(JsonWriter *writer, char c) {
+    reserve(writer, 1);
+    writer->buffer[writer->length++] = c;
+}
+
+bool jwFlush(JsonWriter *writer) {
+    if (!writer->stream) return true;
+
+    // once the client is gone the output is dropped, so the buffer never has to grow
+    if (writer->failed) {
+        writer->length = 0;
+        return false;
+    }
+
+    if (!writeChunk(writer->stream, writer->buffer, writer->length)) {
+        writer->failed = true;
+    }
+
+    writer->length = 0;
+    return !writer->failed;
+}
+
+// 0 = copy as is, otherwise the character after the backslash ('u' means \u00XX)
+static const char escapeTable[256] = {
+    'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'b', 't', 'n', 'u', 'f', 'r', 'u', 'u',
+    'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u',
+    0, 0, '"', 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, '\\', 0, 0, 0,
+};
+
+static void appendEscaped(JsonWriter *writer, const char *str, size_t length) {
+    static const char hex[] = "0123456789abcdef";
+
+    appendChar(writer, '"');
+
+    const unsigned char *p = (const unsigned char *)str;
+    const unsigned char *end = p + length;
+
+    while (p < end) {
+        // copy the clean run up to the next byte that needs escaping in one go
+        size_t run = jsonFindEscape((const char *)p, end - p);
+        append(writer, (const char *)p, run);
+
+        p += run;
+        if (p == end) break;
+
+        char escape = escapeTable[*p];
+
+        if (escape == 'u') {
+            char sequence[6] = { '\\', 'u', '0', '0', hex[*p >> 4], hex[*p & 0xF] };
+            append(writer, sequence, sizeof(sequence));
+        } else {
+            char sequence[2] = { '\\', escape };
+            append(writer, sequence, sizeof(sequence));
+        }
+
+        p++;
+    }
+
+    appendChar(writer, '"');
+}
+
+static const char digitPairs[201] =
+    "00010203040506070809"
+    "10111213141516171819"
+    "20212223242526272829"
+    "30313233343536373839"
+    "40414243444546474849"
+    "50515253545556575859"
+    "60616263646566676869"
+    "70717273747576777879"
+    "80818283848586878889"
+    "90919293949596979899";
+
+#define INTEGER_MAX_LENGTH 20
+
+// writes two digits at a time from the back of a scratch buffer, avoiding snprintf.
+// out needs INTEGER_MAX_LENGTH bytes
+static inline size_t formatInteger(char *out, long long value) {
+    char scratch[24];
+    char *end = scratch + sizeof(scratch);
+    char *p = end;
+
+    unsigned long long magnitude = value < 0 ? 0ULL - (unsigned long long)value : (unsigned long long)value;
+
+    while (magnitude >= 100) {
+        unsigned index = (magnitude % 100) * 2;
+        magnitude /= 100;
+        *--p = digitPairs[index + 1];
+        *--p = digitPairs[index];
+    }
+
+    if (magnitude >= 10) {
+        unsigned index = magnitude * 2;
+        *--p = digitPairs[index + 1];
+        *--p = digitPairs[index];
+    } else {
+        *--p = '0' + magnitude;
+    }
+
+    if (value < 0) *--p = '-';
+
+    memcpy(out, p, end - p);
+    return end - p;
+}
+
+static void appendInteger(JsonWriter *writer, long long value) {
+    reserve(writer, INTEGER_MAX_LENGTH);
+    writer->length += formatInteger(writer->buffer + writer->length, value);
+}
+
+// non-finite doubles have no JSON representation. out needs JSON_DOUBLE_MAX_LENGTH bytes
+static inline size_t formatDouble(char *out, double value) {
+    if (value != value || value > 1.7976931348623157e308 || value < -1.7976931348623157e308) {
+        memcpy(out, "null", 4);
+        return 4;
+    }
+
+    return jsonFormatDouble(value, out);
+}
+
+static void appendDouble(JsonWriter *writer, double value) {
+    reserve(writer, JSON_DOUBLE_MAX_LENGTH);
+    writer->length += formatDouble(writer->buffer + writer->length, value);
+}
+
+// packed arrays are written a block at a time, with room for the whole block reserved up front
+#define PACKED_BLOCK_SIZE 256
+
+static void appendIntegers(JsonWriter *writer, const long long *values, size_t count) {
+    size_t separator = writer->spaced ? 2 : 1;
+
+    for (size_t start = 0; start < count; start += PACKED_BLOCK_SIZE) {
+        size_t end = count - start < PACKED_BLOCK_SIZE ? count : start + PACKED_BLOCK_SIZE;
+
+        reserve(writer, (end - start) * (INTEGER_MAX_LENGTH + separator));
+        char *out = writer->buffer + writer->length;
+
+        for (size_t i = start; i < end; i++) {
+            if (i > 0) {
+                *out++ = ',';
+                if (separator == 2) *out++ = ' ';
+            }
+            out += formatInteger(out, values[i]);
+        }
+
+        writer->length = out - writer->buffer;
+    }
+}
+
+static void appendDoubles(JsonWriter *writer, const double *values, size_t count) {
+    size_t separator = writer->spaced ? 2 : 1;
+
+    for (size_t start = 0; start < count; start += PACKED_BLOCK_SIZE) {
+        size_t end = count - start < PACKED_BLOCK_SIZE ? count : start + PACKED_BLOCK_SIZE;
+
+        reserve(writer, (end - start) * (JSON_DOUBLE_MAX_LENGTH + separator));
+        char *out = writer->buffer + writer->length;
+
+        for (size_t i = start; i < end; i++) {
+            if (i > 0) {
+                *out++ = ',';
+                if (separator == 2) *out++ = ' ';
+            }
+            out += formatDouble(out, values[i]);
+        }
+
+        writer->length = out - writer->buffer;
+    }
+}
+
+// writes the separator owed before a value or key at the current depth
+static void separate(JsonWriter *writer) {
+    if (writer->afterKey) {
+        writer->afterKey = false;
+        return;
+    }
+
+    if (writer->depth == 0) return;
+
+    if (writer->hasItems[writer->depth - 1]) {
+        if (writer->spaced) append(writer, ", ", 2);
+        else appendChar(writer, ',');
+    }
+
+    writer->hasItems[writer->depth - 1] = true;
+}
+
+static void openContainer(JsonWriter *writer, char c) {
+    if (writer->failed) return;
+
+    if (writer->depth >= JSON_WRITER_MAX_DEPTH) {
+        writer->failed = true;
+        return;
+    }
+
+    separate(writer);
+    appendChar(writer, c);
+    writer->hasItems[writer->depth++] = false;
+}
+
+static void closeContainer(JsonWriter *writer, char c) {
+    if (writer->failed || writer->depth == 0) return;
+
+    writer->depth--;
+    writer->afterKey = false;
+    appendChar(writer, c);
+}
+
+void jwObjectStart(JsonWriter *writer) {
+    openContainer(writer, '{');
+}
+
+void jwObjectEnd(JsonWriter *writer) {
+    closeContainer(writer, '}');
+}
+
+void jwArrayStart(JsonWriter *writer) {
+    openContainer(writer, '[');
+}
+
+void jwArrayEnd(JsonWriter *writer) {
+    closeContainer(writer, ']');
+}
+
+void jwKey(JsonWriter *writer, const char *key) {
+    if (writer->failed) return;
+
+    separate(writer);
+    appendEscaped(writer, key, strlen(key));
+
+    if (writer->spaced) append(writer, ": ", 2);
+    else appendChar(writer, ':');
+
+    writer->afterKey = true;
+}
+
+void jwRawKey(JsonWriter *writer, const char *fragment, size_t length) {
+    if (writer->failed) return;
+
+    separate(writer);
+    append(writer, fragment, length);
+
+    if (writer->spaced) appendChar(writer, ' ');
+
+    writer->afterKey = true;
+}
+
+void jwKeyFragment(JsonWriter *writer, const char *key) {
+    if (writer->failed) return;
+
+    appendEscaped(writer, key, strlen(key));
+    appendChar(writer, ':');
+}
+
+void jwStringLength(JsonWriter *writer, const char *value, size_t length) {
+    if (writer->failed) return;
+
+    separate(writer);
+    appendEscaped(writer, value, length);
+}
+
+void jwString(JsonWriter *writer, const char *value) {
+    if (!value) {
+        jwNull(writer);
+        return;
+    }
+
+    jwStringLength(writer, value, strlen(value));
+}
+
+void jwInt(JsonWriter *writer, long long value) {
+    if (writer->failed) return;
+
+    separate(writer);
+    appendInteger(writer, value);
+}
+
+void jwDouble(JsonWriter *writer, double value) {
+    if (writer->failed) return;
+
+    separate(writer);
+    appendDouble(writer, value);
+}
+
+void jwIntegers(JsonWriter *writer, const long long *values, size_t count) {
+    if (writer->failed) return;
+
+    separate(writer);
+    appendChar(writer, '[');
+    appendIntegers(writer, values, count);
+    appendChar(writer, ']');
+}
+
+void jwDoubles(JsonWriter *writer, const double *values, size_t count) {
+    if (writer->failed) return;
+
+    separate(writer);
+    appendChar(writer, '[');
+    appendDoubles(writer, values, count);
+    appendChar(writer, ']');
+}
+
+void jwBool(JsonWriter *writer, bool value) {
+    if (writer->failed) return;
+
+    separate(writer);
+    if (value) append(writer, "true", 4);
+    else append(writer, "false", 5);
+}
+
+void jwNull(JsonWriter *writer) {
+    if (writer->failed) return;
+
+    separate(writer);
+    append(writer, "null", 4);
+}
+
+static inline void appendSeparator(JsonWriter *writer) {
+    if (writer->spaced) append(writer, ", ", 2);
+    else appendChar(writer, ',');
+}
+
+// writes a parsed value by walking its slice of the document's tape in order
+static void writeTape(JsonWriter *writer, JsonDocument *document, size_t index) {
+    JsonTapeEntry *tape = document->tape;
+
+    uint8_t first = tape[index].type;
+    size_t end = first == JSON_TAPE_OBJECT_START || first == JSON_TAPE_ARRAY_START ? tape[index].end : index + 1;
+
+    // one bit per open container, set for objects
+    uint64_t objects[JSON_MAX_DEPTH / 64] = {0};
+    int depth = 0;
+
+    bool afterOpen = true;
+    bool afterKey = false;
+    bool expectKey = false;
+
+    for (size_t i = index; i < end; i++) {
+        JsonTapeEntry *entry = &tape[i];
+
+        if (entry->type == JSON_TAPE_OBJECT_END || entry->type == JSON_TAPE_ARRAY_END) {
+            appendChar(writer, entry->type);
+
+            depth--;
+            afterOpen = false;
+            expectKey = depth > 0 && (objects[(depth - 1) / 64] >> ((depth - 1) % 64) & 1);
+            continue;
+        }
+
+        if (afterKey) {
+            if (writer->spaced) append(writer, ": ", 2);
+            else appendChar(writer, ':');
+        } else if (!afterOpen) {
+            appendSeparator(writer);
+        }
+
+        afterOpen = false;
+        afterKey = false;
+
+        switch (entry->type) {
+            case JSON_TAPE_STRING:
+                if (entry->flags & JSON_TAPE_ESCAPED) {
+                    size_t length;
+                    const char *str = jsonValueString((JsonValue) { .document = document, .index = i }, &length);
+                    appendEscaped(writer, str, length);
+                } else {
+                    appendEscaped(writer, document->source + entry->offset, entry->length);
+                }
+
+                if (expectKey) {
+                    afterKey = true;
+                    expectKey = false;
+                    continue;
+                }
+                break;
+            case JSON_TAPE_INTEGER:
+                appendInteger(writer, entry->integer);
+                break;
+            case JSON_TAPE_DOUBLE:
+                appendDouble(writer, entry->number);
+                break;
+            case JSON_TAPE_TRUE:
+                append(writer, "true", 4);
+                break;
+            case JSON_TAPE_FALSE:
+                append(writer, "false", 5);
+                break;
+            case JSON_TAPE_NULL:
+                append(writer, "null", 4);
+                break;
+            case JSON_TAPE_OBJECT_START:
+            case JSON_TAPE_ARRAY_START: {
+                appendChar(writer, entry->type);
+
+                bool isObject = entry->type == JSON_TAPE_OBJECT_START;
+                if (isObject) objects[depth / 64] |= 1ULL << (depth % 64);
+                else objects[depth / 64] &= ~(1ULL << (depth % 64));
+
+                depth++;
+                afterOpen = true;
+                expectKey = isObject;
+                continue;
+            }
+        }
+
+        expectKey = depth > 0 && (objects[(depth - 1) / 64] >> ((depth - 1) % 64) & 1);
+    }
+}
+
+static void writeTreeObject(JsonWriter *writer, JsonBuilder *builder);
+static void writeTree(JsonWriter *writer, const Json *json);
+
+static void writeArrayElements(JsonWriter *writer, const JsonArray *array) {
+    switch (array->type) {
+        case JSON_ARRAY_INTEGERS:
+            appendIntegers(writer, array->integers, array->count);
+            return;
+        case JSON_ARRAY_DOUBLES:
+            appendDoubles(writer, array->numbers, array->count);
+            return;
+        case JSON_ARRAY_STRINGS:
+            for (int i = 0; i < array->count; i++) {
+                if (i > 0) appendSeparator(writer);
+                appendEscaped(writer, array->strings[i].value, array->strings[i].length);
+            }
+            return;
+        default:
+            for (int i = 0; i < array->count; i++) {
+                if (i > 0) appendSeparator(writer);
+                writeTree(writer, &array->items[i]);
+            }
+            return;
+    }
+}
+
+// writes a whole Json subtree as one value, separators are emitted directly rather than tracked per depth
+static void writeTree(JsonWriter *writer, const Json *json) {
+    switch (json->type) {
+        case JSON_STRING:
+            if (json->value) appendEscaped(writer, json->value, strlen(json->value));
+            else append(writer, "null", 4);
+            break;
+        case JSON_TRUE:
+            append(writer, "true", 4);
+            break;
+        case JSON_FALSE:
+            append(writer, "false", 5);
+            break;
+        case JSON_NUMBER:
+            appendInteger(writer, json->integer);
+            break;
+        case JSON_DOUBLE:
+            appendDouble(writer, json->number);
+            break;
+        case JSON_OBJECT:
+            writeTreeObject(writer, json->object);
+            break;
+        case JSON_ARRAY:
+            if (!json->array) {
+                append(writer, "null", 4);
+                break;
+            }
+
+            appendChar(writer, '[');
+            writeArrayElements(writer, json->array);
+            appendChar(writer, ']');
+            break;
+        case JSON_NULL:
+        default:
+            append(writer, "null", 4);
+            break;
+    }
+}
+
+static void writeTreeObject(JsonWriter *writer, JsonBuilder *builder) {
+    if (!builder) {
+        append(writer, "null", 4);
+        return;
+    }
+
+    jsonResolve(builder);
+
+    if (builder->isView) {
+        writeTape(writer, builder->document, builder->tapeIndex);
+        return;
+    }
+
+    appendChar(writer, '{');
+    for (int i = 0; i < builder->jsonCount; i++) {
+        const Json *json = &builder->json[i];
+        const char *key = json->key ? json->key : "";
+
+        if (i > 0) {
+            if (writer->spaced) append(writer, ", ", 2);
+            else appendChar(writer, ',');
+        }
+
+        appendEscaped(writer, key, strlen(key));
+        if (writer->spaced) append(writer, ": ", 2);
+        else appendChar(writer, ':');
+
+        writeTree(writer, json);
+    }
+    appendChar(writer, '}');
+}
+
+void jwJson(JsonWriter *writer, const Json *json) {
+    if (writer->failed) return;
+
+    separate(writer);
+    writeTree(writer, json);
+}
+
+void jwObject(JsonWriter *writer, JsonBuilder *builder) {
+    if (writer->failed) return;
+
+    separate(writer);
+    writeTreeObject(writer, builder);
+}
+
+char *jwTakeString(JsonWriter *writer) {
+    appendChar(writer, '\0');
+
+    char *json = writer->buffer;
+    writer->buffer = NULL;
+    writer->length = 0;
+    writer->capacity = 0;
+
+    return json;
+}
+
+HttpResponse jwEndStream(JsonWriter *writer) {
+    ResponseStream *stream = writer->stream;
+
+    if (stream) {
+        jwFlush(writer);
+        endChunkedResponse(stream);
+    }
+
+    freeJsonWriter(writer);
+
+    return streamedResponse(stream);
+}
@@ -3,6 +3,8 @@
 #include <string.h>
 
 #include "../include/lavandula.h"
+#include "../include/gzip.h"
+#include "../include/json_shape.h"
 
 void initAppMiddleware(App *app) {
     app->middleware = (MiddlewareHandler) {
@@ -84,7 +86,66 @@ void useEnvironment(AppBuilder *builder, char *env) {
 }
 
 void useSqlLite3(AppBuilder *builder, char *dbPath) {
-    builder->app.dbContext = createSqlLite3DbContext(dbPath);
+    useSqlLite3Pool(builder, dbPath, DB_POOL_SIZE, dbDefaultPragmas());
+}
+
+void useSqlLite3Pool(AppBuilder *builder, char *dbPath, int size, DbPragmas pragmas) {
+    builder->app.dbPool = createDbPool(dbPath, size, pragmas);
+    if (builder->app.dbPool && builder->app.dbQueryCache) dbPoolUseQueryCache(builder->app.dbPool, builder->app.dbQueryCache);
+    if (builder->app.dbPool && builder->app.dbStats) dbPoolUseStats(builder->app.dbPool, builder->app.dbStats);
+}
+
+void useSqlLite3Writer(AppBuilder *builder, char *dbPath) {
+    builder->app.dbWriter = createDbWriter(dbPath, dbDefaultPragmas());
+    if (builder->app.dbWriter && builder->app.dbQueryCache) dbWriterUseQueryCache(builder->app.dbWriter, builder->app.dbQueryCache);
+    if (builder->app.dbWriter && builder->app.dbStats) dbWriterUseStats(builder->app.dbWriter, builder->app.dbStats);
+}
+
+void useSqlLite3QueryCache(AppBuilder *builder, size_t budget, int ttlMs) {
+    App *app = &builder->app;
+
+    freeDbQueryCache(app->dbQueryCache);
+    app->dbQueryCache = createDbQueryCache(budget, ttlMs);
+
+    if (app->dbPool) dbPoolUseQueryCache(app->dbPool, app->dbQueryCache);
+    if (app->dbWriter) dbWriterUseQueryCache(app->dbWriter, app->dbQueryCache);
+}
+
+static void useShardStats(DbShards *shards, DbStats *stats) {
+    for (int i = 0; i < dbShardCount(shards); i++) {
+        dbPoolUseStats(dbShardPool(shards, i), stats);
+        dbWriterUseStats(dbShardWriter(shards, i), stats);
+    }
+}
+
+void useSqlLite3Stats(AppBuilder *builder, double slowMs) {
+    App *app = &builder->app;
+
+    if (app->dbPool) dbPoolUseStats(app->dbPool, NULL);
+    if (app->dbWriter) dbWriterUseStats(app->dbWriter, NULL);
+    if (app->dbShards) useShardStats(app->dbShards, NULL);
+    freeDbStats(app->dbStats);
+
+    app->dbStats = createDbStats(slowMs, NULL);
+
+    if (app->dbPool) dbPoolUseStats(app->dbPool, app->dbStats);
+    if (app->dbWriter) dbWriterUseStats(app->dbWriter, app->dbStats);
+    if (app->dbShards) useShardStats(app->dbShards, app->dbStats);
+}
+
+// the query cache is not shared with the shards, it would give one shard's results for another's
+void useSqlLite3Shards(AppBuilder *builder, const char **paths, int count) {
+    App *app = &builder->app;
+
+    freeDbShards(app->dbShards);
+    app->dbShards = createDbShards(paths, count, dbDefaultPragmas());
+
+    if (app->dbShards && app->dbStats) useShardStats(app->dbShards, app->dbStats);
+}
+
+void useSqlLite3Async(AppBuilder *builder, int threads) {
+    freeDbAsyncPool(builder->app.dbAsync);
+    builder->app.dbAsync = createDbAsyncPool(builder->app.dbPool, threads);
 }
 
 void useLavender(AppBuilder *builder) {
@@ -133,6 +194,20 @@ void useDotenv(char *path) {
 }
 
 App build(AppBuilder builder) {
+    App *app = &builder.app;
+
+    if (isDevelopment(&builder) && (app->dbPool || app->dbWriter || app->dbShards) && !app->dbPlanChecker) {
+        app->dbPlanChecker = createDbPlanChecker(NULL);
+
+        if (app->dbPool) dbPoolUsePlanChecker(app->dbPool, app->dbPlanChecker);
+        if (app->dbWriter) dbWriterUsePlanChecker(app->dbWriter, app->dbPlanChecker);
+
+        for (int i = 0; app->dbShards && i < dbShardCount(app->dbShards); i++) {
+            dbPoolUsePlanChecker(dbShardPool(app->dbShards, i), app->dbPlanChecker);
+            dbWriterUsePlanChecker(dbShardWriter(app->dbShards, i), app->dbPlanChecker);
+        }
+    }
+
     return builder.app;
 }
 
@@ -145,12 +220,35 @@ void cleanupApp(App *app) {
     if (!app) return;
     
     freeServer(&app->server);
+    freeGzipInflater();
+    freeJsonKeys();
     dotenvClean();
     free(app->middleware.handlers);
 
-    if (!app->dbContext) return;
-    if (app->dbContext->type == SQLITE) {
-        free((char *)app->dbContext->connection);
+    // the database threads hold pool connections until they stop
+    freeDbAsyncPool(app->dbAsync);
+    app->dbAsync = NULL;
+
+    freeDbWriter(app->dbWriter);
+    app->dbWriter = NULL;
+
+    freeDbPool(app->dbPool);
+    app->dbPool = NULL;
+
+    freeDbShards(app->dbShards);
+    app->dbShards = NULL;
+
+    freeDbQueryCache(app->dbQueryCache);
+    app->dbQueryCache = NULL;
+
+    freeDbStats(app->dbStats);
+    app->dbStats = NULL;
+
+    if (app->dbPlanChecker) {
+        dbPlanReport(app->dbPlanChecker, stderr);
+
+        freeDbPlanChecker(app->dbPlanChecker);
+        app->dbPlanChecker = NULL;
     }
 }
 
@@ -5,6 +5,7 @@ RequestContext requestContext(App *app, HttpRequest request) {
     return (RequestContext) {
         .app = app,
         .request = request,
-        .db = app->dbContext,
+        .db = dbPoolConnection(app->dbPool),
+        .writer = app->dbWriter,
     };
 }
\ No newline at end of file
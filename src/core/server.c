@@ -8,13 +8,17 @@
 #include <pthread.h>
 #include <termios.h>
 #include <fcntl.h>
+#include <signal.h>
+#include <poll.h>
 
 #include "../include/server.h"
 #include "../include/http.h"
 #include "../include/middleware.h"
 #include "../include/request_context.h"
 #include "../include/sql.h"
+#include "../include/sql_async.h"
 #include "../include/app.h"
+#include "../include/gzip.h"
 
 typedef enum {
     STATE_RUNNING,
@@ -73,6 +77,190 @@ void freeServer(Server *server) {
     freeRouter(&server->router);
 }
 
+// reads until the headers and the announced Content-Length have arrived, returns NULL on failure
+static char *readRequest(int clientSocket, size_t *length) {
+    size_t capacity = BUFFER_SIZE;
+    size_t received = 0;
+    char *buffer = malloc(capacity);
+
+    if (!buffer) {
+        fprintf(stderr, "Fatal: out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+
+    size_t expected = 0;
+
+    while (expected == 0 || received < expected) {
+        if (received + 1 >= capacity) {
+            if (capacity >= MAX_BODY_SIZE + BUFFER_SIZE * 4) break;
+
+            capacity *= 2;
+            buffer = realloc(buffer, capacity);
+
+            if (!buffer) {
+                fprintf(stderr, "Fatal: out of memory\n");
+                exit(EXIT_FAILURE);
+            }
+        }
+
+        ssize_t bytesRead = read(clientSocket, buffer + received, capacity - received - 1);
+        if (bytesRead < 0) {
+            free(buffer);
+            return NULL;
+        }
+        if (bytesRead == 0) break;
+
+        received += bytesRead;
+        buffer[received] = '\0';
+
+        if (expected == 0) {
+            char *headersEnd = strstr(buffer, "\r\n\r\n");
+            if (!headersEnd) continue;
+
+            size_t headerLength = headersEnd - buffer + 4;
+            size_t contentLength = 0;
+
+            for (char *line = strstr(buffer, "\r\n"); line && line < headersEnd; line = strstr(line + 2, "\r\n")) {
+                if (strncasecmp(line + 2, "Content-Length:", 15) == 0) {
+                    contentLength = strtoull(line + 17, NULL, 10);
+                    break;
+                }
+            }
+
+            // oversized bodies are rejected by the parser, no need to wait for them
+            if (contentLength > MAX_BODY_SIZE) contentLength = 0;
+
+            expected = headerLength + contentLength;
+        }
+    }
+
+    buffer[received] = '\0';
+    *length = received;
+
+    return buffer;
+}
+
+// replaces a Content-Encoding: gzip body with its inflated form before the context is built
+static HttpStatusCode decodeRequestBody(HttpRequest *request) {
+    char *encoding = getHeader(request, "Content-Encoding");
+    if (!encoding || request->bodyLength == 0) return HTTP_OK;
+    if (strcasecmp(encoding, "identity") == 0) return HTTP_OK;
+
+    if (strcasecmp(encoding, "gzip") != 0 && strcasecmp(encoding, "x-gzip") != 0) {
+        return HTTP_UNSUPPORTED_MEDIA_TYPE;
+    }
+
+    char *inflated;
+    size_t inflatedLength;
+
+    GzipStatus status = gzipInflate(request->body, request->bodyLength, MAX_INFLATED_BODY_SIZE, &inflated, &inflatedLength);
+    if (status == GZIP_TOO_LARGE) return HTTP_PAYLOAD_TOO_LARGE;
+    if (status != GZIP_OK) return HTTP_BAD_REQUEST;
+
+    free(request->body);
+    request->body = inflated;
+    request->bodyLength = inflatedLength;
+
+    return HTTP_OK;
+}
+
+// application/json, any +json type, or no Content-Type at all
+static bool hasJsonBody(HttpRequest *request) {
+    char *contentType = getHeader(request, "Content-Type");
+    if (!contentType) return true;
+
+    size_t length = strcspn(contentType, ";");
+    while (length > 0 && (contentType[length - 1] == ' ' || contentType[length - 1] == '\t')) {
+        length--;
+    }
+
+    if (length == strlen("application/json") && strncasecmp(contentType, "application/json", length) == 0) {
+        return true;
+    }
+
+    return length > 5 && strncasecmp(contentType + length - 5, "+json", 5) == 0;
+}
+
+static void writeResponse(int clientSocket, HttpResponse response) {
+    if (!response.content) {
+        response.content = strdup("");
+        if (!response.content) {
+            fprintf(stderr, "Fatal: out of memory\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    int contentLength = strlen(response.content);
+
+    const char *statusText = httpStatusCodeToStr(response.status);
+
+    char header[512];
+    snprintf(header, sizeof(header),
+            "HTTP/1.1 %d %s\r\n"
+            "Content-Type: %s\r\n"
+            "Content-Length: %d\r\n"
+            "Connection: close\r\n"
+            "\r\n",
+            response.status, statusText, response.contentType, contentLength
+    );
+
+    if (write(clientSocket, header, strlen(header)) == -1) {
+        perror("write header failed");
+        exit(EXIT_FAILURE);
+    }
+    if (write(clientSocket, response.content, contentLength) == -1) {
+        perror("write content failed");
+        exit(EXIT_FAILURE);
+    }
+}
+
+// the body of a response the handler returned, or the end of one it streamed
+static void sendResponse(int clientSocket, HttpResponse response, ResponseStream *stream) {
+    if (!response.streamed) {
+        writeResponse(clientSocket, response);
+    } else if (!stream->finished) {
+        endChunkedResponse(stream);
+    }
+}
+
+// calls onDone for the queries the database threads have finished and sends their responses
+static void resumeQueries(App *app, Arena *requestArena) {
+    DbAsyncQuery *query;
+
+    while ((query = dbAsyncCompleted(app->dbAsync))) {
+        ResponseStream stream = responseStream(query->socket);
+
+        RequestContext context = requestContext(app, query->request);
+        context.stream = &stream;
+        context.arena = requestArena;
+
+        context.hasBody = query->request.bodyLength > 0;
+        context.body = query->jsonBody ? jsonParseLazy(query->request.body, query->request.bodyLength) : NULL;
+
+        HttpResponse response = query->onDone(context, query->result);
+        freeJsonBuilder(context.body);
+
+        // onDone may start another query for the same request
+        if (!response.deferred) {
+            sendResponse(query->socket, response, &stream);
+            close(query->socket);
+        }
+
+        arenaReset(requestArena);
+        freeDbAsyncQuery(query);
+    }
+}
+
+// waits for a connection, or a finished query, for at most timeoutMs
+static void waitForWork(App *app, int timeoutMs) {
+    struct pollfd fds[2] = {
+        { .fd = app->server.fileDescriptor, .events = POLLIN },
+        { .fd = dbAsyncFd(app->dbAsync), .events = POLLIN },
+    };
+
+    poll(fds, app->dbAsync ? 2 : 1, timeoutMs);
+}
+
 void* key_listener(void* arg) {
     (void)arg;
 
@@ -100,6 +288,9 @@ void runServer(App *app) {
     pthread_t thread_id;
     set_nonblocking_input();
 
+    // a client disconnecting mid-stream should fail the write, not kill the server
+    signal(SIGPIPE, SIG_IGN);
+
     if (pthread_create(&thread_id, NULL, key_listener, NULL)) {
         perror("Failed to create thread");
         return;
@@ -159,14 +350,20 @@ void runServer(App *app) {
         exit(EXIT_FAILURE);
     }
 
+    // one arena reused by every request, its first block is kept across resets
+    Arena requestArena = arena(0);
+
     while (serverState == STATE_RUNNING) {
+        if (app->dbAsync) resumeQueries(app, &requestArena);
+
         struct sockaddr_in clientAddr;
         socklen_t clientLen = sizeof(clientAddr);
 
         int clientSocket = accept(app->server.fileDescriptor, (struct sockaddr *)&clientAddr, &clientLen);
         if (clientSocket < 0) {
             if (errno == EAGAIN || errno == EWOULDBLOCK) {
-                usleep(10000);
+                // wakes up now and then to notice a restart or shutdown
+                waitForWork(app, 10);
                 continue;
             } else {
                 perror("accept failed");
@@ -174,16 +371,33 @@ void runServer(App *app) {
             }
         }
 
-        // TODO: implement dynamic buffer resizing and reading request in chunks
-        char buffer[BUFFER_SIZE] = {0};
-        ssize_t bytesRead = read(clientSocket, buffer, sizeof(buffer) - 1);
-        if (bytesRead < 0) {
+        size_t requestLength;
+        char *buffer = readRequest(clientSocket, &requestLength);
+        if (!buffer) {
             perror("read failed");
             close(clientSocket);
             continue;
         }
 
-        HttpParser parser = parseRequest(buffer);
+        HttpParser parser = parseRequestBuffer(buffer, requestLength);
+        free(buffer);
+
+        if (parser.isValid) {
+            HttpStatusCode decodeStatus = decodeRequestBody(&parser.request);
+
+            if (decodeStatus != HTTP_OK) {
+                writeResponse(clientSocket, (HttpResponse) {
+                    .content = (char *)httpStatusCodeToStr(decodeStatus),
+                    .status = decodeStatus,
+                    .contentType = TEXT_PLAIN,
+                });
+
+                freeParser(&parser);
+                close(clientSocket);
+                continue;
+            }
+        }
+
         HttpRequest request = parser.request;
 
         char *pathOnly = strdup(request.resource);
@@ -210,10 +424,15 @@ void runServer(App *app) {
 
         free(pathOnly);
 
+        ResponseStream stream = responseStream(clientSocket);
+
         RequestContext context = requestContext(app, request);
+        context.stream = &stream;
+        context.arena = &requestArena;
 
         context.hasBody = parser.isValid && request.bodyLength > 0;
-        context.body = context.hasBody ? jsonParse(request.body) : NULL;
+        // parsed by the first handler that reads it
+        context.body = context.hasBody && hasJsonBody(&request) ? jsonParseLazy(request.body, request.bodyLength) : NULL;
 
         HttpResponse response;
         if (route) {
@@ -231,40 +450,17 @@ void runServer(App *app) {
 
         freeJsonBuilder(context.body);
 
-        if (!response.content) {
-            response.content = strdup("");
-            if (!response.content) {
-                fprintf(stderr, "Fatal: out of memory\n");
-                exit(EXIT_FAILURE);
-            }
-        }
-
-        int contentLength = strlen(response.content);
-
-        const char *statusText = httpStatusCodeToStr(response.status);
-
-        char header[512];
-        snprintf(header, sizeof(header),
-                "HTTP/1.1 %d %s\r\n"
-                "Content-Type: %s\r\n"
-                "Content-Length: %d\r\n"
-                "Connection: close\r\n"
-                "\r\n",
-                response.status, statusText, response.contentType, contentLength
-        );
-
-        if (write(clientSocket, header, strlen(header)) == -1) {
-            perror("write header failed");
-            exit(EXIT_FAILURE);
-        }
-        if (write(clientSocket, response.content, contentLength) == -1) {
-            perror("write content failed");
-            exit(EXIT_FAILURE);
+        // a deferred response is sent by resumeQueries, which closes the connection
+        if (!response.deferred) {
+            sendResponse(clientSocket, response, &stream);
+            close(clientSocket);
         }
 
-        close(clientSocket);
+        arenaReset(&requestArena);
     }
 
+    freeArena(&requestArena);
+
     freeServer(&app->server);
     pthread_join(thread_id, NULL);
 
@@ -280,7 +476,7 @@ void runServer(App *app) {
         perror("failed to hot restart! ensure the project has './build/a' in the root dir");
         exit(1);
 
-    } else if (serverState == STATE_SHUTDOWN) {
-        exit(0);
     }
+
+    // STATE_SHUTDOWN returns to runApp, which cleans up the app
 }
\ No newline at end of file
@@ -1,40 +1,377 @@
+#define SQL_NO_CALL_SITES
+
 #include <sqlite3.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdarg.h>
 #include <string.h>
+#include <limits.h>
+#include <math.h>
+#include <pthread.h>
 
 #include "../include/sql.h"
+#include "../include/sql_cache.h"
+#include "../include/sql_stats.h"
+#include "../include/sql_plan.h"
+#include "../include/json_number.h"
+#include "../include/utils.h"
 
-DbContext *createSqlLite3DbContext(char *dbPath) {
-    DbContext *context = malloc(sizeof(DbContext));
-    if (!context) {
-        fprintf(stderr, "Fatal: out of memory\n");
-        exit(EXIT_FAILURE);
-    }
+struct DbPool {
+    char            *path;
+    DbPragmas        pragmas;
+    int              size;
+
+    // every connection the pool has opened, and those handed back by threads that exited
+    DbContext      **connections;
+    int              count;
+    DbContext      **idle;
+    int              idleCount;
+
+    // the connection of each thread
+    pthread_key_t    key;
+    pthread_mutex_t  lock;
+
+    // attached to every connection, see dbPoolUseQueryCache
+    DbQueryCache    *queryCache;
 
+    // attached to every connection, see dbPoolUseStats
+    DbStats         *stats;
+
+    // attached to every connection, see dbPoolUsePlanChecker
+    DbPlanChecker   *planChecker;
+};
+
+_Thread_local DbCallSite dbCallSite;
+
+static DbContext *openSqlite(const char *dbPath, int flags) {
+    DbContext *context = allocate(sizeof(DbContext));
     context->type = SQLITE;
 
     sqlite3 *db;
-    int rc = sqlite3_open(dbPath, &db);
+    int rc = sqlite3_open_v2(dbPath, &db, flags, NULL);
     if (rc != SQLITE_OK) {
         printf("Cannot open database: %s\n", sqlite3_errmsg(db));
+        sqlite3_close(db);
+        free(context);
         return NULL;
     }
 
     context->connection = db;
+    context->statements = (DbStatementCache) {
+        .entries = NULL,
+        .count = 0,
+        .capacity = DB_STATEMENT_CACHE_SIZE,
+        .allocated = 0,
+        .clock = 0,
+        .hits = 0,
+        .misses = 0,
+    };
+    context->pool = NULL;
+    context->queryCache = NULL;
+    context->stats = NULL;
+    context->planChecker = NULL;
 
     return context;
 }
 
-bool dbExec(DbContext *db, const char *query, const DbParam *params, int paramCount) {
-    sqlite3_stmt *stmt;
+DbContext *createSqlLite3DbContext(char *dbPath) {
+    return openSqlite(dbPath, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE);
+}
 
-    if (sqlite3_prepare_v2((sqlite3 *)db->connection, query, -1, &stmt, NULL) != SQLITE_OK) {
-        fprintf(stderr, "Failed to prepare statement: %s\n", sqlite3_errmsg((sqlite3 *)db->connection));
+DbPragmas dbDefaultPragmas() {
+    return (DbPragmas) {
+        .journalMode = "WAL",
+        .synchronous = "NORMAL",
+        .mmapSize = 256LL * 1024 * 1024,
+        .cacheSize = -16 * 1024,
+        .busyTimeout = 5000,
+    };
+}
+
+static bool execPragma(sqlite3 *db, const char *pragma) {
+    char *error = NULL;
+
+    if (sqlite3_exec(db, pragma, NULL, NULL, &error) != SQLITE_OK) {
+        fprintf(stderr, "Failed to apply '%s': %s\n", pragma, error ? error : sqlite3_errmsg(db));
+        sqlite3_free(error);
         return false;
     }
-    
+
+    return true;
+}
+
+bool dbApplyPragmas(DbContext *db, DbPragmas pragmas) {
+    sqlite3 *connection = (sqlite3 *)db->connection;
+    char pragma[128];
+    bool applied = true;
+
+    if (pragmas.busyTimeout > 0) {
+        applied &= sqlite3_busy_timeout(connection, pragmas.busyTimeout) == SQLITE_OK;
+    }
+    if (pragmas.journalMode) {
+        snprintf(pragma, sizeof(pragma), "pragma journal_mode = %s;", pragmas.journalMode);
+        applied &= execPragma(connection, pragma);
+    }
+    if (pragmas.synchronous) {
+        snprintf(pragma, sizeof(pragma), "pragma synchronous = %s;", pragmas.synchronous);
+        applied &= execPragma(connection, pragma);
+    }
+    if (pragmas.mmapSize > 0) {
+        snprintf(pragma, sizeof(pragma), "pragma mmap_size = %lld;", pragmas.mmapSize);
+        applied &= execPragma(connection, pragma);
+    }
+    if (pragmas.cacheSize != 0) {
+        snprintf(pragma, sizeof(pragma), "pragma cache_size = %d;", pragmas.cacheSize);
+        applied &= execPragma(connection, pragma);
+    }
+
+    return applied;
+}
+
+// runs when a thread holding a connection exits
+static void returnConnection(void *connection) {
+    DbContext *db = connection;
+    DbPool *pool = db->pool;
+
+    pthread_mutex_lock(&pool->lock);
+    pool->idle[pool->idleCount++] = db;
+    pthread_mutex_unlock(&pool->lock);
+}
+
+DbPool *createDbPool(const char *dbPath, int size, DbPragmas pragmas) {
+    if (size < 1) size = 1;
+
+    DbPool *pool = allocate(sizeof(DbPool));
+
+    *pool = (DbPool) {
+        .path = copyString(dbPath),
+        .pragmas = pragmas,
+        .size = size,
+        .connections = allocate(sizeof(DbContext *) * size),
+        .count = 0,
+        .idle = allocate(sizeof(DbContext *) * size),
+        .idleCount = 0,
+        .queryCache = NULL,
+        .stats = NULL,
+        .planChecker = NULL,
+    };
+
+    pthread_key_create(&pool->key, returnConnection);
+    pthread_mutex_init(&pool->lock, NULL);
+
+    // open the first connection now so a bad path is reported at startup
+    if (!dbPoolConnection(pool)) {
+        freeDbPool(pool);
+        return NULL;
+    }
+
+    return pool;
+}
+
+DbContext *dbPoolConnection(DbPool *pool) {
+    if (!pool) return NULL;
+
+    DbContext *db = pthread_getspecific(pool->key);
+    if (db) return db;
+
+    pthread_mutex_lock(&pool->lock);
+
+    if (pool->idleCount > 0) {
+        db = pool->idle[--pool->idleCount];
+    } else if (pool->count < pool->size) {
+        // every connection belongs to one thread at a time, so SQLite's own locking is not needed
+        db = openSqlite(pool->path, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE | SQLITE_OPEN_NOMUTEX);
+
+        if (db) {
+            db->pool = pool;
+            dbApplyPragmas(db, pool->pragmas);
+            if (pool->queryCache) dbAttachQueryCache(db, pool->queryCache);
+            if (pool->stats) dbAttachStats(db, pool->stats);
+            db->planChecker = pool->planChecker;
+            pool->connections[pool->count++] = db;
+        }
+    } else {
+        fprintf(stderr, "Database pool for '%s' is exhausted, all %d connections are held by other threads\n", pool->path, pool->size);
+    }
+
+    pthread_mutex_unlock(&pool->lock);
+
+    if (db) pthread_setspecific(pool->key, db);
+    return db;
+}
+
+void dbPoolUseQueryCache(DbPool *pool, DbQueryCache *cache) {
+    pthread_mutex_lock(&pool->lock);
+
+    pool->queryCache = cache;
+    for (int i = 0; i < pool->count; i++) {
+        dbAttachQueryCache(pool->connections[i], cache);
+    }
+
+    pthread_mutex_unlock(&pool->lock);
+}
+
+void dbPoolUseStats(DbPool *pool, DbStats *stats) {
+    pthread_mutex_lock(&pool->lock);
+
+    pool->stats = stats;
+    for (int i = 0; i < pool->count; i++) {
+        dbAttachStats(pool->connections[i], stats);
+    }
+
+    pthread_mutex_unlock(&pool->lock);
+}
+
+void dbPoolUsePlanChecker(DbPool *pool, DbPlanChecker *checker) {
+    pthread_mutex_lock(&pool->lock);
+
+    pool->planChecker = checker;
+    for (int i = 0; i < pool->count; i++) {
+        dbAttachPlanChecker(pool->connections[i], checker);
+    }
+
+    pthread_mutex_unlock(&pool->lock);
+}
+
+void freeDbPool(DbPool *pool) {
+    if (!pool) return;
+
+    pthread_key_delete(pool->key);
+    pthread_mutex_destroy(&pool->lock);
+
+    for (int i = 0; i < pool->count; i++) {
+        dbClose(pool->connections[i]);
+    }
+
+    free(pool->connections);
+    free(pool->idle);
+    free(pool->path);
+    free(pool);
+}
+
+static void evict(DbStatementCache *cache, int index) {
+    DbCachedStatement *entry = &cache->entries[index];
+
+    sqlite3_finalize((sqlite3_stmt *)entry->statement);
+    free(entry->sql);
+
+    cache->entries[index] = cache->entries[--cache->count];
+}
+
+void dbSetStatementCacheSize(DbContext *db, int size) {
+    DbStatementCache *cache = &db->statements;
+    if (size < 0) size = 0;
+
+    // drop the least recently used statements that are not running
+    while (cache->count > size) {
+        int oldest = -1;
+
+        for (int i = 0; i < cache->count; i++) {
+            if (cache->entries[i].inUse) continue;
+            if (oldest < 0 || cache->entries[i].lastUsed < cache->entries[oldest].lastUsed) oldest = i;
+        }
+
+        if (oldest < 0) break;
+        evict(cache, oldest);
+    }
+
+    if (cache->entries && size > cache->allocated) {
+        cache->entries = reallocate(cache->entries, sizeof(DbCachedStatement) * size);
+        cache->allocated = size;
+    }
+
+    cache->capacity = size;
+}
+
+// returns a statement for query ready to bind, from the cache when possible.
+// it has to be handed back with releaseStatement
+static sqlite3_stmt *prepareStatement(DbContext *db, const char *query) {
+    DbStatementCache *cache = &db->statements;
+    sqlite3 *connection = (sqlite3 *)db->connection;
+
+    unsigned int hash = hashString(query);
+    bool busy = false;
+
+    for (int i = 0; i < cache->count; i++) {
+        DbCachedStatement *entry = &cache->entries[i];
+        if (entry->hash != hash) continue;
+        if (entry->query != query && strcmp(entry->sql, query) != 0) continue;
+
+        if (entry->inUse) {
+            busy = true;
+            break;
+        }
+
+        cache->hits++;
+        entry->query = query;
+        entry->lastUsed = ++cache->clock;
+        entry->inUse = true;
+
+        return (sqlite3_stmt *)entry->statement;
+    }
+
+    cache->misses++;
+
+    sqlite3_stmt *stmt;
+    if (sqlite3_prepare_v2(connection, query, -1, &stmt, NULL) != SQLITE_OK) return NULL;
+
+    // a statement is only prepared again once it has left the cache, so this is rarely a repeat
+    if (db->planChecker) dbCheckPlan(db, query);
+
+    // a statement that is already running is used once and finalized
+    if (busy || cache->capacity == 0) return stmt;
+
+    if (cache->count >= cache->capacity) {
+        int oldest = -1;
+
+        for (int i = 0; i < cache->count; i++) {
+            if (cache->entries[i].inUse) continue;
+            if (oldest < 0 || cache->entries[i].lastUsed < cache->entries[oldest].lastUsed) oldest = i;
+        }
+
+        if (oldest < 0) return stmt;
+        evict(cache, oldest);
+    }
+
+    if (!cache->entries) {
+        cache->entries = allocate(sizeof(DbCachedStatement) * cache->capacity);
+        cache->allocated = cache->capacity;
+    }
+
+    DbCachedStatement *entry = &cache->entries[cache->count++];
+    *entry = (DbCachedStatement) {
+        .query = query,
+        .sql = copyString(query),
+        .hash = hash,
+        .statement = stmt,
+        .lastUsed = ++cache->clock,
+        .inUse = true,
+    };
+
+    return stmt;
+}
+
+// entries move around as the cache changes, so the statement is looked up again rather than kept
+static void releaseStatement(DbContext *db, sqlite3_stmt *stmt) {
+    DbStatementCache *cache = &db->statements;
+    bool cached = false;
+
+    for (int i = 0; i < cache->count && !cached; i++) {
+        if (cache->entries[i].statement != stmt) continue;
+
+        sqlite3_reset(stmt);
+        sqlite3_clear_bindings(stmt);
+        cache->entries[i].inUse = false;
+        cached = true;
+    }
+
+    if (!cached) sqlite3_finalize(stmt);
+
+    // writes are visible to other connections once the transaction holding them has ended
+    if (db->queryCache) dbQueryCacheCommitted(db);
+}
+
+static void bindParams(sqlite3_stmt *stmt, const DbParam *params, int paramCount) {
     for (int i = 0; i < paramCount; i++) {
         switch (params[i].type) {
             case DB_PARAM_NULL:
@@ -57,115 +394,572 @@ bool dbExec(DbContext *db, const char *query, const DbParam *params, int paramCo
                 break;
         }
     }
-    
+}
+
+bool dbExec(DbContext *db, const char *query, const DbParam *params, int paramCount) {
+    sqlite3_stmt *stmt = prepareStatement(db, query);
+
+    if (!stmt) {
+        fprintf(stderr, "Failed to prepare statement: %s\n", sqlite3_errmsg((sqlite3 *)db->connection));
+        return false;
+    }
+
+    bindParams(stmt, params, paramCount);
+
     int rc = sqlite3_step(stmt);
-    sqlite3_finalize(stmt);
-    
+
     if (rc != SQLITE_DONE && rc != SQLITE_ROW) {
         fprintf(stderr, "SQL error: %s\n", sqlite3_errmsg((sqlite3 *)db->connection));
+        releaseStatement(db, stmt);
         return false;
     }
-    
+
+    releaseStatement(db, stmt);
     return true;
 }
 
-DbResult *dbQueryRows(DbContext *db, const char *query, DbParam *params, int paramCount) {
-    sqlite3_stmt *stmt;
+bool dbExecMany(DbContext *db, const char *query, const DbParam *params, int paramsPerRow, int rowCount) {
+    sqlite3 *connection = (sqlite3 *)db->connection;
 
-    if (sqlite3_prepare_v2((sqlite3 *)db->connection, query, -1, &stmt, NULL) != SQLITE_OK) {
-        fprintf(stderr, "Failed to prepare query: %s\n", sqlite3_errmsg((sqlite3 *)db->connection));
-        return NULL;
+    // a savepoint starts a transaction of its own, or nests inside one that is already open
+    if (!dbExec(db, "savepoint dbExecMany;", NULL, 0)) return false;
+
+    sqlite3_stmt *stmt = prepareStatement(db, query);
+    bool ok = stmt != NULL;
+
+    if (!stmt) {
+        fprintf(stderr, "Failed to prepare statement: %s\n", sqlite3_errmsg(connection));
     }
 
-    for (int i = 0; i < paramCount; i++) {
-        switch (params[i].type) {
-            case DB_PARAM_NULL:
-                sqlite3_bind_null(stmt, i + 1);
-                break;
-            case DB_PARAM_INT:
-                sqlite3_bind_int(stmt, i + 1, params[i].value.i);
-                break;
-            case DB_PARAM_INT64:
-                sqlite3_bind_int64(stmt, i + 1, params[i].value.i64);
-                break;
-            case DB_PARAM_DOUBLE:
-                sqlite3_bind_double(stmt, i + 1, params[i].value.d);
-                break;
-            case DB_PARAM_TEXT:
-                sqlite3_bind_text(stmt, i + 1, params[i].value.s, -1, SQLITE_TRANSIENT);
-                break;
-            case DB_PARAM_BOOL:
-                sqlite3_bind_int(stmt, i + 1, params[i].value.b ? 1 : 0);
-                break;
+    for (int row = 0; ok && row < rowCount; row++) {
+        bindParams(stmt, params + (size_t)row * paramsPerRow, paramsPerRow);
+
+        int rc = sqlite3_step(stmt);
+        if (rc != SQLITE_DONE && rc != SQLITE_ROW) {
+            fprintf(stderr, "SQL error in row %d: %s\n", row, sqlite3_errmsg(connection));
+            ok = false;
         }
+
+        sqlite3_reset(stmt);
     }
 
-    int colCount = sqlite3_column_count(stmt);
-    int capacity = 10;
-    int rowCount = 0;
-    DbRow *rows = malloc(sizeof(DbRow) * capacity);
+    if (stmt) releaseStatement(db, stmt);
+
+    if (!ok) dbExec(db, "rollback to dbExecMany;", NULL, 0);
+    return dbExec(db, "release dbExecMany;", NULL, 0) && ok;
+}
+
+// a value read while the rows are stepped, before the result is laid out. text and blobs are
+// copied to a scratch buffer and their span is relative to it
+typedef struct {
+    int type;
+
+    union {
+        long long integer;
+        double    number;
+        DbSpan    span;
+    } value;
+} StepCell;
+
+// per column arrays, on the stack for typical column counts
+#define INLINE_COLUMNS 16
+
+// query results small enough for these are read without allocating anything but the result
+#define ROWS_INLINE_CELLS 64
+#define ROWS_INLINE_TEXT  1024
+
+// grows a scratch buffer that starts out in inline storage to hold at least needed bytes
+static void *growScratch(void *data, void *inlineData, size_t *capacity, size_t needed) {
+    if (needed <= *capacity) return data;
+
+    size_t grown = *capacity * 2;
+    while (grown < needed) grown *= 2;
+
+    void *moved = reallocate(data == inlineData ? NULL : data, grown);
+
+    if (data == inlineData) memcpy(moved, data, *capacity);
+    *capacity = grown;
+
+    return moved;
+}
+
+typedef struct {
+    char   *data;
+    char   *inlineData;
+    size_t  length;
+    size_t  capacity;
+} TextScratch;
+
+// copies bytes and a '\0' to the scratch. false when the result would be too large to address
+static bool appendText(TextScratch *text, const void *bytes, size_t length, DbSpan *span) {
+    if (text->length + length + 1 > UINT_MAX) return false;
+
+    text->data = growScratch(text->data, text->inlineData, &text->capacity, text->length + length + 1);
+
+    if (length) memcpy(text->data + text->length, bytes, length);
+    text->data[text->length + length] = '\0';
+
+    *span = (DbSpan) { (unsigned int)text->length, (unsigned int)length };
+    text->length += length + 1;
 
-    if (!rows) {
-        fprintf(stderr, "Fatal: out of memory\n");
-        exit(EXIT_FAILURE);
+    return true;
+}
+
+// numbers in a text column are stored as the text SQLite would give for them
+static bool numberToText(TextScratch *text, StepCell *cell) {
+    char buffer[JSON_DOUBLE_MAX_LENGTH + 1];
+    int length;
+
+    if (cell->type == SQLITE_INTEGER) {
+        length = snprintf(buffer, sizeof(buffer), "%lld", cell->value.integer);
+    } else if (isinf(cell->value.number)) {
+        length = snprintf(buffer, sizeof(buffer), "%s", cell->value.number < 0 ? "-Inf" : "Inf");
+    } else {
+        length = jsonFormatDouble(cell->value.number, buffer);
     }
 
-    while (sqlite3_step(stmt) == SQLITE_ROW) {
-        if (rowCount >= capacity) {
-            capacity *= 2;
-            rows = realloc(rows, sizeof(DbRow) * capacity);
+    cell->type = SQLITE_TEXT;
+    return appendText(text, buffer, length, &cell->value.span);
+}
 
-            if (!rows) {
-                fprintf(stderr, "Fatal: out of memory\n");
-                exit(EXIT_FAILURE);
-            }
+static DbColumnType columnType(int seen) {
+    if (seen == 0) return DB_COLUMN_NULL;
+    if (seen == 1 << SQLITE_INTEGER) return DB_COLUMN_INTEGER;
+    if ((seen & ~(1 << SQLITE_INTEGER | 1 << SQLITE_FLOAT)) == 0) return DB_COLUMN_FLOAT;
+    if (seen & 1 << SQLITE_BLOB) return DB_COLUMN_BLOB;
+
+    return DB_COLUMN_TEXT;
+}
+
+// lays the stepped cells out column by column in a single allocation
+static DbResult *buildResult(sqlite3_stmt *stmt, StepCell *cells, int rowCount, int colCount, int *seen, TextScratch *text) {
+    size_t words = ((size_t)rowCount + 63) / 64;
+    size_t size = sizeof(DbResult) + sizeof(DbColumn) * colCount;
+    size_t namesLength = 0;
+
+    for (int c = 0; c < colCount; c++) {
+        const char *declType = sqlite3_column_decltype(stmt, c);
+
+        namesLength += strlen(sqlite3_column_name(stmt, c)) + 1;
+        if (declType) namesLength += strlen(declType) + 1;
+
+        DbColumnType type = columnType(seen[c]);
+        size += sizeof(unsigned long long) * words;
+        if (type != DB_COLUMN_NULL) size += sizeof(long long) * rowCount;
+
+        if (type != DB_COLUMN_TEXT && type != DB_COLUMN_BLOB) continue;
+
+        for (int r = 0; r < rowCount; r++) {
+            StepCell *cell = &cells[(size_t)r * colCount + c];
+            if (cell->type != SQLITE_INTEGER && cell->type != SQLITE_FLOAT) continue;
+
+            if (!numberToText(text, cell)) return NULL;
         }
+    }
+
+    if (namesLength + text->length > UINT_MAX) return NULL;
+    size += namesLength + text->length;
+
+    // not zeroed, every byte is written below
+    DbResult *result = reallocate(NULL, size);
+
+    result->rowCount = rowCount;
+    result->colCount = colCount;
+    result->size = size;
+    result->columns = (DbColumn *)(result + 1);
+
+    char *next = (char *)(result->columns + colCount);
+    result->heap = (char *)result + size - namesLength - text->length;
 
-        DbRow *row = &rows[rowCount];
-        row->colCount = colCount;
-        row->colNames = malloc(sizeof(char*) * colCount);
-        row->colValues = malloc(sizeof(char*) * colCount);
+    char *names = result->heap;
 
-        if (!row->colNames || !row->colValues) {
-            fprintf(stderr, "Fatal: out of memory\n");
-            exit(EXIT_FAILURE);
+    for (int c = 0; c < colCount; c++) {
+        DbColumn *column = &result->columns[c];
+        const char *declType = sqlite3_column_decltype(stmt, c);
+
+        column->name = strcpy(names, sqlite3_column_name(stmt, c));
+        names += strlen(names) + 1;
+
+        column->declType = declType ? strcpy(names, declType) : NULL;
+        if (declType) names += strlen(names) + 1;
+
+        column->type = columnType(seen[c]);
+        column->nulls = (unsigned long long *)next;
+        memset(column->nulls, 0, sizeof(unsigned long long) * words);
+        next += sizeof(unsigned long long) * words;
+
+        column->values.integers = NULL;
+        if (column->type != DB_COLUMN_NULL) {
+            column->values.integers = (long long *)next;
+            next += sizeof(long long) * rowCount;
         }
 
-        for (int i = 0; i < colCount; i++) {
-            const char *name = sqlite3_column_name(stmt, i);
-            const unsigned char *val = sqlite3_column_text(stmt, i);
+        for (int r = 0; r < rowCount; r++) {
+            StepCell *cell = &cells[(size_t)r * colCount + c];
+
+            if (cell->type == SQLITE_NULL) {
+                column->nulls[r / 64] |= 1ULL << (r % 64);
+                if (column->values.integers) column->values.integers[r] = 0;
+                continue;
+            }
+
+            switch (column->type) {
+                case DB_COLUMN_INTEGER:
+                    column->values.integers[r] = cell->value.integer;
+                    break;
+                case DB_COLUMN_FLOAT:
+                    column->values.floats[r] = cell->type == SQLITE_INTEGER ? (double)cell->value.integer : cell->value.number;
+                    break;
+                default:
+                    column->values.spans[r] = (DbSpan) { cell->value.span.offset + (unsigned int)namesLength, cell->value.span.length };
+                    break;
+            }
+        }
+    }
+
+    if (text->length) memcpy(names, text->data, text->length);
+
+    return result;
+}
+
+// steps stmt, appending its rows to the cells. false when a step fails or the result is too large
+static bool stepRows(DbContext *db, const char *query, sqlite3_stmt *stmt, StepCell **cells, StepCell *inlineCells, size_t *cellCapacity, int *rowCount, int colCount, int *seen, TextScratch *text) {
+    int rc;
+    bool fits = true;
 
-            row->colNames[i] = strdup(name);
-            row->colValues[i] = val ? strdup((const char *)val) : strdup("NULL");
+    while (fits && (rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+        *cells = growScratch(*cells, inlineCells, cellCapacity, sizeof(StepCell) * ((size_t)*rowCount + 1) * colCount);
+        StepCell *row = &(*cells)[(size_t)*rowCount * colCount];
 
-            if (!row->colNames[i] || !row->colValues[i]) {
-                fprintf(stderr, "Fatal: out of memory\n");
-                exit(EXIT_FAILURE);
+        for (int c = 0; c < colCount && fits; c++) {
+            StepCell *cell = &row[c];
+            cell->type = sqlite3_column_type(stmt, c);
+
+            switch (cell->type) {
+                case SQLITE_INTEGER:
+                    cell->value.integer = sqlite3_column_int64(stmt, c);
+                    break;
+                case SQLITE_FLOAT:
+                    cell->value.number = sqlite3_column_double(stmt, c);
+                    break;
+                case SQLITE_TEXT:
+                    fits = appendText(text, sqlite3_column_text(stmt, c), sqlite3_column_bytes(stmt, c), &cell->value.span);
+                    break;
+                case SQLITE_BLOB:
+                    fits = appendText(text, sqlite3_column_blob(stmt, c), sqlite3_column_bytes(stmt, c), &cell->value.span);
+                    break;
+                default:
+                    continue;
             }
+
+            seen[c] |= 1 << cell->type;
         }
 
-        rowCount++;
+        (*rowCount)++;
+    }
+
+    if (!fits) {
+        fprintf(stderr, "SQL error: result of '%s' is too large\n", query);
+        return false;
     }
+    if (rc != SQLITE_DONE) {
+        fprintf(stderr, "SQL error: %s\n", sqlite3_errmsg((sqlite3 *)db->connection));
+        return false;
+    }
+
+    return true;
+}
 
-    sqlite3_finalize(stmt);
+// runs query on each of dbs in turn and lays all of their rows out in one result. the first
+// statement is kept until the end for the column names
+static DbResult *queryRows(DbContext **dbs, int dbCount, const char *query, DbParam *params, int paramCount) {
+    sqlite3_stmt *first = prepareStatement(dbs[0], query);
 
-    DbResult *result = malloc(sizeof(DbResult));
-    
-    if (!result) {
-        fprintf(stderr, "Fatal: out of memory\n");
-        exit(EXIT_FAILURE);
+    if (!first) {
+        fprintf(stderr, "Failed to prepare query: %s\n", sqlite3_errmsg((sqlite3 *)dbs[0]->connection));
+        return NULL;
     }
 
-    result->rowCount = rowCount;
-    result->rows = rows;
+    int colCount = sqlite3_column_count(first);
+    int rowCount = 0;
+
+    StepCell inlineCells[ROWS_INLINE_CELLS];
+    StepCell *cells = inlineCells;
+    size_t cellCapacity = sizeof(inlineCells);
+
+    char inlineText[ROWS_INLINE_TEXT];
+    TextScratch text = { inlineText, inlineText, 0, sizeof(inlineText) };
+
+    // the sqlite types seen in each column, as bits
+    int inlineSeen[INLINE_COLUMNS] = { 0 };
+    int *seen = colCount <= INLINE_COLUMNS ? inlineSeen : allocate(sizeof(int) * colCount);
+
+    bindParams(first, params, paramCount);
+    bool ok = stepRows(dbs[0], query, first, &cells, inlineCells, &cellCapacity, &rowCount, colCount, seen, &text);
+
+    for (int d = 1; ok && d < dbCount; d++) {
+        sqlite3_stmt *stmt = prepareStatement(dbs[d], query);
+
+        if (!stmt) {
+            fprintf(stderr, "Failed to prepare query: %s\n", sqlite3_errmsg((sqlite3 *)dbs[d]->connection));
+            ok = false;
+            break;
+        }
+
+        if (sqlite3_column_count(stmt) != colCount) {
+            fprintf(stderr, "SQL error: '%s' returns different columns on each database\n", query);
+            ok = false;
+        } else {
+            bindParams(stmt, params, paramCount);
+            ok = stepRows(dbs[d], query, stmt, &cells, inlineCells, &cellCapacity, &rowCount, colCount, seen, &text);
+        }
+
+        releaseStatement(dbs[d], stmt);
+    }
+
+    DbResult *result = NULL;
+
+    if (ok) {
+        result = buildResult(first, cells, rowCount, colCount, seen, &text);
+        if (!result) fprintf(stderr, "SQL error: result of '%s' is too large\n", query);
+    }
+
+    releaseStatement(dbs[0], first);
+
+    if (cells != inlineCells) free(cells);
+    if (text.data != inlineText) free(text.data);
+    if (seen != inlineSeen) free(seen);
 
     return result;
 }
 
+DbResult *dbQueryRows(DbContext *db, const char *query, DbParam *params, int paramCount) {
+    return queryRows(&db, 1, query, params, paramCount);
+}
+
+DbResult *dbQueryRowsAcross(DbContext **dbs, int dbCount, const char *query, DbParam *params, int paramCount) {
+    if (dbCount <= 0) return NULL;
+
+    return queryRows(dbs, dbCount, query, params, paramCount);
+}
+
+void freeDbResult(DbResult *result) {
+    free(result);
+}
+
+// moves a pointer into result to the same place in copy
+#define REBASE(pointer) ((pointer) = (void *)((char *)copy + ((const char *)(pointer) - (const char *)result)))
+
+DbResult *dbCopyResult(const DbResult *result) {
+    if (!result) return NULL;
+
+    DbResult *copy = reallocate(NULL, result->size);
+
+    memcpy(copy, result, result->size);
+
+    REBASE(copy->columns);
+    REBASE(copy->heap);
+
+    for (int c = 0; c < copy->colCount; c++) {
+        DbColumn *column = &copy->columns[c];
+
+        REBASE(column->name);
+        REBASE(column->nulls);
+        if (column->declType) REBASE(column->declType);
+        if (column->values.integers) REBASE(column->values.integers);
+    }
+
+    return copy;
+}
+
+#undef REBASE
+
+int dbColumnIndex(const DbResult *result, const char *name) {
+    for (int c = 0; c < result->colCount; c++) {
+        if (strcmp(result->columns[c].name, name) == 0) return c;
+    }
+
+    return -1;
+}
+
+// the column holding a value, or NULL when the value is NULL or out of range
+static const DbColumn *valueColumn(const DbResult *result, int row, int column) {
+    if (!result || row < 0 || row >= result->rowCount || column < 0 || column >= result->colCount) return NULL;
+
+    const DbColumn *col = &result->columns[column];
+    if (col->nulls[row / 64] & 1ULL << (row % 64)) return NULL;
+
+    return col;
+}
+
+bool dbIsNull(const DbResult *result, int row, int column) {
+    return valueColumn(result, row, column) == NULL;
+}
+
+long long dbGetInt64(const DbResult *result, int row, int column) {
+    const DbColumn *col = valueColumn(result, row, column);
+    if (!col) return 0;
+
+    switch (col->type) {
+        case DB_COLUMN_INTEGER: return col->values.integers[row];
+        case DB_COLUMN_FLOAT:   return (long long)col->values.floats[row];
+        case DB_COLUMN_TEXT:    return strtoll(result->heap + col->values.spans[row].offset, NULL, 10);
+        default:                return 0;
+    }
+}
+
+int dbGetInt(const DbResult *result, int row, int column) {
+    return (int)dbGetInt64(result, row, column);
+}
+
+double dbGetDouble(const DbResult *result, int row, int column) {
+    const DbColumn *col = valueColumn(result, row, column);
+    if (!col) return 0;
+
+    switch (col->type) {
+        case DB_COLUMN_INTEGER: return (double)col->values.integers[row];
+        case DB_COLUMN_FLOAT:   return col->values.floats[row];
+        case DB_COLUMN_TEXT:    return strtod(result->heap + col->values.spans[row].offset, NULL);
+        default:                return 0;
+    }
+}
+
+bool dbGetBool(const DbResult *result, int row, int column) {
+    return dbGetDouble(result, row, column) != 0;
+}
+
+const char *dbGetText(const DbResult *result, int row, int column, int *length) {
+    const DbColumn *col = valueColumn(result, row, column);
+
+    if (!col || (col->type != DB_COLUMN_TEXT && col->type != DB_COLUMN_BLOB)) {
+        if (length) *length = 0;
+        return NULL;
+    }
+
+    DbSpan span = col->values.spans[row];
+    if (length) *length = (int)span.length;
+
+    return result->heap + span.offset;
+}
+
+DbCursor dbQueryCursor(DbContext *db, const char *query, const DbParam *params, int paramCount) {
+    DbCursor cursor = {
+        .db = db,
+        .statement = NULL,
+        .colCount = 0,
+        .failed = false,
+    };
+
+    sqlite3_stmt *stmt = prepareStatement(db, query);
+    if (!stmt) {
+        fprintf(stderr, "Failed to prepare query: %s\n", sqlite3_errmsg((sqlite3 *)db->connection));
+        cursor.failed = true;
+        return cursor;
+    }
+
+    bindParams(stmt, params, paramCount);
+
+    cursor.statement = stmt;
+    cursor.colCount = sqlite3_column_count(stmt);
+
+    return cursor;
+}
+
+bool dbNext(DbCursor *cursor) {
+    if (!cursor->statement) return false;
+
+    int rc = sqlite3_step((sqlite3_stmt *)cursor->statement);
+    if (rc == SQLITE_ROW) return true;
+
+    if (rc != SQLITE_DONE) {
+        fprintf(stderr, "SQL error: %s\n", sqlite3_errmsg((sqlite3 *)cursor->db->connection));
+        cursor->failed = true;
+    }
+
+    dbCloseCursor(cursor);
+    return false;
+}
+
+void dbCloseCursor(DbCursor *cursor) {
+    if (!cursor->statement) return;
+
+    releaseStatement(cursor->db, (sqlite3_stmt *)cursor->statement);
+    cursor->statement = NULL;
+}
+
+const char *dbColumnName(DbCursor *cursor, int column) {
+    return sqlite3_column_name((sqlite3_stmt *)cursor->statement, column);
+}
+
+bool dbColumnIsNull(DbCursor *cursor, int column) {
+    return sqlite3_column_type((sqlite3_stmt *)cursor->statement, column) == SQLITE_NULL;
+}
+
+long long dbColumnInt64(DbCursor *cursor, int column) {
+    return sqlite3_column_int64((sqlite3_stmt *)cursor->statement, column);
+}
+
+double dbColumnDouble(DbCursor *cursor, int column) {
+    return sqlite3_column_double((sqlite3_stmt *)cursor->statement, column);
+}
+
+const char *dbColumnText(DbCursor *cursor, int column, int *length) {
+    sqlite3_stmt *stmt = (sqlite3_stmt *)cursor->statement;
+
+    const char *text = (const char *)sqlite3_column_text(stmt, column);
+    if (length) *length = sqlite3_column_bytes(stmt, column);
+
+    return text;
+}
+
+bool dbQueryEach(DbContext *db, const char *query, const DbParam *params, int paramCount, RowCallback callback, void *userData) {
+    DbCursor cursor = dbQueryCursor(db, query, params, paramCount);
+    if (cursor.failed) return false;
+
+    char *inlineColumns[INLINE_COLUMNS * 2];
+    char **names = inlineColumns;
+
+    if (cursor.colCount > INLINE_COLUMNS) {
+        names = allocate(sizeof(char *) * cursor.colCount * 2);
+    }
+
+    char **values = names + cursor.colCount;
+
+    for (int i = 0; i < cursor.colCount; i++) {
+        names[i] = (char *)dbColumnName(&cursor, i);
+    }
+
+    while (dbNext(&cursor)) {
+        for (int i = 0; i < cursor.colCount; i++) {
+            values[i] = (char *)dbColumnText(&cursor, i, NULL);
+        }
+
+        callback(cursor.colCount, names, values, userData);
+    }
+
+    if (names != inlineColumns) free(names);
+
+    return !cursor.failed;
+}
+
 bool dbClose(DbContext *db) {
+    if (!db) return true;
+
     if (db->type == SQLITE) {
+        DbStatementCache *cache = &db->statements;
+
+        dbDetachQueryCache(db);
+        dbDetachStats(db);
+
+        for (int i = 0; i < cache->count; i++) {
+            sqlite3_finalize((sqlite3_stmt *)cache->entries[i].statement);
+            free(cache->entries[i].sql);
+        }
+        free(cache->entries);
+
         sqlite3_close((sqlite3 *)db->connection);
     }
 
+    free(db);
     return true;
 }
\ No newline at end of file
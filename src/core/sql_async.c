@@ -0,0 +1,260 @@
+#define SQL_NO_CALL_SITES
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <pthread.h>
+
+#include "../include/sql_async.h"
+#include "../include/app.h"
+#include "../include/utils.h"
+
+struct DbAsyncPool {
+    DbPool          *pool;
+
+    pthread_t       *threads;
+    int              threadCount;
+
+    pthread_mutex_t  lock;
+    pthread_cond_t   queued;
+
+    // waiting for a thread, and finished and waiting for the server loop
+    DbAsyncQuery    *head;
+    DbAsyncQuery    *tail;
+    DbAsyncQuery    *doneHead;
+    DbAsyncQuery    *doneTail;
+    bool             stopping;
+
+    // a byte is written to wake[1] for every finished query
+    int              wake[2];
+};
+
+static void *runQueries(void *arg) {
+    DbAsyncPool *async = arg;
+
+    // the thread keeps this connection until it exits
+    DbContext *db = dbPoolConnection(async->pool);
+
+    pthread_mutex_lock(&async->lock);
+
+    while (true) {
+        while (!async->head && !async->stopping) {
+            pthread_cond_wait(&async->queued, &async->lock);
+        }
+
+        // stopping, and everything queued has run
+        if (!async->head) break;
+
+        DbAsyncQuery *query = async->head;
+        async->head = query->next;
+        if (!async->head) async->tail = NULL;
+        query->next = NULL;
+
+        pthread_mutex_unlock(&async->lock);
+        dbCallSite = query->site;
+        query->result = db ? dbQueryRows(db, query->query, query->params, query->paramCount) : NULL;
+        pthread_mutex_lock(&async->lock);
+
+        if (async->doneTail) {
+            async->doneTail->next = query;
+        } else {
+            async->doneHead = query;
+        }
+        async->doneTail = query;
+
+        char byte = 0;
+        while (write(async->wake[1], &byte, 1) < 0 && errno == EINTR);
+    }
+
+    pthread_mutex_unlock(&async->lock);
+    return NULL;
+}
+
+DbAsyncPool *createDbAsyncPool(DbPool *pool, int threads) {
+    if (!pool) return NULL;
+    if (threads < 1) threads = 1;
+
+    DbAsyncPool *async = allocate(sizeof(DbAsyncPool));
+
+    *async = (DbAsyncPool) {
+        .pool = pool,
+        .threads = allocate(sizeof(pthread_t) * threads),
+        .threadCount = 0,
+        .stopping = false,
+    };
+
+    if (pipe(async->wake) != 0) {
+        perror("Failed to create the database thread pipe");
+        free(async->threads);
+        free(async);
+        return NULL;
+    }
+
+    // the server loop drains it without blocking, and a full pipe already means there is work
+    for (int i = 0; i < 2; i++) {
+        fcntl(async->wake[i], F_SETFL, fcntl(async->wake[i], F_GETFL, 0) | O_NONBLOCK);
+    }
+
+    pthread_mutex_init(&async->lock, NULL);
+    pthread_cond_init(&async->queued, NULL);
+
+    for (int i = 0; i < threads; i++) {
+        if (pthread_create(&async->threads[i], NULL, runQueries, async) != 0) break;
+        async->threadCount++;
+    }
+
+    if (async->threadCount == 0) {
+        fprintf(stderr, "Failed to start the database threads\n");
+        freeDbAsyncPool(async);
+        return NULL;
+    }
+
+    return async;
+}
+
+void freeDbAsyncQuery(DbAsyncQuery *query) {
+    if (!query) return;
+
+    freeDbResult(query->result);
+
+    for (int i = 0; i < query->paramCount; i++) {
+        if (query->params[i].type == DB_PARAM_TEXT) free((char *)query->params[i].value.s);
+    }
+    free(query->params);
+    free(query->query);
+
+    free(query->request.resource);
+    free(query->request.headers);
+    free(query->request.body);
+
+    free(query);
+}
+
+void freeDbAsyncPool(DbAsyncPool *async) {
+    if (!async) return;
+
+    pthread_mutex_lock(&async->lock);
+    async->stopping = true;
+    pthread_cond_broadcast(&async->queued);
+    pthread_mutex_unlock(&async->lock);
+
+    for (int i = 0; i < async->threadCount; i++) {
+        pthread_join(async->threads[i], NULL);
+    }
+
+    for (DbAsyncQuery *query = async->doneHead, *next; query; query = next) {
+        next = query->next;
+
+        close(query->socket);
+        freeDbAsyncQuery(query);
+    }
+
+    pthread_mutex_destroy(&async->lock);
+    pthread_cond_destroy(&async->queued);
+
+    close(async->wake[0]);
+    close(async->wake[1]);
+
+    free(async->threads);
+    free(async);
+}
+
+// the query outlives the handler, so it keeps its own copy of the request
+static HttpRequest copyRequest(const HttpRequest *request) {
+    HttpRequest copy = *request;
+
+    copy.resource = copyString(request->resource);
+
+    copy.headers = allocate(sizeof(Header) * (request->headerCount + 1));
+    if (request->headerCount > 0) memcpy(copy.headers, request->headers, sizeof(Header) * request->headerCount);
+    copy.headerCapacity = request->headerCount + 1;
+
+    copy.body = NULL;
+    if (request->body) {
+        copy.body = allocate(request->bodyLength + 1);
+        memcpy(copy.body, request->body, request->bodyLength);
+        copy.body[request->bodyLength] = '\0';
+    }
+
+    return copy;
+}
+
+HttpResponse dbQueryAsync(RequestContext ctx, const char *query, const DbParam *params, int paramCount, DbQueryDone onDone) {
+    DbAsyncPool *async = ctx.app ? ctx.app->dbAsync : NULL;
+
+    // no database threads, or no connection to resume: run it here
+    if (!async || !ctx.stream) {
+        DbResult *result = ctx.db ? dbQueryRows(ctx.db, query, (DbParam *)params, paramCount) : NULL;
+        HttpResponse response = onDone(ctx, result);
+
+        freeDbResult(result);
+        return response;
+    }
+
+    DbAsyncQuery *queued = allocate(sizeof(DbAsyncQuery));
+
+    *queued = (DbAsyncQuery) {
+        .socket = ctx.stream->socket,
+        .request = copyRequest(&ctx.request),
+        .jsonBody = ctx.body != NULL,
+        .onDone = onDone,
+        .result = NULL,
+        .site = dbCallSite,
+        .query = copyString(query),
+        .params = allocate(sizeof(DbParam) * (paramCount + 1)),
+        .paramCount = paramCount,
+        .next = NULL,
+    };
+
+    for (int i = 0; i < paramCount; i++) {
+        queued->params[i] = params[i];
+        if (params[i].type == DB_PARAM_TEXT && params[i].value.s) queued->params[i].value.s = copyString(params[i].value.s);
+    }
+
+    pthread_mutex_lock(&async->lock);
+
+    if (async->tail) {
+        async->tail->next = queued;
+    } else {
+        async->head = queued;
+    }
+    async->tail = queued;
+
+    pthread_cond_signal(&async->queued);
+    pthread_mutex_unlock(&async->lock);
+
+    return (HttpResponse) {
+        .content = "",
+        .status = HTTP_OK,
+        .contentType = NULL,
+        .deferred = true,
+    };
+}
+
+int dbAsyncFd(DbAsyncPool *async) {
+    return async ? async->wake[0] : -1;
+}
+
+DbAsyncQuery *dbAsyncCompleted(DbAsyncPool *async) {
+    if (!async) return NULL;
+
+    // drained first, so a query that finishes after this leaves its byte for the next wait
+    char bytes[64];
+    while (read(async->wake[0], bytes, sizeof(bytes)) > 0);
+
+    pthread_mutex_lock(&async->lock);
+
+    DbAsyncQuery *query = async->doneHead;
+    if (query) {
+        async->doneHead = query->next;
+        if (!async->doneHead) async->doneTail = NULL;
+        query->next = NULL;
+    }
+
+    pthread_mutex_unlock(&async->lock);
+
+    return query;
+}
@@ -0,0 +1,643 @@
+#define SQL_NO_CALL_SITES
+
+#include <sqlite3.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "../include/sql_cache.h"
+#include "../include/utils.h"
+
+// a table some cached query reads, its generation goes up every time it is written
+typedef struct {
+    char               *name;
+    unsigned long long  generation;
+} CacheTable;
+
+// a distinct SQL text and the tables it reads, found once when it is first cached
+typedef struct {
+    char         *sql;
+    unsigned int  hash;
+
+    // false for statements that write
+    bool          cacheable;
+
+    int          *tables;
+    int           tableCount;
+} CacheQuery;
+
+typedef struct CacheEntry {
+    unsigned int        hash;
+    char               *key;
+    size_t              keyLength;
+
+    DbResult           *result;
+    size_t              size;
+    long long           expires;
+
+    // the generation of each of the query's tables when the result was read
+    int                 query;
+    unsigned long long *generations;
+
+    struct CacheEntry  *next;
+
+    // least recently used order
+    struct CacheEntry  *newer;
+    struct CacheEntry  *older;
+} CacheEntry;
+
+struct DbQueryCache {
+    pthread_mutex_t    lock;
+
+    size_t             budget;
+    int                ttlMs;
+
+    CacheTable        *tables;
+    int                tableCount;
+    int                tableCapacity;
+
+    CacheQuery        *queries;
+    int                queryCount;
+    int                queryCapacity;
+
+    CacheEntry       **buckets;
+    int                bucketCount;
+
+    CacheEntry        *newest;
+    CacheEntry        *oldest;
+
+    DbQueryCacheStats  stats;
+};
+
+// what a connection has written in its current transaction
+struct DbQueryCacheLink {
+    DbQueryCache  *cache;
+
+    int           *pending;
+    const char   **pendingNames;
+    int            pendingCount;
+    int            pendingCapacity;
+};
+
+#define CACHE_INITIAL_BUCKETS 256
+
+// keys up to this long are built on the stack
+#define CACHE_INLINE_KEY 256
+
+static long long nowMs() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (long long)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+DbQueryCache *createDbQueryCache(size_t budget, int ttlMs) {
+    DbQueryCache *cache = allocate(sizeof(DbQueryCache));
+
+    *cache = (DbQueryCache) {
+        .budget = budget,
+        .ttlMs = ttlMs,
+        .buckets = calloc(CACHE_INITIAL_BUCKETS, sizeof(CacheEntry *)),
+        .bucketCount = CACHE_INITIAL_BUCKETS,
+    };
+
+    if (!cache->buckets) {
+        fprintf(stderr, "Fatal: out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+
+    pthread_mutex_init(&cache->lock, NULL);
+
+    return cache;
+}
+
+static void removeEntry(DbQueryCache *cache, CacheEntry *entry) {
+    CacheEntry **link = &cache->buckets[entry->hash & (cache->bucketCount - 1)];
+    while (*link != entry) link = &(*link)->next;
+    *link = entry->next;
+
+    if (entry->newer) entry->newer->older = entry->older; else cache->newest = entry->older;
+    if (entry->older) entry->older->newer = entry->newer; else cache->oldest = entry->newer;
+
+    cache->stats.bytes -= entry->size;
+    cache->stats.entries--;
+
+    free(entry->key);
+    free(entry->generations);
+    freeDbResult(entry->result);
+    free(entry);
+}
+
+void dbQueryCacheClear(DbQueryCache *cache) {
+    pthread_mutex_lock(&cache->lock);
+
+    while (cache->newest) {
+        removeEntry(cache, cache->newest);
+    }
+
+    pthread_mutex_unlock(&cache->lock);
+}
+
+void freeDbQueryCache(DbQueryCache *cache) {
+    if (!cache) return;
+
+    dbQueryCacheClear(cache);
+
+    for (int i = 0; i < cache->tableCount; i++) {
+        free(cache->tables[i].name);
+    }
+    for (int i = 0; i < cache->queryCount; i++) {
+        free(cache->queries[i].sql);
+        free(cache->queries[i].tables);
+    }
+
+    free(cache->tables);
+    free(cache->queries);
+    free(cache->buckets);
+
+    pthread_mutex_destroy(&cache->lock);
+    free(cache);
+}
+
+DbQueryCacheStats dbQueryCacheStats(DbQueryCache *cache) {
+    pthread_mutex_lock(&cache->lock);
+    DbQueryCacheStats stats = cache->stats;
+    pthread_mutex_unlock(&cache->lock);
+
+    return stats;
+}
+
+// with the lock held
+static int tableIndex(DbQueryCache *cache, const char *name) {
+    for (int i = 0; i < cache->tableCount; i++) {
+        if (strcmp(cache->tables[i].name, name) == 0) return i;
+    }
+
+    if (cache->tableCount == cache->tableCapacity) {
+        cache->tables = growArray(cache->tables, &cache->tableCapacity, sizeof(CacheTable));
+    }
+
+    char *copy = strdup(name);
+    if (!copy) {
+        fprintf(stderr, "Fatal: out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+
+    cache->tables[cache->tableCount] = (CacheTable) { copy, 0 };
+    return cache->tableCount++;
+}
+
+// runs for every row written on an attached connection
+static void onUpdate(void *arg, int operation, const char *database, const char *table, sqlite3_int64 rowid) {
+    (void)operation;
+    (void)database;
+    (void)rowid;
+
+    DbQueryCacheLink *link = arg;
+
+    // the first row of each table in a transaction is enough
+    for (int i = 0; i < link->pendingCount; i++) {
+        if (strcmp(link->pendingNames[i], table) == 0) return;
+    }
+
+    DbQueryCache *cache = link->cache;
+
+    pthread_mutex_lock(&cache->lock);
+    int index = tableIndex(cache, table);
+    cache->tables[index].generation++;
+
+    // table names are never freed while the cache is alive, so they can be read without the lock
+    const char *name = cache->tables[index].name;
+    pthread_mutex_unlock(&cache->lock);
+
+    if (link->pendingCount == link->pendingCapacity) {
+        int capacity = link->pendingCapacity;
+        link->pending = growArray(link->pending, &link->pendingCapacity, sizeof(int));
+        link->pendingNames = growArray(link->pendingNames, &capacity, sizeof(const char *));
+    }
+
+    link->pending[link->pendingCount] = index;
+    link->pendingNames[link->pendingCount++] = name;
+}
+
+void dbQueryCacheCommitted(DbContext *db) {
+    DbQueryCacheLink *link = db->queryCache;
+    if (!link || link->pendingCount == 0) return;
+
+    // still inside a transaction, other connections cannot see the writes yet
+    if (!sqlite3_get_autocommit((sqlite3 *)db->connection)) return;
+
+    DbQueryCache *cache = link->cache;
+
+    pthread_mutex_lock(&cache->lock);
+    for (int i = 0; i < link->pendingCount; i++) {
+        cache->tables[link->pending[i]].generation++;
+    }
+    pthread_mutex_unlock(&cache->lock);
+
+    link->pendingCount = 0;
+}
+
+// a DELETE without a WHERE clause truncates the table without calling the update hook, unless
+// the authorizer ignores it, which makes SQLite delete the rows one at a time
+static int deleteRowByRow(void *arg, int action, const char *table, const char *column, const char *database, const char *trigger) {
+    (void)arg;
+    (void)table;
+    (void)column;
+    (void)database;
+    (void)trigger;
+
+    return action == SQLITE_DELETE ? SQLITE_IGNORE : SQLITE_OK;
+}
+
+void dbQueryCacheAuthorize(DbContext *db) {
+    if (db->queryCache) {
+        sqlite3_set_authorizer((sqlite3 *)db->connection, deleteRowByRow, NULL);
+    } else {
+        sqlite3_set_authorizer((sqlite3 *)db->connection, NULL, NULL);
+    }
+}
+
+void dbAttachQueryCache(DbContext *db, DbQueryCache *cache) {
+    dbDetachQueryCache(db);
+    if (!cache) return;
+
+    DbQueryCacheLink *link = allocate(sizeof(DbQueryCacheLink));
+    *link = (DbQueryCacheLink) { .cache = cache };
+
+    db->queryCache = link;
+    sqlite3_update_hook((sqlite3 *)db->connection, onUpdate, link);
+    dbQueryCacheAuthorize(db);
+}
+
+void dbDetachQueryCache(DbContext *db) {
+    DbQueryCacheLink *link = db->queryCache;
+    if (!link) return;
+
+    sqlite3_update_hook((sqlite3 *)db->connection, NULL, NULL);
+
+    free(link->pending);
+    free(link->pendingNames);
+    free(link);
+
+    db->queryCache = NULL;
+    dbQueryCacheAuthorize(db);
+}
+
+typedef struct {
+    char **names;
+    int    count;
+    int    capacity;
+} TableNames;
+
+// records the tables a statement reads while it is prepared
+static int collectTables(void *arg, int action, const char *table, const char *column, const char *database, const char *trigger) {
+    (void)column;
+    (void)database;
+    (void)trigger;
+
+    TableNames *names = arg;
+    if (action != SQLITE_READ || !table || strncmp(table, "sqlite_", 7) == 0) return SQLITE_OK;
+
+    for (int i = 0; i < names->count; i++) {
+        if (strcmp(names->names[i], table) == 0) return SQLITE_OK;
+    }
+
+    if (names->count == names->capacity) {
+        names->names = growArray(names->names, &names->capacity, sizeof(char *));
+    }
+
+    names->names[names->count] = strdup(table);
+    if (!names->names[names->count]) {
+        fprintf(stderr, "Fatal: out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+    names->count++;
+
+    return SQLITE_OK;
+}
+
+// with the lock held
+static int findQuery(DbQueryCache *cache, const char *sql, unsigned int hash) {
+    for (int i = 0; i < cache->queryCount; i++) {
+        if (cache->queries[i].hash == hash && strcmp(cache->queries[i].sql, sql) == 0) return i;
+    }
+
+    return -1;
+}
+
+// prepares the query once more with an authorizer to learn what it reads, -1 if it does not prepare
+static int describeQuery(DbContext *db, const char *sql, unsigned int hash) {
+    sqlite3 *connection = (sqlite3 *)db->connection;
+    TableNames names = { 0 };
+
+    sqlite3_stmt *stmt;
+    sqlite3_set_authorizer(connection, collectTables, &names);
+    int rc = sqlite3_prepare_v2(connection, sql, -1, &stmt, NULL);
+    dbQueryCacheAuthorize(db);
+
+    if (rc != SQLITE_OK) {
+        for (int i = 0; i < names.count; i++) free(names.names[i]);
+        free(names.names);
+        return -1;
+    }
+
+    bool cacheable = sqlite3_stmt_readonly(stmt);
+    sqlite3_finalize(stmt);
+
+    DbQueryCache *cache = db->queryCache->cache;
+
+    pthread_mutex_lock(&cache->lock);
+
+    // another thread may have described it in the meantime
+    int index = findQuery(cache, sql, hash);
+
+    if (index < 0) {
+        if (cache->queryCount == cache->queryCapacity) {
+            cache->queries = growArray(cache->queries, &cache->queryCapacity, sizeof(CacheQuery));
+        }
+
+        CacheQuery *query = &cache->queries[cache->queryCount];
+        *query = (CacheQuery) {
+            .sql = strdup(sql),
+            .hash = hash,
+            .cacheable = cacheable,
+            .tables = allocate(sizeof(int) * (names.count + 1)),
+            .tableCount = names.count,
+        };
+
+        if (!query->sql) {
+            fprintf(stderr, "Fatal: out of memory\n");
+            exit(EXIT_FAILURE);
+        }
+
+        for (int i = 0; i < names.count; i++) {
+            query->tables[i] = tableIndex(cache, names.names[i]);
+        }
+
+        index = cache->queryCount++;
+    }
+
+    pthread_mutex_unlock(&cache->lock);
+
+    for (int i = 0; i < names.count; i++) free(names.names[i]);
+    free(names.names);
+
+    return index;
+}
+
+typedef struct {
+    char   *data;
+    size_t  length;
+    size_t  capacity;
+    char    inlineData[CACHE_INLINE_KEY];
+} Key;
+
+static void appendKey(Key *key, const void *bytes, size_t length) {
+    if (key->length + length > key->capacity) {
+        size_t capacity = key->capacity * 2;
+        while (capacity < key->length + length) capacity *= 2;
+
+        char *data = key->data == key->inlineData ? malloc(capacity) : realloc(key->data, capacity);
+        if (!data) {
+            fprintf(stderr, "Fatal: out of memory\n");
+            exit(EXIT_FAILURE);
+        }
+
+        if (key->data == key->inlineData) memcpy(data, key->inlineData, key->length);
+
+        key->data = data;
+        key->capacity = capacity;
+    }
+
+    memcpy(key->data + key->length, bytes, length);
+    key->length += length;
+}
+
+// the SQL with its terminator, then each parameter's type and value
+static void buildKey(Key *key, const char *sql, const DbParam *params, int paramCount) {
+    key->data = key->inlineData;
+    key->length = 0;
+    key->capacity = sizeof(key->inlineData);
+
+    appendKey(key, sql, strlen(sql) + 1);
+
+    for (int i = 0; i < paramCount; i++) {
+        unsigned char type = (unsigned char)params[i].type;
+        appendKey(key, &type, 1);
+
+        switch (params[i].type) {
+            case DB_PARAM_NULL:
+                break;
+            case DB_PARAM_INT:
+                appendKey(key, &params[i].value.i, sizeof(int));
+                break;
+            case DB_PARAM_INT64:
+                appendKey(key, &params[i].value.i64, sizeof(long long));
+                break;
+            case DB_PARAM_DOUBLE:
+                appendKey(key, &params[i].value.d, sizeof(double));
+                break;
+            case DB_PARAM_BOOL:
+                type = params[i].value.b;
+                appendKey(key, &type, 1);
+                break;
+            case DB_PARAM_TEXT: {
+                size_t length = params[i].value.s ? strlen(params[i].value.s) : 0;
+                appendKey(key, &length, sizeof(length));
+                if (length) appendKey(key, params[i].value.s, length);
+                break;
+            }
+        }
+    }
+}
+
+static void freeKey(Key *key) {
+    if (key->data != key->inlineData) free(key->data);
+}
+
+// with the lock held
+static CacheEntry *findEntry(DbQueryCache *cache, const Key *key, unsigned int hash) {
+    for (CacheEntry *entry = cache->buckets[hash & (cache->bucketCount - 1)]; entry; entry = entry->next) {
+        if (entry->hash == hash && entry->keyLength == key->length && memcmp(entry->key, key->data, key->length) == 0) {
+            return entry;
+        }
+    }
+
+    return NULL;
+}
+
+static bool isStale(DbQueryCache *cache, const CacheEntry *entry) {
+    const CacheQuery *query = &cache->queries[entry->query];
+
+    for (int i = 0; i < query->tableCount; i++) {
+        if (cache->tables[query->tables[i]].generation != entry->generations[i]) return true;
+    }
+
+    return false;
+}
+
+static void rehash(DbQueryCache *cache) {
+    int count = cache->bucketCount * 2;
+    CacheEntry **buckets = calloc(count, sizeof(CacheEntry *));
+
+    if (!buckets) {
+        fprintf(stderr, "Fatal: out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+
+    for (int i = 0; i < cache->bucketCount; i++) {
+        for (CacheEntry *entry = cache->buckets[i], *next; entry; entry = next) {
+            next = entry->next;
+            entry->next = buckets[entry->hash & (count - 1)];
+            buckets[entry->hash & (count - 1)] = entry;
+        }
+    }
+
+    free(cache->buckets);
+    cache->buckets = buckets;
+    cache->bucketCount = count;
+}
+
+// with the lock held. result is owned by the cache from here on
+static void insertEntry(DbQueryCache *cache, const Key *key, unsigned int hash, int query, const unsigned long long *generations, DbResult *result) {
+    const CacheQuery *described = &cache->queries[query];
+    size_t size = sizeof(CacheEntry) + key->length + result->size + sizeof(unsigned long long) * described->tableCount;
+
+    if (size > cache->budget) {
+        freeDbResult(result);
+        return;
+    }
+
+    CacheEntry *existing = findEntry(cache, key, hash);
+    if (existing) removeEntry(cache, existing);
+
+    CacheEntry *entry = allocate(sizeof(CacheEntry));
+    *entry = (CacheEntry) {
+        .hash = hash,
+        .key = allocate(key->length),
+        .keyLength = key->length,
+        .result = result,
+        .size = size,
+        .expires = nowMs() + cache->ttlMs,
+        .query = query,
+        .generations = allocate(sizeof(unsigned long long) * (described->tableCount + 1)),
+    };
+
+    memcpy(entry->key, key->data, key->length);
+    memcpy(entry->generations, generations, sizeof(unsigned long long) * described->tableCount);
+
+    if (cache->stats.entries >= cache->bucketCount) rehash(cache);
+
+    CacheEntry **bucket = &cache->buckets[hash & (cache->bucketCount - 1)];
+    entry->next = *bucket;
+    *bucket = entry;
+
+    entry->older = cache->newest;
+    if (cache->newest) cache->newest->newer = entry;
+    cache->newest = entry;
+    if (!cache->oldest) cache->oldest = entry;
+
+    cache->stats.bytes += size;
+    cache->stats.entries++;
+
+    while (cache->stats.bytes > cache->budget && cache->oldest) {
+        removeEntry(cache, cache->oldest);
+        cache->stats.evictions++;
+    }
+}
+
+// the generations of a query's tables, for checking a result later
+#define CACHE_INLINE_TABLES 16
+
+DbResult *dbQueryCached(DbContext *db, const char *query, const DbParam *params, int paramCount) {
+    if (!db->queryCache) return dbQueryRows(db, query, (DbParam *)params, paramCount);
+
+    DbQueryCache *cache = db->queryCache->cache;
+
+    Key key;
+    buildKey(&key, query, params, paramCount);
+
+    unsigned int hash = hashBytes(key.data, key.length);
+    unsigned int sqlHash = hashBytes(query, strlen(query));
+
+    pthread_mutex_lock(&cache->lock);
+
+    CacheEntry *entry = findEntry(cache, &key, hash);
+    if (entry) {
+        if (entry->expires <= nowMs()) {
+            removeEntry(cache, entry);
+            cache->stats.expirations++;
+        } else if (isStale(cache, entry)) {
+            removeEntry(cache, entry);
+            cache->stats.invalidations++;
+        } else {
+            // move it to the front of the least recently used order
+            if (entry != cache->newest) {
+                entry->newer->older = entry->older;
+                if (entry->older) entry->older->newer = entry->newer; else cache->oldest = entry->newer;
+
+                entry->newer = NULL;
+                entry->older = cache->newest;
+                cache->newest->newer = entry;
+                cache->newest = entry;
+            }
+
+            DbResult *copy = dbCopyResult(entry->result);
+            cache->stats.hits++;
+
+            pthread_mutex_unlock(&cache->lock);
+            freeKey(&key);
+
+            return copy;
+        }
+    }
+
+    cache->stats.misses++;
+    int described = findQuery(cache, query, sqlHash);
+
+    pthread_mutex_unlock(&cache->lock);
+
+    if (described < 0) described = describeQuery(db, query, sqlHash);
+
+    if (described < 0) {
+        freeKey(&key);
+        return dbQueryRows(db, query, (DbParam *)params, paramCount);
+    }
+
+    // the generations are taken before the query runs, so a write that lands while it runs
+    // leaves the result stale rather than cached as current
+    unsigned long long inlineGenerations[CACHE_INLINE_TABLES];
+    unsigned long long *generations = inlineGenerations;
+
+    pthread_mutex_lock(&cache->lock);
+
+    CacheQuery *shape = &cache->queries[described];
+    bool cacheable = shape->cacheable;
+
+    if (shape->tableCount > CACHE_INLINE_TABLES) {
+        generations = allocate(sizeof(unsigned long long) * shape->tableCount);
+    }
+    for (int i = 0; i < shape->tableCount; i++) {
+        generations[i] = cache->tables[shape->tables[i]].generation;
+    }
+
+    pthread_mutex_unlock(&cache->lock);
+
+    DbResult *result = dbQueryRows(db, query, (DbParam *)params, paramCount);
+
+    if (result && cacheable) {
+        DbResult *copy = dbCopyResult(result);
+
+        pthread_mutex_lock(&cache->lock);
+        insertEntry(cache, &key, hash, described, generations, copy);
+        pthread_mutex_unlock(&cache->lock);
+    }
+
+    if (generations != inlineGenerations) free(generations);
+    freeKey(&key);
+
+    return result;
+}
@@ -0,0 +1,177 @@
+#define SQL_NO_CALL_SITES
+
+#include <sqlite3.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include "../include/sql_json.h"
+#include "../include/router.h"
+
+typedef enum {
+    COLUMN_VALUE,
+    COLUMN_BOOL,
+} ColumnKind;
+
+// the escaped "name": fragment of every column, built once per query and written for every row
+typedef struct {
+    JsonWriter  names;
+    size_t     *offsets;
+    ColumnKind *kinds;
+    int         count;
+} ColumnKeys;
+
+static ColumnKeys columnKeys(sqlite3_stmt *stmt, int colCount) {
+    ColumnKeys keys = {
+        .names = jsonWriter(),
+        .offsets = malloc(sizeof(size_t) * (colCount + 1)),
+        .kinds = malloc(sizeof(ColumnKind) * (colCount + 1)),
+        .count = colCount,
+    };
+
+    if (!keys.offsets || !keys.kinds) {
+        fprintf(stderr, "Fatal: out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+
+    for (int i = 0; i < colCount; i++) {
+        const char *declType = sqlite3_column_decltype(stmt, i);
+
+        keys.offsets[i] = keys.names.length;
+        keys.kinds[i] = declType && (strcasecmp(declType, "bool") == 0 || strcasecmp(declType, "boolean") == 0)
+            ? COLUMN_BOOL
+            : COLUMN_VALUE;
+
+        jwKeyFragment(&keys.names, sqlite3_column_name(stmt, i));
+    }
+    keys.offsets[colCount] = keys.names.length;
+
+    return keys;
+}
+
+static void freeColumnKeys(ColumnKeys *keys) {
+    freeJsonWriter(&keys->names);
+    free(keys->offsets);
+    free(keys->kinds);
+}
+
+static void writeBlob(JsonWriter *writer, const unsigned char *bytes, int length) {
+    static const char map[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+    char *encoded = malloc((size_t)(length + 2) / 3 * 4 + 1);
+    if (!encoded) {
+        fprintf(stderr, "Fatal: out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+
+    size_t n = 0;
+    for (int i = 0; i < length; i += 3) {
+        unsigned int group = (unsigned int)bytes[i] << 16;
+        if (i + 1 < length) group |= (unsigned int)bytes[i + 1] << 8;
+        if (i + 2 < length) group |= bytes[i + 2];
+
+        encoded[n++] = map[group >> 18 & 0x3f];
+        encoded[n++] = map[group >> 12 & 0x3f];
+        encoded[n++] = i + 1 < length ? map[group >> 6 & 0x3f] : '=';
+        encoded[n++] = i + 2 < length ? map[group & 0x3f] : '=';
+    }
+
+    jwStringLength(writer, encoded, n);
+    free(encoded);
+}
+
+static void writeRow(JsonWriter *writer, sqlite3_stmt *stmt, const ColumnKeys *keys) {
+    jwObjectStart(writer);
+
+    for (int i = 0; i < keys->count; i++) {
+        jwRawKey(writer, keys->names.buffer + keys->offsets[i], keys->offsets[i + 1] - keys->offsets[i]);
+
+        switch (sqlite3_column_type(stmt, i)) {
+            case SQLITE_INTEGER:
+                if (keys->kinds[i] == COLUMN_BOOL) {
+                    jwBool(writer, sqlite3_column_int64(stmt, i) != 0);
+                } else {
+                    jwInt(writer, sqlite3_column_int64(stmt, i));
+                }
+                break;
+            case SQLITE_FLOAT:
+                jwDouble(writer, sqlite3_column_double(stmt, i));
+                break;
+            case SQLITE_TEXT:
+                jwStringLength(writer, (const char *)sqlite3_column_text(stmt, i), sqlite3_column_bytes(stmt, i));
+                break;
+            case SQLITE_BLOB:
+                writeBlob(writer, sqlite3_column_blob(stmt, i), sqlite3_column_bytes(stmt, i));
+                break;
+            default:
+                jwNull(writer);
+                break;
+        }
+    }
+
+    jwObjectEnd(writer);
+}
+
+// writes the rows of an open cursor, stopping early if the writer fails. closes the cursor
+static void writeRows(DbCursor *cursor, JsonWriter *writer, bool firstRow) {
+    ColumnKeys keys = columnKeys(cursor->statement, cursor->colCount);
+    bool any = false;
+
+    while (!writer->failed && dbNext(cursor)) {
+        writeRow(writer, cursor->statement, &keys);
+        any = true;
+
+        if (firstRow) break;
+    }
+
+    if (firstRow && !any) jwNull(writer);
+
+    dbCloseCursor(cursor);
+    freeColumnKeys(&keys);
+}
+
+bool dbQueryJson(DbContext *db, const char *query, const DbParam *params, int paramCount, JsonWriter *writer) {
+    DbCursor cursor = dbQueryCursor(db, query, params, paramCount);
+
+    jwArrayStart(writer);
+    if (!cursor.failed) writeRows(&cursor, writer, false);
+    jwArrayEnd(writer);
+
+    return !cursor.failed;
+}
+
+bool dbQueryJsonObject(DbContext *db, const char *query, const DbParam *params, int paramCount, JsonWriter *writer) {
+    DbCursor cursor = dbQueryCursor(db, query, params, paramCount);
+
+    if (cursor.failed) {
+        jwNull(writer);
+        return false;
+    }
+
+    writeRows(&cursor, writer, true);
+    return !cursor.failed;
+}
+
+HttpResponse dbStreamJson(RequestContext ctx, const char *query, const DbParam *params, int paramCount) {
+    // nothing has been sent yet, so a query that cannot be prepared still gets an error status
+    DbCursor cursor = dbQueryCursor(ctx.db, query, params, paramCount);
+    if (cursor.failed) {
+        return internalServerError("Database query failed", TEXT_PLAIN);
+    }
+
+    JsonWriter writer = jsonStreamWriter(ctx, HTTP_OK);
+
+    jwArrayStart(&writer);
+    writeRows(&cursor, &writer, false);
+    jwArrayEnd(&writer);
+
+    // the status has gone out, so a failed step drops the connection without the final chunk
+    // rather than ending what would look like a complete array
+    if (cursor.failed && writer.stream) {
+        writer.failed = true;
+        writer.stream->failed = true;
+    }
+
+    return jwEndStream(&writer);
+}
@@ -0,0 +1,317 @@
+#define SQL_NO_CALL_SITES
+
+#include <sqlite3.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+#include <pthread.h>
+
+#include "../include/sql_plan.h"
+#include "../include/sql_cache.h"
+#include "../include/utils.h"
+
+struct DbPlanChecker {
+    pthread_mutex_t  lock;
+    FILE            *out;
+
+    // statements already checked
+    char           **seen;
+    unsigned int    *hashes;
+    int              seenCount;
+    int              seenCapacity;
+
+    DbPlanWarning   *warnings;
+    int              warningCount;
+    int              warningCapacity;
+};
+
+// the steps of a plan that are kept to look at, a plan with more is cut short
+#define PLAN_MAX_STEPS 64
+
+typedef struct {
+    char *names[PLAN_MAX_STEPS];
+    int   count;
+} NameList;
+
+DbPlanChecker *createDbPlanChecker(FILE *out) {
+    DbPlanChecker *checker = calloc(1, sizeof(DbPlanChecker));
+    if (!checker) {
+        fprintf(stderr, "Fatal: out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+
+    checker->out = out;
+    pthread_mutex_init(&checker->lock, NULL);
+
+    return checker;
+}
+
+void freeDbPlanChecker(DbPlanChecker *checker) {
+    if (!checker) return;
+
+    for (int i = 0; i < checker->seenCount; i++) {
+        free(checker->seen[i]);
+    }
+    for (int i = 0; i < checker->warningCount; i++) {
+        free((char *)checker->warnings[i].sql);
+        free((char *)checker->warnings[i].detail);
+    }
+
+    free(checker->seen);
+    free(checker->hashes);
+    free(checker->warnings);
+
+    pthread_mutex_destroy(&checker->lock);
+    free(checker);
+}
+
+void dbAttachPlanChecker(DbContext *db, DbPlanChecker *checker) {
+    db->planChecker = checker;
+}
+
+// marks query as checked, false if it already was
+static bool firstSeen(DbPlanChecker *checker, const char *query) {
+    unsigned int hash = hashString(query);
+
+    pthread_mutex_lock(&checker->lock);
+
+    for (int i = 0; i < checker->seenCount; i++) {
+        if (checker->hashes[i] == hash && strcmp(checker->seen[i], query) == 0) {
+            pthread_mutex_unlock(&checker->lock);
+            return false;
+        }
+    }
+
+    if (checker->seenCount == checker->seenCapacity) {
+        int capacity = checker->seenCapacity;
+        checker->seen = growArray(checker->seen, &checker->seenCapacity, sizeof(char *));
+        checker->hashes = growArray(checker->hashes, &capacity, sizeof(unsigned int));
+    }
+
+    checker->seen[checker->seenCount] = copyString(query);
+    checker->hashes[checker->seenCount++] = hash;
+
+    pthread_mutex_unlock(&checker->lock);
+    return true;
+}
+
+static void addName(NameList *list, const char *name, size_t length) {
+    if (list->count == PLAN_MAX_STEPS) return;
+
+    for (int i = 0; i < list->count; i++) {
+        if (strlen(list->names[i]) == length && strncmp(list->names[i], name, length) == 0) return;
+    }
+
+    char *copy = malloc(length + 1);
+    if (!copy) {
+        fprintf(stderr, "Fatal: out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+
+    memcpy(copy, name, length);
+    copy[length] = '\0';
+
+    list->names[list->count++] = copy;
+}
+
+static bool hasName(const NameList *list, const char *name, size_t length) {
+    for (int i = 0; i < list->count; i++) {
+        if (strlen(list->names[i]) == length && strncmp(list->names[i], name, length) == 0) return true;
+    }
+
+    return false;
+}
+
+static void freeNames(NameList *list) {
+    for (int i = 0; i < list->count; i++) free(list->names[i]);
+    list->count = 0;
+}
+
+// records the tables the statement reads while it is prepared
+static int collectTables(void *arg, int action, const char *table, const char *column, const char *database, const char *trigger) {
+    (void)column;
+    (void)database;
+    (void)trigger;
+
+    if (action == SQLITE_READ && table && strncmp(table, "sqlite_", 7) != 0) {
+        addName(arg, table, strlen(table));
+    }
+
+    return SQLITE_OK;
+}
+
+// the name a step such as "SCAN todos USING INDEX" is about, and its length
+static const char *stepName(const char *detail, const char *prefix, size_t *length) {
+    size_t prefixLength = strlen(prefix);
+    if (strncmp(detail, prefix, prefixLength) != 0) return NULL;
+
+    const char *name = detail + prefixLength;
+
+    // older versions of SQLite write SCAN TABLE todos
+    if (strncmp(name, "TABLE ", 6) == 0) name += 6;
+
+    *length = strcspn(name, " ");
+    return name;
+}
+
+// whether the statement filters rows, a scan of a table it reads in full is expected
+static bool hasWhere(const char *query) {
+    for (const char *p = query; *p; p++) {
+        if (strncasecmp(p, "where", 5) != 0) continue;
+
+        bool before = p == query || !(isalnum((unsigned char)p[-1]) || p[-1] == '_');
+        bool after = !(isalnum((unsigned char)p[5]) || p[5] == '_');
+        if (before && after) return true;
+    }
+
+    return false;
+}
+
+static bool hasLargeTable(sqlite3 *connection, const NameList *tables) {
+    for (int i = 0; i < tables->count; i++) {
+        char *sql = sqlite3_mprintf("select count(*) from (select 1 from \"%w\" limit %d);", tables->names[i], DB_PLAN_LARGE_TABLE_ROWS);
+
+        sqlite3_stmt *stmt;
+        int rows = 0;
+
+        if (sqlite3_prepare_v2(connection, sql, -1, &stmt, NULL) == SQLITE_OK) {
+            if (sqlite3_step(stmt) == SQLITE_ROW) rows = sqlite3_column_int(stmt, 0);
+            sqlite3_finalize(stmt);
+        }
+
+        sqlite3_free(sql);
+        if (rows >= DB_PLAN_LARGE_TABLE_ROWS) return true;
+    }
+
+    return false;
+}
+
+static void warn(DbPlanChecker *checker, const char *query, const char *problem, const char *detail) {
+    DbCallSite site = dbCallSite;
+    FILE *out = checker->out ? checker->out : stderr;
+
+    pthread_mutex_lock(&checker->lock);
+
+    if (checker->warningCount == checker->warningCapacity) {
+        checker->warnings = growArray(checker->warnings, &checker->warningCapacity, sizeof(DbPlanWarning));
+    }
+
+    checker->warnings[checker->warningCount++] = (DbPlanWarning) {
+        .sql = copyString(query),
+        .detail = copyString(detail),
+        .file = site.file,
+        .line = site.line,
+    };
+
+    if (site.file) {
+        fprintf(out, "Query plan warning at %s:%d: %s (%s)\n    %s\n", site.file, site.line, problem, detail, query);
+    } else {
+        fprintf(out, "Query plan warning: %s (%s)\n    %s\n", problem, detail, query);
+    }
+    fflush(out);
+
+    pthread_mutex_unlock(&checker->lock);
+}
+
+void dbCheckPlan(DbContext *db, const char *query) {
+    DbPlanChecker *checker = db->planChecker;
+    if (!checker) return;
+
+    while (isspace((unsigned char)*query)) query++;
+    if (strncasecmp(query, "explain", 7) == 0) return;
+
+    if (!firstSeen(checker, query)) return;
+
+    sqlite3 *connection = (sqlite3 *)db->connection;
+    char *explain = sqlite3_mprintf("explain query plan %s", query);
+
+    NameList tables = { .count = 0 };
+    sqlite3_stmt *stmt;
+
+    sqlite3_set_authorizer(connection, collectTables, &tables);
+    int rc = sqlite3_prepare_v2(connection, explain, -1, &stmt, NULL);
+    dbQueryCacheAuthorize(db);
+    sqlite3_free(explain);
+
+    // statements without a plan, such as DDL, and ones that do not prepare have nothing to check
+    if (rc != SQLITE_OK || !stmt) {
+        freeNames(&tables);
+        return;
+    }
+
+    NameList steps = { .count = 0 };
+    NameList subqueries = { .count = 0 };
+
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        const char *detail = (const char *)sqlite3_column_text(stmt, 3);
+        if (!detail) continue;
+
+        addName(&steps, detail, strlen(detail));
+
+        // CTEs and subqueries are scanned by name, they are not tables
+        size_t length;
+        const char *name = stepName(detail, "MATERIALIZE ", &length);
+        if (!name) name = stepName(detail, "CO-ROUTINE ", &length);
+        if (name) addName(&subqueries, name, length);
+    }
+
+    sqlite3_finalize(stmt);
+
+    bool filtered = hasWhere(query);
+    int large = -1;
+
+    for (int i = 0; i < steps.count; i++) {
+        const char *detail = steps.names[i];
+        size_t length;
+        const char *name = stepName(detail, "SCAN ", &length);
+
+        if (name) {
+            bool table = name[0] != '(' && strncmp(name, "CONSTANT", length) != 0 && !hasName(&subqueries, name, length);
+            bool indexed = strstr(detail, " USING ") != NULL || strstr(detail, "VIRTUAL TABLE") != NULL;
+
+            if (table && !indexed && filtered) warn(checker, query, "full table scan, is an index missing?", detail);
+        }
+
+        if (strstr(detail, "AUTOMATIC") && strstr(detail, "INDEX")) {
+            warn(checker, query, "index built for every run, is an index missing?", detail);
+        }
+
+        if (strncmp(detail, "USE TEMP B-TREE", 15) == 0) {
+            if (large == -1) large = hasLargeTable(connection, &tables);
+            if (large) warn(checker, query, "rows sorted in a temporary B-tree", detail);
+        }
+    }
+
+    freeNames(&steps);
+    freeNames(&subqueries);
+    freeNames(&tables);
+}
+
+int dbPlanWarnings(DbPlanChecker *checker, const DbPlanWarning **warnings) {
+    pthread_mutex_lock(&checker->lock);
+    *warnings = checker->warnings;
+    int count = checker->warningCount;
+    pthread_mutex_unlock(&checker->lock);
+
+    return count;
+}
+
+void dbPlanReport(DbPlanChecker *checker, FILE *out) {
+    pthread_mutex_lock(&checker->lock);
+
+    fprintf(out, "Query plans: %d statements checked, %d warnings\n", checker->seenCount, checker->warningCount);
+
+    for (int i = 0; i < checker->warningCount; i++) {
+        const DbPlanWarning *warning = &checker->warnings[i];
+
+        if (warning->file) {
+            fprintf(out, "  %s:%d: %s\n    %s\n", warning->file, warning->line, warning->detail, warning->sql);
+        } else {
+            fprintf(out, "  %s\n    %s\n", warning->detail, warning->sql);
+        }
+    }
+
+    pthread_mutex_unlock(&checker->lock);
+}
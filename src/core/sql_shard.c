@@ -0,0 +1,221 @@
+#define SQL_NO_CALL_SITES
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../include/sql_shard.h"
+#include "../include/utils.h"
+
+typedef enum {
+    SHARD_BY_HASH,
+    SHARD_BY_RANGE,
+} ShardKind;
+
+struct DbShards {
+    ShardKind   kind;
+    int         count;
+
+    DbPool    **pools;
+    DbWriter  **writers;
+
+    // the count - 1 upper bounds of range sharding
+    long long  *bounds;
+};
+
+static DbShards *openShards(ShardKind kind, const char **paths, int count, const long long *bounds, DbPragmas pragmas) {
+    if (count <= 0) return NULL;
+
+    DbShards *shards = allocate(sizeof(DbShards));
+    shards->kind = kind;
+    shards->count = count;
+    shards->pools = allocate(sizeof(DbPool *) * count);
+    shards->writers = allocate(sizeof(DbWriter *) * count);
+
+    if (bounds && count > 1) {
+        shards->bounds = allocate(sizeof(long long) * (count - 1));
+        memcpy(shards->bounds, bounds, sizeof(long long) * (count - 1));
+    }
+
+    for (int i = 0; i < count; i++) {
+        // the writer opens the file first, so it exists before the pool's read connections
+        shards->writers[i] = createDbWriter(paths[i], pragmas);
+        shards->pools[i] = createDbPool(paths[i], DB_POOL_SIZE, pragmas);
+
+        if (!shards->writers[i] || !shards->pools[i]) {
+            fprintf(stderr, "Failed to open shard %d: %s\n", i, paths[i]);
+            freeDbShards(shards);
+            return NULL;
+        }
+    }
+
+    return shards;
+}
+
+DbShards *createDbShards(const char **paths, int count, DbPragmas pragmas) {
+    return openShards(SHARD_BY_HASH, paths, count, NULL, pragmas);
+}
+
+DbShards *createDbRangeShards(const char **paths, int count, const long long *bounds, DbPragmas pragmas) {
+    if (!bounds && count > 1) {
+        fprintf(stderr, "Shard bounds are missing\n");
+        return NULL;
+    }
+
+    for (int i = 1; i < count - 1; i++) {
+        if (bounds[i] <= bounds[i - 1]) {
+            fprintf(stderr, "Shard bounds must be ascending\n");
+            return NULL;
+        }
+    }
+
+    return openShards(SHARD_BY_RANGE, paths, count, bounds, pragmas);
+}
+
+void freeDbShards(DbShards *shards) {
+    if (!shards) return;
+
+    for (int i = 0; i < shards->count; i++) {
+        if (shards->writers[i]) freeDbWriter(shards->writers[i]);
+    }
+    for (int i = 0; i < shards->count; i++) {
+        if (shards->pools[i]) freeDbPool(shards->pools[i]);
+    }
+
+    free(shards->pools);
+    free(shards->writers);
+    free(shards->bounds);
+    free(shards);
+}
+
+int dbShardCount(DbShards *shards) {
+    return shards->count;
+}
+
+// Lamping and Veach, "A Fast, Minimal Memory, Consistent Hash Algorithm"
+static int jumpHash(unsigned long long key, int buckets) {
+    long long b = -1;
+    long long j = 0;
+
+    while (j < buckets) {
+        b = j;
+        key = key * 2862933555777941757ULL + 1;
+        j = (long long)((b + 1) * ((double)(1LL << 31) / (double)((key >> 33) + 1)));
+    }
+
+    return (int)b;
+}
+
+// whether key holds an integer, and its value
+static bool integerKey(DbParam key, long long *value) {
+    switch (key.type) {
+        case DB_PARAM_INT:   *value = key.value.i; return true;
+        case DB_PARAM_INT64: *value = key.value.i64; return true;
+        case DB_PARAM_BOOL:  *value = key.value.b; return true;
+        default:             return false;
+    }
+}
+
+int dbShardIndex(DbShards *shards, DbParam key) {
+    long long integer;
+    bool isInteger = integerKey(key, &integer);
+
+    if (shards->kind == SHARD_BY_RANGE) {
+        if (!isInteger) return -1;
+
+        int index = 0;
+        while (index < shards->count - 1 && integer >= shards->bounds[index]) index++;
+
+        return index;
+    }
+
+    unsigned long long hash;
+
+    if (isInteger) {
+        hash = hashBytes64(&integer, sizeof(integer));
+    } else if (key.type == DB_PARAM_DOUBLE) {
+        hash = hashBytes64(&key.value.d, sizeof(key.value.d));
+    } else if (key.type == DB_PARAM_TEXT && key.value.s) {
+        hash = hashBytes64(key.value.s, strlen(key.value.s));
+    } else {
+        return -1;
+    }
+
+    return jumpHash(hash, shards->count);
+}
+
+DbPool *dbShardPool(DbShards *shards, int index) {
+    if (index < 0 || index >= shards->count) return NULL;
+    return shards->pools[index];
+}
+
+DbWriter *dbShardWriter(DbShards *shards, int index) {
+    if (index < 0 || index >= shards->count) return NULL;
+    return shards->writers[index];
+}
+
+static int placeKey(DbShards *shards, DbParam key) {
+    int index = dbShardIndex(shards, key);
+    if (index < 0) fprintf(stderr, "Shard key cannot be placed on a shard\n");
+
+    return index;
+}
+
+DbContext *dbShardConnection(DbShards *shards, DbParam key) {
+    int index = placeKey(shards, key);
+    if (index < 0) return NULL;
+
+    return dbPoolConnection(shards->pools[index]);
+}
+
+DbResult *dbShardQueryRows(DbShards *shards, DbParam key, const char *query, DbParam *params, int paramCount) {
+    DbContext *db = dbShardConnection(shards, key);
+    if (!db) return NULL;
+
+    return dbQueryRows(db, query, params, paramCount);
+}
+
+bool dbShardWrite(DbShards *shards, DbParam key, const char *query, const DbParam *params, int paramCount) {
+    int index = placeKey(shards, key);
+    if (index < 0) return false;
+
+    return dbWrite(shards->writers[index], query, params, paramCount);
+}
+
+bool dbShardWriteWith(DbShards *shards, DbParam key, DbWriteFunction function, void *userData) {
+    int index = placeKey(shards, key);
+    if (index < 0) return false;
+
+    return dbWriteWith(shards->writers[index], function, userData);
+}
+
+// on the stack for typical shard counts
+#define INLINE_SHARDS 16
+
+DbResult *dbShardQueryAll(DbShards *shards, const char *query, DbParam *params, int paramCount) {
+    DbContext *inlineDbs[INLINE_SHARDS];
+    DbContext **dbs = shards->count <= INLINE_SHARDS ? inlineDbs : allocate(sizeof(DbContext *) * shards->count);
+
+    DbResult *result = NULL;
+    bool connected = true;
+
+    for (int i = 0; i < shards->count && connected; i++) {
+        dbs[i] = dbPoolConnection(shards->pools[i]);
+        connected = dbs[i] != NULL;
+    }
+
+    if (connected) result = dbQueryRowsAcross(dbs, shards->count, query, params, paramCount);
+
+    if (dbs != inlineDbs) free(dbs);
+    return result;
+}
+
+bool dbShardWriteAll(DbShards *shards, const char *query, const DbParam *params, int paramCount) {
+    bool ok = true;
+
+    for (int i = 0; i < shards->count; i++) {
+        if (!dbWrite(shards->writers[i], query, params, paramCount)) ok = false;
+    }
+
+    return ok;
+}
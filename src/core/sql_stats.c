@@ -0,0 +1,451 @@
+#define SQL_NO_CALL_SITES
+
+#include <sqlite3.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "../include/sql_stats.h"
+#include "../include/utils.h"
+
+// latencies in nanoseconds, 8 buckets for every power of two. the first 8 hold 0 to 7 exactly
+#define HISTOGRAM_SUB_BUCKETS 8
+#define HISTOGRAM_BUCKETS (62 * HISTOGRAM_SUB_BUCKETS)
+
+// SQL texts remembered with the statement they normalize to, past this they are normalized each time
+#define STATS_MAX_TEXTS 4096
+
+// statements a connection is stepping at once, usually one
+#define STATS_ACTIVE_STATEMENTS 8
+
+typedef struct {
+    char               *sql;
+    unsigned int        hash;
+
+    unsigned long long  calls;
+    unsigned long long  rows;
+    unsigned long long  totalNs;
+    unsigned long long  maxNs;
+
+    unsigned int       *histogram;
+} StatsEntry;
+
+// a SQL text as run, and the entry it was counted under
+typedef struct {
+    char         *sql;
+    unsigned int  hash;
+    int           entry;
+} StatsText;
+
+struct DbStats {
+    pthread_mutex_t  lock;
+
+    double           slowMs;
+    FILE            *slowLog;
+
+    StatsEntry      *entries;
+    int              entryCount;
+    int              entryCapacity;
+
+    StatsText       *texts;
+    int              textCount;
+    int              textCapacity;
+};
+
+// a statement being stepped, when it started and the rows it has returned so far
+typedef struct {
+    sqlite3_stmt       *statement;
+    unsigned long long  start;
+    unsigned long long  rows;
+} ActiveStatement;
+
+struct DbStatsLink {
+    DbStats         *stats;
+
+    ActiveStatement  active[STATS_ACTIVE_STATEMENTS];
+    int              activeCount;
+};
+
+static unsigned long long nowNs() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (unsigned long long)now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+static bool isIdentifier(char c) {
+    return isalnum((unsigned char)c) || c == '_' || c == '$' || (unsigned char)c >= 0x80;
+}
+
+void dbNormalizeSql(const char *sql, char *out) {
+    char *next = out;
+    const char *p = sql;
+
+    while (isspace((unsigned char)*p)) p++;
+
+    while (*p) {
+        if (isspace((unsigned char)*p)) {
+            while (isspace((unsigned char)*p)) p++;
+            if (*p) *next++ = ' ';
+            continue;
+        }
+
+        // a string or blob literal, with '' for a quote inside it
+        if (*p == '\'' || ((*p == 'x' || *p == 'X') && p[1] == '\'' && (p == sql || !isIdentifier(p[-1])))) {
+            if (*p != '\'') p++;
+            p++;
+
+            while (*p && !(*p == '\'' && p[1] != '\'')) {
+                p += *p == '\'' ? 2 : 1;
+            }
+            if (*p) p++;
+
+            *next++ = '?';
+            continue;
+        }
+
+        // quoted identifiers are kept as they are
+        if (*p == '"' || *p == '`' || *p == '[') {
+            char close = *p == '[' ? ']' : *p;
+
+            *next++ = *p++;
+            while (*p && *p != close) *next++ = *p++;
+            if (*p) *next++ = *p++;
+            continue;
+        }
+
+        // a number, unless it is part of a name such as t1
+        bool startsNumber = isdigit((unsigned char)*p) || (*p == '.' && isdigit((unsigned char)p[1]));
+
+        if (startsNumber && (p == sql || !isIdentifier(p[-1]))) {
+            if (p[0] == '0' && (p[1] == 'x' || p[1] == 'X')) {
+                p += 2;
+                while (isxdigit((unsigned char)*p)) p++;
+            } else {
+                while (isdigit((unsigned char)*p) || *p == '.') p++;
+
+                if ((*p == 'e' || *p == 'E') && (isdigit((unsigned char)p[1]) || ((p[1] == '+' || p[1] == '-') && isdigit((unsigned char)p[2])))) {
+                    p += 2;
+                    while (isdigit((unsigned char)*p)) p++;
+                }
+            }
+
+            *next++ = '?';
+            continue;
+        }
+
+        if (isIdentifier(*p)) {
+            while (isIdentifier(*p)) *next++ = *p++;
+            continue;
+        }
+
+        *next++ = *p++;
+    }
+
+    *next = '\0';
+}
+
+DbStats *createDbStats(double slowMs, FILE *slowLog) {
+    DbStats *stats = allocate(sizeof(DbStats));
+
+    stats->slowMs = slowMs;
+    stats->slowLog = slowLog;
+    pthread_mutex_init(&stats->lock, NULL);
+
+    return stats;
+}
+
+void dbStatsReset(DbStats *stats) {
+    pthread_mutex_lock(&stats->lock);
+
+    for (int i = 0; i < stats->entryCount; i++) {
+        free(stats->entries[i].sql);
+        free(stats->entries[i].histogram);
+    }
+    for (int i = 0; i < stats->textCount; i++) {
+        free(stats->texts[i].sql);
+    }
+
+    stats->entryCount = 0;
+    stats->textCount = 0;
+
+    pthread_mutex_unlock(&stats->lock);
+}
+
+void freeDbStats(DbStats *stats) {
+    if (!stats) return;
+
+    dbStatsReset(stats);
+
+    free(stats->entries);
+    free(stats->texts);
+
+    pthread_mutex_destroy(&stats->lock);
+    free(stats);
+}
+
+// with the lock held, the entry for a normalized statement
+static int findEntry(DbStats *stats, const char *normalized) {
+    unsigned int hash = hashString(normalized);
+
+    for (int i = 0; i < stats->entryCount; i++) {
+        if (stats->entries[i].hash == hash && strcmp(stats->entries[i].sql, normalized) == 0) return i;
+    }
+
+    // the last slot collects every statement past the limit
+    if (stats->entryCount == DB_STATS_MAX_STATEMENTS - 1) {
+        normalized = "(other)";
+        hash = hashString(normalized);
+    } else if (stats->entryCount == DB_STATS_MAX_STATEMENTS) {
+        return stats->entryCount - 1;
+    }
+
+    if (stats->entryCount == stats->entryCapacity) {
+        stats->entries = growArray(stats->entries, &stats->entryCapacity, sizeof(StatsEntry));
+    }
+
+    stats->entries[stats->entryCount] = (StatsEntry) {
+        .sql = copyString(normalized),
+        .hash = hash,
+        .histogram = allocate(sizeof(unsigned int) * HISTOGRAM_BUCKETS),
+    };
+
+    return stats->entryCount++;
+}
+
+// with the lock held, the entry a SQL text is counted under
+static int textEntry(DbStats *stats, const char *sql) {
+    unsigned int hash = hashString(sql);
+
+    for (int i = 0; i < stats->textCount; i++) {
+        if (stats->texts[i].hash == hash && strcmp(stats->texts[i].sql, sql) == 0) return stats->texts[i].entry;
+    }
+
+    size_t length = strlen(sql);
+    char inlineNormalized[512];
+    char *normalized = length < sizeof(inlineNormalized) ? inlineNormalized : allocate(length + 1);
+
+    dbNormalizeSql(sql, normalized);
+    int entry = findEntry(stats, normalized);
+
+    if (normalized != inlineNormalized) free(normalized);
+
+    if (stats->textCount < STATS_MAX_TEXTS) {
+        if (stats->textCount == stats->textCapacity) {
+            stats->texts = growArray(stats->texts, &stats->textCapacity, sizeof(StatsText));
+        }
+
+        stats->texts[stats->textCount++] = (StatsText) { copyString(sql), hash, entry };
+    }
+
+    return entry;
+}
+
+static int bucketOf(unsigned long long ns) {
+    if (ns < HISTOGRAM_SUB_BUCKETS) return (int)ns;
+
+    int exponent = 63 - __builtin_clzll(ns);
+    int sub = (int)(ns >> (exponent - 3)) & (HISTOGRAM_SUB_BUCKETS - 1);
+
+    int bucket = (exponent - 2) * HISTOGRAM_SUB_BUCKETS + sub;
+    return bucket < HISTOGRAM_BUCKETS ? bucket : HISTOGRAM_BUCKETS - 1;
+}
+
+// the largest value counted in a bucket
+static unsigned long long bucketLimit(int bucket) {
+    if (bucket < HISTOGRAM_SUB_BUCKETS) return bucket;
+
+    int exponent = bucket / HISTOGRAM_SUB_BUCKETS + 2;
+    unsigned long long sub = bucket % HISTOGRAM_SUB_BUCKETS;
+
+    return ((HISTOGRAM_SUB_BUCKETS + sub + 1) << (exponent - 3)) - 1;
+}
+
+static ActiveStatement *activeStatement(DbStatsLink *link, sqlite3_stmt *stmt, bool add) {
+    for (int i = 0; i < link->activeCount; i++) {
+        if (link->active[i].statement == stmt) return &link->active[i];
+    }
+
+    if (!add || link->activeCount == STATS_ACTIVE_STATEMENTS) return NULL;
+
+    link->active[link->activeCount] = (ActiveStatement) { stmt, 0, 0 };
+    return &link->active[link->activeCount++];
+}
+
+static void logSlow(DbStats *stats, sqlite3_stmt *stmt, double ms, unsigned long long rows) {
+    char *expanded = sqlite3_expanded_sql(stmt);
+    FILE *out = stats->slowLog ? stats->slowLog : stderr;
+
+    fprintf(out, "Slow query (%.1f ms, %llu rows): %s\n", ms, rows, expanded ? expanded : sqlite3_sql(stmt));
+    fflush(out);
+
+    sqlite3_free(expanded);
+}
+
+static int onTrace(unsigned int event, void *arg, void *statement, void *data) {
+    DbStatsLink *link = arg;
+    sqlite3_stmt *stmt = statement;
+
+    // the query plan checker's EXPLAIN statements are not the application's
+    if (sqlite3_stmt_isexplain(stmt)) return 0;
+
+    if (event == SQLITE_TRACE_STMT) {
+        // also reported for each statement of a trigger, as a comment, while the statement runs
+        const char *text = data;
+        if (text && text[0] == '-' && text[1] == '-') return 0;
+
+        ActiveStatement *active = activeStatement(link, stmt, true);
+        if (active) {
+            active->start = nowNs();
+            active->rows = 0;
+        }
+        return 0;
+    }
+
+    if (event == SQLITE_TRACE_ROW) {
+        ActiveStatement *active = activeStatement(link, stmt, false);
+        if (active) active->rows++;
+        return 0;
+    }
+
+    if (event != SQLITE_TRACE_PROFILE) return 0;
+
+    // SQLite's own time is in whole milliseconds, too coarse for most statements
+    unsigned long long ns = *(sqlite3_int64 *)data;
+    unsigned long long rows = 0;
+
+    ActiveStatement *active = activeStatement(link, stmt, false);
+    if (active) {
+        ns = nowNs() - active->start;
+        rows = active->rows;
+        *active = link->active[--link->activeCount];
+    }
+
+    const char *sql = sqlite3_sql(stmt);
+    if (!sql) return 0;
+
+    DbStats *stats = link->stats;
+    double ms = ns / 1e6;
+
+    pthread_mutex_lock(&stats->lock);
+
+    // looked up first, it may grow the entries
+    int index = textEntry(stats, sql);
+    StatsEntry *entry = &stats->entries[index];
+    entry->calls++;
+    entry->rows += rows;
+    entry->totalNs += ns;
+    if (ns > entry->maxNs) entry->maxNs = ns;
+    entry->histogram[bucketOf(ns)]++;
+
+    bool slow = stats->slowMs >= 0 && ms >= stats->slowMs;
+
+    pthread_mutex_unlock(&stats->lock);
+
+    // the statement has finished but is not reset yet, so its parameters are still bound
+    if (slow) logSlow(stats, stmt, ms, rows);
+
+    return 0;
+}
+
+void dbAttachStats(DbContext *db, DbStats *stats) {
+    dbDetachStats(db);
+    if (!stats) return;
+
+    DbStatsLink *link = allocate(sizeof(DbStatsLink));
+    link->stats = stats;
+
+    db->stats = link;
+    sqlite3_trace_v2((sqlite3 *)db->connection, SQLITE_TRACE_STMT | SQLITE_TRACE_ROW | SQLITE_TRACE_PROFILE, onTrace, link);
+}
+
+void dbDetachStats(DbContext *db) {
+    DbStatsLink *link = db->stats;
+    if (!link) return;
+
+    sqlite3_trace_v2((sqlite3 *)db->connection, 0, NULL, NULL);
+
+    free(link);
+    db->stats = NULL;
+}
+
+static double percentile(const StatsEntry *entry, double fraction) {
+    unsigned long long wanted = (unsigned long long)(entry->calls * fraction);
+    if (wanted >= entry->calls) wanted = entry->calls - 1;
+
+    unsigned long long seen = 0;
+
+    for (int i = 0; i < HISTOGRAM_BUCKETS; i++) {
+        seen += entry->histogram[i];
+        if (seen > wanted) {
+            unsigned long long limit = bucketLimit(i);
+            return (limit < entry->maxNs ? limit : entry->maxNs) / 1e6;
+        }
+    }
+
+    return entry->maxNs / 1e6;
+}
+
+static int byTotalTime(const void *a, const void *b) {
+    double left = ((const DbStatementStats *)a)->totalMs;
+    double right = ((const DbStatementStats *)b)->totalMs;
+
+    return (left < right) - (left > right);
+}
+
+int dbStatsStatements(DbStats *stats, DbStatementStats **statements) {
+    pthread_mutex_lock(&stats->lock);
+
+    size_t size = sizeof(DbStatementStats) * (stats->entryCount + 1);
+    for (int i = 0; i < stats->entryCount; i++) {
+        size += strlen(stats->entries[i].sql) + 1;
+    }
+
+    DbStatementStats *list = allocate(size);
+    char *strings = (char *)(list + stats->entryCount + 1);
+    int count = 0;
+
+    for (int i = 0; i < stats->entryCount; i++) {
+        const StatsEntry *entry = &stats->entries[i];
+        if (entry->calls == 0) continue;
+
+        size_t length = strlen(entry->sql) + 1;
+        memcpy(strings, entry->sql, length);
+
+        list[count++] = (DbStatementStats) {
+            .sql = strings,
+            .calls = entry->calls,
+            .rows = entry->rows,
+            .totalMs = entry->totalNs / 1e6,
+            .meanMs = entry->totalNs / 1e6 / entry->calls,
+            .maxMs = entry->maxNs / 1e6,
+            .p99Ms = percentile(entry, 0.99),
+        };
+
+        strings += length;
+    }
+
+    pthread_mutex_unlock(&stats->lock);
+
+    qsort(list, count, sizeof(DbStatementStats), byTotalTime);
+
+    *statements = list;
+    return count;
+}
+
+void dbStatsDump(DbStats *stats, FILE *out) {
+    DbStatementStats *statements;
+    int count = dbStatsStatements(stats, &statements);
+
+    fprintf(out, "%10s %12s %10s %10s %10s %10s  %s\n", "calls", "total ms", "mean ms", "p99 ms", "max ms", "rows", "statement");
+
+    for (int i = 0; i < count; i++) {
+        const DbStatementStats *s = &statements[i];
+        fprintf(out, "%10llu %12.3f %10.3f %10.3f %10.3f %10llu  %s\n", s->calls, s->totalMs, s->meanMs, s->p99Ms, s->maxMs, s->rows, s->sql);
+    }
+
+    free(statements);
+}
@@ -0,0 +1,306 @@
+#define SQL_NO_CALL_SITES
+
+#include <sqlite3.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "../include/sql_writer.h"
+
+// a write waiting in the queue. it lives on the stack of the thread that queued it, which
+// waits until the writer has set done
+typedef struct DbWrite {
+    const char      *query;
+    const DbParam   *params;
+    int              paramCount;
+
+    DbWriteFunction  function;
+    void            *userData;
+
+    // where dbWrite was called from, for the query plan checker
+    DbCallSite       site;
+
+    bool             done;
+    bool             ok;
+
+    struct DbWrite  *next;
+} DbWrite;
+
+struct DbWriter {
+    DbContext       *db;
+    pthread_t        thread;
+
+    pthread_mutex_t  lock;
+    pthread_cond_t   queued;
+    pthread_cond_t   committed;
+
+    DbWrite         *head;
+    DbWrite         *tail;
+    int              count;
+    bool             stopping;
+
+    // the size of the last batch, a window is only worth waiting when writes come in together
+    int              lastBatch;
+
+    DbWriterStats    stats;
+};
+
+static bool runWrite(DbContext *db, DbWrite *write) {
+    dbCallSite = write->site;
+
+    if (write->function) return write->function(db, write->userData);
+
+    return dbExec(db, write->query, write->params, write->paramCount);
+}
+
+// runs a batch in one transaction. a single write needs no savepoint, the transaction is its own
+static void runBatch(DbWriter *writer, DbWrite *batch, int count) {
+    DbContext *db = writer->db;
+    bool isolate = count > 1;
+
+    if (!dbExec(db, "begin immediate;", NULL, 0)) {
+        for (DbWrite *write = batch; write; write = write->next) write->ok = false;
+        return;
+    }
+
+    bool any = false;
+    bool aborted = false;
+
+    for (DbWrite *write = batch; write; write = write->next) {
+        if (isolate) dbExec(db, "savepoint dbWrite;", NULL, 0);
+
+        write->ok = runWrite(db, write);
+        any |= write->ok;
+
+        // INSERT OR ROLLBACK, SQLITE_FULL and I/O errors end the whole transaction, taking the
+        // writes before this one with it. the rest would each commit on their own, so they are
+        // not run
+        if (sqlite3_get_autocommit((sqlite3 *)db->connection)) {
+            aborted = true;
+            break;
+        }
+
+        if (isolate) {
+            if (!write->ok) dbExec(db, "rollback to dbWrite;", NULL, 0);
+            dbExec(db, "release dbWrite;", NULL, 0);
+        }
+    }
+
+    if (!aborted && any && dbExec(db, "commit;", NULL, 0)) return;
+
+    if (!aborted) dbExec(db, "rollback;", NULL, 0);
+    for (DbWrite *write = batch; write; write = write->next) write->ok = false;
+}
+
+static void *runWriter(void *arg) {
+    DbWriter *writer = arg;
+
+    pthread_mutex_lock(&writer->lock);
+
+    while (true) {
+        while (!writer->head && !writer->stopping) {
+            pthread_cond_wait(&writer->queued, &writer->lock);
+        }
+
+        // stopping, and everything queued has run
+        if (!writer->head) break;
+
+        // give writes that arrive at about the same time a moment to join the batch. a lone
+        // writer, such as a single request thread, does not wait for writes that will not come
+        bool contended = writer->count > 1 || writer->lastBatch > 1;
+
+        if (DB_WRITER_BATCH_WINDOW_US > 0 && contended && !writer->stopping) {
+            struct timespec deadline;
+            clock_gettime(CLOCK_REALTIME, &deadline);
+
+            deadline.tv_nsec += DB_WRITER_BATCH_WINDOW_US * 1000L;
+            deadline.tv_sec += deadline.tv_nsec / 1000000000L;
+            deadline.tv_nsec %= 1000000000L;
+
+            // the writers of the last batch are usually the ones coming back, so stop once they have
+            int target = writer->lastBatch > 1 ? writer->lastBatch : DB_WRITER_MAX_BATCH;
+
+            while (writer->count < target && !writer->stopping) {
+                if (pthread_cond_timedwait(&writer->queued, &writer->lock, &deadline) != 0) break;
+            }
+        }
+
+        DbWrite *batch = writer->head;
+        DbWrite *last = batch;
+        int count = 1;
+
+        while (last->next && count < DB_WRITER_MAX_BATCH) {
+            last = last->next;
+            count++;
+        }
+
+        writer->head = last->next;
+        if (!writer->head) writer->tail = NULL;
+        writer->count -= count;
+        last->next = NULL;
+
+        pthread_mutex_unlock(&writer->lock);
+        runBatch(writer, batch, count);
+        pthread_mutex_lock(&writer->lock);
+
+        writer->lastBatch = count;
+        writer->stats.batches++;
+        writer->stats.writes += count;
+
+        // the callers own the writes, so nothing is read from one after its done is set
+        for (DbWrite *write = batch, *next; write; write = next) {
+            next = write->next;
+
+            if (!write->ok) writer->stats.failed++;
+            write->done = true;
+        }
+
+        pthread_cond_broadcast(&writer->committed);
+    }
+
+    pthread_mutex_unlock(&writer->lock);
+    return NULL;
+}
+
+DbWriter *createDbWriter(const char *dbPath, DbPragmas pragmas) {
+    DbContext *db = createSqlLite3DbContext((char *)dbPath);
+    if (!db) return NULL;
+
+    dbApplyPragmas(db, pragmas);
+
+    DbWriter *writer = malloc(sizeof(DbWriter));
+    if (!writer) {
+        fprintf(stderr, "Fatal: out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+
+    *writer = (DbWriter) {
+        .db = db,
+        .head = NULL,
+        .tail = NULL,
+        .count = 0,
+        .stopping = false,
+        .lastBatch = 0,
+    };
+
+    pthread_mutex_init(&writer->lock, NULL);
+    pthread_cond_init(&writer->queued, NULL);
+    pthread_cond_init(&writer->committed, NULL);
+
+    if (pthread_create(&writer->thread, NULL, runWriter, writer) != 0) {
+        fprintf(stderr, "Failed to start the database writer thread\n");
+
+        pthread_mutex_destroy(&writer->lock);
+        pthread_cond_destroy(&writer->queued);
+        pthread_cond_destroy(&writer->committed);
+        dbClose(db);
+        free(writer);
+        return NULL;
+    }
+
+    return writer;
+}
+
+static bool queueWrite(DbWriter *writer, DbWrite *write) {
+    if (!writer) return false;
+
+    pthread_mutex_lock(&writer->lock);
+
+    if (writer->stopping) {
+        pthread_mutex_unlock(&writer->lock);
+        return false;
+    }
+
+    if (writer->tail) {
+        writer->tail->next = write;
+    } else {
+        writer->head = write;
+    }
+    writer->tail = write;
+    writer->count++;
+
+    pthread_cond_signal(&writer->queued);
+
+    while (!write->done) {
+        pthread_cond_wait(&writer->committed, &writer->lock);
+    }
+
+    pthread_mutex_unlock(&writer->lock);
+    return write->ok;
+}
+
+bool dbWrite(DbWriter *writer, const char *query, const DbParam *params, int paramCount) {
+    DbWrite write = {
+        .query = query,
+        .params = params,
+        .paramCount = paramCount,
+        .site = dbCallSite,
+    };
+
+    return queueWrite(writer, &write);
+}
+
+bool dbWriteWith(DbWriter *writer, DbWriteFunction function, void *userData) {
+    DbWrite write = {
+        .function = function,
+        .userData = userData,
+        .site = dbCallSite,
+    };
+
+    return queueWrite(writer, &write);
+}
+
+static bool attachQueryCache(DbContext *db, void *cache) {
+    dbAttachQueryCache(db, cache);
+    return true;
+}
+
+void dbWriterUseQueryCache(DbWriter *writer, DbQueryCache *cache) {
+    // the hook is set on the writer's own thread, between statements
+    dbWriteWith(writer, attachQueryCache, cache);
+}
+
+static bool attachStats(DbContext *db, void *stats) {
+    dbAttachStats(db, stats);
+    return true;
+}
+
+void dbWriterUseStats(DbWriter *writer, DbStats *stats) {
+    dbWriteWith(writer, attachStats, stats);
+}
+
+static bool attachPlanChecker(DbContext *db, void *checker) {
+    dbAttachPlanChecker(db, checker);
+    return true;
+}
+
+void dbWriterUsePlanChecker(DbWriter *writer, DbPlanChecker *checker) {
+    dbWriteWith(writer, attachPlanChecker, checker);
+}
+
+DbWriterStats dbWriterStats(DbWriter *writer) {
+    pthread_mutex_lock(&writer->lock);
+    DbWriterStats stats = writer->stats;
+    pthread_mutex_unlock(&writer->lock);
+
+    return stats;
+}
+
+void freeDbWriter(DbWriter *writer) {
+    if (!writer) return;
+
+    pthread_mutex_lock(&writer->lock);
+    writer->stopping = true;
+    pthread_cond_signal(&writer->queued);
+    pthread_mutex_unlock(&writer->lock);
+
+    pthread_join(writer->thread, NULL);
+
+    pthread_mutex_destroy(&writer->lock);
+    pthread_cond_destroy(&writer->queued);
+    pthread_cond_destroy(&writer->committed);
+
+    dbClose(writer->db);
+    free(writer);
+}
@@ -1,40 +1,131 @@
+#include <limits.h>
+
 #include "../include/middleware.h"
 #include "../include/api_response.h"
 #include "../include/validator.h"
+#include "../include/json_tape.h"
+#include "../include/json_shape.h"
+#include "../include/json_number.h"
+#include "../include/json_string.h"
+#include "../include/utils.h"
+
+typedef enum {
+    SCHEMA_ANY,
+    SCHEMA_STRING,
+    SCHEMA_INTEGER,
+    SCHEMA_NUMBER,
+    SCHEMA_BOOL,
+    SCHEMA_ENUM,
+    SCHEMA_OBJECT,
+    SCHEMA_ARRAY,
+} SchemaKind;
+
+struct JsonSchemaNode {
+    char            *key;
+    size_t           keyLength;
+
+    SchemaKind       kind;
+    const char      *message;
+
+    long long        min;
+    long long        max;
+    double           minNumber;
+    double           maxNumber;
+    char           **values;
+    int              valueCount;
+
+    bool             required;
+    const char      *requiredMessage;
+
+    // generation of the last validation that saw this field
+    unsigned int     seen;
+
+    JsonSchemaNode **children;
+    int              childCount;
+    int              childCapacity;
+
+    // children by key hash, a power of two in size and at most half full
+    JsonSchemaNode **index;
+    unsigned int     indexCapacity;
+};
+
+static const char *MALFORMED_BODY = "Request body is missing or malformed.";
+static const char *BODY_TOO_LARGE = "Request body is too large.";
 
 JsonValidator createValidator() {
     return (JsonValidator) {
         .rules = malloc(sizeof(JsonValidationRule)),
         .ruleCount = 0,
-        .ruleCapacity = 1
+        .ruleCapacity = 1,
+        .maxLength = 0,
+        .schema = NULL,
+        .generation = 0,
+        .error = NULL,
     };
 }
 
+static void freeSchema(JsonSchemaNode *node) {
+    if (!node) return;
+
+    for (int i = 0; i < node->childCount; i++) {
+        freeSchema(node->children[i]);
+    }
+
+    free(node->key);
+    free(node->children);
+    free(node->index);
+    free(node);
+}
+
 void freeValidator(JsonValidator *validator) {
+    for (int i = 0; i < validator->ruleCount; i++) {
+        JsonValidationRule *rule = &validator->rules[i];
+
+        for (int j = 0; j < rule->valueCount; j++) {
+            free(rule->values[j]);
+        }
+
+        free(rule->values);
+        free(rule->field);
+        free(rule->message);
+    }
+
     free(validator->rules);
+    freeSchema(validator->schema);
+
+    validator->rules = NULL;
+    validator->ruleCount = 0;
     validator->ruleCapacity = 0;
+    validator->schema = NULL;
 }
 
-void addRule(JsonValidator *v, const char *field, const char *message) {
+static JsonValidationRule *appendRule(JsonValidator *v, const char *field, const char *message, JsonRuleType type) {
     if (v->ruleCount >= v->ruleCapacity) {
-        v->ruleCapacity *= 2;
+        v->ruleCapacity = v->ruleCapacity ? v->ruleCapacity * 2 : 4;
         v->rules = realloc(v->rules, sizeof(JsonValidationRule) * v->ruleCapacity);
+
+        if (!v->rules) {
+            fprintf(stderr, "Fatal: out of memory\n");
+            exit(EXIT_FAILURE);
+        }
     }
 
-    v->rules[v->ruleCount].field = strdup(field);
-    v->rules[v->ruleCount].message = strdup(message);
+    JsonValidationRule *rule = &v->rules[v->ruleCount++];
+    *rule = (JsonValidationRule) {
+        .field = copyString(field),
+        .message = copyString(message),
+        .type = type,
+    };
 
-    if (!v->rules[v->ruleCount].field) {
-        fprintf(stderr, "Fatal: out of memory\n");
-        exit(EXIT_FAILURE);
-    }
+    // the schema no longer matches the rules
+    freeSchema(v->schema);
+    v->schema = NULL;
 
-    if (!v->rules[v->ruleCount].message) {
-        fprintf(stderr, "Fatal: out of memory\n");
-        exit(EXIT_FAILURE);
-    }
+    return rule;
+}
 
-    v->ruleCount++;
+void addRule(JsonValidator *v, const char *field, const char *message) {
+    appendRule(v, field, message, JSON_RULE_REQUIRED);
 }
 
 bool validateRequired(JsonBuilder *builder, char *field) {
@@ -47,22 +138,584 @@ void required(JsonValidator *v, const char *field) {
     addRule(v, field, message);
 }
 
-bool validate(JsonValidator *v, JsonBuilder *body) {
-    if (!body) {
-        v->error = "Request body is missing or malformed.";
-        return false;
+void isString(JsonValidator *v, const char *field, size_t minLength, size_t maxLength) {
+    char message[256];
+    snprintf(message, sizeof(message), "The field '%s' must be a string of %zu to %zu characters.", field, minLength, maxLength);
+
+    JsonValidationRule *rule = appendRule(v, field, message, JSON_RULE_STRING);
+    rule->min = minLength > LLONG_MAX ? LLONG_MAX : (long long)minLength;
+    rule->max = maxLength > LLONG_MAX ? LLONG_MAX : (long long)maxLength;
+}
+
+void isInteger(JsonValidator *v, const char *field, long long min, long long max) {
+    char message[256];
+    snprintf(message, sizeof(message), "The field '%s' must be an integer from %lld to %lld.", field, min, max);
+
+    JsonValidationRule *rule = appendRule(v, field, message, JSON_RULE_INTEGER);
+    rule->min = min;
+    rule->max = max;
+}
+
+void isNumber(JsonValidator *v, const char *field, double min, double max) {
+    char message[256];
+    snprintf(message, sizeof(message), "The field '%s' must be a number from %g to %g.", field, min, max);
+
+    JsonValidationRule *rule = appendRule(v, field, message, JSON_RULE_NUMBER);
+    rule->minNumber = min;
+    rule->maxNumber = max;
+}
+
+void isBool(JsonValidator *v, const char *field) {
+    char message[256];
+    snprintf(message, sizeof(message), "The field '%s' must be true or false.", field);
+    appendRule(v, field, message, JSON_RULE_BOOL);
+}
+
+void isOneOf(JsonValidator *v, const char *field, const char **values, int count) {
+    char message[256];
+    int length = snprintf(message, sizeof(message), "The field '%s' must be one of:", field);
+
+    for (int i = 0; i < count && length > 0 && (size_t)length < sizeof(message); i++) {
+        length += snprintf(message + length, sizeof(message) - length, "%s '%s'", i ? "," : "", values[i]);
+    }
+
+    if (length > 0 && (size_t)length < sizeof(message) - 1) {
+        message[length] = '.';
+        message[length + 1] = '\0';
     }
 
+    JsonValidationRule *rule = appendRule(v, field, message, JSON_RULE_ENUM);
+
+    rule->values = malloc(sizeof(char *) * (count > 0 ? count : 1));
+    if (!rule->values) {
+        fprintf(stderr, "Fatal: out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+
+    for (int i = 0; i < count; i++) {
+        rule->values[i] = copyString(values[i]);
+    }
+    rule->valueCount = count;
+}
+
+void isObject(JsonValidator *v, const char *field) {
+    char message[256];
+    snprintf(message, sizeof(message), "The field '%s' must be an object.", field);
+    appendRule(v, field, message, JSON_RULE_OBJECT);
+}
+
+void isArray(JsonValidator *v, const char *field, size_t maxItems) {
+    char message[256];
+    snprintf(message, sizeof(message), "The field '%s' must be an array of at most %zu items.", field, maxItems);
+
+    JsonValidationRule *rule = appendRule(v, field, message, JSON_RULE_ARRAY);
+    rule->max = maxItems > LLONG_MAX ? LLONG_MAX : (long long)maxItems;
+}
+
+void maxBodyLength(JsonValidator *v, size_t length) {
+    v->maxLength = length;
+}
+
+static JsonSchemaNode *schemaNode(const char *key, size_t keyLength) {
+    JsonSchemaNode *node = calloc(1, sizeof(JsonSchemaNode));
+    if (!node) {
+        fprintf(stderr, "Fatal: out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+
+    node->key = strndup(key, keyLength);
+    node->keyLength = keyLength;
+    node->kind = SCHEMA_ANY;
+
+    if (!node->key) {
+        fprintf(stderr, "Fatal: out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+
+    return node;
+}
+
+static JsonSchemaNode *findChild(JsonSchemaNode *node, const char *key, size_t keyLength) {
+    if (node->index) {
+        unsigned int mask = node->indexCapacity - 1;
+
+        for (unsigned int slot = jsonHashKey(key, keyLength) & mask; node->index[slot]; slot = (slot + 1) & mask) {
+            JsonSchemaNode *child = node->index[slot];
+            if (child->keyLength == keyLength && memcmp(child->key, key, keyLength) == 0) return child;
+        }
+
+        return NULL;
+    }
+
+    for (int i = 0; i < node->childCount; i++) {
+        JsonSchemaNode *child = node->children[i];
+        if (child->keyLength == keyLength && memcmp(child->key, key, keyLength) == 0) return child;
+    }
+
+    return NULL;
+}
+
+static JsonSchemaNode *addChild(JsonSchemaNode *node, const char *key, size_t keyLength) {
+    JsonSchemaNode *child = findChild(node, key, keyLength);
+    if (child) return child;
+
+    if (node->childCount >= node->childCapacity) {
+        node->childCapacity = node->childCapacity ? node->childCapacity * 2 : 4;
+        node->children = realloc(node->children, sizeof(JsonSchemaNode *) * node->childCapacity);
+
+        if (!node->children) {
+            fprintf(stderr, "Fatal: out of memory\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    child = schemaNode(key, keyLength);
+    node->children[node->childCount++] = child;
+
+    return child;
+}
+
+static void buildIndexes(JsonSchemaNode *node) {
+    if (node->childCount == 0) return;
+
+    node->indexCapacity = 4;
+    while (node->indexCapacity < (unsigned int)node->childCount * 2) {
+        node->indexCapacity *= 2;
+    }
+
+    node->index = calloc(node->indexCapacity, sizeof(JsonSchemaNode *));
+    if (!node->index) {
+        fprintf(stderr, "Fatal: out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+
+    unsigned int mask = node->indexCapacity - 1;
+
+    for (int i = 0; i < node->childCount; i++) {
+        JsonSchemaNode *child = node->children[i];
+
+        unsigned int slot = jsonHashKey(child->key, child->keyLength) & mask;
+        while (node->index[slot]) slot = (slot + 1) & mask;
+        node->index[slot] = child;
+
+        buildIndexes(child);
+    }
+}
+
+static void applyRule(JsonSchemaNode *node, const JsonValidationRule *rule) {
+    static const SchemaKind kinds[] = {
+        [JSON_RULE_STRING]  = SCHEMA_STRING,
+        [JSON_RULE_INTEGER] = SCHEMA_INTEGER,
+        [JSON_RULE_NUMBER]  = SCHEMA_NUMBER,
+        [JSON_RULE_BOOL]    = SCHEMA_BOOL,
+        [JSON_RULE_ENUM]    = SCHEMA_ENUM,
+        [JSON_RULE_OBJECT]  = SCHEMA_OBJECT,
+        [JSON_RULE_ARRAY]   = SCHEMA_ARRAY,
+    };
+
+    if (rule->type == JSON_RULE_REQUIRED) {
+        node->required = true;
+        node->requiredMessage = rule->message;
+        return;
+    }
+
+    // a later type rule on the same field replaces an earlier one
+    node->kind = kinds[rule->type];
+    node->message = rule->message;
+    node->min = rule->min;
+    node->max = rule->max;
+    node->minNumber = rule->minNumber;
+    node->maxNumber = rule->maxNumber;
+    node->values = rule->values;
+    node->valueCount = rule->valueCount;
+}
+
+void compileValidator(JsonValidator *v) {
+    freeSchema(v->schema);
+
+    JsonSchemaNode *root = schemaNode("", 0);
+    root->kind = SCHEMA_OBJECT;
+
     for (int i = 0; i < v->ruleCount; i++) {
-        JsonValidationRule rule = v->rules[i];
+        const JsonValidationRule *rule = &v->rules[i];
+
+        JsonSchemaNode *node = root;
+        const char *segment = rule->field;
+
+        while (true) {
+            const char *dot = strchr(segment, '.');
+            size_t length = dot ? (size_t)(dot - segment) : strlen(segment);
+
+            node = addChild(node, segment, length);
 
-        if (!validateRequired(body, rule.field)) {
-            v->error = rule.message;
-            return false;
+            if (!dot) break;
+
+            // the fields along the path have to be objects, and are required if the field is
+            if (node->kind == SCHEMA_ANY) {
+                node->kind = SCHEMA_OBJECT;
+                node->message = rule->message;
+            }
+            if (rule->type == JSON_RULE_REQUIRED && !node->required) {
+                node->required = true;
+                node->requiredMessage = rule->message;
+            }
+
+            segment = dot + 1;
+        }
+
+        applyRule(node, rule);
+    }
+
+    buildIndexes(root);
+    v->schema = root;
+}
+
+typedef struct {
+    const char   *json;
+    size_t        length;
+    size_t        pos;
+
+    unsigned int  generation;
+    int           depth;
+
+    const char   *error;
+} SchemaScan;
+
+static bool fail(SchemaScan *scan, const char *error) {
+    scan->error = error;
+    return false;
+}
+
+static inline void skipWhitespace(SchemaScan *scan) {
+    while (scan->pos < scan->length) {
+        char c = scan->json[scan->pos];
+        if (c != ' ' && c != '\n' && c != '\r' && c != '\t') break;
+        scan->pos++;
+    }
+}
+
+static bool expectLiteral(SchemaScan *scan, const char *literal, size_t length) {
+    if (scan->length - scan->pos < length || memcmp(scan->json + scan->pos, literal, length) != 0) {
+        return fail(scan, MALFORMED_BODY);
+    }
+
+    scan->pos += length;
+    return true;
+}
+
+// pos is on the opening quote, moves past the closing one. the body is checked for valid escapes,
+// control characters and UTF-8, and its length is counted in characters
+static bool scanString(SchemaScan *scan, const char **body, size_t *bodyLength, size_t *characters) {
+    const char *json = scan->json;
+    size_t start = ++scan->pos;
+    size_t escapedBytes = 0;
+    size_t escapes = 0;
+
+    while (true) {
+        size_t p = scan->pos + jsonFindEscape(json + scan->pos, scan->length - scan->pos);
+        if (p >= scan->length || (unsigned char)json[p] < 0x20) return fail(scan, MALFORMED_BODY);
+
+        if (json[p] == '"') {
+            scan->pos = p + 1;
+            break;
+        }
+
+        // a backslash
+        if (p + 1 >= scan->length) return fail(scan, MALFORMED_BODY);
+
+        switch (json[p + 1]) {
+            case '"': case '\\': case '/': case 'b': case 'f': case 'n': case 'r': case 't':
+                escapedBytes += 2;
+                escapes++;
+                scan->pos = p + 2;
+                break;
+            case 'u': {
+                if (p + 6 > scan->length) return fail(scan, MALFORMED_BODY);
+
+                unsigned int code = 0;
+                for (int h = 2; h < 6; h++) {
+                    char c = json[p + h];
+                    int digit = c >= '0' && c <= '9' ? c - '0'
+                              : c >= 'a' && c <= 'f' ? c - 'a' + 10
+                              : c >= 'A' && c <= 'F' ? c - 'A' + 10 : -1;
+                    if (digit < 0) return fail(scan, MALFORMED_BODY);
+                    code = code * 16 + digit;
+                }
+
+                // the high half of a surrogate pair is counted with the low half
+                escapedBytes += 6;
+                if (code < 0xD800 || code > 0xDBFF) escapes++;
+                scan->pos = p + 6;
+                break;
+            }
+            default:
+                return fail(scan, MALFORMED_BODY);
+        }
+    }
+
+    *body = json + start;
+    *bodyLength = scan->pos - 1 - start;
+
+    if (!jsonValidUtf8(*body, *bodyLength)) return fail(scan, MALFORMED_BODY);
+
+    // every character starts with one byte that is not a continuation byte. escape sequences are
+    // ASCII, so their bytes are counted there and replaced by the characters they stand for
+    size_t count = 0;
+    for (size_t i = 0; i < *bodyLength; i++) {
+        count += ((unsigned char)(*body)[i] & 0xC0) != 0x80;
+    }
+
+    *characters = count - escapedBytes + escapes;
+
+    return true;
+}
+
+static bool scanValue(SchemaScan *scan, JsonSchemaNode *node);
+
+// unescapes raw into buffer, or into a heap copy when it is longer than size. NULL for a bad escape,
+// anything else that is not buffer is freed by the caller
+static char *unescapeText(char *buffer, size_t size, const char *raw, size_t length, size_t *unescaped) {
+    char *out = length <= size ? buffer : allocate(length);
+
+    if (!jsonUnescape(out, raw, length, unescaped)) {
+        if (out != buffer) free(out);
+        return NULL;
+    }
+
+    return out;
+}
+
+static bool scanObject(SchemaScan *scan, JsonSchemaNode *node) {
+    scan->pos++;
+    skipWhitespace(scan);
+
+    if (scan->pos < scan->length && scan->json[scan->pos] == '}') {
+        scan->pos++;
+    } else {
+        while (true) {
+            if (scan->pos >= scan->length || scan->json[scan->pos] != '"') return fail(scan, MALFORMED_BODY);
+
+            const char *key;
+            size_t keyLength, characters;
+            if (!scanString(scan, &key, &keyLength, &characters)) return false;
+
+            JsonSchemaNode *child = NULL;
+
+            if (node && node->childCount > 0) {
+                char buffer[256];
+
+                if (memchr(key, '\\', keyLength)) {
+                    size_t unescaped;
+                    char *text = unescapeText(buffer, sizeof(buffer), key, keyLength, &unescaped);
+
+                    if (text) child = findChild(node, text, unescaped);
+                    if (text != buffer) free(text);
+                } else {
+                    child = findChild(node, key, keyLength);
+                }
+            }
+
+            skipWhitespace(scan);
+            if (scan->pos >= scan->length || scan->json[scan->pos] != ':') return fail(scan, MALFORMED_BODY);
+            scan->pos++;
+            skipWhitespace(scan);
+
+            if (child) child->seen = scan->generation;
+            if (!scanValue(scan, child)) return false;
+
+            skipWhitespace(scan);
+            if (scan->pos >= scan->length) return fail(scan, MALFORMED_BODY);
+
+            char c = scan->json[scan->pos++];
+            if (c == '}') break;
+            if (c != ',') return fail(scan, MALFORMED_BODY);
+
+            skipWhitespace(scan);
+        }
+    }
+
+    if (!node) return true;
+
+    for (int i = 0; i < node->childCount; i++) {
+        JsonSchemaNode *child = node->children[i];
+        if (child->required && child->seen != scan->generation) return fail(scan, child->requiredMessage);
+    }
+
+    return true;
+}
+
+static bool scanArray(SchemaScan *scan, JsonSchemaNode *node) {
+    scan->pos++;
+    skipWhitespace(scan);
+
+    long long count = 0;
+
+    if (scan->pos < scan->length && scan->json[scan->pos] == ']') {
+        scan->pos++;
+        return true;
+    }
+
+    while (true) {
+        // oversized arrays are rejected as soon as they pass the limit
+        if (node && node->kind == SCHEMA_ARRAY && ++count > node->max) return fail(scan, node->message);
+
+        if (!scanValue(scan, NULL)) return false;
+
+        skipWhitespace(scan);
+        if (scan->pos >= scan->length) return fail(scan, MALFORMED_BODY);
+
+        char c = scan->json[scan->pos++];
+        if (c == ']') return true;
+        if (c != ',') return fail(scan, MALFORMED_BODY);
+
+        skipWhitespace(scan);
+    }
+}
+
+static bool stringAllowed(const JsonSchemaNode *node, const char *body, size_t length) {
+    char buffer[256];
+    char *text = NULL;
+
+    if (memchr(body, '\\', length)) {
+        text = unescapeText(buffer, sizeof(buffer), body, length, &length);
+        if (!text) return false;
+
+        body = text;
+    }
+
+    bool allowed = false;
+
+    for (int i = 0; i < node->valueCount && !allowed; i++) {
+        allowed = strlen(node->values[i]) == length && memcmp(node->values[i], body, length) == 0;
+    }
+
+    if (text && text != buffer) free(text);
+    return allowed;
+}
+
+// node is the schema for the value at pos, NULL if nothing is known about it
+static bool scanValue(SchemaScan *scan, JsonSchemaNode *node) {
+    if (scan->pos >= scan->length) return fail(scan, MALFORMED_BODY);
+
+    SchemaKind kind = node ? node->kind : SCHEMA_ANY;
+    char c = scan->json[scan->pos];
+
+    switch (c) {
+        case '{':
+        case '[': {
+            if ((c == '{' && kind != SCHEMA_ANY && kind != SCHEMA_OBJECT) ||
+                (c == '[' && kind != SCHEMA_ANY && kind != SCHEMA_ARRAY)) {
+                return fail(scan, node->message);
+            }
+
+            if (++scan->depth > JSON_MAX_DEPTH) return fail(scan, MALFORMED_BODY);
+
+            bool valid = c == '{' ? scanObject(scan, node) : scanArray(scan, node);
+            scan->depth--;
+
+            return valid;
         }
+        case '"': {
+            const char *body;
+            size_t length, characters;
+            if (!scanString(scan, &body, &length, &characters)) return false;
+
+            if (kind == SCHEMA_STRING) {
+                if ((long long)characters < node->min || (long long)characters > node->max) return fail(scan, node->message);
+                return true;
+            }
+            if (kind == SCHEMA_ENUM) {
+                if (!stringAllowed(node, body, length)) return fail(scan, node->message);
+                return true;
+            }
+
+            return kind == SCHEMA_ANY || fail(scan, node->message);
+        }
+        case 't':
+        case 'f':
+            if (!(c == 't' ? expectLiteral(scan, "true", 4) : expectLiteral(scan, "false", 5))) return false;
+            return kind == SCHEMA_ANY || kind == SCHEMA_BOOL || fail(scan, node->message);
+        case 'n':
+            if (!expectLiteral(scan, "null", 4)) return false;
+            return kind == SCHEMA_ANY || fail(scan, node->message);
+        default: {
+            JsonNumber number;
+            size_t used = jsonParseNumber(scan->json + scan->pos, scan->length - scan->pos, &number);
+            if (!used) return fail(scan, MALFORMED_BODY);
+
+            scan->pos += used;
+
+            if (kind == SCHEMA_INTEGER) {
+                if (!number.isInteger || number.integer < node->min || number.integer > node->max) return fail(scan, node->message);
+                return true;
+            }
+            if (kind == SCHEMA_NUMBER) {
+                double value = number.isInteger ? (double)number.integer : number.number;
+                if (!(value >= node->minNumber && value <= node->maxNumber)) return fail(scan, node->message);
+                return true;
+            }
+
+            return kind == SCHEMA_ANY || fail(scan, node->message);
+        }
+    }
+}
+
+bool validateJson(JsonValidator *v, const char *json, size_t length) {
+    v->error = NULL;
+
+    if (!json) {
+        v->error = (char *)MALFORMED_BODY;
+        return false;
+    }
+
+    if (v->maxLength && length > v->maxLength) {
+        v->error = (char *)BODY_TOO_LARGE;
+        return false;
+    }
+
+    if (!v->schema) compileValidator(v);
+
+    SchemaScan scan = {
+        .json = json,
+        .length = length,
+        .pos = 0,
+        .generation = ++v->generation,
+        .depth = 0,
+        .error = NULL,
+    };
+
+    skipWhitespace(&scan);
+
+    // the body has to be an object
+    bool valid = scan.pos < length && json[scan.pos] == '{' && scanValue(&scan, v->schema);
+
+    if (valid) {
+        skipWhitespace(&scan);
+        valid = scan.pos == length;
     }
 
-    freeValidator(v);
+    if (!valid) {
+        v->error = (char *)(scan.error ? scan.error : MALFORMED_BODY);
+        return false;
+    }
 
     return true;
+}
+
+bool validate(JsonValidator *v, JsonBuilder *body) {
+    if (!body || body->isInvalid) {
+        v->error = (char *)MALFORMED_BODY;
+        return false;
+    }
+
+    // an unparsed body is checked straight from its text and left unparsed
+    if (body->isPending) return validateJson(v, body->source, body->sourceLength);
+
+    // once parsed, the strings in the document's copy of the text are unescaped in place,
+    // so the body is written back out and checked from that
+    char *json = jsonStringify(body);
+    bool valid = validateJson(v, json, json ? strlen(json) : 0);
+    free(json);
+
+    return valid;
 }
\ No newline at end of file
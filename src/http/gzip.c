@@ -0,0 +1,116 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <zlib.h>
+
+#include "../include/gzip.h"
+
+#define INFLATE_CHUNK_SIZE (16 * 1024)
+
+// one inflate state per worker thread, reset between requests instead of re-allocating the window
+static _Thread_local z_stream inflater;
+static _Thread_local bool inflaterReady = false;
+
+static bool acquireInflater() {
+    if (inflaterReady) {
+        return inflateReset(&inflater) == Z_OK;
+    }
+
+    inflater = (z_stream){0};
+
+    // 32 + MAX_WBITS auto-detects a gzip or zlib header
+    if (inflateInit2(&inflater, 32 + MAX_WBITS) != Z_OK) {
+        return false;
+    }
+
+    inflaterReady = true;
+    return true;
+}
+
+void freeGzipInflater(void) {
+    if (!inflaterReady) return;
+
+    inflateEnd(&inflater);
+    inflaterReady = false;
+}
+
+static bool exceedsLimits(size_t produced, size_t consumed, size_t maxLength) {
+    if (produced > maxLength) return true;
+    if (produced <= MIN_INFLATE_RATIO_SIZE) return false;
+
+    return consumed == 0 || produced / consumed > MAX_INFLATE_RATIO;
+}
+
+GzipStatus gzipInflate(const char *data, size_t length, size_t maxLength, char **out, size_t *outLength) {
+    *out = NULL;
+    *outLength = 0;
+
+    if (!data || length == 0) return GZIP_INVALID;
+    if (!acquireInflater()) return GZIP_INVALID;
+
+    size_t capacity = length * 4 < INFLATE_CHUNK_SIZE ? INFLATE_CHUNK_SIZE : length * 4;
+    if (capacity > maxLength + 1) capacity = maxLength + 1;
+
+    char *buffer = malloc(capacity);
+    if (!buffer) {
+        fprintf(stderr, "Fatal: out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+
+    inflater.next_in = (Bytef *)data;
+    inflater.avail_in = length;
+
+    size_t produced = 0;
+    int rc = Z_OK;
+
+    while (rc != Z_STREAM_END) {
+        // always keep one byte spare for the null terminator
+        if (capacity - produced < 2) {
+            if (capacity > maxLength) {
+                free(buffer);
+                return GZIP_TOO_LARGE;
+            }
+
+            capacity *= 2;
+            if (capacity > maxLength + 1) capacity = maxLength + 1;
+
+            buffer = realloc(buffer, capacity);
+            if (!buffer) {
+                fprintf(stderr, "Fatal: out of memory\n");
+                exit(EXIT_FAILURE);
+            }
+        }
+
+        size_t window = capacity - produced - 1;
+        if (window > INFLATE_CHUNK_SIZE) window = INFLATE_CHUNK_SIZE;
+
+        inflater.next_out = (Bytef *)(buffer + produced);
+        inflater.avail_out = window;
+
+        rc = inflate(&inflater, Z_NO_FLUSH);
+        if (rc != Z_OK && rc != Z_STREAM_END) {
+            free(buffer);
+            return GZIP_INVALID;
+        }
+
+        produced += window - inflater.avail_out;
+
+        if (exceedsLimits(produced, length - inflater.avail_in, maxLength)) {
+            free(buffer);
+            return GZIP_TOO_LARGE;
+        }
+
+        // no progress with input left means the stream is truncated
+        if (rc == Z_OK && inflater.avail_in == 0 && inflater.avail_out != 0) {
+            free(buffer);
+            return GZIP_INVALID;
+        }
+    }
+
+    buffer[produced] = '\0';
+
+    *out = buffer;
+    *outLength = produced;
+
+    return GZIP_OK;
+}
@@ -5,8 +5,6 @@
 
 #include "../include/http.h"
 
-#define MAX_BODY_SIZE (10 * 1024 * 1024) // 10 MiB
-
 static HttpMethod toHttpMethod(char *s) {
     if (strcmp(s, "GET") == 0) {
         return HTTP_GET;
@@ -358,10 +356,15 @@ void printHeaders(HttpParser *parser) {
 }
 
 HttpParser parseRequest(char *request) {
+    return parseRequestBuffer(request, strlen(request));
+}
+
+// request bodies may be binary (e.g. gzip), so the length is taken from the caller instead of strlen
+HttpParser parseRequestBuffer(const char *request, size_t length) {
     HttpParser parser = {
         .isValid = true,
-        .requestBuffer = strdup(request),
-        .requestLength = strlen(request),
+        .requestBuffer = malloc(length + 1),
+        .requestLength = length,
         .position = 0,
     };
 
@@ -370,6 +373,9 @@ HttpParser parseRequest(char *request) {
         exit(EXIT_FAILURE);
     }
 
+    memcpy(parser.requestBuffer, request, length);
+    parser.requestBuffer[length] = '\0';
+
     char method[16];
     int methodIndex = 0;
     while (!isEnd(parser) && currentChar(&parser) != ' ' && methodIndex < (int)sizeof(method) - 1) {
@@ -464,6 +470,16 @@ HttpParser parseRequest(char *request) {
     return parser;
 }
 
+char *getHeader(HttpRequest *request, const char *name) {
+    for (size_t i = 0; i < request->headerCount; i++) {
+        if (strcasecmp(request->headers[i].name, name) == 0) {
+            return request->headers[i].value;
+        }
+    }
+
+    return NULL;
+}
+
 void freeParser(HttpParser *parser) {
     if (!parser) return;
 
@@ -0,0 +1,79 @@
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+
+#include "../include/response_stream.h"
+
+ResponseStream responseStream(int socket) {
+    return (ResponseStream) {
+        .socket = socket,
+        .started = false,
+        .finished = false,
+        .failed = false,
+    };
+}
+
+static bool writeAll(ResponseStream *stream, const char *data, size_t length) {
+    if (stream->failed) return false;
+
+    while (length > 0) {
+        ssize_t written = write(stream->socket, data, length);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+
+            stream->failed = true;
+            return false;
+        }
+
+        data += written;
+        length -= written;
+    }
+
+    return true;
+}
+
+bool startChunkedResponse(ResponseStream *stream, HttpStatusCode status, const char *contentType) {
+    if (stream->started) return !stream->failed;
+    stream->started = true;
+
+    char header[512];
+    int length = snprintf(header, sizeof(header),
+            "HTTP/1.1 %d %s\r\n"
+            "Content-Type: %s\r\n"
+            "Transfer-Encoding: chunked\r\n"
+            "Connection: close\r\n"
+            "\r\n",
+            status, httpStatusCodeToStr(status), contentType
+    );
+
+    return writeAll(stream, header, length);
+}
+
+bool writeChunk(ResponseStream *stream, const char *data, size_t length) {
+    // a zero length chunk would terminate the body
+    if (length == 0) return !stream->failed;
+
+    char size[32];
+    int sizeLength = snprintf(size, sizeof(size), "%zx\r\n", length);
+
+    return writeAll(stream, size, sizeLength)
+        && writeAll(stream, data, length)
+        && writeAll(stream, "\r\n", 2);
+}
+
+bool endChunkedResponse(ResponseStream *stream) {
+    if (stream->finished) return !stream->failed;
+    stream->finished = true;
+
+    return writeAll(stream, "0\r\n\r\n", 5);
+}
+
+HttpResponse streamedResponse(ResponseStream *stream) {
+    return (HttpResponse) {
+        .content = "",
+        .status = HTTP_OK,
+        .contentType = NULL,
+        .streamed = stream != NULL,
+    };
+}
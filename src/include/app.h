@@ -4,6 +4,9 @@
 #include "server.h"
 #include "cors.h"
 #include "auth.h"
+#include "sql_writer.h"
+#include "sql_async.h"
+#include "sql_shard.h"
 
 struct App {
     int                port;
@@ -15,7 +18,13 @@ struct App {
     bool               useLavender;     
     MiddlewareHandler  middleware;
     CorsConfig          corsPolicy;
-    DbContext         *dbContext;
+    DbPool            *dbPool;
+    DbWriter          *dbWriter;
+    DbQueryCache      *dbQueryCache;
+    DbAsyncPool       *dbAsync;
+    DbStats           *dbStats;
+    DbPlanChecker     *dbPlanChecker;
+    DbShards          *dbShards;
     BasicAuthenticator auth;
 };
 
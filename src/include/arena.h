@@ -0,0 +1,36 @@
+#ifndef arena_h
+#define arena_h
+
+#include <stddef.h>
+
+/*
+** Bump allocator. Allocations are never freed individually, everything
+** is released at once with arenaReset or freeArena.
+*/
+
+#define ARENA_DEFAULT_BLOCK_SIZE (16 * 1024)
+
+typedef struct ArenaBlock ArenaBlock;
+typedef struct ArenaCleanup ArenaCleanup;
+
+typedef struct {
+    ArenaBlock   *head;
+    size_t        blockSize;
+
+    // run most recent first by arenaReset and freeArena
+    ArenaCleanup *cleanups;
+} Arena;
+
+Arena arena(size_t blockSize);
+void freeArena(Arena *arena);
+
+// keeps the first block for reuse and frees the rest
+void arenaReset(Arena *arena);
+
+void *arenaAlloc(Arena *arena, size_t size);
+char *arenaStrndup(Arena *arena, const char *str, size_t length);
+
+// calls cleanup(data) the next time the arena is reset or freed, e.g. to free heap memory tied to it
+void arenaDefer(Arena *arena, void (*cleanup)(void *data), void *data);
+
+#endif
@@ -0,0 +1,27 @@
+#ifndef gzip_h
+#define gzip_h
+
+#include <stddef.h>
+
+// the largest body a compressed request may inflate to
+#define MAX_INFLATED_BODY_SIZE (10 * 1024 * 1024) // 10 MiB
+
+// maximum output/input ratio, only enforced once the output is past MIN_INFLATE_RATIO_SIZE
+// so small, highly repetitive payloads are not rejected
+#define MAX_INFLATE_RATIO      100
+#define MIN_INFLATE_RATIO_SIZE (64 * 1024)
+
+typedef enum {
+    GZIP_OK,
+    GZIP_INVALID,
+    GZIP_TOO_LARGE,
+} GzipStatus;
+
+// Inflates a gzip (or zlib) encoded buffer into a newly allocated, null terminated string.
+// Stops early with GZIP_TOO_LARGE once the output exceeds maxLength or MAX_INFLATE_RATIO.
+GzipStatus gzipInflate(const char *data, size_t length, size_t maxLength, char **out, size_t *outLength);
+
+// releases the inflate state held by the calling thread
+void freeGzipInflater(void);
+
+#endif
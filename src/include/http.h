@@ -8,6 +8,8 @@
 #define MAX_HEADER_NAME 64
 #define MAX_HEADER_VALUE 256
 
+#define MAX_BODY_SIZE (10 * 1024 * 1024) // 10 MiB
+
 #define APPLICATION_JSON "application/json"
 #define TEXT_PLAIN       "text/plain"
 #define TEXT_HTML        "text/html"
@@ -116,6 +118,12 @@ typedef struct {
     char          *content;
     HttpStatusCode status;
     char          *contentType;
+
+    // the body was already written to the client through a ResponseStream
+    bool           streamed;
+
+    // a query started with dbQueryAsync sends the response later, the connection is kept open
+    bool           deferred;
 } HttpResponse;
 
 typedef struct {
@@ -128,8 +136,12 @@ typedef struct {
 } HttpParser;
 
 HttpParser parseRequest(char *request);
+HttpParser parseRequestBuffer(const char *request, size_t length);
 void       freeParser(HttpParser *parser);
 
+// returns the value of the first header matching name (case-insensitive), or NULL
+char            *getHeader(HttpRequest *request, const char *name);
+
 const char      *httpMethodToStr(HttpMethod method);
 const char      *httpStatusCodeToStr(HttpStatusCode status);
 
@@ -2,10 +2,15 @@
 #define json_h
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdio.h>
 
+#include "arena.h"
+
 typedef struct JsonBuilder JsonBuilder;
 typedef struct JsonArray JsonArray;
+typedef struct JsonDocument JsonDocument;
+typedef struct JsonShape JsonShape;
 
 typedef enum {
     JSON_NULL,
@@ -15,64 +20,177 @@ typedef enum {
     JSON_STRING,
     JSON_ARRAY,
     JSON_OBJECT,
+    JSON_DOUBLE,
 } JsonType;
 
 typedef struct {
     JsonType type;
+
+    // keys are interned and shared between builders, unless the table was full
+    bool     ownsKey;
     char    *key;
     
     union {
         char *value;
         bool boolean;
-        int integer;
+        long long integer;
+        double number;
         JsonBuilder *object;
         JsonArray   *array;
     };
 } Json;
 
+typedef enum {
+    // elements are Json values in items
+    JSON_ARRAY_MIXED,
+
+    // packed arrays keep only the values, one after another
+    JSON_ARRAY_INTEGERS,
+    JSON_ARRAY_DOUBLES,
+    JSON_ARRAY_STRINGS,
+} JsonArrayType;
+
+typedef struct {
+    char  *value;
+    size_t length;
+} JsonStringView;
+
 struct JsonArray {
     Json *items;
     int   count;
     int   capacity;
+
+    JsonArrayType type;
+    union {
+        long long      *integers;
+        double         *numbers;
+        JsonStringView *strings;
+    };
+
+    // strings of an array parsed from a document point into the document
+    bool borrowsStrings;
+
+    // storage and adopted values live in this arena, freeJsonArray leaves them to it
+    Arena *arena;
 };
 
+// open addressing index slot, position is stored + 1 so that 0 marks an empty slot
+typedef struct {
+    unsigned int hash;
+    unsigned int position;
+} JsonIndexSlot;
+
+// objects with at least this many members get a hash index on their first lookup
+#define JSON_INDEX_THRESHOLD 16
+
+// members allocated at once by arena builders and arrays
+#define JSON_ARENA_INITIAL_CAPACITY 8
+
 struct JsonBuilder {
     Json *json;
 
     int jsonCount;
     int jsonCapacity;
+
+    // member positions by key hash, a power of two in size and at most half full
+    JsonIndexSlot *index;
+    unsigned int   indexCapacity;
+
+    // the keys this builder was built with, NULL for parsed objects
+    JsonShape     *shape;
+
+    // set by jsonParseLazy, the source is parsed by the first call that reads the builder
+    const char   *source;
+    size_t        sourceLength;
+    bool          isPending;
+    bool          isInvalid;
+
+    // builders returned by jsonParse read their members straight from the parsed
+    // document until they are first modified, jsonCount still holds the member count
+    JsonDocument *document;
+    size_t        tapeIndex;
+    bool          isView;
+    bool          ownsDocument;
+
+    // nested views and arena builders live in an arena and are released with it
+    bool          arenaAllocated;
+
+    // set for arena builders, members and strings are allocated from it
+    Arena        *arena;
+    JsonBuilder  *nextMaterialized;
 };
 
 JsonBuilder *jsonBuilder();
 JsonArray jsonArray();
+
+// a builder and array living in arena, e.g. ctx.arena. Everything put into them is
+// copied into or tied to the arena and released when it is reset, freeJsonBuilder is a no-op
+JsonBuilder *jsonArenaBuilder(Arena *arena);
+JsonArray jsonArenaArray(Arena *arena);
+
+// packed arrays, appending a value of another type turns them into a mixed array
+JsonArray jsonIntegerArray();
+JsonArray jsonDoubleArray();
+JsonArray jsonStringArray();
 void freeJsonArray(JsonArray *jsonArray);
 void freeJsonBuilder(JsonBuilder *jsonBuilder);
 
 void jsonPutString(JsonBuilder *jsonBuilder, char *key, char *value);
 void jsonPutBool(JsonBuilder *jsonBuilder, char *key, bool value);
 void jsonPutInteger(JsonBuilder *jsonBuilder, char *key, int value);
+void jsonPutInteger64(JsonBuilder *jsonBuilder, char *key, long long value);
+void jsonPutDouble(JsonBuilder *jsonBuilder, char *key, double value);
 void jsonPutNull(JsonBuilder *jsonBuilder, char *key);
 void jsonPutObject(JsonBuilder *jsonBuilder, char *key, JsonBuilder *object);
 void jsonPutArray(JsonBuilder *jsonBuilder, char *key, JsonArray *array);
 void jsonPutJson(JsonBuilder *builder, char *key, Json value);
 
 void jsonArrayAppend(JsonArray *array, Json value);
+void jsonArrayAppendInteger64(JsonArray *array, long long value);
+void jsonArrayAppendDouble(JsonArray *array, double value);
+void jsonArrayAppendString(JsonArray *array, char *value);
+
+// the element at index of any kind of array, strings are borrowed from the array
+Json jsonArrayGet(JsonArray *array, int index);
+long long jsonArrayGetInteger64(JsonArray *array, int index);
+
+// reads integers as well as doubles
+double jsonArrayGetDouble(JsonArray *array, int index);
+char *jsonArrayGetString(JsonArray *array, int index);
 
 Json jsonString(char *value);
 Json jsonBool(bool value);
 Json jsonInteger(int value);
+Json jsonInteger64(long long value);
+Json jsonDouble(double value);
 Json jsonObject(JsonBuilder *builder);
 Json jsonArrayJson(JsonArray *array);
 
 char *jsonStringify(JsonBuilder *jsonBuilder);
 
+// the result is freed with the arena, so it can be returned as the response content
+char *jsonStringifyArena(JsonBuilder *jsonBuilder, Arena *arena);
+
 JsonBuilder *jsonParse(char *jsonString);
 
+// defers parsing to the first read of the builder, json must outlive that read
+JsonBuilder *jsonParseLazy(const char *json, size_t length);
+
+// parses a lazy builder now, false if its source was not a JSON object
+bool jsonResolve(JsonBuilder *builder);
+
 char *jsonGetString(JsonBuilder *jsonBuilder, char *key);
 bool jsonGetBool(JsonBuilder *jsonBuilder, char *key);
 int jsonGetInteger(JsonBuilder *jsonBuilder, char *key);
+long long jsonGetInteger64(JsonBuilder *jsonBuilder, char *key);
+
+// reads integers as well as doubles
+double jsonGetDouble(JsonBuilder *jsonBuilder, char *key);
 JsonBuilder *jsonGetJson(JsonBuilder *jsonBuilder, char *key);
 
+// arrays of only integers, only doubles or only strings are parsed into packed arrays
+JsonArray *jsonGetArray(JsonBuilder *jsonBuilder, char *key);
+
 bool jsonHasKey(JsonBuilder *jsonBuilder, char *key);
 
 // more Get methods are required
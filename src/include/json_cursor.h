@@ -0,0 +1,49 @@
+#ifndef json_cursor_h
+#define json_cursor_h
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "json.h"
+
+/*
+** On-demand JSON access. A cursor reads straight from the source text: seeking to
+** a path skips every value it does not need to look at, without building a tape or
+** allocating. Only the values that are visited are checked, so a cursor will not
+** notice a malformed subtree that it skipped over.
+*/
+
+typedef struct {
+    const char *json;
+    size_t      length;
+
+    // start of the current value
+    size_t      position;
+
+    // set once a seek fails, later calls fail too
+    bool        failed;
+} JsonCursor;
+
+JsonCursor jsonCursor(const char *json, size_t length);
+
+// moves to the value at path, relative to the current value.
+// e.g. "$.user.id", "user.id" or "todos[2].title"
+bool jsonCursorSeek(JsonCursor *cursor, const char *path);
+
+// JSON_NULL for null, and for a value that is not valid JSON such as 12abc or txyz
+JsonType jsonCursorType(JsonCursor *cursor);
+
+// false if the value is not an integer that fits in a long long
+bool jsonCursorInteger(JsonCursor *cursor, long long *value);
+
+// any number, integers included
+bool jsonCursorDouble(JsonCursor *cursor, double *value);
+bool jsonCursorBool(JsonCursor *cursor, bool *value);
+
+// the text between the quotes with escapes left as they are, valid as long as the source is
+const char *jsonCursorRawString(JsonCursor *cursor, size_t *length);
+
+// copies the unescaped, null terminated string into buffer, false if it does not fit
+bool jsonCursorString(JsonCursor *cursor, char *buffer, size_t size);
+
+#endif
@@ -0,0 +1,34 @@
+#ifndef json_number_h
+#define json_number_h
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+** Number conversions for the JSON parser and writer, without strtod or printf.
+**
+** Parsing takes Clinger's exact fast path when it can and Eisel-Lemire otherwise,
+** only falling back to strtod for the rare inputs neither can decide. Doubles are
+** printed with Grisu2, which always reads back as the same double and is almost
+** always the shortest such representation.
+*/
+
+// longest output of jsonFormatDouble, e.g. -1.7976931348623157e308 or a 21 digit integer with ".0"
+#define JSON_DOUBLE_MAX_LENGTH 25
+
+typedef struct {
+    bool      isInteger;
+    long long integer;
+    double    number;
+} JsonNumber;
+
+// parses one number in the strict JSON grammar from the start of str.
+// returns the number of characters used, or 0 if str does not start with a number.
+// integers that do not fit in a long long are returned as doubles
+size_t jsonParseNumber(const char *str, size_t length, JsonNumber *number);
+
+// writes the digits of a finite double into buffer, which needs JSON_DOUBLE_MAX_LENGTH bytes.
+// returns the length, the output is not null terminated
+int jsonFormatDouble(double value, char *buffer);
+
+#endif
@@ -0,0 +1,60 @@
+#ifndef json_shape_h
+#define json_shape_h
+
+#include <stddef.h>
+
+#include "json.h"
+
+/*
+** Key interning and object shapes.
+**
+** Keys put into a builder are interned, so every builder holding "id" points at the
+** same copy and building a list of objects does not allocate a key per member.
+** Builders also track their shape, the sequence of keys they were built with.
+** Objects built the same way end up on the same shape, and the hash index of a
+** wide shape is built once and used by every object that has it.
+**
+** Both tables are process wide and not locked, so JSON is only built and parsed on the
+** thread handling requests, never in a dbWriteWith function or on a database thread.
+** They are bounded by JSON_INTERN_MAX_BYTES and JSON_MAX_SHAPES, past which keys are
+** copied per member and objects go without a shape.
+*/
+
+#define JSON_INTERN_MAX_KEY_LENGTH 64
+#define JSON_INTERN_MAX_BYTES      (256 * 1024)
+#define JSON_MAX_SHAPES            4096
+
+struct JsonShape {
+    // key of the last member, NULL for the empty shape
+    const char    *key;
+    int            count;
+
+    // number of times a builder was given this shape, capped at 2
+    int            uses;
+
+    // shapes reached by adding one more key
+    JsonShape    **transitions;
+    int            transitionCount;
+    int            transitionCapacity;
+
+    // built on a lookup once more than one object has had this shape, see JSON_INDEX_THRESHOLD
+    JsonIndexSlot *index;
+    unsigned int   indexCapacity;
+};
+
+// FNV-1a, used for both the intern table and object indexes
+unsigned int jsonHashKey(const char *key, size_t length);
+
+// a stable, shared copy of key. NULL if the key is too long or the table is full
+const char *jsonInternKey(const char *key, size_t length);
+
+// the shape of an object with no members
+JsonShape *jsonEmptyShape(void);
+
+// the shape after adding key, which must be interned. NULL once there is no room for new shapes
+JsonShape *jsonShapeAdd(JsonShape *shape, const char *key);
+
+// releases every interned key and shape, only call once no builder is left
+void freeJsonKeys(void);
+
+#endif
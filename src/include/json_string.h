@@ -0,0 +1,21 @@
+#ifndef json_string_h
+#define json_string_h
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+** Vectorized scans over JSON string contents, shared by the parser and the writer.
+** Each routine uses AVX2 when the CPU supports it, SSE2 otherwise, and a scalar loop
+** for short inputs and tails.
+*/
+
+// position of the first '"', '\' or control character in str, length if there is none.
+// these are the bytes that have to be escaped in a JSON string
+size_t jsonFindEscape(const char *str, size_t length);
+
+// false for malformed UTF-8: stray continuation bytes, truncated or overlong
+// sequences, surrogates and code points past U+10FFFF
+bool jsonValidUtf8(const char *str, size_t length);
+
+#endif
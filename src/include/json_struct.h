@@ -0,0 +1,198 @@
+#ifndef json_struct_h
+#define json_struct_h
+
+#include <stdbool.h>
+#include <limits.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "json.h"
+#include "json_tape.h"
+#include "json_writer.h"
+
+/*
+** Typed JSON conversions for plain C structs, generated at compile time.
+**
+**     JSON_STRUCT(Todo,
+**         FIELD(int, id),
+**         FIELD(str, title),
+**         FIELD(bool, completed)
+**     )
+**
+** declares the Todo struct along with
+**
+**     void Todo_toJson(JsonWriter *writer, const Todo *value);
+**     bool Todo_fromJson(JsonValue value, Todo *out);
+**
+** Todo_toJson writes each member with its key as a literal fragment, e.g. "\"id\":",
+** and Todo_fromJson reads the members straight from a parsed tape. Neither goes
+** through a JsonBuilder.
+**
+** Field types are int, int64 (long long), double, bool and str. A str member is a
+** const char * that Todo_toJson writes as null when it is NULL, and that Todo_fromJson
+** points into the parsed document, so it is valid for as long as the document is.
+**
+** The functions are static, so JSON_STRUCT can go in a header that several files
+** include. A struct may have up to 32 fields.
+*/
+
+typedef const char *JsonStr;
+
+#define JSON_FIELD_TYPE_int    int
+#define JSON_FIELD_TYPE_int64  long long
+#define JSON_FIELD_TYPE_double double
+#define JSON_FIELD_TYPE_bool   bool
+#define JSON_FIELD_TYPE_str    JsonStr
+
+// stdbool.h makes bool a macro, so a bool field can reach the pasting below as _Bool
+#define JSON_FIELD_TYPE__Bool  bool
+#define jsonWriteField__Bool   jsonWriteField_bool
+#define jsonReadField__Bool    jsonReadField_bool
+
+static inline void jsonWriteField_int(JsonWriter *writer, int value) {
+    jwInt(writer, value);
+}
+
+static inline void jsonWriteField_int64(JsonWriter *writer, long long value) {
+    jwInt(writer, value);
+}
+
+static inline void jsonWriteField_double(JsonWriter *writer, double value) {
+    jwDouble(writer, value);
+}
+
+static inline void jsonWriteField_bool(JsonWriter *writer, bool value) {
+    jwBool(writer, value);
+}
+
+static inline void jsonWriteField_str(JsonWriter *writer, JsonStr value) {
+    jwString(writer, value);
+}
+
+static inline bool jsonReadField_int64(JsonValue value, long long *out) {
+    if (!jsonValueIsInteger(value)) return false;
+
+    *out = jsonValueInteger(value);
+    return true;
+}
+
+static inline bool jsonReadField_int(JsonValue value, int *out) {
+    long long integer;
+    if (!jsonReadField_int64(value, &integer) || integer < INT_MIN || integer > INT_MAX) return false;
+
+    *out = (int)integer;
+    return true;
+}
+
+static inline bool jsonReadField_double(JsonValue value, double *out) {
+    JsonType type = jsonValueType(value);
+    if (type != JSON_NUMBER && type != JSON_DOUBLE) return false;
+
+    *out = jsonValueDouble(value);
+    return true;
+}
+
+static inline bool jsonReadField_bool(JsonValue value, bool *out) {
+    JsonType type = jsonValueType(value);
+    if (type != JSON_TRUE && type != JSON_FALSE) return false;
+
+    *out = type == JSON_TRUE;
+    return true;
+}
+
+static inline bool jsonReadField_str(JsonValue value, JsonStr *out) {
+    JsonType type = jsonValueType(value);
+    if (type == JSON_NULL) {
+        *out = NULL;
+        return true;
+    }
+    if (type != JSON_STRING) return false;
+
+    size_t length;
+    *out = jsonValueString(value, &length);
+    return true;
+}
+
+// applies m to every argument
+#define JSON_EACH(m, ...) JSON_EACH_PICK(__VA_ARGS__, JSON_EACH_32, JSON_EACH_31, JSON_EACH_30, JSON_EACH_29, JSON_EACH_28, JSON_EACH_27, JSON_EACH_26, JSON_EACH_25, JSON_EACH_24, JSON_EACH_23, JSON_EACH_22, JSON_EACH_21, JSON_EACH_20, JSON_EACH_19, JSON_EACH_18, JSON_EACH_17, JSON_EACH_16, JSON_EACH_15, JSON_EACH_14, JSON_EACH_13, JSON_EACH_12, JSON_EACH_11, JSON_EACH_10, JSON_EACH_9, JSON_EACH_8, JSON_EACH_7, JSON_EACH_6, JSON_EACH_5, JSON_EACH_4, JSON_EACH_3, JSON_EACH_2, JSON_EACH_1)(m, __VA_ARGS__)
+#define JSON_EACH_PICK(_1, _2, _3, _4, _5, _6, _7, _8, _9, _10, _11, _12, _13, _14, _15, _16, _17, _18, _19, _20, _21, _22, _23, _24, _25, _26, _27, _28, _29, _30, _31, _32, name, ...) name
+#define JSON_EACH_1(m, x) m(x)
+#define JSON_EACH_2(m, x, ...) m(x) JSON_EACH_1(m, __VA_ARGS__)
+#define JSON_EACH_3(m, x, ...) m(x) JSON_EACH_2(m, __VA_ARGS__)
+#define JSON_EACH_4(m, x, ...) m(x) JSON_EACH_3(m, __VA_ARGS__)
+#define JSON_EACH_5(m, x, ...) m(x) JSON_EACH_4(m, __VA_ARGS__)
+#define JSON_EACH_6(m, x, ...) m(x) JSON_EACH_5(m, __VA_ARGS__)
+#define JSON_EACH_7(m, x, ...) m(x) JSON_EACH_6(m, __VA_ARGS__)
+#define JSON_EACH_8(m, x, ...) m(x) JSON_EACH_7(m, __VA_ARGS__)
+#define JSON_EACH_9(m, x, ...) m(x) JSON_EACH_8(m, __VA_ARGS__)
+#define JSON_EACH_10(m, x, ...) m(x) JSON_EACH_9(m, __VA_ARGS__)
+#define JSON_EACH_11(m, x, ...) m(x) JSON_EACH_10(m, __VA_ARGS__)
+#define JSON_EACH_12(m, x, ...) m(x) JSON_EACH_11(m, __VA_ARGS__)
+#define JSON_EACH_13(m, x, ...) m(x) JSON_EACH_12(m, __VA_ARGS__)
+#define JSON_EACH_14(m, x, ...) m(x) JSON_EACH_13(m, __VA_ARGS__)
+#define JSON_EACH_15(m, x, ...) m(x) JSON_EACH_14(m, __VA_ARGS__)
+#define JSON_EACH_16(m, x, ...) m(x) JSON_EACH_15(m, __VA_ARGS__)
+#define JSON_EACH_17(m, x, ...) m(x) JSON_EACH_16(m, __VA_ARGS__)
+#define JSON_EACH_18(m, x, ...) m(x) JSON_EACH_17(m, __VA_ARGS__)
+#define JSON_EACH_19(m, x, ...) m(x) JSON_EACH_18(m, __VA_ARGS__)
+#define JSON_EACH_20(m, x, ...) m(x) JSON_EACH_19(m, __VA_ARGS__)
+#define JSON_EACH_21(m, x, ...) m(x) JSON_EACH_20(m, __VA_ARGS__)
+#define JSON_EACH_22(m, x, ...) m(x) JSON_EACH_21(m, __VA_ARGS__)
+#define JSON_EACH_23(m, x, ...) m(x) JSON_EACH_22(m, __VA_ARGS__)
+#define JSON_EACH_24(m, x, ...) m(x) JSON_EACH_23(m, __VA_ARGS__)
+#define JSON_EACH_25(m, x, ...) m(x) JSON_EACH_24(m, __VA_ARGS__)
+#define JSON_EACH_26(m, x, ...) m(x) JSON_EACH_25(m, __VA_ARGS__)
+#define JSON_EACH_27(m, x, ...) m(x) JSON_EACH_26(m, __VA_ARGS__)
+#define JSON_EACH_28(m, x, ...) m(x) JSON_EACH_27(m, __VA_ARGS__)
+#define JSON_EACH_29(m, x, ...) m(x) JSON_EACH_28(m, __VA_ARGS__)
+#define JSON_EACH_30(m, x, ...) m(x) JSON_EACH_29(m, __VA_ARGS__)
+#define JSON_EACH_31(m, x, ...) m(x) JSON_EACH_30(m, __VA_ARGS__)
+#define JSON_EACH_32(m, x, ...) m(x) JSON_EACH_31(m, __VA_ARGS__)
+
+// FIELD(type, name) is pasted onto these prefixes, so FIELD itself is never a macro
+#define JSON_MEMBER_(field)   JSON_MEMBER_##field
+#define JSON_WRITE_(field)    JSON_WRITE_##field
+#define JSON_READ_(field)     JSON_READ_##field
+
+#define JSON_MEMBER_FIELD(type, name) JSON_FIELD_TYPE_##type name;
+
+#define JSON_WRITE_FIELD(type, name) \
+    jwRawKey(writer, "\"" #name "\":", sizeof("\"" #name "\":") - 1); \
+    jsonWriteField_##type(writer, value->name);
+
+// one link of an if / else chain over the member keys, unknown keys fall through to the end
+#define JSON_READ_FIELD(type, name) \
+    if (length == sizeof(#name) - 1 && memcmp(key, #name, length) == 0) { \
+        if (!jsonReadField_##type(member, &out->name)) return false; \
+    } else
+
+#define JSON_STRUCT(Name, ...) \
+    typedef struct { \
+        JSON_EACH(JSON_MEMBER_, __VA_ARGS__) \
+    } Name; \
+    \
+    __attribute__((unused)) static void Name##_toJson(JsonWriter *writer, const Name *value) { \
+        jwObjectStart(writer); \
+        JSON_EACH(JSON_WRITE_, __VA_ARGS__) \
+        jwObjectEnd(writer); \
+    } \
+    \
+    /* members missing from the JSON keep the value they had in out */ \
+    __attribute__((unused)) static bool Name##_fromJson(JsonValue object, Name *out) { \
+        if (jsonValueType(object) != JSON_OBJECT) return false; \
+        \
+        JsonValue entry = jsonValueFirst(object); \
+        while (!jsonValueIsEnd(entry)) { \
+            size_t length; \
+            const char *key = jsonValueString(entry, &length); \
+            JsonValue member = jsonValueSkip(entry); \
+            \
+            JSON_EACH(JSON_READ_, __VA_ARGS__) { } \
+            \
+            entry = jsonValueSkip(member); \
+        } \
+        \
+        return true; \
+    }
+
+#endif
@@ -0,0 +1,115 @@
+#ifndef json_tape_h
+#define json_tape_h
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "json.h"
+#include "arena.h"
+
+/*
+** Two stage JSON parser.
+**
+** Stage 1 finds the position of every structural character ({}[]:, and string
+** quotes) with SIMD where available. Stage 2 walks those positions and writes a
+** flat tape, one 16 byte entry per value. Strings are left in place in the
+** document's copy of the source and only unescaped when they are first read.
+*/
+
+#define JSON_MAX_DEPTH 1024
+
+typedef enum {
+    JSON_TAPE_OBJECT_START = '{',
+    JSON_TAPE_OBJECT_END   = '}',
+    JSON_TAPE_ARRAY_START  = '[',
+    JSON_TAPE_ARRAY_END    = ']',
+    JSON_TAPE_STRING       = '"',
+    JSON_TAPE_INTEGER      = 'l',
+    JSON_TAPE_DOUBLE       = 'd',
+    JSON_TAPE_TRUE         = 't',
+    JSON_TAPE_FALSE        = 'f',
+    JSON_TAPE_NULL         = 'n',
+} JsonTapeType;
+
+// string flags
+#define JSON_TAPE_ESCAPED      0x1  // contains backslash escapes
+#define JSON_TAPE_UNESCAPED    0x2  // has been unescaped and null terminated in place
+
+typedef struct {
+    uint8_t  type;
+    uint8_t  flags;
+
+    // string: byte length, containers: member or element count
+    uint32_t length;
+
+    union {
+        // string: offset of the first character in source
+        uint64_t offset;
+        // container start: index of the entry after the matching end
+        uint64_t end;
+        int64_t  integer;
+        double   number;
+    };
+} JsonTapeEntry;
+
+struct JsonDocument {
+    char          *source;
+    size_t         length;
+
+    JsonTapeEntry *tape;
+    size_t         tapeCount;
+
+    // backs views handed out by jsonGetJson
+    Arena          arena;
+
+    // nested views that were modified and now own heap allocated members
+    JsonBuilder   *materialized;
+};
+
+// a position in a document's tape
+typedef struct {
+    JsonDocument *document;
+    size_t        index;
+} JsonValue;
+
+// parses any JSON value, returns NULL if the input is not valid JSON
+JsonDocument *jsonParseDocument(const char *json, size_t length);
+void freeJsonDocument(JsonDocument *document);
+
+JsonValue jsonDocumentRoot(JsonDocument *document);
+
+JsonType jsonValueType(JsonValue value);
+bool jsonValueIsInteger(JsonValue value);
+
+// number of members or elements of an object or array
+size_t jsonValueCount(JsonValue value);
+
+// the value following this one at the same level, skipping any nested values
+JsonValue jsonValueSkip(JsonValue value);
+
+bool jsonValueFind(JsonValue object, const char *key, JsonValue *out);
+
+// null terminated, unescaped on first access, valid for the life of the document
+const char *jsonValueString(JsonValue value, size_t *length);
+long long jsonValueInteger(JsonValue value);
+double jsonValueDouble(JsonValue value);
+bool jsonValueBool(JsonValue value);
+
+// iteration, e.g. for (JsonValue v = jsonValueFirst(array); !jsonValueIsEnd(v); v = jsonValueSkip(v))
+// object members are visited as key, value, key, value...
+JsonValue jsonValueFirst(JsonValue container);
+bool jsonValueIsEnd(JsonValue value);
+
+// the tape position of a parsed builder such as ctx.body, false once it has been modified
+bool jsonBuilderValue(JsonBuilder *builder, JsonValue *value);
+
+// decodes the escapes of a raw string body into out, which needs length bytes and may be str itself.
+// false if an escape is malformed
+bool jsonUnescape(char *out, const char *str, size_t length, size_t *outLength);
+
+// whether a raw string body decodes to text, compared escape by escape without a buffer.
+// false if an escape is malformed
+bool jsonUnescapedEquals(const char *str, size_t length, const char *text, size_t textLength);
+
+#endif
@@ -0,0 +1,84 @@
+#ifndef json_writer_h
+#define json_writer_h
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "json.h"
+#include "response_stream.h"
+#include "request_context.h"
+
+/*
+** Push-style JSON writer. Values are appended to a buffer as they are written,
+** without building a JsonBuilder tree first.
+**
+** A writer from jsonWriter() grows its buffer and hands back the whole string.
+** A writer from jsonStreamWriter() is tied to the client connection and sends the
+** buffer as a chunk every time its JSON_STREAM_BUFFER_SIZE bytes fill up.
+*/
+
+#define JSON_WRITER_MAX_DEPTH   128
+#define JSON_STREAM_BUFFER_SIZE (16 * 1024)
+
+typedef struct {
+    char   *buffer;
+    size_t  length;
+    size_t  capacity;
+
+    ResponseStream *stream;
+
+    int     depth;
+    bool    hasItems[JSON_WRITER_MAX_DEPTH];
+    bool    afterKey;
+
+    // writes ", " and ": " instead of "," and ":"
+    bool    spaced;
+
+    // set when nesting is too deep or the client went away, later writes are ignored
+    bool    failed;
+} JsonWriter;
+
+JsonWriter jsonWriter();
+void freeJsonWriter(JsonWriter *writer);
+
+// starts a chunked application/json response on the request's connection
+JsonWriter jsonStreamWriter(RequestContext ctx, HttpStatusCode status);
+
+void jwObjectStart(JsonWriter *writer);
+void jwObjectEnd(JsonWriter *writer);
+void jwArrayStart(JsonWriter *writer);
+void jwArrayEnd(JsonWriter *writer);
+
+void jwKey(JsonWriter *writer, const char *key);
+// a key that is already quoted and escaped, colon included, e.g. "\"id\":"
+void jwRawKey(JsonWriter *writer, const char *fragment, size_t length);
+// appends the quoted and escaped key and a colon to the buffer as it is, without writing a key into
+// the document. for building the fragments passed to jwRawKey at runtime
+void jwKeyFragment(JsonWriter *writer, const char *key);
+
+void jwString(JsonWriter *writer, const char *value);
+void jwStringLength(JsonWriter *writer, const char *value, size_t length);
+void jwInt(JsonWriter *writer, long long value);
+
+// shortest form that reads back as the same double, NaN and infinities are written as null
+void jwDouble(JsonWriter *writer, double value);
+// whole arrays of numbers, written in tight loops
+void jwIntegers(JsonWriter *writer, const long long *values, size_t count);
+void jwDoubles(JsonWriter *writer, const double *values, size_t count);
+void jwBool(JsonWriter *writer, bool value);
+void jwNull(JsonWriter *writer);
+
+// writes an existing JsonBuilder / Json value in place
+void jwObject(JsonWriter *writer, JsonBuilder *builder);
+void jwJson(JsonWriter *writer, const Json *json);
+
+// sends what is buffered as a chunk, a no-op for in-memory writers
+bool jwFlush(JsonWriter *writer);
+
+// takes ownership of the null terminated output of an in-memory writer
+char *jwTakeString(JsonWriter *writer);
+
+// flushes and terminates a streamed response, returning what the controller should return
+HttpResponse jwEndStream(JsonWriter *writer);
+
+#endif
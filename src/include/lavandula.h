@@ -13,11 +13,22 @@
 #include "middleware.h"
 #include "logger.h"
 #include "validate_json_body.h"
+#include "validator.h"
 #include "lavandula_test.h"
 #include "json.h"
+#include "json_writer.h"
+#include "json_cursor.h"
+#include "json_struct.h"
+#include "response_stream.h"
 #include "cors.h"
 #include "environment.h"
 #include "sql.h"
+#include "sql_json.h"
+#include "sql_writer.h"
+#include "sql_cache.h"
+#include "sql_async.h"
+#include "sql_stats.h"
+#include "sql_plan.h"
 #include "lavender.h"
 #include "utils.h"
 #include "auth.h"
@@ -67,8 +78,29 @@ void useHttpsRedirect(AppBuilder *builder);
 // sets the application environment (development, production, testing)
 void useEnvironment(AppBuilder *builder, char *env);
 
-// integrates SQLite3 database with the application
+// integrates SQLite3 database with the application, with a pool of DB_POOL_SIZE connections
+// and dbDefaultPragmas(). each request's ctx.db is its thread's connection
 void useSqlLite3(AppBuilder *builder, char *dbPath);
+void useSqlLite3Pool(AppBuilder *builder, char *dbPath, int size, DbPragmas pragmas);
+
+// starts a writer thread for dbPath that batches the writes queued with dbWrite(ctx.writer, ...)
+void useSqlLite3Writer(AppBuilder *builder, char *dbPath);
+
+// shares a query result cache between the pool and the writer, for dbQueryCached(ctx.db, ...).
+// budget and ttlMs as createDbQueryCache, e.g. DB_QUERY_CACHE_BUDGET and DB_QUERY_CACHE_TTL_MS
+void useSqlLite3QueryCache(AppBuilder *builder, size_t budget, int ttlMs);
+
+// starts threads that run the queries of dbQueryAsync, each using a connection from the pool.
+// call it after useSqlLite3, and keep threads below the pool's size
+void useSqlLite3Async(AppBuilder *builder, int threads);
+
+// times every statement run by the pool and the writer into app.dbStats, and writes those
+// taking slowMs or longer to stderr, e.g. DB_SLOW_QUERY_MS
+void useSqlLite3Stats(AppBuilder *builder, double slowMs);
+
+// splits the database across count files, one pool and one writer for each, for
+// dbShardQueryRows(ctx.app->dbShards, key, ...) and the other functions of sql_shard.h
+void useSqlLite3Shards(AppBuilder *builder, const char **paths, int count);
 
 // integrates Lavender ORM with the application
 void useLavender(AppBuilder *builder);
@@ -83,6 +115,8 @@ bool isDevelopment(AppBuilder *builder);
 bool isProduction(AppBuilder *builder);
 bool isTesting(AppBuilder *builder);
 
+// in the DEVELOPMENT environment, also checks the query plan of every statement the pool, the
+// writer and the shards prepare, see sql_plan.h
 App build(AppBuilder builder);
 
 void runApp(App *app);
@@ -2,8 +2,10 @@
 #define context_h
 
 #include "sql.h"
+#include "sql_writer.h"
 #include "http.h"
 #include "json.h"
+#include "response_stream.h"
 
 typedef struct App App; 
 
@@ -11,10 +13,20 @@ typedef struct {
     App         *app;
 
     DbContext   *db;
+
+    // the app's write queue, NULL unless useSqlLite3Writer was called
+    DbWriter    *writer;
+
     HttpRequest  request;
 
     JsonBuilder *body;
     bool         hasBody;
+
+    // reset once the response has been sent, see jsonArenaBuilder
+    Arena       *arena;
+
+    // the client connection, for controllers that stream their response
+    ResponseStream *stream;
 } RequestContext;
 
 RequestContext requestContext(App *app, HttpRequest request);
@@ -0,0 +1,33 @@
+#ifndef response_stream_h
+#define response_stream_h
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "http.h"
+
+/*
+** A response written to the client socket as it is produced, using
+** Transfer-Encoding: chunked, instead of being returned as one string.
+*/
+
+typedef struct {
+    int  socket;
+
+    bool started;
+    bool finished;
+
+    // set once a write fails, usually because the client disconnected
+    bool failed;
+} ResponseStream;
+
+ResponseStream responseStream(int socket);
+
+bool startChunkedResponse(ResponseStream *stream, HttpStatusCode status, const char *contentType);
+bool writeChunk(ResponseStream *stream, const char *data, size_t length);
+bool endChunkedResponse(ResponseStream *stream);
+
+// the response a controller returns once it has streamed its body itself
+HttpResponse streamedResponse(ResponseStream *stream);
+
+#endif
@@ -2,6 +2,7 @@
 #define sql_h
 
 #include <stdbool.h>
+#include <stddef.h>
 
 #define DB_PARAMS(...) ((DbParam[]){ __VA_ARGS__ })
 
@@ -34,33 +35,243 @@ typedef struct {
 } DbParam;
 
 
+// called by dbQueryEach for every row. names and values are borrowed from SQLite and only valid
+// during the call, a NULL column has a NULL value
 typedef void (*RowCallback)(int colCount, char **colNames, char **colValues, void *userData);
 
+// how a column of a DbResult is stored, chosen from the values it holds: INTEGER when every
+// value is an integer, FLOAT when they are all numbers, BLOB when any is a blob and TEXT otherwise.
+// NULL when the column has no values
+typedef enum {
+    DB_COLUMN_NULL,
+    DB_COLUMN_INTEGER,
+    DB_COLUMN_FLOAT,
+    DB_COLUMN_TEXT,
+    DB_COLUMN_BLOB,
+} DbColumnType;
+
+// a text or blob value in the result's heap
+typedef struct {
+    unsigned int offset;
+    unsigned int length;
+} DbSpan;
+
 typedef struct {
-    int colCount;
-    char **colNames;
-    char **colValues;
-} DbRow;
+    const char   *name;
+
+    // the type the column was declared with, NULL for an expression
+    const char   *declType;
+    DbColumnType  type;
+
+    // a bit for each row, set when the value is NULL
+    unsigned long long *nulls;
+
+    union {
+        long long *integers;
+        double    *floats;
+        DbSpan    *spans;
+    } values;
+} DbColumn;
 
+// the rows of a query stored column by column. the names, values and text are all in the same
+// allocation as the result, so freeDbResult is a single free
 typedef struct {
-    int rowCount;
-    DbRow *rows;
+    int       rowCount;
+    int       colCount;
+    DbColumn *columns;
+
+    // text and blob values, each followed by a '\0'
+    char     *heap;
+
+    // bytes in the allocation
+    size_t    size;
 } DbResult;
 
 typedef enum {
     SQLITE,
 } SqlDbType;
 
+// prepared statements kept per connection, the least recently used one is finalized when full
+#define DB_STATEMENT_CACHE_SIZE 32
+
+typedef struct {
+    // the query string the statement was prepared from, and a hash and copy of its text
+    const char        *query;
+    char              *sql;
+    unsigned int       hash;
+
+    // if type is SQLITE, statement is sqlite3_stmt*
+    void              *statement;
+    unsigned long long lastUsed;
+
+    // checked out by a running query, a nested use of the same SQL prepares its own
+    bool               inUse;
+} DbCachedStatement;
+
+typedef struct {
+    DbCachedStatement *entries;
+    int                count;
+    int                capacity;
+    int                allocated;
+
+    unsigned long long clock;
+
+    // lookups that found a ready statement and ones that had to prepare it
+    unsigned long long hits;
+    unsigned long long misses;
+} DbStatementCache;
+
+typedef struct DbPool DbPool;
+typedef struct DbQueryCacheLink DbQueryCacheLink;
+typedef struct DbStatsLink DbStatsLink;
+typedef struct DbPlanChecker DbPlanChecker;
+
 typedef struct {
     SqlDbType type;
 
     // if type is SQLITE, connection is sqlite3*
     void *connection;
+
+    DbStatementCache statements;
+
+    // the pool the connection was taken from, NULL for a connection opened on its own
+    DbPool *pool;
+
+    // set by dbAttachQueryCache, see sql_cache.h
+    DbQueryCacheLink *queryCache;
+
+    // set by dbAttachStats, see sql_stats.h
+    DbStatsLink *stats;
+
+    // set by dbAttachPlanChecker, see sql_plan.h
+    DbPlanChecker *planChecker;
 } DbContext;
 
+// settings applied to every connection a pool opens. NULL and 0 leave SQLite's default
+typedef struct {
+    const char *journalMode;
+    const char *synchronous;
+
+    // bytes of the database file to memory map
+    long long   mmapSize;
+
+    // as PRAGMA cache_size: pages, or KiB when negative
+    int         cacheSize;
+
+    // how long, in milliseconds, to retry a statement while another connection holds a lock
+    int         busyTimeout;
+} DbPragmas;
+
+// connections a pool opens at most, one for each thread that uses it
+#define DB_POOL_SIZE 8
+
+// WAL journal, synchronous=NORMAL, 256 MiB mmap, 16 MiB page cache and a 5 second busy timeout
+DbPragmas dbDefaultPragmas();
+
 DbContext *createSqlLite3DbContext(char *dbPath);
 
+// opens connections to dbPath lazily, each one with SQLITE_OPEN_NOMUTEX and the given pragmas
+DbPool *createDbPool(const char *dbPath, int size, DbPragmas pragmas);
+
+// the calling thread's connection, opened on its first call. a thread that exits hands its
+// connection back for the next one. NULL once size threads hold a connection
+DbContext *dbPoolConnection(DbPool *pool);
+
+// closes every connection, none of them may be in use
+void freeDbPool(DbPool *pool);
+
+bool dbApplyPragmas(DbContext *db, DbPragmas pragmas);
+
+// finalizes the cached statements, closes the connection and frees db
+bool dbClose(DbContext *db);
+
+// 0 turns the cache off, shrinking it finalizes the statements that no longer fit
+void dbSetStatementCacheSize(DbContext *db, int size);
+
 bool dbExec(DbContext *db, const char *query, const DbParam *params, int paramCount);
+
+// runs query for each of rowCount rows of paramsPerRow params, with one prepared statement and in a
+// single transaction, e.g. a multi-row insert. if any row fails none of them are written
+bool dbExecMany(DbContext *db, const char *query, const DbParam *params, int paramsPerRow, int rowCount);
+
 DbResult *dbQueryRows(DbContext *db, const char *query, DbParam *params, int paramCount);
 
+// runs query on each of dbs, which have the same schema, and returns the rows of all of them in
+// one result, in the order of dbs. NULL if it fails on any of them
+DbResult *dbQueryRowsAcross(DbContext **dbs, int dbCount, const char *query, DbParam *params, int paramCount);
+
+void freeDbResult(DbResult *result);
+
+// a copy of result in a new allocation, freed with freeDbResult
+DbResult *dbCopyResult(const DbResult *result);
+
+// the index of the column called name, or -1
+int dbColumnIndex(const DbResult *result, const char *name);
+
+// values of a DbResult. numbers are converted between integer and float, and text is parsed as a
+// number. NULL values and rows or columns out of range read as 0 or NULL
+bool dbIsNull(const DbResult *result, int row, int column);
+long long dbGetInt64(const DbResult *result, int row, int column);
+int dbGetInt(const DbResult *result, int row, int column);
+double dbGetDouble(const DbResult *result, int row, int column);
+bool dbGetBool(const DbResult *result, int row, int column);
+
+// text or blob values, NULL for a number column. length may be NULL
+const char *dbGetText(const DbResult *result, int row, int column, int *length);
+
+// runs query and calls callback for each row as it is stepped, without copying the rows
+bool dbQueryEach(DbContext *db, const char *query, const DbParam *params, int paramCount, RowCallback callback, void *userData);
+
+// a query being stepped one row at a time, e.g.
+//     DbCursor cursor = dbQueryCursor(db, "select id, title from todos;", NULL, 0);
+//     while (dbNext(&cursor)) { ... dbColumnInt64(&cursor, 0) ... }
+//     dbCloseCursor(&cursor);
+typedef struct {
+    DbContext *db;
+
+    // if db is SQLITE, statement is sqlite3_stmt*, NULL once the cursor is closed
+    void      *statement;
+    int        colCount;
+
+    // set when the query could not be prepared or a step failed
+    bool       failed;
+} DbCursor;
+
+DbCursor dbQueryCursor(DbContext *db, const char *query, const DbParam *params, int paramCount);
+
+// moves to the next row, false at the end or on an error. the cursor is closed at the end
+bool dbNext(DbCursor *cursor);
+
+// gives the statement back, needed when a loop stops before the last row
+void dbCloseCursor(DbCursor *cursor);
+
+// values of the current row, borrowed and valid until the next dbNext
+const char *dbColumnName(DbCursor *cursor, int column);
+bool dbColumnIsNull(DbCursor *cursor, int column);
+long long dbColumnInt64(DbCursor *cursor, int column);
+double dbColumnDouble(DbCursor *cursor, int column);
+const char *dbColumnText(DbCursor *cursor, int column, int *length);
+
+// the file and line a query was run from, for the query plan checker. the query functions are
+// wrapped in macros that record it for the calling thread before the call
+typedef struct {
+    const char *file;
+    int         line;
+} DbCallSite;
+
+extern _Thread_local DbCallSite dbCallSite;
+
+#define DB_CALL_SITE (dbCallSite = (DbCallSite){ __FILE__, __LINE__ })
+
+// the library's own sources define SQL_NO_CALL_SITES, so its internal queries keep the site of
+// the application's call
+#ifndef SQL_NO_CALL_SITES
+#define dbExec(...)        (DB_CALL_SITE, dbExec(__VA_ARGS__))
+#define dbExecMany(...)    (DB_CALL_SITE, dbExecMany(__VA_ARGS__))
+#define dbQueryRows(...)   (DB_CALL_SITE, dbQueryRows(__VA_ARGS__))
+#define dbQueryRowsAcross(...) (DB_CALL_SITE, dbQueryRowsAcross(__VA_ARGS__))
+#define dbQueryEach(...)   (DB_CALL_SITE, dbQueryEach(__VA_ARGS__))
+#define dbQueryCursor(...) (DB_CALL_SITE, dbQueryCursor(__VA_ARGS__))
+#endif
+
 #endif
\ No newline at end of file
@@ -0,0 +1,79 @@
+#ifndef sql_async_h
+#define sql_async_h
+
+#include <stdbool.h>
+
+#include "sql.h"
+#include "http.h"
+#include "request_context.h"
+
+/*
+** Queries run on a few database threads, so that a slow one does not hold up the server
+** loop and every other client behind it.
+**
+** A handler starts the query with dbQueryAsync and returns the response it gives back,
+** which tells the server to keep the connection open and move on to the next request.
+** A database thread takes the query from the queue and runs it on its own pool
+** connection. Once it is done the server loop picks the result up and calls onDone with
+** the request's context, and the response onDone returns is sent as usual.
+**
+** onDone runs on the server's thread, like any other handler, so it can build JSON and
+** use ctx.db freely. Only the query itself runs elsewhere. The key and shape tables of
+** json_shape.h are not locked, so JSON must never be built on a database thread.
+*/
+
+// database threads started by useSqlLite3Async, each one takes a connection from the pool
+#define DB_ASYNC_THREADS 2
+
+// builds the response from the rows of a query started with dbQueryAsync. result is NULL if
+// the query failed, and is freed once onDone returns
+typedef HttpResponse (*DbQueryDone)(RequestContext ctx, DbResult *result);
+
+typedef struct DbAsyncPool DbAsyncPool;
+
+// a query handed back by a database thread, with what is needed to resume its request
+typedef struct DbAsyncQuery {
+    int          socket;
+
+    // a copy of the request, freed with the query
+    HttpRequest  request;
+    bool         jsonBody;
+
+    DbQueryDone  onDone;
+    DbResult    *result;
+
+    // where dbQueryAsync was called from
+    DbCallSite   site;
+
+    char        *query;
+    DbParam     *params;
+    int          paramCount;
+
+    struct DbAsyncQuery *next;
+} DbAsyncQuery;
+
+// starts threads that run queries on connections from pool
+DbAsyncPool *createDbAsyncPool(DbPool *pool, int threads);
+
+// finishes the queued queries and stops the threads. the connections of queries that were not
+// resumed are closed without a response
+void freeDbAsyncPool(DbAsyncPool *async);
+
+// queues query to run on a database thread, params are copied. the handler returns the response
+// as it is. without useSqlLite3Async the query runs here and onDone is called straight away
+HttpResponse dbQueryAsync(RequestContext ctx, const char *query, const DbParam *params, int paramCount, DbQueryDone onDone);
+
+// readable while finished queries are waiting, for the server to wait on alongside its socket
+int dbAsyncFd(DbAsyncPool *async);
+
+// the next finished query, NULL when there are none. freed with freeDbAsyncQuery
+DbAsyncQuery *dbAsyncCompleted(DbAsyncPool *async);
+
+// frees the query's result and request, the socket is left to the caller
+void freeDbAsyncQuery(DbAsyncQuery *query);
+
+#ifndef SQL_NO_CALL_SITES
+#define dbQueryAsync(...) (DB_CALL_SITE, dbQueryAsync(__VA_ARGS__))
+#endif
+
+#endif
@@ -0,0 +1,81 @@
+#ifndef sql_cache_h
+#define sql_cache_h
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "sql.h"
+
+/*
+** A cache of query results, shared by every connection it is attached to.
+**
+** dbQueryCached looks up a result by its SQL and bound parameters and returns a copy
+** without touching SQLite. On a miss it runs the query with dbQueryRows and keeps the
+** result until it expires, is pushed out by the memory budget, or a table it read
+** from is written.
+**
+** The tables a query reads are found once per SQL text, with an authorizer while it is
+** prepared. Writes are seen through sqlite3_update_hook on every attached connection,
+** which marks the tables as changed both when a row is written and again when the
+** transaction ends, so a result read while the write was still uncommitted is not kept.
+** An authorizer on the attached connections turns off SQLite's truncate optimization,
+** so a DELETE without a WHERE clause also goes through the hook row by row.
+**
+** Writes the hook does not see, from another process, a DROP, a WITHOUT ROWID table or
+** a statement prepared before the cache was attached, are only picked up when entries
+** expire.
+*/
+
+#define DB_QUERY_CACHE_BUDGET (16 * 1024 * 1024)
+#define DB_QUERY_CACHE_TTL_MS 5000
+
+typedef struct DbQueryCache DbQueryCache;
+
+typedef struct {
+    unsigned long long hits;
+    unsigned long long misses;
+
+    // entries dropped because a table they read was written, because they expired, and
+    // to stay within the budget
+    unsigned long long invalidations;
+    unsigned long long expirations;
+    unsigned long long evictions;
+
+    size_t             bytes;
+    int                entries;
+} DbQueryCacheStats;
+
+// budget is the most bytes of results to keep, ttlMs how long a result is used for
+DbQueryCache *createDbQueryCache(size_t budget, int ttlMs);
+
+// the connections attached to the cache must be closed or detached first
+void freeDbQueryCache(DbQueryCache *cache);
+
+// watches db for writes and lets dbQueryCached on db use the cache. call it from the thread that
+// uses the connection, or before any thread does
+void dbAttachQueryCache(DbContext *db, DbQueryCache *cache);
+void dbDetachQueryCache(DbContext *db);
+
+// attaches the cache to every connection the pool has opened or will open, before the pool's
+// connections are in use
+void dbPoolUseQueryCache(DbPool *pool, DbQueryCache *cache);
+
+// as dbQueryRows, returning a cached copy when there is one. statements that write are never
+// cached. without a cache attached to db this is dbQueryRows
+DbResult *dbQueryCached(DbContext *db, const char *query, const DbParam *params, int paramCount);
+
+void dbQueryCacheClear(DbQueryCache *cache);
+DbQueryCacheStats dbQueryCacheStats(DbQueryCache *cache);
+
+// called once a statement on db has finished, to publish its writes if its transaction has ended
+void dbQueryCacheCommitted(DbContext *db);
+
+// puts back the authorizer the cache needs on db, or none when it has no cache, for code that sets
+// an authorizer of its own while it prepares a statement
+void dbQueryCacheAuthorize(DbContext *db);
+
+#ifndef SQL_NO_CALL_SITES
+#define dbQueryCached(...) (DB_CALL_SITE, dbQueryCached(__VA_ARGS__))
+#endif
+
+#endif
@@ -0,0 +1,47 @@
+#ifndef sql_json_h
+#define sql_json_h
+
+#include <stdbool.h>
+
+#include "sql.h"
+#include "json_writer.h"
+
+/*
+** Query results written straight to JSON.
+**
+** dbQueryJson steps a statement and writes every row as an object into a JsonWriter,
+** reading each column as its SQLite type, so values go from SQLite to the response
+** without a DbResult, a struct or a JsonBuilder in between.
+**
+**     JsonWriter writer = jsonWriter();
+**     dbQueryJson(ctx.db, "select id, title, completed from todos;", NULL, 0, &writer);
+**     return ok(jwTakeString(&writer), APPLICATION_JSON);
+**
+** writes [{"id":1,"title":"...","completed":false},...]. Integers and floats are written
+** as numbers, text as strings and NULL as null. Columns declared BOOL or BOOLEAN are
+** written as true or false, and blobs as base64 strings.
+*/
+
+// writes the rows as an array of objects. false if the query fails, in which case the array
+// holds the rows written before the failure
+bool dbQueryJson(DbContext *db, const char *query, const DbParam *params, int paramCount, JsonWriter *writer);
+
+// writes the first row as an object, or null when there are no rows
+bool dbQueryJsonObject(DbContext *db, const char *query, const DbParam *params, int paramCount, JsonWriter *writer);
+
+// sends the rows of a query on ctx.db as a chunked JSON array, e.g.
+//     appRoute(exportTodos, ctx) {
+//         return dbStreamJson(ctx, "select * from todos;", NULL, 0);
+//     }
+// rows are stepped only as fast as the client reads them, with one JSON_STREAM_BUFFER_SIZE
+// buffer however many there are, and stepping stops if the client disconnects. a query that
+// cannot be prepared returns a 500 response instead
+HttpResponse dbStreamJson(RequestContext ctx, const char *query, const DbParam *params, int paramCount);
+
+#ifndef SQL_NO_CALL_SITES
+#define dbQueryJson(...)       (DB_CALL_SITE, dbQueryJson(__VA_ARGS__))
+#define dbQueryJsonObject(...) (DB_CALL_SITE, dbQueryJsonObject(__VA_ARGS__))
+#define dbStreamJson(...)      (DB_CALL_SITE, dbStreamJson(__VA_ARGS__))
+#endif
+
+#endif
@@ -0,0 +1,56 @@
+#ifndef sql_plan_h
+#define sql_plan_h
+
+#include <stdio.h>
+
+#include "sql.h"
+
+/*
+** Checks the query plan of every distinct statement the first time a connection it is
+** attached to prepares it, and warns about plans that will not hold up on real data.
+**
+** Two things are reported: a full scan of a table by a statement with a WHERE clause,
+** which usually means a missing index, and a temporary B-tree for ORDER BY, GROUP BY or
+** DISTINCT over a table with DB_PLAN_LARGE_TABLE_ROWS rows or more. Each warning names
+** the file and line the query was run from.
+**
+** build turns it on in the DEVELOPMENT environment, and cleanupApp prints a summary of
+** every warning.
+*/
+
+// a temporary B-tree is only reported for tables with at least this many rows
+#define DB_PLAN_LARGE_TABLE_ROWS 1000
+
+typedef struct DbPlanChecker DbPlanChecker;
+
+typedef struct {
+    // the statement as it was prepared, and the step of its plan that was flagged
+    const char *sql;
+    const char *detail;
+
+    // where the query was run from, NULL when it is not known
+    const char *file;
+    int         line;
+} DbPlanWarning;
+
+// warnings are written to out as they are found, NULL for stderr
+DbPlanChecker *createDbPlanChecker(FILE *out);
+
+// the connections attached to the checker must be closed or detached first
+void freeDbPlanChecker(DbPlanChecker *checker);
+
+void dbAttachPlanChecker(DbContext *db, DbPlanChecker *checker);
+
+// attaches the checker to every connection the pool has opened or will open
+void dbPoolUsePlanChecker(DbPool *pool, DbPlanChecker *checker);
+
+// called when db prepares query without its statement cache, checks it if it is new
+void dbCheckPlan(DbContext *db, const char *query);
+
+// the warnings so far, valid until the next one is found
+int dbPlanWarnings(DbPlanChecker *checker, const DbPlanWarning **warnings);
+
+// writes how many statements were checked and every warning
+void dbPlanReport(DbPlanChecker *checker, FILE *out);
+
+#endif
@@ -0,0 +1,72 @@
+#ifndef sql_shard_h
+#define sql_shard_h
+
+#include <stdbool.h>
+
+#include "sql.h"
+#include "sql_writer.h"
+
+/*
+** One logical database split across several SQLite files, each with its own connection
+** pool for reads and its own writer. Every file has its own write lock and its own
+** commits, so writes to different shards do not wait for each other, and with the files on
+** different disks write throughput grows with the number of shards.
+**
+** A row lives on the shard its key picks, e.g. the tenant or owner id. Queries and writes
+** that know the key go to that shard alone. Queries without a key are run on every shard
+** and their rows returned together, so an ORDER BY, LIMIT or aggregate applies to each
+** shard on its own and has to be finished by the caller.
+**
+** Hash sharding spreads keys evenly with jump consistent hashing, so going from n to n + 1
+** shards only moves about 1 / (n + 1) of the keys. Range sharding keeps neighbouring
+** integer keys together and lets a new shard take over the keys above the last bound.
+*/
+
+typedef struct DbShards DbShards;
+
+// opens count shards, one for each path, that place keys by their hash
+DbShards *createDbShards(const char **paths, int count, DbPragmas pragmas);
+
+// opens count shards that place integer keys by range: keys below bounds[0] go to the first
+// shard, keys below bounds[1] to the second and so on, and the rest to the last one. bounds
+// holds count - 1 ascending values
+DbShards *createDbRangeShards(const char **paths, int count, const long long *bounds, DbPragmas pragmas);
+
+// frees the writers, then the pools. none of the connections may be in use
+void freeDbShards(DbShards *shards);
+
+int dbShardCount(DbShards *shards);
+
+// the shard key is placed on, -1 when it cannot be placed, e.g. a text key with range sharding.
+// integer, int64 and bool keys with the same value are placed together
+int dbShardIndex(DbShards *shards, DbParam key);
+
+// the pool and the writer of a shard, e.g. to attach stats to them
+DbPool *dbShardPool(DbShards *shards, int index);
+DbWriter *dbShardWriter(DbShards *shards, int index);
+
+// the calling thread's connection to the shard key is placed on, NULL if there is none
+DbContext *dbShardConnection(DbShards *shards, DbParam key);
+
+DbResult *dbShardQueryRows(DbShards *shards, DbParam key, const char *query, DbParam *params, int paramCount);
+
+// as dbWrite and dbWriteWith, on the writer of the shard key is placed on
+bool dbShardWrite(DbShards *shards, DbParam key, const char *query, const DbParam *params, int paramCount);
+bool dbShardWriteWith(DbShards *shards, DbParam key, DbWriteFunction function, void *userData);
+
+// runs query on every shard and returns all of their rows, in shard order
+DbResult *dbShardQueryAll(DbShards *shards, const char *query, DbParam *params, int paramCount);
+
+// runs a write on every shard, e.g. to create the schema. each shard commits on its own, so
+// when it fails on one shard the others may have it. false if any of them failed
+bool dbShardWriteAll(DbShards *shards, const char *query, const DbParam *params, int paramCount);
+
+#ifndef SQL_NO_CALL_SITES
+#define dbShardQueryRows(...) (DB_CALL_SITE, dbShardQueryRows(__VA_ARGS__))
+#define dbShardWrite(...)     (DB_CALL_SITE, dbShardWrite(__VA_ARGS__))
+#define dbShardWriteWith(...) (DB_CALL_SITE, dbShardWriteWith(__VA_ARGS__))
+#define dbShardQueryAll(...)  (DB_CALL_SITE, dbShardQueryAll(__VA_ARGS__))
+#define dbShardWriteAll(...)  (DB_CALL_SITE, dbShardWriteAll(__VA_ARGS__))
+#endif
+
+#endif
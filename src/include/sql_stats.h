@@ -0,0 +1,75 @@
+#ifndef sql_stats_h
+#define sql_stats_h
+
+#include <stdio.h>
+#include <stdbool.h>
+
+#include "sql.h"
+
+/*
+** Timing statistics for every statement run on the connections they are attached to.
+**
+** Statements are timed through sqlite3_trace_v2, from the event at their first step to
+** the profile event when they finish, so dbExec, dbQueryRows, cursors and the JSON
+** writers are all covered without timing code of their own.
+**
+** Statements are grouped by their SQL with string and number literals replaced by '?',
+** so queries built with literals in them still add up to one entry.
+**
+** A statement slower than the threshold is also written to the slow query log, with its
+** bound parameters filled in.
+*/
+
+// statements at least this slow are written to the slow query log
+#define DB_SLOW_QUERY_MS 100
+
+// distinct statements tracked, later ones are counted together under "(other)"
+#define DB_STATS_MAX_STATEMENTS 1024
+
+typedef struct DbStats DbStats;
+
+typedef struct {
+    // the normalized SQL
+    const char        *sql;
+
+    unsigned long long calls;
+    unsigned long long rows;
+
+    double             totalMs;
+    double             meanMs;
+    double             maxMs;
+
+    // from a histogram, within an eighth of the real value
+    double             p99Ms;
+} DbStatementStats;
+
+// slowMs is the slow query threshold, a negative one turns the log off. slowLog is where slow
+// statements are written, NULL for stderr
+DbStats *createDbStats(double slowMs, FILE *slowLog);
+
+// the connections attached to stats must be closed or detached first
+void freeDbStats(DbStats *stats);
+
+// times every statement run on db from now on. call it from the thread that uses the
+// connection, or before any thread does
+void dbAttachStats(DbContext *db, DbStats *stats);
+void dbDetachStats(DbContext *db);
+
+// attaches stats to every connection the pool has opened or will open, before the pool's
+// connections are in use
+void dbPoolUseStats(DbPool *pool, DbStats *stats);
+
+// the statements seen so far, most total time first. the array and its strings are a single
+// allocation, freed with free
+int dbStatsStatements(DbStats *stats, DbStatementStats **statements);
+
+// writes a table of the statements, most total time first
+void dbStatsDump(DbStats *stats, FILE *out);
+
+void dbStatsReset(DbStats *stats);
+
+// replaces literals with '?' and runs of whitespace with a single space. out holds at least
+// strlen(sql) + 1 bytes
+void dbNormalizeSql(const char *sql, char *out);
+
+#endif
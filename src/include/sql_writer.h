@@ -0,0 +1,80 @@
+#ifndef sql_writer_h
+#define sql_writer_h
+
+#include <stdbool.h>
+
+#include "sql.h"
+#include "sql_cache.h"
+#include "sql_stats.h"
+#include "sql_plan.h"
+
+/*
+** A single writer thread with its own connection, which runs the writes queued by
+** request threads in batches.
+**
+** SQLite allows one writer at a time, and every autocommit statement is a transaction
+** of its own with a sync at commit. The writer instead takes everything that has queued
+** up, runs it all in one BEGIN ... COMMIT and then wakes each caller with its own result.
+** While writes are arriving together it also waits DB_WRITER_BATCH_WINDOW_US after the
+** first one for more to join the batch. Concurrent writers never see SQLITE_BUSY from
+** each other and share the cost of each commit.
+**
+** Each write in a batch runs inside a savepoint, so a write that fails is rolled back on
+** its own without failing the others. A failure that ends the whole transaction, such as
+** INSERT OR ROLLBACK or a full disk, fails every write in its batch, and none of them
+** are written.
+*/
+
+// how long the writer waits after the first queued write for others to join its batch
+#define DB_WRITER_BATCH_WINDOW_US 500
+
+// writes run in a single transaction at most
+#define DB_WRITER_MAX_BATCH 1024
+
+typedef struct DbWriter DbWriter;
+
+// runs on the writer's connection inside a batch, returning false rolls back what it did. it must
+// not end the batch's transaction itself. it runs on the writer's thread, so it must not build or
+// parse JSON: the key and shape tables of json_shape.h are not locked and belong to the server's
+// thread
+typedef bool (*DbWriteFunction)(DbContext *db, void *userData);
+
+typedef struct {
+    unsigned long long writes;
+    unsigned long long batches;
+    unsigned long long failed;
+} DbWriterStats;
+
+// opens the writer's connection to dbPath with the given pragmas and starts its thread
+DbWriter *createDbWriter(const char *dbPath, DbPragmas pragmas);
+
+// queues a statement and waits until the batch holding it has committed. params are used
+// where they are, since they stay alive until the call returns. false if the statement or
+// the commit failed
+bool dbWrite(DbWriter *writer, const char *query, const DbParam *params, int paramCount);
+
+// as dbWrite, but runs function on the writer's connection, e.g. to write several rows or
+// read back an id with sqlite3_last_insert_rowid
+bool dbWriteWith(DbWriter *writer, DbWriteFunction function, void *userData);
+
+// invalidates the results in cache that the writes read from, see sql_cache.h
+void dbWriterUseQueryCache(DbWriter *writer, DbQueryCache *cache);
+
+// times the writes with stats, see sql_stats.h
+void dbWriterUseStats(DbWriter *writer, DbStats *stats);
+
+// checks the plans of the writes with checker, see sql_plan.h
+void dbWriterUsePlanChecker(DbWriter *writer, DbPlanChecker *checker);
+
+DbWriterStats dbWriterStats(DbWriter *writer);
+
+// runs what is still queued, then stops the thread and closes the connection
+void freeDbWriter(DbWriter *writer);
+
+// the call site travels with the write to the writer's thread
+#ifndef SQL_NO_CALL_SITES
+#define dbWrite(...)     (DB_CALL_SITE, dbWrite(__VA_ARGS__))
+#define dbWriteWith(...) (DB_CALL_SITE, dbWriteWith(__VA_ARGS__))
+#endif
+
+#endif
@@ -1,6 +1,26 @@
 #ifndef utils_h
 #define utils_h
 
+#include <stddef.h>
+
 char *readFile(const char *filename);
 
+// zeroed memory, exits when out of memory
+void *allocate(size_t size);
+
+// doubles *capacity, starting at 16, and reallocates items to that many items of size bytes.
+// exits when out of memory
+void *growArray(void *items, int *capacity, size_t size);
+
+// realloc, exits when out of memory
+void *reallocate(void *memory, size_t size);
+
+// a copy of str, "" for NULL. exits when out of memory
+char *copyString(const char *str);
+
+// 32 and 64 bit FNV-1a
+unsigned int hashBytes(const void *bytes, size_t length);
+unsigned int hashString(const char *str);
+unsigned long long hashBytes64(const void *bytes, size_t length);
+
 #endif
\ No newline at end of file
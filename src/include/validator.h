@@ -1,26 +1,92 @@
 #ifndef validator_h
 #define validator_h
 
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "json.h"
+
+/*
+** Request body validation.
+**
+** Rules are added to a validator once, usually at startup, and compiled into a
+** schema tree the first time it is used. validate() then checks the raw body text
+** against the schema in a single pass, before the body is parsed and without
+** building anything, stopping at the first problem. A validator is not changed by
+** validating, so the same one can be used for every request.
+**
+** Fields are dotted paths into nested objects, e.g. "address.city".
+*/
+
+typedef enum {
+    JSON_RULE_REQUIRED,
+    JSON_RULE_STRING,
+    JSON_RULE_INTEGER,
+    JSON_RULE_NUMBER,
+    JSON_RULE_BOOL,
+    JSON_RULE_ENUM,
+    JSON_RULE_OBJECT,
+    JSON_RULE_ARRAY,
+} JsonRuleType;
+
 typedef struct {
-    char *field;
-    char *message;
+    char         *field;
+    char         *message;
+    JsonRuleType  type;
+
+    // string length in characters, array length, or integer range
+    long long     min;
+    long long     max;
+
+    // number range
+    double        minNumber;
+    double        maxNumber;
+
+    // allowed strings of an enum rule
+    char        **values;
+    int           valueCount;
 } JsonValidationRule;
 
+typedef struct JsonSchemaNode JsonSchemaNode;
+
 typedef struct {
     JsonValidationRule *rules;
     int                 ruleCount;
     int                 ruleCapacity;
 
+    // bodies longer than this are rejected without being read, 0 for no limit
+    size_t              maxLength;
+
+    // compiled from the rules on first use, and again after rules are added
+    JsonSchemaNode     *schema;
+    unsigned int        generation;
+
     char               *error;
 } JsonValidator;
 
 JsonValidator createValidator();
 void freeValidator(JsonValidator *validator);
 
+// a required field with a custom message
 void addRule(JsonValidator *v, const char *field, const char *message);
-bool validate(JsonValidator *v, JsonBuilder *body);
 
 void required(JsonValidator *v, const char *field);
+void isString(JsonValidator *v, const char *field, size_t minLength, size_t maxLength);
+void isInteger(JsonValidator *v, const char *field, long long min, long long max);
+void isNumber(JsonValidator *v, const char *field, double min, double max);
+void isBool(JsonValidator *v, const char *field);
+void isOneOf(JsonValidator *v, const char *field, const char **values, int count);
+void isObject(JsonValidator *v, const char *field);
+void isArray(JsonValidator *v, const char *field, size_t maxItems);
+void maxBodyLength(JsonValidator *v, size_t length);
+
+// builds the schema now rather than on the first request
+void compileValidator(JsonValidator *v);
+
+// false with v->error set if the body is missing, malformed or breaks a rule
+bool validate(JsonValidator *v, JsonBuilder *body);
+bool validateJson(JsonValidator *v, const char *json, size_t length);
+
 bool validateRequired(JsonBuilder *builder, char *field);
 
 #endif
\ No newline at end of file
@@ -5,5 +5,9 @@ middleware(validateJsonBody, ctx, m) {
         return apiFailure("Error: no JSON body provided.");
     }
 
+    if (!jsonResolve(ctx.body)) {
+        return apiFailure("Error: request body is not a JSON object.");
+    }
+
     return next(ctx, m);
 }
\ No newline at end of file
@@ -29,4 +29,79 @@ char *readFile(const char *path) {
     fclose(fptr);
 
     return buff;
+}
+
+void *allocate(size_t size) {
+    void *memory = calloc(1, size);
+    if (!memory) {
+        fprintf(stderr, "Fatal: out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+
+    return memory;
+}
+
+void *growArray(void *items, int *capacity, size_t size) {
+    *capacity = *capacity ? *capacity * 2 : 16;
+
+    void *grown = realloc(items, (size_t)*capacity * size);
+    if (!grown) {
+        fprintf(stderr, "Fatal: out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+
+    return grown;
+}
+
+void *reallocate(void *memory, size_t size) {
+    void *moved = realloc(memory, size);
+    if (!moved) {
+        fprintf(stderr, "Fatal: out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+
+    return moved;
+}
+
+char *copyString(const char *str) {
+    char *copy = strdup(str ? str : "");
+    if (!copy) {
+        fprintf(stderr, "Fatal: out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+
+    return copy;
+}
+
+unsigned int hashBytes(const void *bytes, size_t length) {
+    unsigned int hash = 2166136261u;
+
+    for (size_t i = 0; i < length; i++) {
+        hash ^= ((const unsigned char *)bytes)[i];
+        hash *= 16777619u;
+    }
+
+    return hash;
+}
+
+unsigned int hashString(const char *str) {
+    unsigned int hash = 2166136261u;
+
+    for (const unsigned char *p = (const unsigned char *)str; *p; p++) {
+        hash ^= *p;
+        hash *= 16777619u;
+    }
+
+    return hash;
+}
+
+unsigned long long hashBytes64(const void *bytes, size_t length) {
+    unsigned long long hash = 14695981039346656037ULL;
+
+    for (size_t i = 0; i < length; i++) {
+        hash ^= ((const unsigned char *)bytes)[i];
+        hash *= 1099511628211ULL;
+    }
+
+    return hash;
 }
\ No newline at end of file
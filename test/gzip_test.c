@@ -0,0 +1,112 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <zlib.h>
+#include "../src/include/lavandula_test.h"
+#include "../src/include/gzip.h"
+
+static char *gzipCompress(const char *data, size_t length, size_t *outLength) {
+    z_stream stream = {0};
+    deflateInit2(&stream, Z_BEST_COMPRESSION, Z_DEFLATED, 16 + MAX_WBITS, 8, Z_DEFAULT_STRATEGY);
+
+    size_t capacity = deflateBound(&stream, length);
+    char *out = malloc(capacity);
+
+    stream.next_in = (Bytef *)data;
+    stream.avail_in = length;
+    stream.next_out = (Bytef *)out;
+    stream.avail_out = capacity;
+
+    deflate(&stream, Z_FINISH);
+    *outLength = capacity - stream.avail_out;
+    deflateEnd(&stream);
+
+    return out;
+}
+
+void testGzipInflateRoundTrip() {
+    const char *json = "{\"events\": [{\"name\": \"open\"}, {\"name\": \"close\"}]}";
+
+    size_t compressedLength;
+    char *compressed = gzipCompress(json, strlen(json), &compressedLength);
+
+    char *inflated;
+    size_t inflatedLength;
+    GzipStatus status = gzipInflate(compressed, compressedLength, MAX_INFLATED_BODY_SIZE, &inflated, &inflatedLength);
+
+    expect(status, toBe(GZIP_OK));
+    expect(inflatedLength, toBe(strlen(json)));
+    expect(strcmp(inflated, json), toBe(0));
+
+    free(inflated);
+    free(compressed);
+}
+
+void testGzipInflateRejectsGarbage() {
+    char *inflated;
+    size_t inflatedLength;
+    GzipStatus status = gzipInflate("{\"not\": \"gzip\"}", 15, MAX_INFLATED_BODY_SIZE, &inflated, &inflatedLength);
+
+    expect(status, toBe(GZIP_INVALID));
+    expectNull(inflated);
+}
+
+void testGzipInflateRejectsTruncatedStream() {
+    const char *text = "lavandula lavandula lavandula lavandula";
+
+    size_t compressedLength;
+    char *compressed = gzipCompress(text, strlen(text), &compressedLength);
+
+    char *inflated;
+    size_t inflatedLength;
+    GzipStatus status = gzipInflate(compressed, compressedLength / 2, MAX_INFLATED_BODY_SIZE, &inflated, &inflatedLength);
+
+    expect(status, toBe(GZIP_INVALID));
+
+    free(compressed);
+}
+
+void testGzipInflateEnforcesSizeCap() {
+    char text[4096];
+    for (size_t i = 0; i < sizeof(text); i++) {
+        text[i] = 'a' + (i * 7) % 26;
+    }
+
+    size_t compressedLength;
+    char *compressed = gzipCompress(text, sizeof(text), &compressedLength);
+
+    char *inflated;
+    size_t inflatedLength;
+    GzipStatus status = gzipInflate(compressed, compressedLength, 1024, &inflated, &inflatedLength);
+
+    expect(status, toBe(GZIP_TOO_LARGE));
+    expectNull(inflated);
+
+    free(compressed);
+}
+
+void testGzipInflateEnforcesRatioCap() {
+    size_t length = 4 * 1024 * 1024;
+    char *zeros = calloc(length, 1);
+
+    size_t compressedLength;
+    char *compressed = gzipCompress(zeros, length, &compressedLength);
+
+    char *inflated;
+    size_t inflatedLength;
+    GzipStatus status = gzipInflate(compressed, compressedLength, MAX_INFLATED_BODY_SIZE, &inflated, &inflatedLength);
+
+    expect(status, toBe(GZIP_TOO_LARGE));
+
+    free(compressed);
+    free(zeros);
+}
+
+void runGzipTests() {
+    runTest(testGzipInflateRoundTrip);
+    runTest(testGzipInflateRejectsGarbage);
+    runTest(testGzipInflateRejectsTruncatedStream);
+    runTest(testGzipInflateEnforcesSizeCap);
+    runTest(testGzipInflateEnforcesRatioCap);
+    freeGzipInflater();
+}
@@ -0,0 +1,130 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../src/include/lavandula_test.h"
+#include "../src/include/json_cursor.h"
+
+static const char *document =
+    "{\"skip\": {\"deep\": [1, {\"x\": \"}]\\\"\"}], \"n\": null}, "
+    "\"user\": {\"name\": \"Ada \\\"L\\\"\", \"id\": -42, \"admin\": true}, "
+    "\"todos\": [{\"title\": \"a\"}, {\"title\": \"caf\\u00e9\"}]}";
+
+void testJsonCursorSeeksNestedKey() {
+    JsonCursor cursor = jsonCursor(document, strlen(document));
+
+    expect(jsonCursorSeek(&cursor, "$.user.id"), toBe(true));
+    expect(jsonCursorType(&cursor), toBe(JSON_NUMBER));
+
+    long long id = 0;
+    expect(jsonCursorInteger(&cursor, &id), toBe(true));
+    expect(id, toBe(-42));
+}
+
+void testJsonCursorSeeksArrayIndex() {
+    JsonCursor cursor = jsonCursor(document, strlen(document));
+
+    expect(jsonCursorSeek(&cursor, "todos[1].title"), toBe(true));
+
+    char title[16];
+    expect(jsonCursorString(&cursor, title, sizeof(title)), toBe(true));
+    expect(strcmp(title, "caf\xc3\xa9"), toBe(0));
+}
+
+void testJsonCursorRelativeSeeks() {
+    JsonCursor cursor = jsonCursor(document, strlen(document));
+
+    expect(jsonCursorSeek(&cursor, "user"), toBe(true));
+
+    JsonCursor name = cursor;
+    expect(jsonCursorSeek(&name, "name"), toBe(true));
+
+    size_t length = 0;
+    const char *raw = jsonCursorRawString(&name, &length);
+    expect(length, toBe(9));
+    expect(strncmp(raw, "Ada \\\"L\\\"", length), toBe(0));
+
+    bool admin = false;
+    expect(jsonCursorSeek(&cursor, "admin"), toBe(true));
+    expect(jsonCursorBool(&cursor, &admin), toBe(true));
+    expect(admin, toBe(true));
+}
+
+void testJsonCursorMissingPath() {
+    JsonCursor cursor = jsonCursor(document, strlen(document));
+
+    expect(jsonCursorSeek(&cursor, "user.email"), toBe(false));
+    expect(cursor.failed, toBe(true));
+    expect(jsonCursorSeek(&cursor, "user"), toBe(false));
+
+    JsonCursor outOfRange = jsonCursor(document, strlen(document));
+    expect(jsonCursorSeek(&outOfRange, "todos[2]"), toBe(false));
+
+    JsonCursor wrongType = jsonCursor(document, strlen(document));
+    expect(jsonCursorSeek(&wrongType, "user[0]"), toBe(false));
+}
+
+void testJsonCursorRejectsTrailingBytes() {
+    const char *json = "{\"a\": 12abc, \"b\": txyz, \"c\": 1.5}";
+
+    JsonCursor cursor = jsonCursor(json, strlen(json));
+    expect(jsonCursorSeek(&cursor, "a"), toBe(true));
+
+    long long integer = 0;
+    double number = 0;
+    expect(jsonCursorInteger(&cursor, &integer), toBe(false));
+    expect(jsonCursorDouble(&cursor, &number), toBe(false));
+    expect(jsonCursorType(&cursor), toBe(JSON_NULL));
+
+    cursor = jsonCursor(json, strlen(json));
+    expect(jsonCursorSeek(&cursor, "b"), toBe(true));
+
+    bool flag;
+    expect(jsonCursorType(&cursor), toBe(JSON_NULL));
+    expect(jsonCursorBool(&cursor, &flag), toBe(false));
+
+    // a value at the very end of the input, or before '}', is complete
+    cursor = jsonCursor(json, strlen(json));
+    expect(jsonCursorSeek(&cursor, "c"), toBe(true));
+    expect(jsonCursorDouble(&cursor, &number), toBe(true));
+
+    cursor = jsonCursor("true", 4);
+    expect(jsonCursorBool(&cursor, &flag), toBe(true));
+    expect(flag, toBe(true));
+}
+
+void testJsonCursorSeeksEscapedKeys() {
+    const char *key = "customer_shipping_address_postal_code_value";
+
+    // every character of the key escaped, longer than 256 bytes
+    char json[512];
+    char *end = json + sprintf(json, "{\"");
+    for (const char *c = key; *c; c++) end += sprintf(end, "\\u%04x", *c);
+    sprintf(end, "\": 7, \"\\ud83d\\ude00x\": 8}");
+
+    long long value = 0;
+    JsonCursor cursor = jsonCursor(json, strlen(json));
+    expect(jsonCursorSeek(&cursor, key), toBe(true));
+    expect(jsonCursorInteger(&cursor, &value), toBe(true));
+    expect(value, toBe(7));
+
+    cursor = jsonCursor(json, strlen(json));
+    expect(jsonCursorSeek(&cursor, "\xf0\x9f\x98\x80x"), toBe(true));
+    expect(jsonCursorInteger(&cursor, &value), toBe(true));
+    expect(value, toBe(8));
+
+    // a prefix or an extension of an escaped key is another key
+    cursor = jsonCursor(json, strlen(json));
+    expect(jsonCursorSeek(&cursor, "customer_shipping_address"), toBe(false));
+
+    cursor = jsonCursor(json, strlen(json));
+    expect(jsonCursorSeek(&cursor, "\xf0\x9f\x98\x80xy"), toBe(false));
+}
+
+void runJsonCursorTests() {
+    runTest(testJsonCursorSeeksNestedKey);
+    runTest(testJsonCursorSeeksArrayIndex);
+    runTest(testJsonCursorRelativeSeeks);
+    runTest(testJsonCursorMissingPath);
+    runTest(testJsonCursorRejectsTrailingBytes);
+    runTest(testJsonCursorSeeksEscapedKeys);
+}
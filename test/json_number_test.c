@@ -0,0 +1,128 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../src/include/lavandula_test.h"
+#include "../src/include/json_number.h"
+#include "../src/include/json.h"
+#include "../src/include/json_writer.h"
+
+static bool parsesTo(const char *str, double expected) {
+    JsonNumber number;
+    size_t used = jsonParseNumber(str, strlen(str), &number);
+
+    return used == strlen(str) && !number.isInteger && number.number == expected;
+}
+
+static bool formatsAs(double value, const char *expected) {
+    char buffer[JSON_DOUBLE_MAX_LENGTH + 1];
+    int length = jsonFormatDouble(value, buffer);
+    buffer[length] = '\0';
+
+    return strcmp(buffer, expected) == 0;
+}
+
+void testJsonParseIntegers() {
+    JsonNumber number;
+
+    expect(jsonParseNumber("9223372036854775807", 19, &number), toBe(19));
+    expect(number.isInteger, toBe(true));
+    expect(number.integer == 9223372036854775807LL, toBe(true));
+
+    expect(jsonParseNumber("-9223372036854775808", 20, &number), toBe(20));
+    expect(number.isInteger, toBe(true));
+    expect(number.integer == (-9223372036854775807LL - 1), toBe(true));
+
+    // too large for a long long
+    expect(jsonParseNumber("9223372036854775808", 19, &number), toBe(19));
+    expect(number.isInteger, toBe(false));
+    expect(number.number == 9223372036854775808.0, toBe(true));
+
+    // stops at the end of the number
+    expect(jsonParseNumber("42,", 3, &number), toBe(2));
+    expect(number.integer, toBe(42));
+}
+
+void testJsonParseDoubles() {
+    expect(parsesTo("12.5", 12.5), toBe(true));
+    expect(parsesTo("-0.1", -0.1), toBe(true));
+    expect(parsesTo("1e-5", 1e-5), toBe(true));
+    expect(parsesTo("1E+23", 1e23), toBe(true));
+    expect(parsesTo("2.2250738585072014e-308", 2.2250738585072014e-308), toBe(true));
+    expect(parsesTo("1.7976931348623157e308", 1.7976931348623157e308), toBe(true));
+    expect(parsesTo("3.141592653589793238462643383279", 3.141592653589793), toBe(true));
+    expect(parsesTo("4.9e-324", 4.9e-324), toBe(true));
+}
+
+void testJsonParseRejectsMalformedNumbers() {
+    const char *invalid[] = { "-", "01", "1.", ".5", "1e", "1e+", "+1", "--1" };
+    JsonNumber number;
+
+    for (size_t i = 0; i < sizeof(invalid) / sizeof(invalid[0]); i++) {
+        size_t used = jsonParseNumber(invalid[i], strlen(invalid[i]), &number);
+        expect(used == strlen(invalid[i]), toBe(false));
+    }
+}
+
+void testJsonFormatDoubles() {
+    expect(formatsAs(0.1, "0.1"), toBe(true));
+    expect(formatsAs(12.5, "12.5"), toBe(true));
+    expect(formatsAs(100.0, "100.0"), toBe(true));
+    expect(formatsAs(-0.0, "-0.0"), toBe(true));
+    expect(formatsAs(1.5e-7, "1.5e-7"), toBe(true));
+    expect(formatsAs(0.001234, "0.001234"), toBe(true));
+    expect(formatsAs(1e21, "1e21"), toBe(true));
+    expect(formatsAs(0.30000000000000004, "0.30000000000000004"), toBe(true));
+    expect(formatsAs(1.7976931348623157e308, "1.7976931348623157e308"), toBe(true));
+    expect(formatsAs(5e-324, "5e-324"), toBe(true));
+}
+
+void testJsonFormatRoundTrips() {
+    double values[] = { 3.141592653589793, 2.718281828459045e-100, 123456.789, 9007199254740993.0, 6.02214076e23 };
+
+    for (size_t i = 0; i < sizeof(values) / sizeof(values[0]); i++) {
+        char buffer[JSON_DOUBLE_MAX_LENGTH];
+        int length = jsonFormatDouble(values[i], buffer);
+
+        JsonNumber number;
+        expect(jsonParseNumber(buffer, length, &number), toBe((size_t)length));
+        expect(number.number == values[i], toBe(true));
+    }
+}
+
+void testJsonNumberMembers() {
+    JsonBuilder *builder = jsonParse("{\"price\": 12.5, \"id\": 9007199254740993, \"count\": 3}");
+
+    expect(jsonGetDouble(builder, "price") == 12.5, toBe(true));
+    expect(jsonGetDouble(builder, "count") == 3.0, toBe(true));
+    expect(jsonGetInteger64(builder, "id") == 9007199254740993LL, toBe(true));
+    expect(jsonGetInteger(builder, "price"), toBe(0));
+
+    jsonPutDouble(builder, "ratio", 0.25);
+    jsonPutInteger64(builder, "total", -5000000000LL);
+
+    char *json = jsonStringify(builder);
+    expect(strcmp(json, "{\"price\": 12.5, \"id\": 9007199254740993, \"count\": 3, \"ratio\": 0.25, \"total\": -5000000000}"), toBe(0));
+
+    free(json);
+    freeJsonBuilder(builder);
+
+    JsonWriter writer = jsonWriter();
+    jwArrayStart(&writer);
+    jwDouble(&writer, 1.0 / 3.0);
+    jwDouble(&writer, 0.0 / 0.0);
+    jwArrayEnd(&writer);
+
+    json = jwTakeString(&writer);
+    expect(strcmp(json, "[0.3333333333333333,null]"), toBe(0));
+
+    free(json);
+}
+
+void runJsonNumberTests() {
+    runTest(testJsonParseIntegers);
+    runTest(testJsonParseDoubles);
+    runTest(testJsonParseRejectsMalformedNumbers);
+    runTest(testJsonFormatDoubles);
+    runTest(testJsonFormatRoundTrips);
+    runTest(testJsonNumberMembers);
+}
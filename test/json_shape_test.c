@@ -0,0 +1,123 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../src/include/lavandula_test.h"
+#include "../src/include/json.h"
+#include "../src/include/json_shape.h"
+
+static JsonBuilder *todo(int id, const char *title) {
+    JsonBuilder *builder = jsonBuilder();
+    jsonPutInteger(builder, "id", id);
+    jsonPutString(builder, "title", (char *)title);
+    jsonPutBool(builder, "completed", false);
+
+    return builder;
+}
+
+void testJsonInternKey() {
+    char key[] = "title";
+
+    const char *first = jsonInternKey("title", 5);
+    const char *second = jsonInternKey(key, strlen(key));
+
+    expect(first == second, toBe(true));
+    expect(first != key, toBe(true));
+    expect(strcmp(first, "title"), toBe(0));
+    expect(jsonInternKey("titles", 5) == first, toBe(true));
+    expect(jsonInternKey("titles", 6) == first, toBe(false));
+
+    char longKey[JSON_INTERN_MAX_KEY_LENGTH + 2];
+    memset(longKey, 'k', sizeof(longKey) - 1);
+    longKey[sizeof(longKey) - 1] = '\0';
+
+    expect(jsonInternKey(longKey, strlen(longKey)) == NULL, toBe(true));
+}
+
+void testJsonObjectsShareKeysAndShape() {
+    JsonBuilder *first = todo(1, "Write tests");
+    JsonBuilder *second = todo(2, "Ship it");
+
+    expect(first->shape != NULL, toBe(true));
+    expect(first->shape == second->shape, toBe(true));
+    expect(first->shape->count, toBe(3));
+    expect(first->json[1].key == second->json[1].key, toBe(true));
+    expect(first->json[1].ownsKey, toBe(false));
+
+    // same keys in another order is another shape
+    JsonBuilder *reordered = jsonBuilder();
+    jsonPutString(reordered, "title", "Reordered");
+    jsonPutInteger(reordered, "id", 3);
+    jsonPutBool(reordered, "completed", true);
+
+    expect(reordered->shape != first->shape, toBe(true));
+    expect(jsonGetInteger(reordered, "id"), toBe(3));
+
+    freeJsonBuilder(first);
+    freeJsonBuilder(second);
+    freeJsonBuilder(reordered);
+}
+
+void testJsonWideObjectsShareIndex() {
+    JsonBuilder *builders[3];
+    char key[16];
+
+    for (int b = 0; b < 3; b++) {
+        builders[b] = jsonBuilder();
+
+        for (int i = 0; i < 40; i++) {
+            snprintf(key, sizeof(key), "column%d", i);
+            jsonPutInteger(builders[b], key, b * 100 + i);
+        }
+    }
+
+    expect(jsonGetInteger(builders[0], "column39"), toBe(39));
+    expect(jsonGetInteger(builders[2], "column17"), toBe(217));
+    expect(jsonHasKey(builders[1], "column40"), toBe(false));
+
+    expect(builders[0]->shape->index != NULL, toBe(true));
+    expect(builders[2]->index == NULL, toBe(true));
+
+    for (int b = 0; b < 3; b++) {
+        freeJsonBuilder(builders[b]);
+    }
+}
+
+void testJsonLongKeysAreCopied() {
+    char key[JSON_INTERN_MAX_KEY_LENGTH + 11];
+    memset(key, 'a', sizeof(key) - 1);
+    key[sizeof(key) - 1] = '\0';
+
+    JsonBuilder *builder = jsonBuilder();
+    jsonPutInteger(builder, "id", 1);
+    jsonPutString(builder, key, "long");
+
+    expect(builder->json[1].ownsKey, toBe(true));
+    expect(builder->shape == NULL, toBe(true));
+    expect(strcmp(jsonGetString(builder, key), "long"), toBe(0));
+
+    jsonPutInteger(builder, "after", 2);
+    expect(jsonGetInteger(builder, "after"), toBe(2));
+
+    freeJsonBuilder(builder);
+}
+
+void testJsonParsedObjectKeysAfterChange() {
+    JsonBuilder *builder = jsonParse("{\"id\": 7, \"title\": \"parsed\"}");
+
+    jsonPutBool(builder, "completed", true);
+
+    char *json = jsonStringify(builder);
+    expect(strcmp(json, "{\"id\": 7, \"title\": \"parsed\", \"completed\": true}"), toBe(0));
+    expect(builder->shape == NULL, toBe(true));
+
+    free(json);
+    freeJsonBuilder(builder);
+}
+
+void runJsonShapeTests() {
+    runTest(testJsonInternKey);
+    runTest(testJsonObjectsShareKeysAndShape);
+    runTest(testJsonWideObjectsShareIndex);
+    runTest(testJsonLongKeysAreCopied);
+    runTest(testJsonParsedObjectKeysAfterChange);
+}
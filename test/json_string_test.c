@@ -0,0 +1,130 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../src/include/lavandula_test.h"
+#include "../src/include/json_string.h"
+#include "../src/include/json_tape.h"
+#include "../src/include/json_writer.h"
+
+// pads bytes with ASCII on both sides so the check also runs through the vectorized path
+static bool validPadded(const char *bytes, size_t before, size_t after) {
+    size_t length = strlen(bytes);
+    char *buffer = malloc(before + length + after);
+
+    memset(buffer, 'a', before);
+    memcpy(buffer + before, bytes, length);
+    memset(buffer + before + length, 'a', after);
+
+    bool valid = jsonValidUtf8(buffer, before + length + after);
+    free(buffer);
+
+    return valid;
+}
+
+static bool parses(const char *json) {
+    JsonDocument *document = jsonParseDocument(json, strlen(json));
+    if (!document) return false;
+
+    freeJsonDocument(document);
+    return true;
+}
+
+void testJsonFindEscape() {
+    expect(jsonFindEscape("", 0), toBe(0));
+    expect(jsonFindEscape("hello", 5), toBe(5));
+    expect(jsonFindEscape("a\"b", 3), toBe(1));
+    expect(jsonFindEscape("ab\\", 3), toBe(2));
+    expect(jsonFindEscape("\x1f", 1), toBe(0));
+
+    // bytes past ASCII are copied as they are
+    expect(jsonFindEscape("caf\xc3\xa9\x7f", 6), toBe(6));
+
+    char buffer[200];
+    memset(buffer, 'x', sizeof(buffer));
+    expect(jsonFindEscape(buffer, sizeof(buffer)), toBe(sizeof(buffer)));
+
+    size_t positions[] = { 0, 15, 16, 31, 32, 63, 64, 100, 199 };
+    for (size_t i = 0; i < sizeof(positions) / sizeof(positions[0]); i++) {
+        memset(buffer, 'x', sizeof(buffer));
+        buffer[positions[i]] = '\n';
+        expect(jsonFindEscape(buffer, sizeof(buffer)), toBe(positions[i]));
+    }
+}
+
+void testJsonValidUtf8() {
+    size_t paddings[] = { 0, 1, 30, 31, 62, 63, 64, 100 };
+
+    for (size_t i = 0; i < sizeof(paddings) / sizeof(paddings[0]); i++) {
+        size_t pad = paddings[i];
+
+        expect(validPadded("", pad, pad), toBe(true));
+        expect(validPadded("caf\xc3\xa9", pad, pad), toBe(true));
+        expect(validPadded("\xe2\x82\xac \xf0\x9f\x98\x80", pad, pad), toBe(true));
+        expect(validPadded("\xef\xbf\xbf\xf4\x8f\xbf\xbf", pad, pad), toBe(true));
+
+        // overlong encodings
+        expect(validPadded("\xc0\x80", pad, pad), toBe(false));
+        expect(validPadded("\xe0\x80\xaf", pad, pad), toBe(false));
+        expect(validPadded("\xf0\x80\x80\xaf", pad, pad), toBe(false));
+
+        // surrogates and code points past U+10FFFF
+        expect(validPadded("\xed\xa0\x80", pad, pad), toBe(false));
+        expect(validPadded("\xf4\x90\x80\x80", pad, pad), toBe(false));
+        expect(validPadded("\xf5\x80\x80\x80", pad, pad), toBe(false));
+
+        // stray continuation bytes and truncated sequences
+        expect(validPadded("\x80", pad, pad), toBe(false));
+        expect(validPadded("\xc3", pad, pad), toBe(false));
+        expect(validPadded("\xe2\x82", pad, pad), toBe(false));
+        expect(validPadded("\xf0\x9f\x98", pad, pad), toBe(false));
+
+        // truncated right at the end of the input
+        expect(validPadded("\xe2\x82", pad, 0), toBe(false));
+        expect(validPadded("\xf0\x9f\x98", pad, 0), toBe(false));
+    }
+}
+
+void testJsonParseRejectsBadStrings() {
+    expect(parses("[\"caf\xc3\xa9\", \"\\u00e9\\n\"]"), toBe(true));
+
+    expect(parses("[\"line\nbreak\"]"), toBe(false));
+    expect(parses("[\"tab\there\"]"), toBe(false));
+    expect(parses("[\"\xc3\x28\"]"), toBe(false));
+    expect(parses("{\"\xed\xa0\x80\": 1}"), toBe(false));
+    expect(parses("[\"\\x\"]"), toBe(false));
+}
+
+void testJsonWriterEscapesLongStrings() {
+    char text[150];
+    memset(text, 'a', sizeof(text) - 1);
+    text[sizeof(text) - 1] = '\0';
+
+    text[5] = '"';
+    text[70] = '\n';
+    text[140] = '\x01';
+
+    JsonWriter writer = jsonWriter();
+    jwString(&writer, text);
+
+    char *json = jwTakeString(&writer);
+    expect(strlen(json), toBe(sizeof(text) - 1 + 2 + 1 + 1 + 5));
+    expect(strncmp(json, "\"aaaaa\\\"a", 9), toBe(0));
+    expect(strstr(json, "a\\na") != NULL, toBe(true));
+    expect(strstr(json, "a\\u0001a") != NULL, toBe(true));
+
+    JsonDocument *document = jsonParseDocument(json, strlen(json));
+    expect(document != NULL, toBe(true));
+
+    size_t length;
+    expect(strcmp(jsonValueString(jsonDocumentRoot(document), &length), text), toBe(0));
+
+    freeJsonDocument(document);
+    free(json);
+}
+
+void runJsonStringTests() {
+    runTest(testJsonFindEscape);
+    runTest(testJsonValidUtf8);
+    runTest(testJsonParseRejectsBadStrings);
+    runTest(testJsonWriterEscapesLongStrings);
+}
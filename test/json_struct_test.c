@@ -0,0 +1,124 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../src/include/lavandula_test.h"
+#include "../src/include/json_struct.h"
+
+JSON_STRUCT(Todo,
+    FIELD(int, id),
+    FIELD(str, title),
+    FIELD(bool, completed)
+)
+
+JSON_STRUCT(Reading,
+    FIELD(int64, sensor),
+    FIELD(double, value),
+    FIELD(str, unit)
+)
+
+static JsonDocument *parse(const char *json) {
+    return jsonParseDocument(json, strlen(json));
+}
+
+void testJsonStructToJson() {
+    Todo todos[] = {
+        { .id = 1, .title = "Write \"tests\"", .completed = true },
+        { .id = 2, .title = NULL, .completed = false },
+    };
+
+    JsonWriter writer = jsonWriter();
+    jwArrayStart(&writer);
+    for (int i = 0; i < 2; i++) {
+        Todo_toJson(&writer, &todos[i]);
+    }
+    jwArrayEnd(&writer);
+
+    char *json = jwTakeString(&writer);
+    expect(strcmp(json, "[{\"id\":1,\"title\":\"Write \\\"tests\\\"\",\"completed\":true},{\"id\":2,\"title\":null,\"completed\":false}]"), toBe(0));
+    free(json);
+
+    Reading reading = { .sensor = 5000000000LL, .value = 21.5, .unit = "C" };
+
+    writer = jsonWriter();
+    writer.spaced = true;
+    jwObjectStart(&writer);
+    jwKey(&writer, "reading");
+    Reading_toJson(&writer, &reading);
+    jwObjectEnd(&writer);
+
+    json = jwTakeString(&writer);
+    expect(strcmp(json, "{\"reading\": {\"sensor\": 5000000000, \"value\": 21.5, \"unit\": \"C\"}}"), toBe(0));
+    free(json);
+}
+
+void testJsonStructFromJson() {
+    JsonDocument *document = parse("{\"completed\": true, \"extra\": [1, {\"id\": 9}], \"title\": \"Caf\\u00e9\", \"id\": 42}");
+
+    Todo todo = { 0 };
+    expect(Todo_fromJson(jsonDocumentRoot(document), &todo), toBe(true));
+    expect(todo.id, toBe(42));
+    expect(strcmp(todo.title, "Caf\xc3\xa9"), toBe(0));
+    expect(todo.completed, toBe(true));
+
+    freeJsonDocument(document);
+
+    // missing members keep their defaults
+    document = parse("{\"value\": 3, \"unit\": null}");
+
+    Reading reading = { .sensor = 7, .value = 0, .unit = "K" };
+    expect(Reading_fromJson(jsonDocumentRoot(document), &reading), toBe(true));
+    expect(reading.sensor == 7, toBe(true));
+    expect(reading.value == 3.0, toBe(true));
+    expect(reading.unit == NULL, toBe(true));
+
+    freeJsonDocument(document);
+}
+
+void testJsonStructRejectsWrongTypes() {
+    const char *invalid[] = {
+        "{\"id\": \"1\"}",
+        "{\"id\": 1.5}",
+        "{\"id\": 3000000000}",
+        "{\"title\": 5}",
+        "{\"completed\": 1}",
+        "[1, 2]",
+    };
+
+    for (size_t i = 0; i < sizeof(invalid) / sizeof(invalid[0]); i++) {
+        JsonDocument *document = parse(invalid[i]);
+
+        Todo todo = { 0 };
+        expect(Todo_fromJson(jsonDocumentRoot(document), &todo), toBe(false));
+
+        freeJsonDocument(document);
+    }
+}
+
+void testJsonStructFromBody() {
+    JsonBuilder *body = jsonParse("{\"id\": 5, \"title\": \"From the body\"}");
+
+    JsonValue value;
+    expect(jsonBuilderValue(body, &value), toBe(true));
+
+    Todo todo = { 0 };
+    expect(Todo_fromJson(value, &todo), toBe(true));
+    expect(todo.id, toBe(5));
+    expect(strcmp(todo.title, "From the body"), toBe(0));
+
+    // once modified the members no longer live on the tape
+    jsonPutBool(body, "completed", true);
+    expect(jsonBuilderValue(body, &value), toBe(false));
+
+    freeJsonBuilder(body);
+
+    JsonBuilder *built = jsonBuilder();
+    expect(jsonBuilderValue(built, &value), toBe(false));
+    freeJsonBuilder(built);
+}
+
+void runJsonStructTests() {
+    runTest(testJsonStructToJson);
+    runTest(testJsonStructFromJson);
+    runTest(testJsonStructRejectsWrongTypes);
+    runTest(testJsonStructFromBody);
+}
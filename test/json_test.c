@@ -132,6 +132,333 @@ void testJsonBuildEmptyArray() {
     freeJsonBuilder(builder);
 }
 
+void testJsonPackedArrays() {
+    JsonArray integers = jsonIntegerArray();
+    for (int i = 0; i < 3; i++) {
+        jsonArrayAppendInteger64(&integers, 5000000000LL * i);
+    }
+
+    JsonArray doubles = jsonDoubleArray();
+    jsonArrayAppendDouble(&doubles, 0.5);
+    jsonArrayAppendDouble(&doubles, -2.25);
+
+    JsonArray strings = jsonStringArray();
+    jsonArrayAppendString(&strings, "a\"b");
+    jsonArrayAppendString(&strings, "c");
+
+    expect(integers.type, toBe(JSON_ARRAY_INTEGERS));
+    expect(jsonArrayGetInteger64(&integers, 2) == 10000000000LL, toBe(true));
+    expect(jsonArrayGetDouble(&integers, 1) == 5e9, toBe(true));
+    expect(strcmp(jsonArrayGetString(&strings, 0), "a\"b"), toBe(0));
+
+    JsonBuilder *builder = jsonBuilder();
+    jsonPutArray(builder, "integers", &integers);
+    jsonPutArray(builder, "doubles", &doubles);
+    jsonPutArray(builder, "strings", &strings);
+
+    char *json = jsonStringify(builder);
+    expect(strcmp(json, "{\"integers\": [0, 5000000000, 10000000000], \"doubles\": [0.5, -2.25], \"strings\": [\"a\\\"b\", \"c\"]}"), toBe(0));
+    free(json);
+
+    // another type unpacks the array and keeps what it held
+    jsonArrayAppend(&doubles, jsonBool(true));
+    expect(doubles.type, toBe(JSON_ARRAY_MIXED));
+    expect(jsonArrayGetDouble(&doubles, 1) == -2.25, toBe(true));
+
+    json = jsonStringify(builder);
+    expect(strstr(json, "\"doubles\": [0.5, -2.25, true]") != NULL, toBe(true));
+
+    free(json);
+    freeJsonBuilder(builder);
+}
+
+void testJsonParsePackedArrays() {
+    char *source = "{\"ids\": [1, -2, 3], \"prices\": [1.5, 2e-3], \"tags\": [\"x\", \"y\\n\"], \"mixed\": [1, 2.5], \"empty\": []}";
+    JsonBuilder *builder = jsonParse(source);
+
+    JsonArray *ids = jsonGetArray(builder, "ids");
+    JsonArray *prices = jsonGetArray(builder, "prices");
+    JsonArray *tags = jsonGetArray(builder, "tags");
+
+    expect(ids->type, toBe(JSON_ARRAY_INTEGERS));
+    expect(jsonArrayGetInteger64(ids, 1), toBe(-2));
+    expect(prices->type, toBe(JSON_ARRAY_DOUBLES));
+    expect(jsonArrayGetDouble(prices, 1) == 2e-3, toBe(true));
+    expect(tags->type, toBe(JSON_ARRAY_STRINGS));
+    expect(strcmp(jsonArrayGetString(tags, 1), "y\n"), toBe(0));
+    expect(jsonGetArray(builder, "mixed")->type, toBe(JSON_ARRAY_MIXED));
+    expect(jsonGetArray(builder, "empty")->count, toBe(0));
+    expect(jsonGetArray(builder, "missing") == NULL, toBe(true));
+
+    // parsed strings are copied once the array has to hold something else
+    jsonArrayAppendString(tags, "z");
+    expect(tags->type, toBe(JSON_ARRAY_MIXED));
+
+    char *json = jsonStringify(builder);
+    expect(strcmp(json, "{\"ids\": [1, -2, 3], \"prices\": [1.5, 0.002], \"tags\": [\"x\", \"y\\n\", \"z\"], \"mixed\": [1, 2.5], \"empty\": []}"), toBe(0));
+
+    free(json);
+    freeJsonBuilder(builder);
+}
+
+void testJsonArenaBuilder() {
+    Arena requestArena = arena(0);
+
+    JsonBuilder *root = jsonArenaBuilder(&requestArena);
+    JsonArray todos = jsonArenaArray(&requestArena);
+    jsonPutArray(root, "todos", &todos);
+
+    for (int i = 0; i < 20; i++) {
+        JsonBuilder *todo = jsonArenaBuilder(&requestArena);
+        jsonPutInteger(todo, "id", i);
+        jsonPutString(todo, "title", "short");
+        jsonArrayAppend(&todos, jsonObject(todo));
+    }
+
+    // heap values handed over are released with the arena
+    JsonBuilder *meta = jsonBuilder();
+    jsonPutString(meta, "source", "heap");
+    jsonPutObject(root, "meta", meta);
+
+    JsonArray tags = jsonArray();
+    jsonPutArray(root, "tags", &tags);
+    jsonArrayAppend(&tags, jsonString("added after the put"));
+    jsonArrayAppendString(&tags, "b");
+
+    jsonPutJson(root, "note", jsonString("copied"));
+
+    expect(jsonGetInteger(jsonGetJson(root, "meta"), "missing"), toBe(0));
+    expect(root->jsonCount, toBe(4));
+
+    char *json = jsonStringifyArena(root, &requestArena);
+    expect(strncmp(json, "{\"todos\": [{\"id\": 0, \"title\": \"short\"}, ", 40), toBe(0));
+    expect(strstr(json, "\"meta\": {\"source\": \"heap\"}, \"tags\": [\"added after the put\", \"b\"], \"note\": \"copied\"}") != NULL, toBe(true));
+
+    // a no-op, the arena owns everything
+    freeJsonBuilder(root);
+
+    arenaReset(&requestArena);
+    freeArena(&requestArena);
+}
+
+void testJsonStringifyEscapesStrings() {
+    JsonBuilder *builder = jsonBuilder();
+    jsonPutString(builder, "quote\"key", "say \"hi\"\n\t\\ \x01");
+
+    char *json = jsonStringify(builder);
+    expect(strcmp(json, "{\"quote\\\"key\": \"say \\\"hi\\\"\\n\\t\\\\ \\u0001\"}"), toBe(0));
+
+    free(json);
+    freeJsonBuilder(builder);
+}
+
+void testJsonStringifyLongString() {
+    char value[1024];
+    memset(value, 'a', sizeof(value) - 1);
+    value[sizeof(value) - 1] = '\0';
+
+    JsonBuilder *builder = jsonBuilder();
+    jsonPutString(builder, "long", value);
+
+    char *json = jsonStringify(builder);
+    expect(strlen(json), toBe(strlen("{\"long\": \"\"}") + sizeof(value) - 1));
+
+    free(json);
+    freeJsonBuilder(builder);
+}
+
+void testJsonStringifyIntegers() {
+    JsonBuilder *builder = jsonBuilder();
+    jsonPutInteger(builder, "a", 0);
+    jsonPutInteger(builder, "b", 7);
+    jsonPutInteger(builder, "c", -10);
+    jsonPutInteger(builder, "d", 123456789);
+    jsonPutInteger(builder, "e", -2147483647 - 1);
+
+    char *json = jsonStringify(builder);
+    expect(strcmp(json, "{\"a\": 0, \"b\": 7, \"c\": -10, \"d\": 123456789, \"e\": -2147483648}"), toBe(0));
+
+    free(json);
+    freeJsonBuilder(builder);
+}
+
+void testJsonStringifyNestedArrays() {
+    JsonBuilder *builder = jsonBuilder();
+
+    JsonArray inner = jsonArray();
+    jsonArrayAppend(&inner, jsonInteger(1));
+    jsonArrayAppend(&inner, jsonInteger(2));
+
+    JsonArray outer = jsonArray();
+    jsonArrayAppend(&outer, jsonArrayJson(&inner));
+    jsonArrayAppend(&outer, jsonString("x"));
+
+    JsonBuilder *child = jsonBuilder();
+    jsonPutArray(child, "outer", &outer);
+    jsonPutObject(builder, "child", child);
+
+    char *json = jsonStringify(builder);
+    expect(strcmp(json, "{\"child\": {\"outer\": [[1, 2], \"x\"]}}"), toBe(0));
+
+    free(json);
+    freeJsonBuilder(builder);
+}
+
+void testJsonParseFields() {
+    JsonBuilder *builder = jsonParse("{\"title\": \"Buy milk\", \"id\": 42, \"done\": true, \"big\": -9000000000, \"none\": null}");
+
+    expect(builder != NULL, toBe(true));
+    expect(builder->jsonCount, toBe(5));
+    expect(strcmp(jsonGetString(builder, "title"), "Buy milk"), toBe(0));
+    expect(jsonGetInteger(builder, "id"), toBe(42));
+    expect(jsonGetBool(builder, "done"), toBe(true));
+    expect(jsonHasKey(builder, "none"), toBe(true));
+    expect(jsonHasKey(builder, "missing"), toBe(false));
+    expect(jsonGetString(builder, "id"), toBe(NULL));
+
+    freeJsonBuilder(builder);
+}
+
+void testJsonParseEscapedStrings() {
+    // long enough to go through the vectorized scan, with structural characters inside strings
+    JsonBuilder *builder = jsonParse("{\"text\": \"say \\\"hi\\\", {ok}: [1]\", \"caf\\u00e9\": \"\\ud83d\\ude00\\n\"}");
+
+    expect(builder != NULL, toBe(true));
+    expect(strcmp(jsonGetString(builder, "text"), "say \"hi\", {ok}: [1]"), toBe(0));
+    expect(strcmp(jsonGetString(builder, "caf\xc3\xa9"), "\xf0\x9f\x98\x80\n"), toBe(0));
+
+    freeJsonBuilder(builder);
+}
+
+void testJsonParseNestedObject() {
+    JsonBuilder *builder = jsonParse("{\"user\": {\"id\": 7, \"tags\": [\"a\", {\"b\": []}]}, \"after\": 1}");
+    expect(builder != NULL, toBe(true));
+
+    JsonBuilder *user = jsonGetJson(builder, "user");
+    expect(user != NULL, toBe(true));
+    expect(jsonGetInteger(user, "id"), toBe(7));
+    expect(jsonGetInteger(builder, "after"), toBe(1));
+
+    // changes to a nested object show up when the parent is written
+    jsonPutString(user, "name", "ada");
+
+    char *json = jsonStringify(builder);
+    expect(strcmp(json, "{\"user\": {\"id\": 7, \"tags\": [\"a\", {\"b\": []}], \"name\": \"ada\"}, \"after\": 1}"), toBe(0));
+
+    free(json);
+    freeJsonBuilder(builder);
+}
+
+void testJsonParseRoundTrip() {
+    JsonBuilder *builder = jsonParse(" {\"a\":[1,-2,3.5,true,false,null],\"b\":\"x\\/y\\t\"} \n");
+    expect(builder != NULL, toBe(true));
+
+    char *json = jsonStringify(builder);
+    expect(strcmp(json, "{\"a\": [1, -2, 3.5, true, false, null], \"b\": \"x/y\\t\"}"), toBe(0));
+
+    free(json);
+    freeJsonBuilder(builder);
+}
+
+void testJsonParseInvalid() {
+    char *invalid[] = {
+        "",
+        "[1, 2]",
+        "{\"a\": 1,}",
+        "{\"a\" 1}",
+        "{\"a\": 01}",
+        "{\"a\": \"unterminated}",
+        "{\"a\": \"bad \\x escape\"}",
+        "{\"a\": tru}",
+        "{\"a\": 1} trailing",
+        "{\"a\": [1, 2}",
+        "{\"a\": 1 2}",
+    };
+
+    for (size_t i = 0; i < sizeof(invalid) / sizeof(invalid[0]); i++) {
+        expect(jsonParse(invalid[i]), toBe(NULL));
+    }
+}
+
+void testJsonParseLazy() {
+    char source[] = "{\"id\": 3, \"title\": \"later\"}";
+    JsonBuilder *builder = jsonParseLazy(source, strlen(source));
+
+    // nothing is parsed until the builder is read
+    expect(builder->isPending, toBe(true));
+    expect(builder->document, toBe(NULL));
+
+    expect(jsonGetInteger(builder, "id"), toBe(3));
+    expect(builder->isPending, toBe(false));
+    expect(strcmp(jsonGetString(builder, "title"), "later"), toBe(0));
+
+    freeJsonBuilder(builder);
+
+    JsonBuilder *invalid = jsonParseLazy("{\"id\": ", 7);
+    expect(jsonResolve(invalid), toBe(false));
+    expect(jsonHasKey(invalid, "id"), toBe(false));
+
+    freeJsonBuilder(invalid);
+}
+
+void testJsonWideObjectLookups() {
+    JsonBuilder *builder = jsonBuilder();
+    char key[16];
+
+    for (int i = 0; i < 200; i++) {
+        snprintf(key, sizeof(key), "field%d", i);
+        jsonPutInteger(builder, key, i);
+    }
+
+    // same key with another type, lookups still filter by type in insertion order
+    jsonPutString(builder, "field7", "seven");
+
+    expect(jsonGetInteger(builder, "field0"), toBe(0));
+    expect(jsonGetInteger(builder, "field199"), toBe(199));
+    expect(strcmp(jsonGetString(builder, "field7"), "seven"), toBe(0));
+    expect(jsonHasKey(builder, "field200"), toBe(false));
+    expect(builder->index != NULL, toBe(true));
+
+    // members added after the index was built are found too
+    for (int i = 200; i < 300; i++) {
+        snprintf(key, sizeof(key), "field%d", i);
+        jsonPutInteger(builder, key, i);
+    }
+
+    expect(jsonGetInteger(builder, "field250"), toBe(250));
+    expect(jsonGetInteger(builder, "field299"), toBe(299));
+
+    freeJsonBuilder(builder);
+}
+
+void testJsonWideParsedObjectLookups() {
+    JsonBuilder *source = jsonBuilder();
+    char key[16];
+
+    for (int i = 0; i < 64; i++) {
+        snprintf(key, sizeof(key), "k%d", i);
+        jsonPutBool(source, key, i % 2 == 0);
+    }
+
+    JsonBuilder *nested = jsonBuilder();
+    jsonPutString(nested, "name", "inner");
+    jsonPutObject(source, "nested", nested);
+
+    char *json = jsonStringify(source);
+    JsonBuilder *builder = jsonParse(json);
+
+    expect(jsonGetBool(builder, "k10"), toBe(true));
+    expect(jsonGetBool(builder, "k11"), toBe(false));
+    expect(jsonHasKey(builder, "k63"), toBe(true));
+    expect(jsonHasKey(builder, "k64"), toBe(false));
+    expect(strcmp(jsonGetString(jsonGetJson(builder, "nested"), "name"), "inner"), toBe(0));
+    expect(jsonGetBool(builder, "k62"), toBe(true));
+
+    free(json);
+    freeJsonBuilder(builder);
+    freeJsonBuilder(source);
+}
+
 void runJsonTests(){
     runTest(testJsonArrayInit);
     runTest(testJsonBuilderInit);
@@ -143,4 +470,19 @@ void runJsonTests(){
     runTest(testJsonBuildJsonField);
     runTest(testJsonBuildArrayField);
     runTest(testJsonBuildEmptyArray);
+    runTest(testJsonPackedArrays);
+    runTest(testJsonParsePackedArrays);
+    runTest(testJsonArenaBuilder);
+    runTest(testJsonStringifyEscapesStrings);
+    runTest(testJsonStringifyLongString);
+    runTest(testJsonStringifyIntegers);
+    runTest(testJsonStringifyNestedArrays);
+    runTest(testJsonParseFields);
+    runTest(testJsonParseEscapedStrings);
+    runTest(testJsonParseNestedObject);
+    runTest(testJsonParseRoundTrip);
+    runTest(testJsonParseInvalid);
+    runTest(testJsonParseLazy);
+    runTest(testJsonWideObjectLookups);
+    runTest(testJsonWideParsedObjectLookups);
 }
\ No newline at end of file
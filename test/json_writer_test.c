@@ -0,0 +1,182 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include "../src/include/lavandula_test.h"
+#include "../src/include/json_writer.h"
+
+void testJsonWriterCompactOutput() {
+    JsonWriter writer = jsonWriter();
+
+    jwObjectStart(&writer);
+    jwKey(&writer, "id");
+    jwInt(&writer, 42);
+    jwKey(&writer, "tags");
+    jwArrayStart(&writer);
+    jwString(&writer, "a");
+    jwBool(&writer, false);
+    jwNull(&writer);
+    jwArrayEnd(&writer);
+    jwKey(&writer, "empty");
+    jwObjectStart(&writer);
+    jwObjectEnd(&writer);
+    jwObjectEnd(&writer);
+
+    char *json = jwTakeString(&writer);
+    expect(strcmp(json, "{\"id\":42,\"tags\":[\"a\",false,null],\"empty\":{}}"), toBe(0));
+
+    free(json);
+    freeJsonWriter(&writer);
+}
+
+void testJsonWriterEscapesLengthStrings() {
+    JsonWriter writer = jsonWriter();
+
+    jwArrayStart(&writer);
+    jwStringLength(&writer, "tab\there", 3);
+    jwString(&writer, "new\nline");
+    jwArrayEnd(&writer);
+
+    char *json = jwTakeString(&writer);
+    expect(strcmp(json, "[\"tab\",\"new\\nline\"]"), toBe(0));
+
+    free(json);
+}
+
+void testJsonWriterNumberArrays() {
+    long long integers[600];
+    for (int i = 0; i < 600; i++) {
+        integers[i] = i - 300;
+    }
+
+    double doubles[] = { 0.1, 1e300, -0.0 };
+
+    JsonWriter writer = jsonWriter();
+    jwArrayStart(&writer);
+    jwIntegers(&writer, integers, 600);
+    jwDoubles(&writer, doubles, 3);
+    jwIntegers(&writer, integers, 0);
+    jwArrayEnd(&writer);
+
+    char *json = jwTakeString(&writer);
+
+    expect(strncmp(json, "[[-300,-299,", 12), toBe(0));
+    expect(strstr(json, ",-1,0,1,") != NULL, toBe(true));
+    const char *tail = "298,299],[0.1,1e300,-0.0],[]]";
+    expect(strcmp(json + strlen(json) - strlen(tail), tail), toBe(0));
+
+    free(json);
+}
+
+void testJsonWriterRejectsDeepNesting() {
+    JsonWriter writer = jsonWriter();
+
+    for (int i = 0; i < JSON_WRITER_MAX_DEPTH + 1; i++) {
+        jwArrayStart(&writer);
+    }
+
+    expect(writer.failed, toBe(true));
+
+    freeJsonWriter(&writer);
+}
+
+void testJsonStreamWriterSendsChunks() {
+    int sockets[2];
+    expect(socketpair(AF_UNIX, SOCK_STREAM, 0, sockets), toBe(0));
+
+    ResponseStream stream = responseStream(sockets[0]);
+    RequestContext ctx = { .stream = &stream };
+
+    JsonWriter writer = jsonStreamWriter(ctx, HTTP_OK);
+    jwArrayStart(&writer);
+    for (int i = 0; i < 5000; i++) {
+        jwInt(&writer, i);
+    }
+    jwArrayEnd(&writer);
+
+    // the buffer never grows past one chunk
+    expect(writer.capacity, toBe(JSON_STREAM_BUFFER_SIZE));
+
+    HttpResponse response = jwEndStream(&writer);
+    expect(response.streamed, toBe(true));
+    close(sockets[0]);
+
+    size_t capacity = 64 * 1024;
+    size_t length = 0;
+    char *received = malloc(capacity);
+    ssize_t n;
+    while ((n = read(sockets[1], received + length, capacity - length - 1)) > 0) {
+        length += n;
+    }
+    received[length] = '\0';
+    close(sockets[1]);
+
+    expectNotNull(strstr(received, "Transfer-Encoding: chunked\r\n"));
+    expect(strcmp(received + length - 5, "0\r\n\r\n"), toBe(0));
+
+    // reassemble the chunks and check the body is intact
+    char *body = malloc(length);
+    size_t bodyLength = 0;
+    char *p = strstr(received, "\r\n\r\n") + 4;
+    int chunks = 0;
+
+    while (1) {
+        char *end;
+        size_t size = strtoul(p, &end, 16);
+        if (size == 0) break;
+
+        memcpy(body + bodyLength, end + 2, size);
+        bodyLength += size;
+        p = end + 2 + size + 2;
+        chunks++;
+    }
+
+    expect(chunks > 1, toBe(true));
+    expect(strncmp(body, "[0,1,2,", 7), toBe(0));
+    expect(strncmp(body + bodyLength - 6, ",4999]", 6), toBe(0));
+
+    free(body);
+    free(received);
+}
+
+void testJsonStreamWriterDropsOutputAfterFailure() {
+    int sockets[2];
+    expect(socketpair(AF_UNIX, SOCK_STREAM, 0, sockets), toBe(0));
+
+    ResponseStream stream = responseStream(sockets[0]);
+    RequestContext ctx = { .stream = &stream };
+
+    JsonWriter writer = jsonStreamWriter(ctx, HTTP_OK);
+
+    // the connection goes away after the headers, so the first flush inside the string fails
+    close(sockets[0]);
+    close(sockets[1]);
+
+    // every byte needs escaping, so the string is six times the buffer once written
+    size_t length = JSON_STREAM_BUFFER_SIZE;
+    char *text = malloc(length + 1);
+    memset(text, '\x01', length);
+    text[length] = '\0';
+
+    jwArrayStart(&writer);
+    jwString(&writer, text);
+    jwString(&writer, text);
+    jwArrayEnd(&writer);
+
+    expect(writer.failed, toBe(true));
+    expect(writer.length <= writer.capacity, toBe(true));
+    expect(writer.capacity, toBe(JSON_STREAM_BUFFER_SIZE));
+
+    free(text);
+    freeJsonWriter(&writer);
+}
+
+void runJsonWriterTests() {
+    runTest(testJsonWriterCompactOutput);
+    runTest(testJsonWriterEscapesLengthStrings);
+    runTest(testJsonWriterNumberArrays);
+    runTest(testJsonWriterRejectsDeepNesting);
+    runTest(testJsonStreamWriterSendsChunks);
+    runTest(testJsonStreamWriterDropsOutputAfterFailure);
+}
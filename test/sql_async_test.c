@@ -0,0 +1,168 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include "../src/include/lavandula_test.h"
+#include "../src/include/sql_async.h"
+#include "../src/include/app.h"
+#include "sql_test_helpers.h"
+
+static int doneCalls;
+static int doneRows;
+
+static HttpResponse countRows(RequestContext ctx, DbResult *result) {
+    (void)ctx;
+
+    doneCalls++;
+    doneRows = result ? result->rowCount : -1;
+
+    return (HttpResponse) { .content = "ok", .status = HTTP_OK };
+}
+
+static DbPool *todoPool(char *path) {
+    createTestDatabase(path);
+
+    DbContext *db = openTodoDatabase(path, "title text");
+    dbExec(db, "insert into todos (title) values ('a'), ('b'), ('c');", NULL, 0);
+    dbClose(db);
+
+    return createDbPool(path, 4, dbDefaultPragmas());
+}
+
+static DbAsyncQuery *waitCompleted(DbAsyncPool *async) {
+    for (int i = 0; i < 500; i++) {
+        DbAsyncQuery *query = dbAsyncCompleted(async);
+        if (query) return query;
+
+        struct pollfd fd = { .fd = dbAsyncFd(async), .events = POLLIN };
+        poll(&fd, 1, 10);
+    }
+
+    return NULL;
+}
+
+void testSqlAsyncRunsInlineWithoutThreads() {
+    char path[] = "/tmp/lavandula_async_XXXXXX";
+    DbPool *pool = todoPool(path);
+
+    App app = { .dbPool = pool };
+    RequestContext ctx = requestContext(&app, (HttpRequest) { 0 });
+
+    doneCalls = 0;
+    HttpResponse response = dbQueryAsync(ctx, "select * from todos where id > ?;", DB_PARAMS(PARAM_INT(1)), 1, countRows);
+
+    expect(response.deferred, toBe(false));
+    expect(strcmp(response.content, "ok"), toBe(0));
+    expect(doneCalls, toBe(1));
+    expect(doneRows, toBe(2));
+
+    freeDbPool(pool);
+    removeTestDatabase(path);
+}
+
+void testSqlAsyncRunsOnDatabaseThread() {
+    char path[] = "/tmp/lavandula_async_XXXXXX";
+    DbPool *pool = todoPool(path);
+
+    int sockets[2];
+    socketpair(AF_UNIX, SOCK_STREAM, 0, sockets);
+
+    App app = { .dbPool = pool, .dbAsync = createDbAsyncPool(pool, 2) };
+    expect(app.dbAsync != NULL, toBe(true));
+
+    char resource[] = "/todos";
+    char body[] = "{\"id\":1}";
+    HttpRequest request = { .method = HTTP_GET, .resource = resource, .body = body, .bodyLength = strlen(body) };
+
+    ResponseStream stream = responseStream(sockets[0]);
+    RequestContext ctx = requestContext(&app, request);
+    ctx.stream = &stream;
+
+    // the params and the request are copied, the handler's are gone once it returns
+    char title[] = "b";
+    doneCalls = 0;
+    HttpResponse response = dbQueryAsync(ctx, "select * from todos where title = ?;", DB_PARAMS(PARAM_TEXT(title)), 1, countRows);
+    title[0] = 'x';
+    resource[1] = 'x';
+
+    expect(response.deferred, toBe(true));
+    expect(doneCalls, toBe(0));
+
+    DbAsyncQuery *query = waitCompleted(app.dbAsync);
+    expect(query != NULL, toBe(true));
+    expect(query->socket, toBe(sockets[0]));
+    expect(query->onDone == countRows, toBe(true));
+    expect(query->result->rowCount, toBe(1));
+    expect(strcmp(query->request.resource, "/todos"), toBe(0));
+    expect(query->request.bodyLength, toBe(strlen(body)));
+    expect(dbAsyncCompleted(app.dbAsync) == NULL, toBe(true));
+
+    freeDbAsyncQuery(query);
+
+    // a failed query is handed back with no result
+    dbQueryAsync(ctx, "select * from missing;", NULL, 0, countRows);
+    query = waitCompleted(app.dbAsync);
+    expect(query != NULL && query->result == NULL, toBe(true));
+    freeDbAsyncQuery(query);
+
+    freeDbAsyncPool(app.dbAsync);
+    freeDbPool(pool);
+
+    close(sockets[0]);
+    close(sockets[1]);
+    removeTestDatabase(path);
+}
+
+void testSqlAsyncSlowQueryDoesNotBlock() {
+    char path[] = "/tmp/lavandula_async_XXXXXX";
+    DbPool *pool = todoPool(path);
+
+    int slowSockets[2];
+    int fastSockets[2];
+    socketpair(AF_UNIX, SOCK_STREAM, 0, slowSockets);
+    socketpair(AF_UNIX, SOCK_STREAM, 0, fastSockets);
+
+    App app = { .dbPool = pool, .dbAsync = createDbAsyncPool(pool, 2) };
+
+    ResponseStream slowStream = responseStream(slowSockets[0]);
+    RequestContext slow = requestContext(&app, (HttpRequest) { .resource = "/report" });
+    slow.stream = &slowStream;
+
+    ResponseStream fastStream = responseStream(fastSockets[0]);
+    RequestContext fast = requestContext(&app, (HttpRequest) { .resource = "/health" });
+    fast.stream = &fastStream;
+
+    const char *report = "with recursive n(i) as (select 1 union all select i + 1 from n where i < 2000000) select count(*) from n;";
+    dbQueryAsync(slow, report, NULL, 0, countRows);
+    dbQueryAsync(fast, "select 1;", NULL, 0, countRows);
+
+    // the server thread is free in the meantime, and the cheap query is not stuck behind the slow one
+    DbResult *result = dbQueryRows(fast.db, "select count(*) from todos;", NULL, 0);
+    expect(dbGetInt(result, 0, 0), toBe(3));
+    freeDbResult(result);
+
+    DbAsyncQuery *first = waitCompleted(app.dbAsync);
+    expect(first != NULL && first->socket == fastSockets[0], toBe(true));
+    freeDbAsyncQuery(first);
+
+    // the slow one is never resumed, so its connection is closed when the pool stops
+    freeDbAsyncPool(app.dbAsync);
+
+    char byte;
+    expect(read(slowSockets[1], &byte, 1), toBe(0));
+
+    freeDbPool(pool);
+
+    close(fastSockets[0]);
+    close(fastSockets[1]);
+    close(slowSockets[1]);
+    removeTestDatabase(path);
+}
+
+void runSqlAsyncTests() {
+    runTest(testSqlAsyncRunsInlineWithoutThreads);
+    runTest(testSqlAsyncRunsOnDatabaseThread);
+    runTest(testSqlAsyncSlowQueryDoesNotBlock);
+}
@@ -0,0 +1,200 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "../src/include/lavandula_test.h"
+#include "../src/include/sql_cache.h"
+#include "../src/include/sql_writer.h"
+#include "sql_test_helpers.h"
+
+static DbContext *openTodos(char *path) {
+    createTestDatabase(path);
+
+    DbContext *db = openTodoDatabase(path, "title text");
+    dbExec(db, "create table users (id integer primary key, name text);", NULL, 0);
+    dbExec(db, "insert into todos (id, title) values (1, 'a'), (2, 'b');", NULL, 0);
+    dbExec(db, "insert into users (id, name) values (1, 'ann');", NULL, 0);
+
+    return db;
+}
+
+static int titleLength(DbContext *db, int id) {
+    DbResult *result = dbQueryCached(db, "select title from todos where id = ?;", DB_PARAMS(PARAM_INT(id)), 1);
+
+    int length = -1;
+    if (result && result->rowCount == 1) dbGetText(result, 0, 0, &length);
+
+    freeDbResult(result);
+    return length;
+}
+
+void testSqlCacheHits() {
+    char path[] = "/tmp/lavandula_cache_XXXXXX";
+    DbContext *db = openTodos(path);
+
+    DbQueryCache *cache = createDbQueryCache(DB_QUERY_CACHE_BUDGET, DB_QUERY_CACHE_TTL_MS);
+    dbAttachQueryCache(db, cache);
+
+    expect(titleLength(db, 1), toBe(1));
+    expect(titleLength(db, 1), toBe(1));
+    expect(titleLength(db, 2), toBe(1));
+    expect(titleLength(db, 3), toBe(-1));
+
+    DbQueryCacheStats stats = dbQueryCacheStats(cache);
+    expect(stats.hits, toBe(1));
+    expect(stats.misses, toBe(3));
+    expect(stats.entries, toBe(3));
+
+    // a cached copy is the caller's to free and reads like the original
+    DbResult *result = dbQueryCached(db, "select id, title from todos order by id;", NULL, 0);
+    DbResult *cached = dbQueryCached(db, "select id, title from todos order by id;", NULL, 0);
+
+    expect(cached != result, toBe(true));
+    expect(cached->rowCount, toBe(2));
+    expect(dbGetInt(cached, 1, 0), toBe(2));
+    expect(strcmp(dbGetText(cached, 1, 1, NULL), "b"), toBe(0));
+    expect(strcmp(cached->columns[1].name, "title"), toBe(0));
+
+    freeDbResult(result);
+    freeDbResult(cached);
+
+    dbQueryCacheClear(cache);
+    expect(dbQueryCacheStats(cache).entries, toBe(0));
+    expect(dbQueryCacheStats(cache).bytes, toBe(0));
+
+    dbClose(db);
+    freeDbQueryCache(cache);
+    removeTestDatabase(path);
+}
+
+void testSqlCacheInvalidatesOnWrite() {
+    char path[] = "/tmp/lavandula_cache_XXXXXX";
+    DbContext *db = openTodos(path);
+    DbContext *other = createSqlLite3DbContext(path);
+
+    DbQueryCache *cache = createDbQueryCache(DB_QUERY_CACHE_BUDGET, DB_QUERY_CACHE_TTL_MS);
+    dbAttachQueryCache(db, cache);
+    dbAttachQueryCache(other, cache);
+
+    const char *users = "select name from users where id = 1;";
+    DbResult *result = dbQueryCached(db, users, NULL, 0);
+    freeDbResult(result);
+
+    expect(titleLength(db, 1), toBe(1));
+
+    // written through another attached connection
+    dbExec(other, "update todos set title = 'abc' where id = 1;", NULL, 0);
+    expect(titleLength(db, 1), toBe(3));
+
+    // a write inside a transaction is seen again when it commits
+    dbExec(other, "begin;", NULL, 0);
+    dbExec(other, "update todos set title = 'abcd' where id = 1;", NULL, 0);
+    expect(titleLength(db, 1), toBe(3));
+    dbExec(other, "commit;", NULL, 0);
+    expect(titleLength(db, 1), toBe(4));
+
+    DbQueryCacheStats stats = dbQueryCacheStats(cache);
+    expect(stats.invalidations, toBe(3));
+
+    // the users result was not touched by writes to todos
+    result = dbQueryCached(db, users, NULL, 0);
+    freeDbResult(result);
+    expect(dbQueryCacheStats(cache).hits, toBe(stats.hits + 1));
+
+    // statements that write are run every time
+    for (int i = 0; i < 2; i++) {
+        result = dbQueryCached(db, "insert into todos (title) values ('c') returning id;", NULL, 0);
+        freeDbResult(result);
+    }
+    result = dbQueryCached(db, "select count(*) from todos;", NULL, 0);
+    expect(dbGetInt(result, 0, 0), toBe(4));
+    freeDbResult(result);
+
+    // a delete without a WHERE clause is not truncated past the update hook
+    dbExec(other, "delete from todos;", NULL, 0);
+    result = dbQueryCached(db, "select count(*) from todos;", NULL, 0);
+    expect(dbGetInt(result, 0, 0), toBe(0));
+    freeDbResult(result);
+
+    dbClose(other);
+    dbClose(db);
+    freeDbQueryCache(cache);
+    removeTestDatabase(path);
+}
+
+void testSqlCacheExpiresAndEvicts() {
+    char path[] = "/tmp/lavandula_cache_XXXXXX";
+    DbContext *db = openTodos(path);
+
+    DbQueryCache *cache = createDbQueryCache(DB_QUERY_CACHE_BUDGET, 20);
+    dbAttachQueryCache(db, cache);
+
+    expect(titleLength(db, 1), toBe(1));
+    usleep(30 * 1000);
+    expect(titleLength(db, 1), toBe(1));
+    expect(dbQueryCacheStats(cache).expirations, toBe(1));
+
+    size_t entrySize = dbQueryCacheStats(cache).bytes;
+    dbDetachQueryCache(db);
+    freeDbQueryCache(cache);
+
+    // room for a single result
+    size_t budget = entrySize + entrySize / 2;
+    cache = createDbQueryCache(budget, DB_QUERY_CACHE_TTL_MS);
+    dbAttachQueryCache(db, cache);
+
+    expect(titleLength(db, 1), toBe(1));
+    expect(titleLength(db, 2), toBe(1));
+
+    DbQueryCacheStats stats = dbQueryCacheStats(cache);
+    expect(stats.entries, toBe(1));
+    expect(stats.evictions, toBe(1));
+    expect(stats.bytes <= budget, toBe(true));
+
+    // the most recent one is kept
+    expect(titleLength(db, 2), toBe(1));
+    expect(dbQueryCacheStats(cache).hits, toBe(1));
+
+    dbClose(db);
+    freeDbQueryCache(cache);
+    removeTestDatabase(path);
+}
+
+void testSqlCacheWithWriter() {
+    char path[] = "/tmp/lavandula_cache_XXXXXX";
+    DbContext *db = openTodos(path);
+
+    DbQueryCache *cache = createDbQueryCache(DB_QUERY_CACHE_BUDGET, DB_QUERY_CACHE_TTL_MS);
+    dbAttachQueryCache(db, cache);
+
+    DbWriter *writer = createDbWriter(path, dbDefaultPragmas());
+    dbWriterUseQueryCache(writer, cache);
+
+    expect(titleLength(db, 2), toBe(1));
+    expect(dbWrite(writer, "update todos set title = 'bb' where id = 2;", NULL, 0), toBe(true));
+    expect(titleLength(db, 2), toBe(2));
+
+    freeDbWriter(writer);
+    dbClose(db);
+    freeDbQueryCache(cache);
+    removeTestDatabase(path);
+}
+
+void testSqlCacheWithoutCache() {
+    char path[] = "/tmp/lavandula_cache_XXXXXX";
+    DbContext *db = openTodos(path);
+
+    expect(titleLength(db, 1), toBe(1));
+    expect(dbCopyResult(NULL) == NULL, toBe(true));
+
+    dbClose(db);
+    removeTestDatabase(path);
+}
+
+void runSqlCacheTests() {
+    runTest(testSqlCacheHits);
+    runTest(testSqlCacheInvalidatesOnWrite);
+    runTest(testSqlCacheExpiresAndEvicts);
+    runTest(testSqlCacheWithWriter);
+    runTest(testSqlCacheWithoutCache);
+}
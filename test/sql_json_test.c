@@ -0,0 +1,192 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include "../src/include/lavandula_test.h"
+#include "../src/include/sql_json.h"
+#include "sql_test_helpers.h"
+
+static DbContext *todoDatabase() {
+    DbContext *db = openTodoDatabase(":memory:", "title text, completed boolean, score real, raw blob");
+
+    dbExec(db, "insert into todos (title, completed, score, raw) values ('Say \"hi\"', 1, 2.5, x'fbff00');", NULL, 0);
+    dbExec(db, "insert into todos (title, completed, score, raw) values (null, 0, 3, null);", NULL, 0);
+
+    return db;
+}
+
+void testSqlJsonWritesRowsAsObjects() {
+    DbContext *db = todoDatabase();
+    JsonWriter writer = jsonWriter();
+
+    jwObjectStart(&writer);
+    jwKey(&writer, "todos");
+    expect(dbQueryJson(db, "select id, title, completed, score, raw, id * 2 as \"say \"\"hi\"\"\" from todos;", NULL, 0, &writer), toBe(true));
+    jwObjectEnd(&writer);
+
+    char *json = jwTakeString(&writer);
+    expect(strcmp(json,
+        "{\"todos\":["
+        "{\"id\":1,\"title\":\"Say \\\"hi\\\"\",\"completed\":true,\"score\":2.5,\"raw\":\"+/8A\",\"say \\\"hi\\\"\":2},"
+        "{\"id\":2,\"title\":null,\"completed\":false,\"score\":3.0,\"raw\":null,\"say \\\"hi\\\"\":4}"
+        "]}"), toBe(0));
+
+    free(json);
+    freeJsonWriter(&writer);
+    dbClose(db);
+}
+
+void testSqlJsonObjectAndEmptyResults() {
+    DbContext *db = todoDatabase();
+    JsonWriter writer = jsonWriter();
+
+    jwArrayStart(&writer);
+    expect(dbQueryJsonObject(db, "select id, title from todos where id = ?;", DB_PARAMS(PARAM_INT(2)), 1, &writer), toBe(true));
+    expect(dbQueryJsonObject(db, "select id, title from todos where id = ?;", DB_PARAMS(PARAM_INT(9)), 1, &writer), toBe(true));
+    expect(dbQueryJson(db, "select id from todos where id > 9;", NULL, 0, &writer), toBe(true));
+    expect(dbQueryJson(db, "select * from missing;", NULL, 0, &writer), toBe(false));
+    jwArrayEnd(&writer);
+
+    char *json = jwTakeString(&writer);
+    expect(strcmp(json, "[{\"id\":2,\"title\":null},null,[],[]]"), toBe(0));
+
+    // the statement went back to the cache after stopping at the first row
+    unsigned long long hits = db->statements.hits;
+    expect(dbQueryJsonObject(db, "select id, title from todos where id = ?;", DB_PARAMS(PARAM_INT(1)), 1, &writer), toBe(true));
+    expect(db->statements.hits - hits, toBe(1));
+
+    free(json);
+    freeJsonWriter(&writer);
+    dbClose(db);
+}
+
+typedef struct {
+    int    socket;
+    char  *received;
+    size_t length;
+} Drain;
+
+// reads everything the other end sends, as a client would
+static void *drainSocket(void *arg) {
+    Drain *drain = arg;
+    size_t capacity = 1024 * 1024;
+    drain->received = malloc(capacity);
+
+    ssize_t n;
+    while ((n = read(drain->socket, drain->received + drain->length, capacity - drain->length - 1)) > 0) {
+        drain->length += n;
+
+        if (capacity - drain->length < 64 * 1024) {
+            capacity *= 2;
+            drain->received = realloc(drain->received, capacity);
+        }
+    }
+    drain->received[drain->length] = '\0';
+
+    return NULL;
+}
+
+// joins the chunks of a chunked body, false if the final chunk is missing
+static bool unchunk(const char *received, char *body) {
+    const char *p = strstr(received, "\r\n\r\n") + 4;
+    size_t length = 0;
+
+    while (*p) {
+        char *end;
+        size_t size = strtoul(p, &end, 16);
+        if (size == 0) {
+            body[length] = '\0';
+            return true;
+        }
+
+        memcpy(body + length, end + 2, size);
+        length += size;
+        p = end + 2 + size + 2;
+    }
+
+    body[length] = '\0';
+    return false;
+}
+
+void testSqlJsonStreamsLargeResults() {
+    DbContext *db = openTodoDatabase(":memory:", "title text");
+
+    dbExec(db, "begin;", NULL, 0);
+    for (int i = 0; i < 20000; i++) {
+        dbExec(db, "insert into todos (title) values ('Export this row');", NULL, 0);
+    }
+    dbExec(db, "commit;", NULL, 0);
+
+    int sockets[2];
+    expect(socketpair(AF_UNIX, SOCK_STREAM, 0, sockets), toBe(0));
+
+    Drain drain = { .socket = sockets[1] };
+    pthread_t reader;
+    pthread_create(&reader, NULL, drainSocket, &drain);
+
+    ResponseStream stream = responseStream(sockets[0]);
+    RequestContext ctx = { .db = db, .stream = &stream };
+
+    HttpResponse response = dbStreamJson(ctx, "select id, title from todos;", NULL, 0);
+    expect(response.streamed, toBe(true));
+    expect(stream.failed, toBe(false));
+
+    close(sockets[0]);
+    pthread_join(reader, NULL);
+    close(sockets[1]);
+
+    char *body = malloc(drain.length + 1);
+    expect(unchunk(drain.received, body), toBe(true));
+    expect(strncmp(body, "[{\"id\":1,\"title\":\"Export this row\"},{\"id\":2,", 44), toBe(0));
+    expect(strcmp(body + strlen(body) - 39, "{\"id\":20000,\"title\":\"Export this row\"}]"), toBe(0));
+
+    free(body);
+    free(drain.received);
+    dbClose(db);
+}
+
+void testSqlJsonStreamStopsWhenTheClientLeaves() {
+    DbContext *db = createSqlLite3DbContext(":memory:");
+
+    // the client went away, so the first chunk fails and stepping stops there
+    signal(SIGPIPE, SIG_IGN);
+
+    int sockets[2];
+    expect(socketpair(AF_UNIX, SOCK_STREAM, 0, sockets), toBe(0));
+    close(sockets[1]);
+
+    ResponseStream stream = responseStream(sockets[0]);
+    RequestContext ctx = { .db = db, .stream = &stream };
+
+    const char *query = "with recursive n(i) as (select 1 union all select i + 1 from n) select i from n;";
+    HttpResponse response = dbStreamJson(ctx, query, NULL, 0);
+
+    expect(response.streamed, toBe(true));
+    expect(stream.failed, toBe(true));
+    expect(db->statements.count, toBe(1));
+    expect(db->statements.entries[0].inUse, toBe(false));
+    close(sockets[0]);
+
+    // a query that cannot be prepared is answered before anything is streamed
+    expect(socketpair(AF_UNIX, SOCK_STREAM, 0, sockets), toBe(0));
+    stream = responseStream(sockets[0]);
+
+    response = dbStreamJson(ctx, "select * from missing;", NULL, 0);
+    expect(response.streamed, toBe(false));
+    expect(response.status, toBe(HTTP_INTERNAL_SERVER_ERROR));
+    expect(stream.started, toBe(false));
+
+    close(sockets[0]);
+    close(sockets[1]);
+    dbClose(db);
+}
+
+void runSqlJsonTests() {
+    runTest(testSqlJsonWritesRowsAsObjects);
+    runTest(testSqlJsonObjectAndEmptyResults);
+    runTest(testSqlJsonStreamsLargeResults);
+    runTest(testSqlJsonStreamStopsWhenTheClientLeaves);
+}
@@ -0,0 +1,104 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../src/include/lavandula_test.h"
+#include "../src/include/sql_plan.h"
+#include "sql_test_helpers.h"
+
+static DbContext *createTodos(DbPlanChecker *checker, int rows) {
+    DbContext *db = openTodoDatabase(":memory:", "title text, done integer");
+    dbExec(db, "create index todos_done on todos (done);", NULL, 0);
+
+    dbExec(db,
+        "insert into todos (id, title, done) "
+        "with recursive n(i) as (select 1 union all select i + 1 from n where i < ?) "
+        "select i, 'todo ' || (i % 7), i % 2 from n;",
+        DB_PARAMS(PARAM_INT(rows)), 1);
+
+    dbAttachPlanChecker(db, checker);
+    return db;
+}
+
+void testSqlPlanWarnsAboutFullScans() {
+    FILE *out = tmpfile();
+    DbPlanChecker *checker = createDbPlanChecker(out);
+    DbContext *db = createTodos(checker, 10);
+
+    int line = __LINE__ + 1;
+    DbResult *result = dbQueryRows(db, "select * from todos where title = ?;", DB_PARAMS(PARAM_TEXT("todo")), 1);
+    freeDbResult(result);
+
+    const DbPlanWarning *warnings;
+    expect(dbPlanWarnings(checker, &warnings), toBe(1));
+    expect(strstr(warnings[0].detail, "SCAN") != NULL, toBe(true));
+    expect(strcmp(warnings[0].file, __FILE__), toBe(0));
+    expect(warnings[0].line, toBe(line));
+
+    // the same statement is only checked once
+    result = dbQueryRows(db, "select * from todos where title = ?;", DB_PARAMS(PARAM_TEXT("todo")), 1);
+    freeDbResult(result);
+    expect(dbPlanWarnings(checker, &warnings), toBe(1));
+
+    // lookups by key or index, and reading a whole table, are fine
+    result = dbQueryRows(db, "select * from todos where id = ?;", DB_PARAMS(PARAM_INT(1)), 1);
+    freeDbResult(result);
+    result = dbQueryRows(db, "select * from todos where done = ?;", DB_PARAMS(PARAM_INT(1)), 1);
+    freeDbResult(result);
+    result = dbQueryRows(db, "select * from todos;", NULL, 0);
+    freeDbResult(result);
+    dbExec(db, "update todos set done = 1 where id = ?;", DB_PARAMS(PARAM_INT(1)), 1);
+
+    expect(dbPlanWarnings(checker, &warnings), toBe(1));
+
+    char buffer[1024] = { 0 };
+    rewind(out);
+    fread(buffer, 1, sizeof(buffer) - 1, out);
+    expect(strstr(buffer, "Query plan warning at ") != NULL, toBe(true));
+    expect(strstr(buffer, "select * from todos where title = ?;") != NULL, toBe(true));
+
+    dbClose(db);
+    freeDbPlanChecker(checker);
+    fclose(out);
+}
+
+void testSqlPlanWarnsAboutSortsOfLargeTables() {
+    FILE *out = tmpfile();
+    DbPlanChecker *checker = createDbPlanChecker(out);
+
+    // a small table sorts quickly
+    DbContext *db = createTodos(checker, 10);
+
+    DbResult *result = dbQueryRows(db, "select * from todos order by title;", NULL, 0);
+    freeDbResult(result);
+
+    const DbPlanWarning *warnings;
+    expect(dbPlanWarnings(checker, &warnings), toBe(0));
+    dbClose(db);
+
+    db = createTodos(checker, DB_PLAN_LARGE_TABLE_ROWS);
+
+    result = dbQueryRows(db, "select title, count(*) from todos group by title;", NULL, 0);
+    freeDbResult(result);
+
+    expect(dbPlanWarnings(checker, &warnings), toBe(1));
+    expect(strstr(warnings[0].detail, "TEMP B-TREE") != NULL, toBe(true));
+
+    FILE *report = tmpfile();
+    dbPlanReport(checker, report);
+
+    char buffer[1024] = { 0 };
+    rewind(report);
+    fread(buffer, 1, sizeof(buffer) - 1, report);
+    expect(strstr(buffer, "warnings") != NULL, toBe(true));
+    expect(strstr(buffer, "select title, count(*) from todos group by title;") != NULL, toBe(true));
+
+    fclose(report);
+    dbClose(db);
+    freeDbPlanChecker(checker);
+    fclose(out);
+}
+
+void runSqlPlanTests() {
+    runTest(testSqlPlanWarnsAboutFullScans);
+    runTest(testSqlPlanWarnsAboutSortsOfLargeTables);
+}
@@ -0,0 +1,144 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../src/include/lavandula_test.h"
+#include "../src/include/sql_shard.h"
+#include "sql_test_helpers.h"
+
+#define SHARDS 3
+
+typedef struct {
+    char        names[SHARDS][32];
+    const char *paths[SHARDS];
+} ShardFiles;
+
+static void createFiles(ShardFiles *files) {
+    for (int i = 0; i < SHARDS; i++) {
+        strcpy(files->names[i], "/tmp/lavandula_shard_XXXXXX");
+        createTestDatabase(files->names[i]);
+        files->paths[i] = files->names[i];
+    }
+}
+
+static void removeFiles(ShardFiles *files) {
+    for (int i = 0; i < SHARDS; i++) {
+        removeTestDatabase(files->names[i]);
+    }
+}
+
+void testSqlShardPlacesKeys() {
+    ShardFiles files;
+    createFiles(&files);
+
+    DbShards *shards = createDbShards(files.paths, SHARDS, dbDefaultPragmas());
+    expect(dbShardCount(shards), toBe(SHARDS));
+
+    // the same value is placed together whatever its type
+    expect(dbShardIndex(shards, PARAM_INT(42)), toBe(dbShardIndex(shards, PARAM_INT64(42))));
+    expect(dbShardIndex(shards, PARAM_NULL), toBe(-1));
+
+    int perShard[SHARDS] = { 0 };
+    for (int key = 0; key < 3000; key++) {
+        int index = dbShardIndex(shards, PARAM_INT(key));
+        if (index >= 0 && index < SHARDS) perShard[index]++;
+    }
+    for (int i = 0; i < SHARDS; i++) {
+        expect(perShard[i] > 800 && perShard[i] < 1200, toBe(true));
+    }
+
+    int text = dbShardIndex(shards, PARAM_TEXT("tenant-a"));
+    expect(text >= 0 && text < SHARDS, toBe(true));
+    expect(dbShardIndex(shards, PARAM_TEXT("tenant-a")), toBe(text));
+
+    freeDbShards(shards);
+
+    long long bounds[SHARDS - 1] = { 100, 200 };
+    shards = createDbRangeShards(files.paths, SHARDS, bounds, dbDefaultPragmas());
+
+    expect(dbShardIndex(shards, PARAM_INT(-5)), toBe(0));
+    expect(dbShardIndex(shards, PARAM_INT(99)), toBe(0));
+    expect(dbShardIndex(shards, PARAM_INT(100)), toBe(1));
+    expect(dbShardIndex(shards, PARAM_INT64(5000000000LL)), toBe(2));
+    expect(dbShardIndex(shards, PARAM_TEXT("tenant-a")), toBe(-1));
+
+    freeDbShards(shards);
+
+    // bounds are required for more than one shard, and must be ascending
+    expect(createDbRangeShards(files.paths, 2, NULL, dbDefaultPragmas()) == NULL, toBe(true));
+
+    long long descending[SHARDS - 1] = { 200, 100 };
+    expect(createDbRangeShards(files.paths, SHARDS, descending, dbDefaultPragmas()) == NULL, toBe(true));
+    removeFiles(&files);
+}
+
+void testSqlShardRoutesQueries() {
+    ShardFiles files;
+    createFiles(&files);
+
+    DbShards *shards = createDbShards(files.paths, SHARDS, dbDefaultPragmas());
+
+    expect(dbShardWriteAll(shards, "create table todos (id integer primary key, owner integer, title text);", NULL, 0), toBe(true));
+
+    for (int owner = 1; owner <= 30; owner++) {
+        DbParam key = PARAM_INT(owner);
+        expect(dbShardWrite(shards, key, "insert into todos (owner, title) values (?, 'todo');", DB_PARAMS(key), 1), toBe(true));
+    }
+
+    // a shard only holds the rows of its own keys
+    int total = 0;
+    for (int i = 0; i < SHARDS; i++) {
+        DbResult *rows = dbQueryRows(dbPoolConnection(dbShardPool(shards, i)), "select owner from todos;", NULL, 0);
+
+        for (int r = 0; r < rows->rowCount; r++) {
+            expect(dbShardIndex(shards, PARAM_INT(dbGetInt(rows, r, 0))), toBe(i));
+        }
+
+        total += rows->rowCount;
+        freeDbResult(rows);
+    }
+    expect(total, toBe(30));
+
+    DbResult *result = dbShardQueryRows(shards, PARAM_INT(7), "select owner from todos where owner = ?;", DB_PARAMS(PARAM_INT(7)), 1);
+    expect(result->rowCount, toBe(1));
+    expect(dbGetInt(result, 0, 0), toBe(7));
+    freeDbResult(result);
+
+    result = dbShardQueryAll(shards, "select owner, title from todos where owner > ?;", DB_PARAMS(PARAM_INT(10)), 1);
+    expect(result->rowCount, toBe(20));
+    expect(result->colCount, toBe(2));
+    expect(strcmp(dbGetText(result, 19, 1, NULL), "todo"), toBe(0));
+    freeDbResult(result);
+
+    freeDbShards(shards);
+    removeFiles(&files);
+}
+
+void testSqlQueryRowsAcross() {
+    DbContext *dbs[2] = { createSqlLite3DbContext(":memory:"), createSqlLite3DbContext(":memory:") };
+
+    dbExec(dbs[0], "create table t (v);", NULL, 0);
+    dbExec(dbs[1], "create table t (v);", NULL, 0);
+    dbExec(dbs[0], "insert into t values (1), (2);", NULL, 0);
+    dbExec(dbs[1], "insert into t values ('three');", NULL, 0);
+
+    // a column that holds numbers on one database and text on another is text
+    DbResult *result = dbQueryRowsAcross(dbs, 2, "select v from t;", NULL, 0);
+    expect(result->rowCount, toBe(3));
+    expect(result->columns[0].type, toBe(DB_COLUMN_TEXT));
+    expect(strcmp(dbGetText(result, 0, 0, NULL), "1"), toBe(0));
+    expect(strcmp(dbGetText(result, 2, 0, NULL), "three"), toBe(0));
+    freeDbResult(result);
+
+    dbExec(dbs[0], "create table u (a);", NULL, 0);
+    dbExec(dbs[1], "create table u (a, b);", NULL, 0);
+    expect(dbQueryRowsAcross(dbs, 2, "select * from u;", NULL, 0) == NULL, toBe(true));
+
+    dbClose(dbs[0]);
+    dbClose(dbs[1]);
+}
+
+void runSqlShardTests() {
+    runTest(testSqlShardPlacesKeys);
+    runTest(testSqlShardRoutesQueries);
+    runTest(testSqlQueryRowsAcross);
+}
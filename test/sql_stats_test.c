@@ -0,0 +1,139 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "../src/include/lavandula_test.h"
+#include "../src/include/sql_stats.h"
+
+static bool normalizesTo(const char *sql, const char *expected) {
+    char out[256];
+    dbNormalizeSql(sql, out);
+
+    return strcmp(out, expected) == 0;
+}
+
+void testSqlStatsNormalize() {
+    expect(normalizesTo("select * from todos where id = 42;", "select * from todos where id = ?;"), toBe(true));
+    expect(normalizesTo("  select\n\t title  from todos  ", "select title from todos"), toBe(true));
+    expect(normalizesTo("insert into t1 (a, b) values ('it''s', -1.5e+3);", "insert into t1 (a, b) values (?, -?);"), toBe(true));
+    expect(normalizesTo("select x'00ff', 0x1F, .5 from t2;", "select ?, ?, ? from t2;"), toBe(true));
+    expect(normalizesTo("select \"col 1\", [a b] from todos where id = ?;", "select \"col 1\", [a b] from todos where id = ?;"), toBe(true));
+}
+
+static DbStatementStats *findStatement(DbStatementStats *statements, int count, const char *sql) {
+    for (int i = 0; i < count; i++) {
+        if (strcmp(statements[i].sql, sql) == 0) return &statements[i];
+    }
+
+    return NULL;
+}
+
+void testSqlStatsCountsStatements() {
+    DbContext *db = createSqlLite3DbContext(":memory:");
+    DbStats *stats = createDbStats(-1, NULL);
+    dbAttachStats(db, stats);
+
+    dbExec(db, "create table todos (id integer primary key, title text);", NULL, 0);
+
+    // literals in the SQL are counted as one statement
+    char sql[128];
+    for (int i = 1; i <= 5; i++) {
+        snprintf(sql, sizeof(sql), "insert into todos (id, title) values (%d, 'todo %d');", i, i);
+        dbExec(db, sql, NULL, 0);
+    }
+
+    for (int i = 0; i < 3; i++) {
+        DbResult *result = dbQueryRows(db, "select * from todos where id > ?;", DB_PARAMS(PARAM_INT(2)), 1);
+        freeDbResult(result);
+    }
+
+    // a cursor closed early counts the rows it stepped
+    DbCursor cursor = dbQueryCursor(db, "select id from todos;", NULL, 0);
+    dbNext(&cursor);
+    dbNext(&cursor);
+    dbCloseCursor(&cursor);
+
+    DbStatementStats *statements;
+    int count = dbStatsStatements(stats, &statements);
+    expect(count, toBe(4));
+
+    DbStatementStats *insert = findStatement(statements, count, "insert into todos (id, title) values (?, ?);");
+    expect(insert != NULL, toBe(true));
+    expect(insert->calls, toBe(5));
+    expect(insert->rows, toBe(0));
+
+    DbStatementStats *select = findStatement(statements, count, "select * from todos where id > ?;");
+    expect(select != NULL, toBe(true));
+    expect(select->calls, toBe(3));
+    expect(select->rows, toBe(9));
+    expect(select->totalMs > 0, toBe(true));
+    expect(select->meanMs * 3 <= select->totalMs + 1e-9, toBe(true));
+    expect(select->p99Ms <= select->maxMs, toBe(true));
+
+    DbStatementStats *scan = findStatement(statements, count, "select id from todos;");
+    expect(scan != NULL && scan->rows == 2, toBe(true));
+
+    // most total time first
+    for (int i = 1; i < count; i++) {
+        expect(statements[i - 1].totalMs >= statements[i].totalMs, toBe(true));
+    }
+
+    free(statements);
+
+    dbStatsReset(stats);
+    count = dbStatsStatements(stats, &statements);
+    expect(count, toBe(0));
+    free(statements);
+
+    dbClose(db);
+    freeDbStats(stats);
+}
+
+void testSqlStatsSlowQueryLog() {
+    FILE *log = tmpfile();
+
+    DbContext *db = createSqlLite3DbContext(":memory:");
+    DbStats *stats = createDbStats(0, log);
+    dbAttachStats(db, stats);
+
+    dbExec(db, "create table todos (id integer primary key, title text);", NULL, 0);
+    dbExec(db, "insert into todos (id, title) values (?, ?);", DB_PARAMS(PARAM_INT(7), PARAM_TEXT("slow")), 2);
+
+    // bound parameters are written in place
+    char buffer[1024] = { 0 };
+    rewind(log);
+    fread(buffer, 1, sizeof(buffer) - 1, log);
+
+    expect(strstr(buffer, "Slow query (") != NULL, toBe(true));
+    expect(strstr(buffer, "values (7, 'slow');") != NULL, toBe(true));
+
+    FILE *dump = tmpfile();
+    dbStatsDump(stats, dump);
+
+    memset(buffer, 0, sizeof(buffer));
+    rewind(dump);
+    fread(buffer, 1, sizeof(buffer) - 1, dump);
+
+    expect(strstr(buffer, "p99 ms") != NULL, toBe(true));
+    expect(strstr(buffer, "insert into todos (id, title) values (?, ?);") != NULL, toBe(true));
+
+    fclose(dump);
+
+    // detached connections are no longer timed
+    dbDetachStats(db);
+    dbExec(db, "delete from todos;", NULL, 0);
+
+    DbStatementStats *statements;
+    expect(dbStatsStatements(stats, &statements), toBe(2));
+    free(statements);
+
+    dbClose(db);
+    freeDbStats(stats);
+    fclose(log);
+}
+
+void runSqlStatsTests() {
+    runTest(testSqlStatsNormalize);
+    runTest(testSqlStatsCountsStatements);
+    runTest(testSqlStatsSlowQueryLog);
+}
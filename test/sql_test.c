@@ -0,0 +1,392 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "../src/include/lavandula_test.h"
+#include "../src/include/sql.h"
+#include "sql_test_helpers.h"
+
+static DbContext *todoDatabase() {
+    return openTodoDatabase(":memory:", "title text, completed integer");
+}
+
+void testSqlExecAndQuery() {
+    DbContext *db = todoDatabase();
+
+    for (int i = 0; i < 3; i++) {
+        char title[32];
+        snprintf(title, sizeof(title), "todo %d", i);
+
+        DbParam *params = DB_PARAMS(PARAM_TEXT(title), PARAM_BOOL(i % 2 == 0));
+        expect(dbExec(db, "insert into todos (title, completed) values (?, ?);", params, 2), toBe(true));
+    }
+
+    DbResult *result = dbQueryRows(db, "select id, title from todos where completed = ?;", DB_PARAMS(PARAM_INT(1)), 1);
+    expect(result->rowCount, toBe(2));
+    expect(strcmp(dbGetText(result, 1, 1, NULL), "todo 2"), toBe(0));
+    freeDbResult(result);
+
+    expect(dbExec(db, "insert into missing values (1);", NULL, 0), toBe(false));
+    expect(dbQueryRows(db, "select * from missing;", NULL, 0) == NULL, toBe(true));
+
+    dbClose(db);
+}
+
+void testSqlStatementCacheReusesStatements() {
+    DbContext *db = todoDatabase();
+    unsigned long long misses = db->statements.misses;
+
+    const char *insert = "insert into todos (title, completed) values (?, 0);";
+    for (int i = 0; i < 10; i++) {
+        dbExec(db, insert, DB_PARAMS(PARAM_TEXT("x")), 1);
+    }
+
+    expect(db->statements.misses - misses, toBe(1));
+    expect(db->statements.hits, toBe(9));
+
+    // the same text at another address is found by its hash, and bindings do not carry over
+    char copy[128];
+    strcpy(copy, "select count(*) from todos where title = ?;");
+
+    DbResult *result = dbQueryRows(db, copy, DB_PARAMS(PARAM_TEXT("x")), 1);
+    expect(dbGetInt64(result, 0, 0), toBe(10));
+    freeDbResult(result);
+
+    result = dbQueryRows(db, "select count(*) from todos where title = ?;", NULL, 0);
+    expect(dbGetInt64(result, 0, 0), toBe(0));
+    freeDbResult(result);
+
+    expect(db->statements.hits, toBe(10));
+
+    // a statement that failed to step is reset and works next time
+    dbExec(db, "create unique index todos_title on todos (title, id);", NULL, 0);
+    const char *insertId = "insert into todos (id, title) values (?, 'y');";
+
+    expect(dbExec(db, insertId, DB_PARAMS(PARAM_INT(1)), 1), toBe(false));
+    expect(dbExec(db, insertId, DB_PARAMS(PARAM_INT(100)), 1), toBe(true));
+
+    dbClose(db);
+}
+
+void testSqlStatementCacheEvictsLeastRecentlyUsed() {
+    DbContext *db = todoDatabase();
+    dbSetStatementCacheSize(db, 2);
+
+    const char *a = "select 1;";
+    const char *b = "select 2;";
+    const char *c = "select 3;";
+
+    freeDbResult(dbQueryRows(db, a, NULL, 0));
+    freeDbResult(dbQueryRows(db, b, NULL, 0));
+    freeDbResult(dbQueryRows(db, a, NULL, 0));
+
+    // b is the least recently used, so c takes its place
+    freeDbResult(dbQueryRows(db, c, NULL, 0));
+    expect(db->statements.count, toBe(2));
+
+    unsigned long long hits = db->statements.hits;
+    freeDbResult(dbQueryRows(db, a, NULL, 0));
+    expect(db->statements.hits - hits, toBe(1));
+
+    unsigned long long misses = db->statements.misses;
+    freeDbResult(dbQueryRows(db, b, NULL, 0));
+    expect(db->statements.misses - misses, toBe(1));
+
+    dbSetStatementCacheSize(db, 0);
+    expect(db->statements.count, toBe(0));
+
+    DbResult *result = dbQueryRows(db, c, NULL, 0);
+    expect(dbGetInt64(result, 0, 0), toBe(3));
+    freeDbResult(result);
+    expect(db->statements.count, toBe(0));
+
+    dbClose(db);
+}
+
+void testSqlTypedResult() {
+    DbContext *db = createSqlLite3DbContext(":memory:");
+    dbExec(db, "create table readings (id integer primary key, sensor text, value real, raw blob, note);", NULL, 0);
+
+    dbExec(db, "insert into readings (sensor, value, raw, note) values ('a', 1.5, x'00ff', 'x');", NULL, 0);
+    dbExec(db, "insert into readings (sensor, value, raw, note) values (null, 2, null, 7);", NULL, 0);
+    dbExec(db, "insert into readings (sensor, value, raw, note) values ('c', null, null, 0.25);", NULL, 0);
+    dbExec(db, "insert into readings (id, sensor) values (?, 'big');", DB_PARAMS(PARAM_INT64(5000000000LL)), 1);
+
+    DbResult *result = dbQueryRows(db, "select id, sensor, value, raw, note, null as empty from readings order by id;", NULL, 0);
+    expect(result->rowCount, toBe(4));
+    expect(result->colCount, toBe(6));
+
+    expect(strcmp(result->columns[0].name, "id"), toBe(0));
+    expect(strcmp(result->columns[2].declType, "REAL"), toBe(0));
+    expect(result->columns[5].declType == NULL, toBe(true));
+    expect(dbColumnIndex(result, "note"), toBe(4));
+    expect(dbColumnIndex(result, "missing"), toBe(-1));
+
+    expect(result->columns[0].type, toBe(DB_COLUMN_INTEGER));
+    expect(result->columns[1].type, toBe(DB_COLUMN_TEXT));
+    expect(result->columns[2].type, toBe(DB_COLUMN_FLOAT));
+    expect(result->columns[3].type, toBe(DB_COLUMN_BLOB));
+    expect(result->columns[4].type, toBe(DB_COLUMN_TEXT));
+    expect(result->columns[5].type, toBe(DB_COLUMN_NULL));
+
+    expect(dbGetInt64(result, 3, 0) == 5000000000LL, toBe(true));
+    expect(dbGetInt(result, 0, 0), toBe(1));
+
+    expect(strcmp(dbGetText(result, 0, 1, NULL), "a"), toBe(0));
+    expect(dbIsNull(result, 1, 1), toBe(true));
+    expect(dbGetText(result, 1, 1, NULL) == NULL, toBe(true));
+
+    // integers in a float column are read as doubles, NULL reads as 0
+    expect(dbGetDouble(result, 0, 2) == 1.5, toBe(true));
+    expect(dbGetDouble(result, 1, 2) == 2.0, toBe(true));
+    expect(dbGetInt64(result, 1, 2), toBe(2));
+    expect(dbIsNull(result, 2, 2), toBe(true));
+    expect(dbGetDouble(result, 2, 2) == 0, toBe(true));
+
+    int length;
+    const char *raw = dbGetText(result, 0, 3, &length);
+    expect(length, toBe(2));
+    expect((unsigned char)raw[1], toBe(0xff));
+
+    // numbers in a mixed column are kept as text
+    expect(strcmp(dbGetText(result, 1, 4, NULL), "7"), toBe(0));
+    expect(strcmp(dbGetText(result, 2, 4, NULL), "0.25"), toBe(0));
+    expect(dbGetInt64(result, 1, 4), toBe(7));
+    expect(dbGetDouble(result, 2, 4) == 0.25, toBe(true));
+
+    expect(dbIsNull(result, 0, 5), toBe(true));
+    expect(dbGetInt64(result, 0, 100), toBe(0));
+    expect(dbIsNull(result, 4, 0), toBe(true));
+    expect(dbGetText(result, 1, 0, NULL) == NULL, toBe(true));
+
+    freeDbResult(result);
+
+    // enough rows and text to outgrow the space on the stack
+    dbExec(db, "begin;", NULL, 0);
+    for (int i = 0; i < 300; i++) {
+        dbExec(db, "insert into readings (sensor, value) values ('a longer sensor name to fill the text buffer', ?);", DB_PARAMS(PARAM_DOUBLE(i / 4.0)), 1);
+    }
+    dbExec(db, "commit;", NULL, 0);
+
+    result = dbQueryRows(db, "select sensor, value from readings where id > 5000000000;", NULL, 0);
+    expect(result->rowCount, toBe(300));
+
+    bool same = true;
+    double total = 0;
+    for (int r = 0; r < result->rowCount; r++) {
+        same = same && strcmp(dbGetText(result, r, 0, NULL), "a longer sensor name to fill the text buffer") == 0;
+        total += dbGetDouble(result, r, 1);
+    }
+
+    expect(same, toBe(true));
+    expect(total == 299 * 300 / 8.0, toBe(true));
+    freeDbResult(result);
+
+    result = dbQueryRows(db, "select id from readings where id < 0;", NULL, 0);
+    expect(result->rowCount, toBe(0));
+    expect(strcmp(result->columns[0].name, "id"), toBe(0));
+    freeDbResult(result);
+
+    dbClose(db);
+}
+
+void testSqlExecMany() {
+    DbContext *db = todoDatabase();
+
+    DbParam params[200];
+    for (int i = 0; i < 100; i++) {
+        params[i * 2] = PARAM_INT(i + 1);
+        params[i * 2 + 1] = PARAM_BOOL(i % 2);
+    }
+
+    expect(dbExecMany(db, "insert into todos (id, title, completed) values (?, 'todo', ?);", params, 2, 100), toBe(true));
+
+    DbResult *result = dbQueryRows(db, "select count(*), sum(completed) from todos;", NULL, 0);
+    expect(dbGetInt(result, 0, 0), toBe(100));
+    expect(dbGetInt(result, 0, 1), toBe(50));
+    freeDbResult(result);
+
+    // the last row has an id that is already taken, so none of them are written
+    params[0] = PARAM_INT(101);
+    params[2] = PARAM_INT(102);
+    params[4] = PARAM_INT(1);
+    expect(dbExecMany(db, "insert into todos (id, title, completed) values (?, 'todo', ?);", params, 2, 3), toBe(false));
+
+    result = dbQueryRows(db, "select count(*) from todos;", NULL, 0);
+    expect(dbGetInt(result, 0, 0), toBe(100));
+    freeDbResult(result);
+
+    // inside a transaction the rows are part of it
+    dbExec(db, "begin;", NULL, 0);
+    expect(dbExecMany(db, "insert into todos (id, title, completed) values (?, 'todo', ?);", params, 2, 2), toBe(true));
+    dbExec(db, "rollback;", NULL, 0);
+
+    result = dbQueryRows(db, "select count(*) from todos;", NULL, 0);
+    expect(dbGetInt(result, 0, 0), toBe(100));
+    freeDbResult(result);
+
+    dbClose(db);
+}
+
+static void *threadConnection(void *pool) {
+    return dbPoolConnection(pool);
+}
+
+static DbContext *connectionFromThread(DbPool *pool) {
+    pthread_t thread;
+    void *db;
+
+    pthread_create(&thread, NULL, threadConnection, pool);
+    pthread_join(thread, &db);
+
+    return db;
+}
+
+void testSqlPoolGivesEachThreadAConnection() {
+    char path[] = "/tmp/lavandula_pool_XXXXXX";
+    createTestDatabase(path);
+
+    DbPool *pool = createDbPool(path, 2, dbDefaultPragmas());
+    expect(pool != NULL, toBe(true));
+
+    DbContext *db = dbPoolConnection(pool);
+    expect(db != NULL, toBe(true));
+    expect(dbPoolConnection(pool) == db, toBe(true));
+
+    DbResult *result = dbQueryRows(db, "pragma journal_mode;", NULL, 0);
+    expect(strcmp(dbGetText(result, 0, 0, NULL), "wal"), toBe(0));
+    freeDbResult(result);
+
+    result = dbQueryRows(db, "pragma synchronous;", NULL, 0);
+    expect(dbGetInt64(result, 0, 0), toBe(1));
+    freeDbResult(result);
+
+    // a thread gets its own connection, and hands it back when it exits
+    DbContext *other = connectionFromThread(pool);
+    expect(other != NULL && other != db, toBe(true));
+    expect(connectionFromThread(pool) == other, toBe(true));
+
+    // both connections see the same database
+    dbExec(db, "create table todos (id integer primary key, title text);", NULL, 0);
+    dbExec(other, "insert into todos (title) values ('from another connection');", NULL, 0);
+
+    result = dbQueryRows(db, "select title from todos;", NULL, 0);
+    expect(result->rowCount, toBe(1));
+    freeDbResult(result);
+
+    freeDbPool(pool);
+
+    // the pool is exhausted while every connection is held by a live thread
+    pool = createDbPool(path, 1, dbDefaultPragmas());
+    expect(connectionFromThread(pool) == NULL, toBe(true));
+    freeDbPool(pool);
+    removeTestDatabase(path);
+}
+
+struct Scan {
+    int rows;
+    long long total;
+    bool sawNull;
+};
+
+static void sumRow(int colCount, char **colNames, char **colValues, void *userData) {
+    struct Scan *scan = userData;
+
+    if (colCount != 2 || strcmp(colNames[0], "id") != 0 || strcmp(colNames[1], "title") != 0) return;
+
+    scan->rows++;
+    scan->total += atoll(colValues[0]);
+    if (!colValues[1]) scan->sawNull = true;
+}
+
+void testSqlQueryEach() {
+    DbContext *db = todoDatabase();
+
+    dbExec(db, "insert into todos (title) values ('a'), ('b'), (null);", NULL, 0);
+
+    struct Scan scan = { 0 };
+    expect(dbQueryEach(db, "select id, title from todos where id > ?;", DB_PARAMS(PARAM_INT(0)), 1, sumRow, &scan), toBe(true));
+    expect(scan.rows, toBe(3));
+    expect(scan.total, toBe(6));
+    expect(scan.sawNull, toBe(true));
+
+    expect(dbQueryEach(db, "select * from missing;", NULL, 0, sumRow, &scan), toBe(false));
+
+    dbClose(db);
+}
+
+void testSqlCursor() {
+    DbContext *db = todoDatabase();
+
+    dbExec(db, "begin;", NULL, 0);
+    for (int i = 0; i < 1000; i++) {
+        dbExec(db, "insert into todos (title, completed) values ('todo', ?);", DB_PARAMS(PARAM_BOOL(i % 4 == 0)), 1);
+    }
+    dbExec(db, "commit;", NULL, 0);
+
+    const char *query = "select id, title, completed, id * 0.5 from todos where completed = ?;";
+
+    DbCursor cursor = dbQueryCursor(db, query, DB_PARAMS(PARAM_BOOL(true)), 1);
+    expect(cursor.colCount, toBe(4));
+    expect(strcmp(dbColumnName(&cursor, 1), "title"), toBe(0));
+
+    int rows = 0;
+    long long ids = 0;
+    double halves = 0;
+
+    while (dbNext(&cursor)) {
+        int length;
+        const char *title = dbColumnText(&cursor, 1, &length);
+
+        if (strcmp(title, "todo") == 0 && length == 4 && dbColumnInt64(&cursor, 2) == 1) rows++;
+        ids += dbColumnInt64(&cursor, 0);
+        halves += dbColumnDouble(&cursor, 3);
+    }
+
+    expect(rows, toBe(250));
+    expect(halves == ids * 0.5, toBe(true));
+    expect(cursor.failed, toBe(false));
+    expect(cursor.statement == NULL, toBe(true));
+
+    // a loop that stops early closes the cursor, and the statement can be used again
+    cursor = dbQueryCursor(db, query, DB_PARAMS(PARAM_BOOL(false)), 1);
+    expect(dbNext(&cursor), toBe(true));
+    expect(dbColumnIsNull(&cursor, 1), toBe(false));
+    dbCloseCursor(&cursor);
+    dbCloseCursor(&cursor);
+
+    unsigned long long hits = db->statements.hits;
+
+    cursor = dbQueryCursor(db, query, DB_PARAMS(PARAM_BOOL(false)), 1);
+    rows = 0;
+    while (dbNext(&cursor)) rows++;
+
+    expect(rows, toBe(750));
+    expect(db->statements.hits - hits, toBe(1));
+
+    // the same query inside a running cursor gets its own statement
+    cursor = dbQueryCursor(db, "select id from todos where id <= 2;", NULL, 0);
+    rows = 0;
+    while (dbNext(&cursor)) {
+        DbCursor inner = dbQueryCursor(db, "select id from todos where id <= 2;", NULL, 0);
+        while (dbNext(&inner)) rows++;
+    }
+    expect(rows, toBe(4));
+
+    cursor = dbQueryCursor(db, "select * from missing;", NULL, 0);
+    expect(cursor.failed, toBe(true));
+    expect(dbNext(&cursor), toBe(false));
+
+    dbClose(db);
+}
+
+void runSqlTests() {
+    runTest(testSqlExecAndQuery);
+    runTest(testSqlStatementCacheReusesStatements);
+    runTest(testSqlStatementCacheEvictsLeastRecentlyUsed);
+    runTest(testSqlTypedResult);
+    runTest(testSqlExecMany);
+    runTest(testSqlPoolGivesEachThreadAConnection);
+    runTest(testSqlQueryEach);
+    runTest(testSqlCursor);
+}
@@ -0,0 +1,28 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "sql_test_helpers.h"
+
+void createTestDatabase(char *path) {
+    close(mkstemp(path));
+}
+
+void removeTestDatabase(const char *path) {
+    char sidecar[256];
+
+    snprintf(sidecar, sizeof(sidecar), "%s-wal", path);
+    unlink(sidecar);
+    snprintf(sidecar, sizeof(sidecar), "%s-shm", path);
+    unlink(sidecar);
+    unlink(path);
+}
+
+DbContext *openTodoDatabase(const char *path, const char *columns) {
+    char schema[256];
+    snprintf(schema, sizeof(schema), "create table todos (id integer primary key, %s);", columns);
+
+    DbContext *db = createSqlLite3DbContext((char *)path);
+    dbExec(db, schema, NULL, 0);
+
+    return db;
+}
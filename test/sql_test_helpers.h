@@ -0,0 +1,20 @@
+#ifndef sql_test_helpers_h
+#define sql_test_helpers_h
+
+#include "../src/include/sql.h"
+
+/*
+** Temporary databases shared by the SQL tests.
+*/
+
+// creates an empty database file from a mkstemp template such as "/tmp/lavandula_sql_XXXXXX"
+void createTestDatabase(char *path);
+
+// deletes a database file along with its -wal and -shm sidecars
+void removeTestDatabase(const char *path);
+
+// opens the database at path, ":memory:" included, with a todos table of the given columns
+// after its integer primary key id
+DbContext *openTodoDatabase(const char *path, const char *columns);
+
+#endif
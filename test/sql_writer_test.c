@@ -0,0 +1,195 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "../src/include/lavandula_test.h"
+#include "../src/include/sql_writer.h"
+#include "sql_test_helpers.h"
+
+static long long countRows(const char *path, const char *query) {
+    DbContext *db = createSqlLite3DbContext((char *)path);
+    DbResult *result = dbQueryRows(db, query, NULL, 0);
+
+    long long count = dbGetInt64(result, 0, 0);
+
+    freeDbResult(result);
+    dbClose(db);
+
+    return count;
+}
+
+void testSqlWriterRunsWrites() {
+    char path[] = "/tmp/lavandula_writer_XXXXXX";
+    createTestDatabase(path);
+
+    DbWriter *writer = createDbWriter(path, dbDefaultPragmas());
+    expect(writer != NULL, toBe(true));
+
+    expect(dbWrite(writer, "create table todos (id integer primary key, title text);", NULL, 0), toBe(true));
+    expect(dbWrite(writer, "insert into todos (id, title) values (?, ?);", DB_PARAMS(PARAM_INT(1), PARAM_TEXT("a")), 2), toBe(true));
+    expect(dbWrite(writer, "insert into todos (id, title) values (?, ?);", DB_PARAMS(PARAM_INT(1), PARAM_TEXT("b")), 2), toBe(false));
+
+    DbWriterStats stats = dbWriterStats(writer);
+    expect(stats.writes, toBe(3));
+    expect(stats.batches, toBe(3));
+    expect(stats.failed, toBe(1));
+
+    freeDbWriter(writer);
+
+    expect(countRows(path, "select count(*) from todos;"), toBe(1));
+    expect(dbWrite(NULL, "select 1;", NULL, 0), toBe(false));
+
+    removeTestDatabase(path);
+}
+
+typedef struct {
+    DbWriter   *writer;
+    int         id;
+    bool        ok;
+
+    // the insert to run, the plain one when NULL
+    const char *query;
+} Writer;
+
+static pthread_mutex_t startedLock = PTHREAD_MUTEX_INITIALIZER;
+static int started;
+static bool holding;
+
+// holds up its batch until the other threads are about to queue their writes
+static bool holdBatch(DbContext *db, void *threads) {
+    (void)db;
+
+    pthread_mutex_lock(&startedLock);
+    holding = true;
+    pthread_mutex_unlock(&startedLock);
+
+    for (int i = 0; i < 1000; i++) {
+        pthread_mutex_lock(&startedLock);
+        bool all = started == *(int *)threads;
+        pthread_mutex_unlock(&startedLock);
+
+        if (all) break;
+        usleep(1000);
+    }
+
+    usleep(20 * 1000);
+    return true;
+}
+
+static int holdFor;
+
+static void *holdWriter(void *arg) {
+    dbWriteWith(arg, holdBatch, &holdFor);
+    return NULL;
+}
+
+// queues a write that holds up the writer until threads more are about to queue theirs
+static void holdWriterFor(DbWriter *writer, pthread_t *holder, int threads) {
+    started = 0;
+    holding = false;
+    holdFor = threads;
+
+    pthread_create(holder, NULL, holdWriter, writer);
+
+    for (bool held = false; !held; usleep(1000)) {
+        pthread_mutex_lock(&startedLock);
+        held = holding;
+        pthread_mutex_unlock(&startedLock);
+    }
+}
+
+static void *insertTodo(void *arg) {
+    Writer *w = arg;
+
+    pthread_mutex_lock(&startedLock);
+    started++;
+    pthread_mutex_unlock(&startedLock);
+
+    const char *query = w->query ? w->query : "insert into todos (id, title) values (?, 'todo');";
+    w->ok = dbWrite(w->writer, query, DB_PARAMS(PARAM_INT(w->id)), 1);
+    return NULL;
+}
+
+void testSqlWriterBatchesConcurrentWrites() {
+    char path[] = "/tmp/lavandula_writer_XXXXXX";
+    createTestDatabase(path);
+
+    DbWriter *writer = createDbWriter(path, dbDefaultPragmas());
+    dbWrite(writer, "create table todos (id integer primary key, title text);", NULL, 0);
+
+    pthread_t holder;
+    holdWriterFor(writer, &holder, 8);
+
+    // these queue up while the writer is busy and run as one batch
+    pthread_t threads[8];
+    Writer writers[8];
+
+    for (int i = 0; i < 8; i++) {
+        // ids 1 and 2 are written twice, the second of each fails without failing the others
+        writers[i] = (Writer) { .writer = writer, .id = i % 6 + 1 };
+        pthread_create(&threads[i], NULL, insertTodo, &writers[i]);
+    }
+
+    int ok = 0;
+    for (int i = 0; i < 8; i++) {
+        pthread_join(threads[i], NULL);
+        ok += writers[i].ok;
+    }
+    pthread_join(holder, NULL);
+
+    expect(ok, toBe(6));
+    expect(countRows(path, "select count(*) from todos;"), toBe(6));
+
+    DbWriterStats stats = dbWriterStats(writer);
+    expect(stats.writes, toBe(10));
+    expect(stats.failed, toBe(2));
+    expect(stats.batches <= 4, toBe(true));
+
+    freeDbWriter(writer);
+    removeTestDatabase(path);
+}
+
+void testSqlWriterFailsBatchWhenTransactionEnds() {
+    char path[] = "/tmp/lavandula_writer_XXXXXX";
+    createTestDatabase(path);
+
+    DbWriter *writer = createDbWriter(path, dbDefaultPragmas());
+    dbWrite(writer, "create table todos (id integer primary key, title text);", NULL, 0);
+    dbWrite(writer, "insert into todos (id, title) values (1, 'todo');", NULL, 0);
+
+    pthread_t holder;
+    holdWriterFor(writer, &holder, 2);
+
+    // the conflict rolls back the whole batch, the other insert included
+    pthread_t threads[2];
+    Writer writers[2] = {
+        { .writer = writer, .id = 1, .query = "insert or rollback into todos (id, title) values (?, 'todo');" },
+        { .writer = writer, .id = 2 },
+    };
+
+    for (int i = 0; i < 2; i++) {
+        pthread_create(&threads[i], NULL, insertTodo, &writers[i]);
+    }
+    for (int i = 0; i < 2; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    pthread_join(holder, NULL);
+
+    expect(writers[0].ok, toBe(false));
+    expect(writers[1].ok, toBe(false));
+    expect(countRows(path, "select count(*) from todos;"), toBe(1));
+
+    // so a caller that retries writes its row once
+    expect(dbWrite(writer, "insert into todos (id, title) values (2, 'todo');", NULL, 0), toBe(true));
+    expect(countRows(path, "select count(*) from todos;"), toBe(2));
+
+    freeDbWriter(writer);
+    removeTestDatabase(path);
+}
+
+void runSqlWriterTests() {
+    runTest(testSqlWriterRunsWrites);
+    runTest(testSqlWriterBatchesConcurrentWrites);
+    runTest(testSqlWriterFailsBatchWhenTransactionEnds);
+}
@@ -10,6 +10,22 @@ void runAuthTests();
 void runJsonTests();
 void runBase64Tests();
 void runCorsTests();
+void runGzipTests();
+void runJsonWriterTests();
+void runJsonCursorTests();
+void runJsonNumberTests();
+void runJsonShapeTests();
+void runJsonStringTests();
+void runJsonStructTests();
+void runValidatorTests();
+void runSqlTests();
+void runSqlJsonTests();
+void runSqlWriterTests();
+void runSqlCacheTests();
+void runSqlAsyncTests();
+void runSqlStatsTests();
+void runSqlPlanTests();
+void runSqlShardTests();
 
 int main() {
     testsRan = 0;
@@ -24,6 +40,22 @@ int main() {
     runJsonTests();
     runBase64Tests();
     runCorsTests();
+    runGzipTests();
+    runJsonWriterTests();
+    runJsonCursorTests();
+    runJsonNumberTests();
+    runJsonShapeTests();
+    runJsonStringTests();
+    runJsonStructTests();
+    runValidatorTests();
+    runSqlTests();
+    runSqlJsonTests();
+    runSqlWriterTests();
+    runSqlCacheTests();
+    runSqlAsyncTests();
+    runSqlStatsTests();
+    runSqlPlanTests();
+    runSqlShardTests();
 
     printf("=== Lavandula Test Results ===\n");
     testResults();
@@ -0,0 +1,189 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../src/include/lavandula_test.h"
+#include "../src/include/json.h"
+#include "../src/include/validator.h"
+
+static bool check(JsonValidator *v, const char *json) {
+    return validateJson(v, json, strlen(json));
+}
+
+static bool failsWith(JsonValidator *v, const char *json, const char *error) {
+    return !check(v, json) && v->error && strcmp(v->error, error) == 0;
+}
+
+void testValidatorRequired() {
+    JsonValidator v = createValidator();
+    required(&v, "username");
+    required(&v, "password");
+
+    expect(check(&v, "{\"username\": \"ada\", \"password\": null}"), toBe(true));
+    expect(failsWith(&v, "{\"username\": \"ada\"}", "The field 'password' is required."), toBe(true));
+    expect(failsWith(&v, "{}", "The field 'username' is required."), toBe(true));
+
+    // the same validator is used again after a failure and a success
+    expect(check(&v, "{\"password\": \"x\", \"username\": \"y\"}"), toBe(true));
+    expect(v.error == NULL, toBe(true));
+
+    freeValidator(&v);
+}
+
+void testValidatorTypes() {
+    const char *roles[] = { "admin", "member" };
+
+    JsonValidator v = createValidator();
+    isString(&v, "name", 2, 5);
+    isInteger(&v, "age", 0, 150);
+    isNumber(&v, "score", 0, 1);
+    isBool(&v, "active");
+    isOneOf(&v, "role", roles, 2);
+    isArray(&v, "tags", 3);
+
+    expect(check(&v, "{\"name\": \"Ada\", \"age\": 36, \"score\": 0.5, \"active\": true, \"role\": \"admin\", \"tags\": [1, \"a\", {}]}"), toBe(true));
+
+    // fields without a rule can hold anything, and fields with a rule may be left out
+    expect(check(&v, "{\"other\": [{\"age\": \"old\"}]}"), toBe(true));
+
+    expect(failsWith(&v, "{\"name\": \"A\"}", "The field 'name' must be a string of 2 to 5 characters."), toBe(true));
+    expect(failsWith(&v, "{\"name\": \"Adelaide\"}", "The field 'name' must be a string of 2 to 5 characters."), toBe(true));
+    expect(failsWith(&v, "{\"name\": 12}", "The field 'name' must be a string of 2 to 5 characters."), toBe(true));
+
+    // lengths are in characters, escapes and multi byte characters count once
+    expect(check(&v, "{\"name\": \"\xc3\xa9\xc3\xa9\xc3\xa9\xc3\xa9\xc3\xa9\"}"), toBe(true));
+    expect(check(&v, "{\"name\": \"\\u00e9\\n\\\"\\ud83d\\ude00\"}"), toBe(true));
+
+    expect(failsWith(&v, "{\"age\": 151}", "The field 'age' must be an integer from 0 to 150."), toBe(true));
+    expect(failsWith(&v, "{\"age\": 3.5}", "The field 'age' must be an integer from 0 to 150."), toBe(true));
+    expect(failsWith(&v, "{\"score\": 2}", "The field 'score' must be a number from 0 to 1."), toBe(true));
+    expect(failsWith(&v, "{\"active\": \"yes\"}", "The field 'active' must be true or false."), toBe(true));
+    expect(failsWith(&v, "{\"role\": \"owner\"}", "The field 'role' must be one of: 'admin', 'member'."), toBe(true));
+    expect(check(&v, "{\"role\": \"\\u0061dmin\"}"), toBe(true));
+    expect(failsWith(&v, "{\"tags\": [1, 2, 3, 4]}", "The field 'tags' must be an array of at most 3 items."), toBe(true));
+    expect(failsWith(&v, "{\"tags\": {}}", "The field 'tags' must be an array of at most 3 items."), toBe(true));
+
+    freeValidator(&v);
+}
+
+void testValidatorNestedObjects() {
+    JsonValidator v = createValidator();
+    required(&v, "address.city");
+    isString(&v, "address.city", 1, 50);
+    isInteger(&v, "address.geo.zoom", 1, 20);
+
+    expect(check(&v, "{\"address\": {\"city\": \"Oslo\", \"geo\": {\"zoom\": 3}}}"), toBe(true));
+    expect(failsWith(&v, "{}", "The field 'address.city' is required."), toBe(true));
+    expect(failsWith(&v, "{\"address\": {}}", "The field 'address.city' is required."), toBe(true));
+    expect(failsWith(&v, "{\"address\": {\"city\": \"\"}}", "The field 'address.city' must be a string of 1 to 50 characters."), toBe(true));
+    expect(failsWith(&v, "{\"address\": {\"city\": \"Oslo\", \"geo\": {\"zoom\": 0}}}", "The field 'address.geo.zoom' must be an integer from 1 to 20."), toBe(true));
+    expect(failsWith(&v, "{\"address\": \"Oslo\"}", "The field 'address.city' is required."), toBe(true));
+
+    freeValidator(&v);
+}
+
+void testValidatorRejectsMalformedBodies() {
+    const char *malformed = "Request body is missing or malformed.";
+
+    JsonValidator v = createValidator();
+    isString(&v, "name", 0, 10);
+
+    const char *invalid[] = {
+        "",
+        "[]",
+        "{\"name\": \"a\"",
+        "{\"name\": \"a\",}",
+        "{\"name\" \"a\"}",
+        "{\"name\": \"a\"} {}",
+        "{\"other\": tru}",
+        "{\"other\": 01}",
+        "{\"other\": \"line\nbreak\"}",
+        "{\"other\": \"\\q\"}",
+        "{\"other\": \"\xc3\x28\"}",
+        "{\"other\": [1, 2,]}",
+    };
+
+    for (size_t i = 0; i < sizeof(invalid) / sizeof(invalid[0]); i++) {
+        expect(failsWith(&v, invalid[i], malformed), toBe(true));
+    }
+
+    expect(validate(&v, NULL), toBe(false));
+    expect(strcmp(v.error, malformed), toBe(0));
+
+    maxBodyLength(&v, 16);
+    expect(check(&v, "{\"name\": \"abc\"}"), toBe(true));
+    expect(failsWith(&v, "{\"name\": \"abcdefg\"}", "Request body is too large."), toBe(true));
+
+    freeValidator(&v);
+}
+
+void testValidatorChecksBodiesWithoutParsing() {
+    JsonValidator v = createValidator();
+    required(&v, "id");
+    isInteger(&v, "id", 1, 100);
+    compileValidator(&v);
+
+    const char *json = "{\"id\": 5}";
+    JsonBuilder *body = jsonParseLazy(json, strlen(json));
+
+    expect(validate(&v, body), toBe(true));
+    expect(body->isPending, toBe(true));
+    expect(jsonGetInteger(body, "id"), toBe(5));
+
+    // parsed, and then modified bodies are checked too
+    expect(validate(&v, body), toBe(true));
+    jsonPutInteger(body, "id", 500);
+    expect(validate(&v, body), toBe(false));
+
+    freeJsonBuilder(body);
+
+    // rules added later are picked up
+    isBool(&v, "admin");
+    expect(check(&v, "{\"id\": 1, \"admin\": 1}"), toBe(false));
+
+    freeValidator(&v);
+}
+
+// writes every character of text as a \u00XX escape
+static char *escapeAll(char *out, const char *text) {
+    for (; *text; text++) out += sprintf(out, "\\u%04x", (unsigned char)*text);
+    return out;
+}
+
+void testValidatorUnescapesLongKeys() {
+    const char *key = "customer_shipping_address_postal_code_value";
+    const char *code = "postal_code_in_the_old_format_used_before_the_reform";
+
+    JsonValidator v = createValidator();
+    isInteger(&v, key, 0, 10);
+    isOneOf(&v, "format", &code, 1);
+
+    // both escaped texts are longer than 256 bytes
+    char json[1024];
+    char *end = json + sprintf(json, "{\"");
+    end = escapeAll(end, key);
+    end += sprintf(end, "\": 5, \"format\": \"");
+    end = escapeAll(end, code);
+    sprintf(end, "\"}");
+    expect(check(&v, json), toBe(true));
+
+    end = json + sprintf(json, "{\"");
+    end = escapeAll(end, key);
+    sprintf(end, "\": \"five\"}");
+    expect(check(&v, json), toBe(false));
+
+    sprintf(json, "{\"format\": \"");
+    end = escapeAll(json + strlen(json), "postal_code_in_the_new_format_used_after_the_reform__");
+    sprintf(end, "\"}");
+    expect(check(&v, json), toBe(false));
+
+    freeValidator(&v);
+}
+
+void runValidatorTests() {
+    runTest(testValidatorRequired);
+    runTest(testValidatorTypes);
+    runTest(testValidatorNestedObjects);
+    runTest(testValidatorRejectsMalformedBodies);
+    runTest(testValidatorChecksBodiesWithoutParsing);
+    runTest(testValidatorUnescapesLongKeys);
+}